@@ -1,4 +1,5 @@
 #include "AST.h"
+#include "CompilerStats.h"
 
 // Function to create a new AST node
 ASTNode *createASTNode(NodeType type)
@@ -11,8 +12,11 @@ ASTNode *createASTNode(NodeType type)
     }
 
     node->type = type;
+    node->probe = 0;
+    node->value.strValue = NULL; // Call nodes print it without setting it
     node->children = NULL;
     node->childCount = 0;
+    compilerStats.astNodes++;
 
     printf("AST: Node created with type %s\n", nodeTypeToString(type));
     return node;
@@ -43,6 +47,7 @@ void addChildNode(ASTNode *parent, ASTNode *child)
            nodeTypeToString(child->type), nodeTypeToString(parent->type));
 
     parent->childCount++;
+    compilerStats.childReallocs++;
     parent->children = realloc(parent->children, sizeof(ASTNode *) * parent->childCount);
     if (!parent->children)
     {
@@ -55,13 +60,15 @@ void addChildNode(ASTNode *parent, ASTNode *child)
            nodeTypeToString(child->type), nodeTypeToString(parent->type));
 }
 
-// Function to free an AST
+// Function to free an AST, with the identifiers its variables and parameters own
 void freeAST(ASTNode *node)
 {
     for (int i = 0; i < node->childCount; i++)
     {
         freeAST(node->children[i]);
     }
+    if (node->type == AST_VARIABLE || node->type == AST_PARAMETER)
+        free(node->value.strValue);
     free(node->children);
     free(node);
 }
@@ -108,6 +115,8 @@ const char *nodeTypeToString(NodeType type)
         return "AST_ARGUMENTS";
     case AST_PARAMETER_LIST:
         return "AST_PARAMETER_LIST";
+    case AST_FLOAT_LITERAL:
+        return "AST_FLOAT_LITERAL";
     case AST_UNEXPECTED:
         return "AST_UNEXPECTED";
 
@@ -134,6 +143,9 @@ void printNodeValue(ASTNode *node)
     case AST_LITERAL:
         printf("%d", node->value.intValue); // Assuming int literals for simplicity
         break;
+    case AST_FLOAT_LITERAL:
+        printf("%g", node->value.floatValue);
+        break;
     case AST_VARIABLE:
     case AST_FUNCTION_CALL:
         printf("%s", node->value.strValue);
@@ -164,7 +176,8 @@ void printAST(ASTNode *node, int level)
         printf("Unknown NodeType (%d)", node->type);
     }
 
-    if (node->type == AST_LITERAL || node->type == AST_VARIABLE || node->type == AST_FUNCTION_CALL)
+    if (node->type == AST_LITERAL || node->type == AST_FLOAT_LITERAL || node->type == AST_VARIABLE ||
+        node->type == AST_FUNCTION_CALL)
     {
         printf(" (");
         printNodeValue(node);
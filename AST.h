@@ -27,6 +27,7 @@ typedef enum
     AST_BLOCK,
     AST_ARGUMENTS,
     AST_PARAMETER_LIST,
+    AST_FLOAT_LITERAL,
     AST_UNEXPECTED
 } NodeType;
 
@@ -36,7 +37,13 @@ typedef enum
     OP_MINUS,
     OP_MULTIPLY,
     OP_DIVIDE,
-    OP_NEGATE
+    OP_NEGATE,
+    OP_LESS,
+    OP_LESS_EQUAL,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_EQUAL,
+    OP_NOT_EQUAL
 } OperatorType;
 
 // Define the type of value that a node can hold
@@ -53,6 +60,7 @@ typedef union
 typedef struct ASTNode
 {
     NodeType type;
+    int probe; // Ifs, loops and calls: ordinal in their function for profiles, from 1; 0 if unnumbered
     Value value;
     struct ASTNode **children;
     int childCount;
@@ -0,0 +1,201 @@
+#include "AsmEmitter.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static AsmEmitter *allocateEmitter(size_t capacity, AsmSinkWrite write, void *context)
+{
+    AsmEmitter *emitter = calloc(1, sizeof(AsmEmitter));
+    if (!emitter)
+    {
+        perror("Failed to allocate emitter");
+        exit(EXIT_FAILURE);
+    }
+    emitter->buffer = malloc(capacity);
+    if (!emitter->buffer)
+    {
+        perror("Failed to allocate emitter buffer");
+        exit(EXIT_FAILURE);
+    }
+    emitter->capacity = capacity;
+    emitter->write = write;
+    emitter->context = context;
+    emitter->fd = -1;
+    return emitter;
+}
+
+static int writeToFd(void *context, const char *data, size_t length)
+{
+    int fd = ((AsmEmitter *)context)->fd;
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+static int writeToStream(void *context, const char *data, size_t length)
+{
+    FILE *stream = ((AsmEmitter *)context)->stream;
+    return fwrite(data, 1, length, stream) == length ? 0 : -1;
+}
+
+AsmEmitter *createFdEmitter(int fd)
+{
+    AsmEmitter *emitter = allocateEmitter(ASM_EMITTER_BUFFER_SIZE, writeToFd, NULL);
+    emitter->context = emitter;
+    emitter->fd = fd;
+    return emitter;
+}
+
+AsmEmitter *createFileEmitter(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return NULL;
+    AsmEmitter *emitter = createFdEmitter(fd);
+    emitter->ownsFd = 1;
+    return emitter;
+}
+
+// For stdout and other streams that also carry printf output, so ordering is kept
+AsmEmitter *createStreamEmitter(FILE *stream)
+{
+    AsmEmitter *emitter = allocateEmitter(ASM_EMITTER_BUFFER_SIZE, writeToStream, NULL);
+    emitter->context = emitter;
+    emitter->stream = stream;
+    return emitter;
+}
+
+AsmEmitter *createMemoryEmitter()
+{
+    return allocateEmitter(ASM_EMITTER_BUFFER_SIZE, NULL, NULL);
+}
+
+AsmEmitter *createCustomEmitter(AsmSinkWrite write, void *context)
+{
+    return allocateEmitter(ASM_EMITTER_BUFFER_SIZE, write, context);
+}
+
+static void sendToSink(AsmEmitter *emitter, const char *data, size_t length)
+{
+    if (emitter->error || length == 0)
+        return;
+    errno = 0;
+    if (emitter->write(emitter->context, data, length) != 0)
+        emitter->error = errno ? errno : EIO;
+    emitter->flushCount++;
+}
+
+void flushEmitter(AsmEmitter *emitter)
+{
+    if (!emitter->write)
+        return;
+    sendToSink(emitter, emitter->buffer, emitter->length);
+    emitter->length = 0;
+    if (emitter->stream)
+        fflush(emitter->stream);
+}
+
+void emitBytes(AsmEmitter *emitter, const char *data, size_t length)
+{
+    emitter->bytesEmitted += length;
+    if (emitter->capacity - emitter->length >= length)
+    {
+        memcpy(emitter->buffer + emitter->length, data, length);
+        emitter->length += length;
+        return;
+    }
+
+    if (!emitter->write)
+    {
+        size_t capacity = emitter->capacity;
+        while (capacity - emitter->length < length)
+            capacity *= 2;
+        char *grown = realloc(emitter->buffer, capacity);
+        if (!grown)
+        {
+            perror("Failed to grow emitter buffer");
+            exit(EXIT_FAILURE);
+        }
+        emitter->buffer = grown;
+        emitter->capacity = capacity;
+        memcpy(emitter->buffer + emitter->length, data, length);
+        emitter->length += length;
+        return;
+    }
+
+    sendToSink(emitter, emitter->buffer, emitter->length);
+    emitter->length = 0;
+    if (length >= emitter->capacity)
+    {
+        sendToSink(emitter, data, length); // Too big to stage; write it straight through
+        return;
+    }
+    memcpy(emitter->buffer, data, length);
+    emitter->length = length;
+}
+
+void emitString(AsmEmitter *emitter, const char *text)
+{
+    emitBytes(emitter, text, strlen(text));
+}
+
+// Digits are produced right to left into a scratch buffer; no printf involved
+void emitInt(AsmEmitter *emitter, int value)
+{
+    char digits[12];
+    char *end = digits + sizeof(digits);
+    char *start = end;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do
+    {
+        *--start = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0)
+        *--start = '-';
+    emitBytes(emitter, start, (size_t)(end - start));
+}
+
+// Memory sinks only; the returned text is NUL terminated and owned by the emitter
+const char *getEmitterContents(AsmEmitter *emitter, size_t *length)
+{
+    emitChar(emitter, '\0');
+    emitter->length--;
+    emitter->bytesEmitted--;
+    if (length)
+        *length = emitter->length;
+    return emitter->buffer;
+}
+
+// Lets a memory emitter be reused for the next unit without reallocating
+void resetEmitter(AsmEmitter *emitter)
+{
+    emitter->length = 0;
+    emitter->bytesEmitted = 0;
+    emitter->flushCount = 0;
+    emitter->error = 0;
+}
+
+// Flushes, releases the sink and returns 0, or the errno of the first failed write
+int closeEmitter(AsmEmitter *emitter)
+{
+    flushEmitter(emitter);
+    int error = emitter->error;
+    if (emitter->ownsFd && close(emitter->fd) != 0 && !error)
+        error = errno;
+    free(emitter->buffer);
+    free(emitter);
+    return error;
+}
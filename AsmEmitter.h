@@ -0,0 +1,51 @@
+#ifndef ASM_EMITTER_H
+#define ASM_EMITTER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Bytes staged before a flush to a file, fd or custom sink
+#define ASM_EMITTER_BUFFER_SIZE (1 << 16)
+
+// Writes all of data or returns -1; context is whatever the sink was created with
+typedef int (*AsmSinkWrite)(void *context, const char *data, size_t length);
+
+typedef struct AsmEmitter
+{
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    AsmSinkWrite write; // NULL for memory sinks, which grow instead of flushing
+    void *context;
+    int fd;
+    FILE *stream;
+    int ownsFd;
+    int error;          // errno of the first failed write; later output is dropped
+    size_t bytesEmitted;
+    size_t flushCount;
+} AsmEmitter;
+
+AsmEmitter *createFileEmitter(const char *path);
+AsmEmitter *createFdEmitter(int fd);
+AsmEmitter *createStreamEmitter(FILE *stream);
+AsmEmitter *createMemoryEmitter();
+AsmEmitter *createCustomEmitter(AsmSinkWrite write, void *context);
+
+void emitBytes(AsmEmitter *emitter, const char *data, size_t length);
+void emitString(AsmEmitter *emitter, const char *text);
+void emitInt(AsmEmitter *emitter, int value);
+void flushEmitter(AsmEmitter *emitter);
+const char *getEmitterContents(AsmEmitter *emitter, size_t *length);
+void resetEmitter(AsmEmitter *emitter);
+int closeEmitter(AsmEmitter *emitter);
+
+// Hot path for single characters; everything else goes through emitBytes
+static inline void emitChar(AsmEmitter *emitter, char c)
+{
+    if (emitter->length == emitter->capacity)
+        emitBytes(emitter, &c, 1);
+    else
+        emitter->buffer[emitter->length++] = c;
+}
+
+#endif // ASM_EMITTER_H
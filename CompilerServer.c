@@ -0,0 +1,484 @@
+#define _GNU_SOURCE // struct ucred
+#include "CompilerServer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <malloc.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAX_WORKERS 64
+#define MAX_REQUEST (1 << 16)
+// Heap an idle worker faults in for its compile before a request arrives
+#define WARM_HEAP (1 << 20)
+
+typedef struct Worker
+{
+    pid_t pid;
+    int connection; // Kept open by the server to send the exit status
+} Worker;
+
+static Worker workers[MAX_WORKERS];
+static int workerCount = 0;
+static int childPipe[2]; // SIGCHLD wakes the poll loop through this
+static const char *listeningPath;
+static struct stat listeningSocket; // What this process bound there, so only that is removed
+static int listener = -1;
+// A worker forked ahead of the next request, warmed and waiting for its
+// connection on idleChannel
+static pid_t idlePid = 0;
+static int idleChannel = -1;
+
+// The compiler's code, as GNU ld labels it
+extern char __executable_start[];
+extern char etext[];
+
+static void onChildExit(int number)
+{
+    int savedErrno = errno;
+    char wake = 0;
+    if (write(childPipe[1], &wake, 1) < 0)
+    {
+        // Full pipe: a wake-up is already pending
+    }
+    errno = savedErrno;
+}
+
+static void onTerminate(int number)
+{
+    struct stat current;
+    if (lstat(listeningPath, &current) == 0 && current.st_dev == listeningSocket.st_dev &&
+        current.st_ino == listeningSocket.st_ino)
+        unlink(listeningPath);
+    _exit(EXIT_SUCCESS);
+}
+
+// Sends each finished worker's status to its client; with block set, waits for at least one
+static void reapWorkers(int block)
+{
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, block ? 0 : WNOHANG)) > 0)
+    {
+        block = 0;
+        unsigned char code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        if (pid == idlePid)
+        {
+            close(idleChannel); // Died before any request reached it
+            idlePid = 0;
+        }
+        for (int i = 0; i < workerCount; i++)
+        {
+            if (workers[i].pid != pid)
+                continue;
+            send(workers[i].connection, &code, 1, MSG_NOSIGNAL); // The client may be gone
+            close(workers[i].connection);
+            workers[i] = workers[--workerCount];
+            break;
+        }
+    }
+}
+
+// Reads a whole request into buffer and takes the descriptors sent with it; returns 0 on success
+static int receiveRequest(int connection, char *buffer, int fds[3])
+{
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec data = {buffer, MAX_REQUEST};
+    struct msghdr message = {0};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t length = recvmsg(connection, &message, 0);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (length <= 0 || !header || header->cmsg_type != SCM_RIGHTS ||
+        header->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+        return -1;
+    memcpy(fds, CMSG_DATA(header), 3 * sizeof(int));
+
+    // The rest of a long request can arrive in later reads; it ends with an empty string
+    size_t received = length;
+    for (;;)
+    {
+        size_t start = 0;
+        while (start < received && buffer[start])
+            start += strnlen(buffer + start, received - start) + 1;
+        if (start < received)
+            return 0;
+        if (received == MAX_REQUEST)
+            return -1;
+        length = read(connection, buffer + received, MAX_REQUEST - received);
+        if (length <= 0)
+            return -1;
+        received += length;
+    }
+}
+
+// Faults in the compiler's code and a heap for the compile, so that the request
+// does not wait for the page faults a freshly forked process takes
+static void warmWorker()
+{
+    mallopt(M_MMAP_THRESHOLD, WARM_HEAP + 1); // The heap is carved from brk and kept
+    mallopt(M_TRIM_THRESHOLD, 2 * WARM_HEAP);
+    char *heap = malloc(WARM_HEAP);
+    if (heap)
+    {
+        for (long i = 0; i < WARM_HEAP; i += 4096)
+            heap[i] = 0;
+        free(heap);
+    }
+    volatile char sum = 0;
+    for (char *page = __executable_start; page < etext; page += 4096)
+        sum += *page;
+}
+
+// Sends connection, or with connection -1 receives it; returns it or -1
+static int passConnection(int channel, int connection)
+{
+    char control[CMSG_SPACE(sizeof(int))] = {0};
+    char byte = 0;
+    struct iovec data = {&byte, 1};
+    struct msghdr message = {0};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (connection >= 0)
+    {
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(header), &connection, sizeof(int));
+        return sendmsg(channel, &message, MSG_NOSIGNAL) == 1 ? connection : -1;
+    }
+    ssize_t length;
+    do
+        length = recvmsg(channel, &message, 0);
+    while (length < 0 && errno == EINTR);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (length != 1 || !header || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(int)))
+        return -1;
+    memcpy(&connection, CMSG_DATA(header), sizeof(int));
+    return connection;
+}
+
+static void runWorker(int connection, CompileFunction compile)
+{
+    char *request = malloc(MAX_REQUEST);
+    char **argv = malloc(sizeof(char *) * (MAX_REQUEST / 2 + 1));
+    int fds[3];
+    if (!request || !argv || receiveRequest(connection, request, fds) != 0)
+        _exit(127);
+    close(connection);
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (fds[i] != i)
+        {
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+    }
+    // The server never touched stdout, so it can still take the client's buffering
+    setvbuf(stdout, NULL, isatty(STDOUT_FILENO) ? _IOLBF : _IOFBF, BUFSIZ);
+
+    char *directory = request;
+    int argc = 0;
+    for (char *arg = directory + strlen(directory) + 1; *arg; arg += strlen(arg) + 1)
+        argv[argc++] = arg;
+    argv[argc] = NULL;
+    if (chdir(directory) != 0)
+    {
+        perror("Failed to enter the client's directory");
+        exit(EXIT_FAILURE);
+    }
+    exit(compile(argc, argv));
+}
+
+// Forks the idle worker for the next request. It warms up unless a request is
+// already waiting for it, then runs that request and exits.
+static void startIdleWorker(CompileFunction compile)
+{
+    int channel[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel) != 0)
+        return; // Requests fork their workers as they come
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(listener);
+        close(childPipe[0]);
+        close(childPipe[1]);
+        close(channel[0]);
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        struct pollfd pending = {channel[1], POLLIN, 0};
+        if (poll(&pending, 1, 0) == 0)
+            warmWorker();
+        int connection = passConnection(channel[1], -1);
+        if (connection < 0)
+            _exit(EXIT_SUCCESS); // The server stopped
+        close(channel[1]);
+        runWorker(connection, compile);
+    }
+    close(channel[1]);
+    if (pid < 0)
+    {
+        perror("Failed to fork compile worker");
+        close(channel[0]);
+        return;
+    }
+    idlePid = pid;
+    idleChannel = channel[0];
+}
+
+// Only the server's own user may have it compile, since a worker writes files as that user
+static int fromSameUser(int connection)
+{
+    struct ucred peer;
+    socklen_t length = sizeof(peer);
+    if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0)
+    {
+        fprintf(stderr, "SERVER: Refused a request, cannot read peer credentials: %s\n", strerror(errno));
+        return 0;
+    }
+    if (peer.uid == geteuid())
+        return 1;
+    fprintf(stderr, "SERVER: Refused a request from uid %d\n", (int)peer.uid);
+    return 0;
+}
+
+// Removes a socket left behind by a server that was killed. Anything else at the
+// path, or a server still answering there, is an error rather than replaced.
+static int clearStaleSocket(const char *socketPath, const struct sockaddr_un *address)
+{
+    struct stat existing;
+    if (lstat(socketPath, &existing) != 0)
+        return 1; // Nothing there
+    if (!S_ISSOCK(existing.st_mode))
+    {
+        fprintf(stderr, "Not a socket, refusing to replace: %s\n", socketPath);
+        return 0;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    int live = probe >= 0 && connect(probe, (const struct sockaddr *)address, sizeof(*address)) == 0;
+    if (probe >= 0)
+        close(probe);
+    if (live)
+    {
+        fprintf(stderr, "A compiler server is already listening on %s\n", socketPath);
+        return 0;
+    }
+    if (unlink(socketPath) != 0)
+    {
+        perror("Failed to remove stale compiler socket");
+        return 0;
+    }
+    return 1;
+}
+
+int serveCompiler(const char *socketPath, CompileFunction compile, WarmFunction warm)
+{
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return 1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    if (!clearStaleSocket(socketPath, &address))
+        return 1;
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t mask = umask(0177); // Only the owner may connect: the socket is created 0600
+    int bound = listener >= 0 && bind(listener, (struct sockaddr *)&address, sizeof(address)) == 0;
+    umask(mask);
+    if (!bound || listen(listener, SOMAXCONN) != 0 || lstat(socketPath, &listeningSocket) != 0)
+    {
+        perror("Failed to listen on compiler socket");
+        return 1;
+    }
+    if (pipe(childPipe) != 0)
+    {
+        perror("Failed to create pipe");
+        return 1;
+    }
+    fcntl(childPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(childPipe[1], F_SETFL, O_NONBLOCK);
+
+    listeningPath = socketPath;
+    struct sigaction action = {0};
+    action.sa_handler = onChildExit;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, NULL);
+    action.sa_handler = onTerminate;
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    if (warm)
+        warm();
+    startIdleWorker(compile);
+    fprintf(stderr, "SERVER: Listening on %s\n", socketPath);
+
+    for (;;)
+    {
+        struct pollfd events[2] = {{listener, POLLIN, 0}, {childPipe[0], POLLIN, 0}};
+        if (poll(events, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Failed to wait for compile requests");
+            return 1;
+        }
+        if (events[1].revents & POLLIN)
+        {
+            char wakes[64];
+            while (read(childPipe[0], wakes, sizeof(wakes)) > 0)
+                ;
+            int running = workerCount;
+            reapWorkers(0);
+            if (warm && workerCount < running)
+                warm(); // Picks up what the finished workers left, such as new cache entries
+            if (!idlePid)
+                startIdleWorker(compile);
+        }
+        if (!(events[0].revents & POLLIN))
+            continue;
+
+        if (workerCount == MAX_WORKERS)
+            reapWorkers(1);
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0)
+            continue;
+        if (!fromSameUser(connection))
+        {
+            close(connection);
+            continue;
+        }
+        if (idlePid)
+        {
+            // The next idle worker is forked once this request is done
+            pid_t idle = idlePid;
+            int handed = passConnection(idleChannel, connection) >= 0;
+            close(idleChannel);
+            idlePid = 0;
+            if (handed)
+            {
+                workers[workerCount].pid = idle;
+                workers[workerCount].connection = connection;
+                workerCount++;
+                continue;
+            }
+        }
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(listener);
+            close(childPipe[0]);
+            close(childPipe[1]);
+            signal(SIGCHLD, SIG_DFL);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+            runWorker(connection, compile);
+        }
+        if (pid < 0)
+        {
+            perror("Failed to fork compile worker");
+            close(connection);
+            continue;
+        }
+        workers[workerCount].pid = pid;
+        workers[workerCount].connection = connection;
+        workerCount++;
+    }
+}
+
+int requestCompile(const char *socketPath, int argc, char *argv[], const int fds[3])
+{
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    char directory[PATH_MAX];
+    if (!getcwd(directory, sizeof(directory)))
+        return -1;
+    size_t size = strlen(directory) + 2;
+    for (int i = 0; i < argc; i++)
+        size += strlen(argv[i]) + 1;
+    if (size > MAX_REQUEST)
+    {
+        errno = E2BIG;
+        return -1;
+    }
+    char *request = malloc(size);
+    if (!request)
+        return -1;
+    char *end = stpcpy(request, directory) + 1;
+    for (int i = 0; i < argc; i++)
+        end = stpcpy(end, argv[i]) + 1;
+    *end = '\0';
+
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0 || connect(connection, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        int savedErrno = errno;
+        if (connection >= 0)
+            close(connection);
+        free(request);
+        errno = savedErrno;
+        return -1;
+    }
+
+    char control[CMSG_SPACE(3 * sizeof(int))] = {0};
+    struct iovec data = {request, size};
+    struct msghdr message = {0};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(header), fds, 3 * sizeof(int));
+
+    ssize_t sent = sendmsg(connection, &message, MSG_NOSIGNAL);
+    while (sent > 0 && (size_t)sent < size)
+    {
+        ssize_t more = send(connection, request + sent, size - sent, MSG_NOSIGNAL);
+        sent = more > 0 ? sent + more : more;
+    }
+    free(request);
+
+    unsigned char status;
+    ssize_t received = -1;
+    if (sent > 0)
+    {
+        do
+            received = read(connection, &status, 1);
+        while (received < 0 && errno == EINTR);
+    }
+    close(connection);
+    if (received != 1)
+    {
+        errno = ECONNRESET;
+        return -1;
+    }
+    return status;
+}
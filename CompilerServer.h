@@ -0,0 +1,25 @@
+#ifndef COMPILER_SERVER_H
+#define COMPILER_SERVER_H
+
+// A compile request is the client's working directory and arguments, NUL-terminated
+// and ended by an empty string, sent with the client's stdin, stdout and stderr
+// attached. The server answers with one byte, the compile's exit status.
+typedef int (*CompileFunction)(int argc, char *argv[]);
+// Loads what workers should find in memory; run before the first request and
+// again whenever workers finish
+typedef void (*WarmFunction)(void);
+
+// Listens on socketPath, created 0600, and runs compile once per request in a
+// worker forked from this process, chdir'ed to the client's directory and writing
+// to its stdout and stderr. The worker for the next request is forked ahead and
+// faults in its code and heap while it waits. A worker exits after its request,
+// so all of a request's memory goes with it. Requests from other users are
+// refused. A stale socket at the path is replaced, but not a file or a live
+// server's socket. Only returns on failure to set up the socket.
+int serveCompiler(const char *socketPath, CompileFunction compile, WarmFunction warm);
+
+// Sends one request and waits for it; returns the exit status, or -1 with errno set
+// when the server cannot be reached or drops the request
+int requestCompile(const char *socketPath, int argc, char *argv[], const int fds[3]);
+
+#endif // COMPILER_SERVER_H
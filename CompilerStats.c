@@ -0,0 +1,191 @@
+#include "CompilerStats.h"
+#include "Options.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_PHASE_DEPTH 16
+
+_Thread_local CompilerStats compilerStats;
+
+static const char *phaseNames[PHASE_COUNT] = {
+    "other", "lex", "parse", "symbols", "ir", "boundsChecks", "select", "regalloc",
+    "mips", "peephole", "schedule", "delaySlots", "simulate", "cache", "write", "dump"};
+
+static _Thread_local CompilerPhase phaseStack[MAX_PHASE_DEPTH] = {PHASE_OTHER};
+static _Thread_local int phaseDepth = 0;
+static double startTime;
+static _Thread_local double chargedUntil; // Time up to which the phase on top of the stack has been charged
+static _Thread_local FILE *diagnosticsOut = NULL;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Gives the phase on top of the stack the time since it was last charged
+static void chargeCurrentPhase()
+{
+    double time = now();
+    compilerStats.phases[phaseStack[phaseDepth]].seconds += time - chargedUntil;
+    chargedUntil = time;
+}
+
+void startCompilerStats()
+{
+    startTime = chargedUntil = now();
+}
+
+void enterPhase(CompilerPhase phase)
+{
+    if (compilerOptions.timePhases)
+        chargeCurrentPhase();
+    if (phaseDepth + 1 < MAX_PHASE_DEPTH)
+        phaseStack[++phaseDepth] = phase;
+}
+
+void leavePhase()
+{
+    if (compilerOptions.timePhases)
+        chargeCurrentPhase();
+    if (phaseDepth > 0)
+        phaseDepth--;
+}
+
+void addCompilerStats(CompilerStats *into, const CompilerStats *from)
+{
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        into->phases[p].allocations += from->phases[p].allocations;
+        into->phases[p].allocatedBytes += from->phases[p].allocatedBytes;
+    }
+    into->tokens += from->tokens;
+    into->astNodes += from->astNodes;
+    into->childReallocs += from->childReallocs;
+    into->symbolsAdded += from->symbolsAdded;
+    into->symbolLookups += from->symbolLookups;
+    into->symbolProbes += from->symbolProbes;
+    into->irInstructions += from->irInstructions;
+    into->temps += from->temps;
+    into->labels += from->labels;
+    into->values += from->values;
+    into->valuesInRegisters += from->valuesInRegisters;
+    into->spills += from->spills;
+    into->spillReloads += from->spillReloads;
+    into->spillStores += from->spillStores;
+    into->mipsInstructions += from->mipsInstructions;
+    into->cacheHits += from->cacheHits;
+    into->cacheMisses += from->cacheMisses;
+    into->cacheStores += from->cacheStores;
+    into->cacheEvictions += from->cacheEvictions;
+}
+
+FILE *diagnostics()
+{
+    return diagnosticsOut ? diagnosticsOut : stdout;
+}
+
+void setDiagnostics(FILE *out)
+{
+    diagnosticsOut = out;
+}
+
+#ifdef COUNT_ALLOCATIONS
+// Counting allocator hook, only in builds made with -DCOUNT_ALLOCATIONS: glibc
+// lets a program interpose malloc, and its own callers (strdup, stdio) go through
+// the interposed one too. free and the aligned allocators stay glibc's, which is
+// the same heap. Sanitizer and valgrind builds interpose malloc themselves, so
+// they leave the flag out.
+#ifndef __GLIBC__
+#error "COUNT_ALLOCATIONS needs glibc's __libc_malloc"
+#endif
+static const int countsAllocations = 1;
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+static void countAllocation(size_t bytes)
+{
+    PhaseStats *phase = &compilerStats.phases[phaseStack[phaseDepth]];
+    phase->allocations++;
+    phase->allocatedBytes += bytes;
+}
+
+void *malloc(size_t size)
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    countAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+#else
+static const int countsAllocations = 0;
+#endif
+
+static void writeJsonString(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (; *text; text++)
+    {
+        if (*text == '"' || *text == '\\')
+            fputc('\\', out);
+        if ((unsigned char)*text < 0x20)
+            fprintf(out, "\\u%04x", *text);
+        else
+            fputc(*text, out);
+    }
+    fputc('"', out);
+}
+
+void writeCompilerStats(FILE *out)
+{
+    if (compilerOptions.timePhases)
+        chargeCurrentPhase();
+
+    fprintf(out, "{\"input\": ");
+    writeJsonString(out, compilerOptions.inputFile);
+    if (compilerOptions.timePhases)
+        fprintf(out, ", \"seconds\": %.6f", now() - startTime);
+
+    fprintf(out, ", \"phases\": {");
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        PhaseStats *phase = &compilerStats.phases[p];
+        fprintf(out, "%s\"%s\": {", p ? ", " : "", phaseNames[p]);
+        int allocations = compilerOptions.stats && countsAllocations;
+        if (compilerOptions.timePhases)
+            fprintf(out, "\"seconds\": %.6f%s", phase->seconds, allocations ? ", " : "");
+        if (allocations)
+            fprintf(out, "\"allocations\": %lld, \"allocatedBytes\": %lld", phase->allocations, phase->allocatedBytes);
+        fprintf(out, "}");
+    }
+    fprintf(out, "}");
+
+    if (compilerOptions.stats)
+    {
+        CompilerStats *s = &compilerStats;
+        fprintf(out, ", \"counts\": {\"tokens\": %lld, \"astNodes\": %lld, \"childReallocs\": %lld, "
+                     "\"symbolsAdded\": %lld, \"symbolLookups\": %lld, \"symbolProbes\": %lld, "
+                     "\"irInstructions\": %lld, \"temps\": %lld, \"labels\": %lld, "
+                     "\"values\": %lld, \"valuesInRegisters\": %lld, \"spills\": %lld, "
+                     "\"spillReloads\": %lld, \"spillStores\": %lld, \"mipsInstructions\": %lld, "
+                     "\"cacheHits\": %lld, \"cacheMisses\": %lld, \"cacheStores\": %lld, \"cacheEvictions\": %lld}",
+                s->tokens, s->astNodes, s->childReallocs, s->symbolsAdded, s->symbolLookups, s->symbolProbes,
+                s->irInstructions, s->temps, s->labels, s->values, s->valuesInRegisters, s->spills,
+                s->spillReloads, s->spillStores, s->mipsInstructions, s->cacheHits, s->cacheMisses, s->cacheStores,
+                s->cacheEvictions);
+    }
+    fprintf(out, "}\n");
+}
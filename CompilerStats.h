@@ -0,0 +1,82 @@
+#ifndef COMPILER_STATS_H
+#define COMPILER_STATS_H
+
+#include <stdio.h>
+
+// Where compile time and allocations are charged. Phases nest (lexing runs inside
+// parsing, symbol lookups inside both) and each is charged exclusively, so the
+// seconds of all phases add up to the whole compile.
+typedef enum
+{
+    PHASE_OTHER, // Start-up and anything outside a named phase
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_SYMBOLS,
+    PHASE_IR,
+    PHASE_BOUNDS_CHECKS,
+    PHASE_SELECT,
+    PHASE_REGALLOC,
+    PHASE_MIPS, // Translating IR to MIPS, frames and data layout
+    PHASE_PEEPHOLE,
+    PHASE_SCHEDULE,
+    PHASE_DELAY_SLOTS,
+    PHASE_SIMULATE,
+    PHASE_CACHE, // Hashing functions and reading, writing and evicting --cache entries
+    PHASE_WRITE, // Writing the assembly or object file
+    PHASE_DUMP,  // Printing the AST, IR and allocation diagnostics
+    PHASE_COUNT
+} CompilerPhase;
+
+typedef struct PhaseStats
+{
+    double seconds; // Only measured with --time-phases
+    long long allocations; // Only counted in builds made with -DCOUNT_ALLOCATIONS
+    long long allocatedBytes;
+} PhaseStats;
+
+typedef struct CompilerStats
+{
+    PhaseStats phases[PHASE_COUNT];
+    long long tokens;
+    long long astNodes;
+    long long childReallocs; // addChildNode grows the children array one slot at a time
+    long long symbolsAdded;
+    long long symbolLookups;
+    long long symbolProbes; // Entries findSymbol compared
+    long long irInstructions;
+    long long temps;
+    long long labels;
+    long long values; // Live intervals over all units
+    long long valuesInRegisters;
+    long long spills;
+    long long spillReloads;
+    long long spillStores;
+    long long mipsInstructions;
+    long long cacheHits;   // Functions whose --cache entry was reused
+    long long cacheMisses; // Functions generated and translated, then stored
+    long long cacheStores;
+    long long cacheEvictions;
+} CompilerStats;
+
+// Each thread keeps its own; a --jobs worker's counters are added to the
+// compile's when it finishes
+extern _Thread_local CompilerStats compilerStats;
+
+// Counters are always kept; they cost an increment each. The clock is only read
+// on phase changes when --time-phases asks for it.
+void startCompilerStats();
+void enterPhase(CompilerPhase phase);
+void leavePhase();
+// Adds from's counters and allocations to into's. Seconds stay out: the phases
+// of the thread that started the compile already account for all of its time.
+void addCompilerStats(CompilerStats *into, const CompilerStats *from);
+
+// Where the calling thread's diagnostic lines go: stdout, unless a --jobs worker
+// is collecting one function's lines to print them in source order
+FILE *diagnostics();
+void setDiagnostics(FILE *out);
+
+// Writes everything --stats and --time-phases asked for as a single-line JSON record
+void writeCompilerStats(FILE *out);
+
+#endif // COMPILER_STATS_H
@@ -0,0 +1,503 @@
+#include "DataLayout.h"
+#include "NameTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static DataObject *globals = NULL;
+static DataObject *lastGlobal = NULL;
+// Open-addressed index of globals by name, kept at most half full; every
+// variable reference in the program looks its name up here
+static DataObject **globalTable = NULL;
+static int globalTableSize = 0;
+static int globalCount = 0;
+
+// Names a streamed function used without declaring them while no global had the
+// name; a later global of that name would change code already written out
+static char **unresolvedNames = NULL;
+static int unresolvedCount = 0;
+static int unresolvedCapacity = 0;
+
+// Float literals, loaded with lwc1 since there is no immediate form for them
+typedef struct FloatConstant
+{
+    float value;
+    char label[16];
+} FloatConstant;
+
+static FloatConstant *floatConstants = NULL;
+static int floatConstantCount = 0;
+static int floatConstantCapacity = 0;
+
+// Pool entries asked for since startRecordingFloatConstants, each once
+static int recordingFloatConstants = 0;
+static int *recordedConstants = NULL;
+static int recordedCount = 0;
+static int recordedCapacity = 0;
+
+static const char *globalInSlot(const void *table, int slot)
+{
+    DataObject *object = ((DataObject *const *)table)[slot];
+    return object ? object->name : NULL;
+}
+
+// Finds the slot holding name, or the empty slot where it belongs
+static int probeGlobal(DataObject **table, int size, const char *name)
+{
+    return probeNameTable(table, size, globalInSlot, name);
+}
+
+DataObject *findGlobal(const char *name)
+{
+    return globalTableSize ? globalTable[probeGlobal(globalTable, globalTableSize, name)] : NULL;
+}
+
+static void indexGlobal(DataObject *object)
+{
+    if (2 * (globalCount + 1) > globalTableSize)
+    {
+        int size = globalTableSize ? 2 * globalTableSize : 64;
+        DataObject **table = calloc(size, sizeof(DataObject *));
+        if (!table)
+        {
+            perror("Failed to allocate global table");
+            exit(EXIT_FAILURE);
+        }
+        for (DataObject *other = globals; other; other = other->next)
+        {
+            if (other != object)
+                table[probeGlobal(table, size, other->name)] = other;
+        }
+        free(globalTable);
+        globalTable = table;
+        globalTableSize = size;
+    }
+    globalTable[probeGlobal(globalTable, globalTableSize, object->name)] = object;
+    globalCount++;
+}
+
+static DataObject *addGlobal(char *name, int words, int isArray)
+{
+    DataObject *object = findGlobal(name);
+    if (object)
+    {
+        if (object->isArray != isArray || object->words != words)
+        {
+            fprintf(stderr, "Error: %s redeclared at top level with a different type\n", name);
+            exit(EXIT_FAILURE);
+        }
+        return object;
+    }
+    for (int i = 0; i < unresolvedCount; i++)
+    {
+        if (strcmp(unresolvedNames[i], name) == 0)
+        {
+            fprintf(stderr, "Error: global %s is declared after a function that uses it, which --stream cannot compile\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    object = calloc(1, sizeof(DataObject));
+    if (!object)
+    {
+        perror("Failed to allocate data object");
+        exit(EXIT_FAILURE);
+    }
+    object->name = name;
+    object->words = words;
+    object->isArray = isArray;
+    if (lastGlobal)
+        lastGlobal->next = object;
+    else
+        globals = object;
+    lastGlobal = object;
+    indexGlobal(object);
+    return object;
+}
+
+DataObject *declareInternalArray(char *name)
+{
+    return addGlobal(name, 0, 1);
+}
+
+// Array sizes must be integer literals so every array has a fixed slot
+static int arrayLength(ASTNode *declaration)
+{
+    ASTNode *size = declaration->children[2];
+    if (size->type != AST_LITERAL || size->value.intValue <= 0)
+    {
+        fprintf(stderr, "Error: array %s needs a positive constant size\n", declaration->children[1]->value.strValue);
+        exit(EXIT_FAILURE);
+    }
+    return size->value.intValue;
+}
+
+// True when node, a function or anything inside it, declares name
+static int declaresName(ASTNode *node, const char *name)
+{
+    if (!node)
+        return 0;
+    if ((node->type == AST_DECLARATION || node->type == AST_ARRAY_DECLARATION) &&
+        strcmp(node->children[1]->value.strValue, name) == 0)
+        return 1;
+    if (node->type == AST_PARAMETER && strcmp(node->value.strValue, name) == 0)
+        return 1;
+    for (int i = 0; i < node->childCount; i++)
+    {
+        if (declaresName(node->children[i], name))
+            return 1;
+    }
+    return 0;
+}
+
+int isMemoryGlobal(const char *name)
+{
+    DataObject *object = findGlobal(name);
+    return object && !object->isArray && object->inMemory;
+}
+
+// Names a function has in scope while its globals are marked, innermost last
+typedef struct ScopeNames
+{
+    const char **names;
+    int count;
+    int capacity;
+} ScopeNames;
+
+static void enterName(ScopeNames *scope, const char *name)
+{
+    if (scope->count == scope->capacity)
+    {
+        scope->capacity = scope->capacity ? 2 * scope->capacity : 8;
+        scope->names = realloc(scope->names, sizeof(char *) * scope->capacity);
+        if (!scope->names)
+        {
+            perror("Failed to allocate scope names");
+            exit(EXIT_FAILURE);
+        }
+    }
+    scope->names[scope->count++] = name;
+}
+
+static int inScope(ScopeNames *scope, const char *name)
+{
+    for (int i = scope->count - 1; i >= 0; i--)
+    {
+        if (strcmp(scope->names[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Moves the globals a function refers to into memory. A local hides a global
+// only from its declaration to the end of its block, so the walk keeps the
+// names in scope as it goes.
+static void markReferencedGlobals(ScopeNames *scope, ASTNode *node)
+{
+    if (!node)
+        return;
+    switch (node->type)
+    {
+    case AST_VARIABLE:
+    {
+        DataObject *object = node->value.strValue ? findGlobal(node->value.strValue) : NULL;
+        if (object && !object->isArray && !object->inMemory && !inScope(scope, object->name))
+            object->inMemory = 1;
+        return;
+    }
+    case AST_DECLARATION:
+    case AST_ARRAY_DECLARATION:
+        // The initializer is evaluated before the name it initializes is declared
+        if (node->childCount > 2)
+            markReferencedGlobals(scope, node->children[2]);
+        enterName(scope, node->children[1]->value.strValue);
+        return;
+    case AST_PARAMETER:
+        enterName(scope, node->value.strValue);
+        return;
+    case AST_BLOCK:
+    {
+        int enclosingCount = scope->count;
+        for (int i = 0; i < node->childCount; i++)
+            markReferencedGlobals(scope, node->children[i]);
+        scope->count = enclosingCount;
+        return;
+    }
+    default:
+        // children[0] of a call is the callee's name, not a variable
+        for (int i = node->type == AST_FUNCTION_CALL ? 1 : 0; i < node->childCount; i++)
+            markReferencedGlobals(scope, node->children[i]);
+    }
+}
+
+static void markFunctionGlobals(ASTNode *function)
+{
+    ScopeNames scope = {NULL, 0, 0};
+    markReferencedGlobals(&scope, function->children[2]);
+    markReferencedGlobals(&scope, function->children[3]);
+    free(scope.names);
+}
+
+void declareGlobal(ASTNode *declaration)
+{
+    if (declaration->type == AST_ARRAY_DECLARATION)
+    {
+        DataObject *object = addGlobal(declaration->children[1]->value.strValue, arrayLength(declaration), 1);
+        object->isFloat = declaration->children[0]->value.typeCode == TypeFLOAT;
+    }
+    else if (declaration->type == AST_DECLARATION)
+    {
+        DataObject *object = addGlobal(declaration->children[1]->value.strValue, 1, 0);
+        object->isFloat = declaration->children[0]->value.typeCode == TypeFLOAT;
+        ASTNode *initializer = declaration->childCount == 3 ? declaration->children[2] : NULL;
+        if (initializer && (initializer->type == AST_LITERAL || initializer->type == AST_FLOAT_LITERAL))
+        {
+            // The literal is converted to the declared type, as an assignment would
+            double value = initializer->type == AST_LITERAL ? initializer->value.intValue : initializer->value.floatValue;
+            object->initialized = 1;
+            object->initialValue = (int)value;
+            object->initialFloat = (float)value;
+        }
+    }
+}
+
+// Remembers the undeclared names node uses; checked lists the names already looked at
+static void collectUnresolvedNames(ASTNode *function, ASTNode *node, char ***checked, int *checkedCount)
+{
+    if (!node)
+        return;
+    if (node->type == AST_VARIABLE && node->value.strValue && !findGlobal(node->value.strValue))
+    {
+        const char *name = node->value.strValue;
+        int seen = 0;
+        for (int i = 0; i < *checkedCount && !seen; i++)
+            seen = strcmp((*checked)[i], name) == 0;
+        if (!seen)
+        {
+            // Distinct names are few, so a list and one declaresName walk each is enough
+            *checked = realloc(*checked, sizeof(char *) * (*checkedCount + 1));
+            if (!*checked)
+            {
+                perror("Failed to allocate name list");
+                exit(EXIT_FAILURE);
+            }
+            (*checked)[(*checkedCount)++] = (char *)name;
+            if (!declaresName(function, name))
+            {
+                if (unresolvedCount == unresolvedCapacity)
+                {
+                    unresolvedCapacity = unresolvedCapacity ? 2 * unresolvedCapacity : 8;
+                    unresolvedNames = realloc(unresolvedNames, sizeof(char *) * unresolvedCapacity);
+                    if (!unresolvedNames)
+                    {
+                        perror("Failed to allocate unresolved name list");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                unresolvedNames[unresolvedCount++] = strdup(name);
+            }
+        }
+    }
+    for (int i = node->type == AST_FUNCTION_CALL ? 1 : 0; i < node->childCount; i++)
+        collectUnresolvedNames(function, node->children[i], checked, checkedCount);
+}
+
+void layOutFunctionGlobals(ASTNode *function)
+{
+    markFunctionGlobals(function);
+    char **checked = NULL;
+    int checkedCount = 0;
+    collectUnresolvedNames(function, function->children[3], &checked, &checkedCount);
+    free(checked);
+}
+
+void layOutGlobals(ASTNode *program)
+{
+    for (int i = 0; i < program->childCount; i++)
+        declareGlobal(program->children[i]);
+    for (int i = 0; i < program->childCount; i++)
+    {
+        ASTNode *child = program->children[i];
+        if (child->type == AST_FUNCTION_DECLARATION)
+            markFunctionGlobals(child);
+    }
+    for (DataObject *object = globals; object; object = object->next)
+    {
+        printf("LAYOUT: %s %s%s, %d bytes%s\n", object->name, object->isFloat ? "float " : "",
+               object->isArray ? "array" : "scalar", 4 * object->words,
+               object->isArray || object->inMemory ? (object->initialized ? " in .data" : " in .bss") : " in registers");
+    }
+}
+
+static void recordFloatConstant(int index)
+{
+    for (int i = 0; i < recordedCount; i++)
+    {
+        if (recordedConstants[i] == index)
+            return;
+    }
+    if (recordedCount == recordedCapacity)
+    {
+        recordedCapacity = recordedCapacity ? 2 * recordedCapacity : 8;
+        recordedConstants = realloc(recordedConstants, sizeof(int) * recordedCapacity);
+        if (!recordedConstants)
+        {
+            perror("Failed to allocate float constant record");
+            exit(EXIT_FAILURE);
+        }
+    }
+    recordedConstants[recordedCount++] = index;
+}
+
+const char *floatConstantLabel(float value)
+{
+    for (int i = 0; i < floatConstantCount; i++)
+    {
+        if (memcmp(&floatConstants[i].value, &value, sizeof(float)) == 0)
+        {
+            if (recordingFloatConstants)
+                recordFloatConstant(i);
+            return floatConstants[i].label;
+        }
+    }
+    if (floatConstantCount == floatConstantCapacity)
+    {
+        floatConstantCapacity = floatConstantCapacity ? 2 * floatConstantCapacity : 8;
+        floatConstants = realloc(floatConstants, sizeof(FloatConstant) * floatConstantCapacity);
+        if (!floatConstants)
+        {
+            perror("Failed to allocate float constant pool");
+            exit(EXIT_FAILURE);
+        }
+    }
+    FloatConstant *constant = &floatConstants[floatConstantCount];
+    constant->value = value;
+    snprintf(constant->label, sizeof(constant->label), "$LC%d", floatConstantCount);
+    if (recordingFloatConstants)
+        recordFloatConstant(floatConstantCount);
+    floatConstantCount++;
+    return constant->label;
+}
+
+void startRecordingFloatConstants()
+{
+    recordingFloatConstants = 1;
+    recordedCount = 0;
+}
+
+float *stopRecordingFloatConstants(int *count)
+{
+    recordingFloatConstants = 0;
+    float *values = malloc(sizeof(float) * (recordedCount + 1));
+    if (!values)
+    {
+        perror("Failed to allocate float constant record");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < recordedCount; i++)
+        values[i] = floatConstants[recordedConstants[i]].value;
+    *count = recordedCount;
+    return values;
+}
+
+// .float takes the literal as text; %.9g keeps every bit of a single
+static MipsOperand floatOperand(float value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", value);
+    return mipsLabelOperand(strdup(text));
+}
+
+// Initialized scalars go to .data, everything else to .bss, and float literals to
+// a read-only pool; every slot is word aligned
+void emitDataSections(MipsList *list)
+{
+    static const char *sections[] = {".data", ".bss"};
+    for (int section = 0; section < 2; section++)
+    {
+        int opened = 0;
+        for (DataObject *object = globals; object; object = object->next)
+        {
+            if ((!object->isArray && !object->inMemory) || object->initialized != (section == 0))
+                continue;
+            if (!opened)
+            {
+                emitMipsDirective(list, sections[section], NO_OPERAND);
+                emitMipsDirective(list, ".align", mipsImmediate(2));
+                opened = 1;
+            }
+            emitMipsLabel(list, object->name);
+            if (section == 1)
+                emitMipsDirective(list, ".space", mipsImmediate(4 * object->words));
+            else if (object->isFloat)
+                emitMipsDirective(list, ".float", floatOperand(object->initialFloat));
+            else
+                emitMipsDirective(list, ".word", mipsImmediate(object->initialValue));
+        }
+    }
+    if (floatConstantCount == 0)
+        return;
+    emitMipsDirective(list, ".rdata", NO_OPERAND);
+    emitMipsDirective(list, ".align", mipsImmediate(2));
+    for (int i = 0; i < floatConstantCount; i++)
+    {
+        emitMipsLabel(list, floatConstants[i].label);
+        emitMipsDirective(list, ".float", floatOperand(floatConstants[i].value));
+    }
+}
+
+// Gives each array the unit declares (ALLOC_ARRAY name #words) its own word-aligned
+// slot; a name declared twice keeps one slot, sized for the larger declaration
+FrameArrays layOutFrameArrays(IRInstruction *first, IRInstruction *end)
+{
+    FrameArrays layout = {NULL, 0, 0};
+    int capacity = 0;
+    for (IRInstruction *current = first; current != end; current = current->next)
+    {
+        if (strcmp(current->op, "ALLOC_ARRAY") != 0)
+            continue;
+        int words = immediateValue(current->arg2);
+        FrameArray *array = findFrameArray(&layout, current->arg1);
+        if (array)
+        {
+            if (words > array->words)
+                array->words = words;
+            continue;
+        }
+        if (layout.count == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 4;
+            layout.arrays = realloc(layout.arrays, sizeof(FrameArray) * capacity);
+            if (!layout.arrays)
+            {
+                perror("Failed to allocate frame array layout");
+                exit(EXIT_FAILURE);
+            }
+        }
+        layout.arrays[layout.count].name = current->arg1;
+        layout.arrays[layout.count].words = words;
+        layout.count++;
+    }
+    for (int i = 0; i < layout.count; i++)
+    {
+        layout.arrays[i].offset = layout.bytes;
+        layout.bytes += 4 * layout.arrays[i].words;
+    }
+    return layout;
+}
+
+FrameArray *findFrameArray(FrameArrays *layout, const char *name)
+{
+    for (int i = 0; i < layout->count; i++)
+    {
+        if (strcmp(layout->arrays[i].name, name) == 0)
+            return &layout->arrays[i];
+    }
+    return NULL;
+}
+
+void freeFrameArrays(FrameArrays *layout)
+{
+    free(layout->arrays);
+    layout->arrays = NULL;
+    layout->count = layout->bytes = 0;
+}
@@ -0,0 +1,63 @@
+#ifndef DATA_LAYOUT_H
+#define DATA_LAYOUT_H
+
+#include "AST.h"
+#include "IRGeneration.h"
+#include "MipsInstruction.h"
+
+// Storage for the program's top-level declarations. Arrays always live in
+// memory; a scalar does only when some function reads or writes it, otherwise
+// it stays a register variable of main.
+typedef struct DataObject
+{
+    char *name;
+    int words;        // Elements of an array, 1 for a scalar
+    int isArray;
+    int isFloat;      // Single-precision elements
+    int inMemory;     // Scalars: accessed through the .data/.bss slot
+    int initialized;  // Has a literal initializer, so it goes to .data
+    int initialValue;
+    float initialFloat;
+    struct DataObject *next;
+} DataObject;
+
+// An array declared inside a function, placed in that function's frame
+typedef struct FrameArray
+{
+    char *name;
+    int words;
+    int offset; // From the start of the frame's array area
+} FrameArray;
+
+typedef struct FrameArrays
+{
+    FrameArray *arrays;
+    int count;
+    int bytes;
+} FrameArrays;
+
+void layOutGlobals(ASTNode *program);
+// Streaming lays globals out as their declarations arrive, and moves the ones a
+// function uses into memory before the function is lowered
+void declareGlobal(ASTNode *declaration);
+void layOutFunctionGlobals(ASTNode *function);
+DataObject *findGlobal(const char *name);
+// An array the compiler itself adds to .bss; its size may grow until the data is emitted
+DataObject *declareInternalArray(char *name);
+// True when name is a global scalar kept in memory; locals that shadow it are the caller's to check
+int isMemoryGlobal(const char *name);
+void emitDataSections(MipsList *list);
+
+// Label of the constant pool entry holding value, adding one on first use
+const char *floatConstantLabel(float value);
+// Collects the distinct values floatConstantLabel is asked for until stopped, in
+// the order of their first request; asking for them again in that order labels
+// them as generating the same code again would
+void startRecordingFloatConstants();
+float *stopRecordingFloatConstants(int *count);
+
+FrameArrays layOutFrameArrays(IRInstruction *first, IRInstruction *end);
+FrameArray *findFrameArray(FrameArrays *layout, const char *name);
+void freeFrameArrays(FrameArrays *layout);
+
+#endif // DATA_LAYOUT_H
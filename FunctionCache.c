@@ -0,0 +1,915 @@
+#include "FunctionCache.h"
+#include "DataLayout.h"
+#include "Options.h"
+#include "CompilerStats.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bumped whenever the entry format changes; entries of another version are misses
+#define ENTRY_VERSION 1
+#define ENTRY_SUFFIX ".fn"
+
+static const char *cacheDirectory = NULL;
+static long long cacheLimit = 0;
+
+// A --serve process's entries, kept in memory for the workers it forks
+typedef struct ResidentEntry
+{
+    char key[FUNCTION_CACHE_KEY_LENGTH + 1];
+    char *text;
+    long size;
+    int seen; // Still in the directory at the last scan
+} ResidentEntry;
+
+static char *residentDirectory = NULL; // Resolved, to compare with a request's --cache
+static ResidentEntry *residentEntries = NULL; // Sorted by key
+static int residentCount = 0;
+static int usesResidentEntries = 0; // This compile's --cache is the resident directory
+
+// This compile's functions by key, open-addressed and kept at most half full
+static CachedFunction **functionTable = NULL;
+static int functionTableSize = 0;
+static int functionCount = 0;
+
+// The program's functions sorted by name, then by position, for the
+// signatures of callees
+typedef struct IndexedFunction
+{
+    const char *name;
+    int position;
+    ASTNode *function;
+} IndexedFunction;
+
+static ASTNode *indexedProgram = NULL;
+static IndexedFunction *functionIndex = NULL;
+static int indexedCount = 0;
+
+// 128-bit FNV-1a over the key material
+typedef struct KeyHash
+{
+    unsigned long long low;
+    unsigned long long high;
+} KeyHash;
+
+// The 128-bit FNV prime is 2^88 + 0x13b, so the product is h * 0x13b + (h << 88)
+static void multiplyByPrime(KeyHash *hash)
+{
+    unsigned long long lowPart = (hash->low & 0xffffffffull) * 0x13b;
+    unsigned long long highPart = (hash->low >> 32) * 0x13b;
+    unsigned long long low = lowPart + (highPart << 32);
+    unsigned long long carry = (highPart >> 32) + (low < lowPart);
+    hash->high = hash->high * 0x13b + carry + (hash->low << 24);
+    hash->low = low;
+}
+
+static void hashBytes(KeyHash *hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash->low ^= bytes[i];
+        multiplyByPrime(hash);
+    }
+}
+
+static void hashInt(KeyHash *hash, int value)
+{
+    hashBytes(hash, &value, sizeof(value));
+}
+
+// The terminator goes in too, so that "ab" "c" and "a" "bc" differ
+static void hashString(KeyHash *hash, const char *text)
+{
+    if (!text)
+        hashInt(hash, -1);
+    else
+        hashBytes(hash, text, strlen(text) + 1);
+}
+
+static int compareIndexedFunctions(const void *a, const void *b)
+{
+    const IndexedFunction *x = a, *y = b;
+    int order = strcmp(x->name, y->name);
+    return order ? order : x->position - y->position;
+}
+
+static void indexFunctions(ASTNode *program)
+{
+    free(functionIndex);
+    indexedProgram = program;
+    indexedCount = 0;
+    functionIndex = malloc(sizeof(IndexedFunction) * (program->childCount + 1));
+    if (!functionIndex)
+    {
+        perror("Failed to allocate function index");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < program->childCount; i++)
+    {
+        ASTNode *child = program->children[i];
+        if (child->type == AST_FUNCTION_DECLARATION)
+            functionIndex[indexedCount++] = (IndexedFunction){child->children[1]->value.strValue, i, child};
+    }
+    qsort(functionIndex, indexedCount, sizeof(IndexedFunction), compareIndexedFunctions);
+}
+
+// The first function declared with name, as IR generation finds it
+static ASTNode *findIndexedFunction(const char *name)
+{
+    int low = 0, high = indexedCount;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (strcmp(functionIndex[middle].name, name) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low < indexedCount && strcmp(functionIndex[low].name, name) == 0 ? functionIndex[low].function : NULL;
+}
+
+// What the code of a caller depends on: the callee's declared types
+static void hashSignature(KeyHash *hash, const char *name)
+{
+    ASTNode *callee = name ? findIndexedFunction(name) : NULL;
+    if (!callee)
+    {
+        hashInt(hash, -1); // Undeclared: taken to return an int
+        return;
+    }
+    hashInt(hash, callee->children[0]->value.typeCode);
+    ASTNode *parameters = callee->children[2];
+    hashInt(hash, parameters ? parameters->childCount : 0);
+    for (int i = 0; parameters && i < parameters->childCount; i++)
+    {
+        ASTNode *parameter = parameters->children[i];
+        hashInt(hash, parameter->childCount > 0 ? (int)parameter->children[0]->value.typeCode : -1);
+    }
+}
+
+// A name may be a global even where a local shadows it; hashing it anyway only costs a miss
+static void hashGlobal(KeyHash *hash, const char *name)
+{
+    DataObject *object = name ? findGlobal(name) : NULL;
+    if (!object)
+    {
+        hashInt(hash, 0);
+        return;
+    }
+    int layout[5] = {1, object->words, object->isArray, object->isFloat, object->inMemory};
+    hashBytes(hash, layout, sizeof(layout));
+}
+
+// The tree as the parser built it, with each name's global and each callee's signature
+static void hashNode(KeyHash *hash, ASTNode *node)
+{
+    if (!node)
+    {
+        hashInt(hash, -1);
+        return;
+    }
+    hashInt(hash, node->type);
+    hashInt(hash, node->childCount);
+    switch (node->type)
+    {
+    case AST_LITERAL:
+        hashInt(hash, node->value.intValue);
+        break;
+    case AST_FLOAT_LITERAL:
+        hashBytes(hash, &node->value.floatValue, sizeof(node->value.floatValue));
+        break;
+    case AST_TYPE:
+        hashInt(hash, node->value.typeCode);
+        break;
+    case AST_BINARY_EXPR:
+    case AST_UNARY_EXPR:
+        hashInt(hash, node->value.opType);
+        break;
+    case AST_PARAMETER:
+        hashString(hash, node->value.strValue);
+        break;
+    case AST_VARIABLE:
+        hashString(hash, node->value.strValue);
+        hashGlobal(hash, node->value.strValue);
+        break;
+    case AST_FUNCTION_CALL:
+        hashSignature(hash, node->childCount > 0 ? node->children[0]->value.strValue : NULL);
+        break;
+    default:
+        break;
+    }
+    for (int i = 0; i < node->childCount; i++)
+        hashNode(hash, node->children[i]);
+}
+
+static void computeKey(ASTNode *function, const char *nextUnit, char *key)
+{
+    KeyHash hash = {0x62b821756295c58dull, 0x6c62272e07bb0142ull}; // The FNV-1a offset basis
+    hashString(&hash, "cmm function cache " COMPILER_VERSION);
+    hashInt(&hash, ENTRY_VERSION);
+    int options[] = {compilerOptions.fuseBranches, compilerOptions.selectInstructions, compilerOptions.eliminateChecks,
+                     compilerOptions.schedule,     compilerOptions.unrollFactor,       compilerOptions.tailCalls,
+                     compilerOptions.fillDelaySlots, compilerOptions.vectorize};
+    hashBytes(&hash, options, sizeof(options));
+    hashBytes(&hash, &compilerOptions.latency, sizeof(compilerOptions.latency));
+    hashString(&hash, nextUnit);
+    hashNode(&hash, function);
+    snprintf(key, FUNCTION_CACHE_KEY_LENGTH + 1, "%016llx%016llx", hash.high, hash.low);
+}
+
+static unsigned int keySlot(const char *key, int size)
+{
+    unsigned int slot = 0;
+    for (int i = 0; i < 8; i++) // The key is a hash already
+        slot = slot << 4 | (key[i] <= '9' ? key[i] - '0' : key[i] - 'a' + 10);
+    return slot & (size - 1);
+}
+
+static int probeFunction(CachedFunction **table, int size, const char *key)
+{
+    unsigned int slot = keySlot(key, size);
+    while (table[slot] && strcmp(table[slot]->key, key) != 0)
+        slot = (slot + 1) & (size - 1);
+    return slot;
+}
+
+CachedFunction *cachedFunction(const char *key)
+{
+    return functionTableSize ? functionTable[probeFunction(functionTable, functionTableSize, key)] : NULL;
+}
+
+static void addFunction(CachedFunction *cached)
+{
+    if (2 * (functionCount + 1) > functionTableSize)
+    {
+        int size = functionTableSize ? 2 * functionTableSize : 64;
+        CachedFunction **table = calloc(size, sizeof(CachedFunction *));
+        if (!table)
+        {
+            perror("Failed to allocate function cache table");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < functionTableSize; i++)
+        {
+            if (functionTable[i])
+                table[probeFunction(table, size, functionTable[i]->key)] = functionTable[i];
+        }
+        free(functionTable);
+        functionTable = table;
+        functionTableSize = size;
+    }
+    functionTable[probeFunction(functionTable, functionTableSize, cached->key)] = cached;
+    functionCount++;
+}
+
+static char *entryPath(const char *key)
+{
+    size_t size = strlen(cacheDirectory) + strlen(key) + sizeof(ENTRY_SUFFIX) + 2;
+    char *path = malloc(size);
+    if (!path)
+    {
+        perror("Failed to allocate cache path");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(path, size, "%s/%s%s", cacheDirectory, key, ENTRY_SUFFIX);
+    return path;
+}
+
+void openFunctionCache(const char *directory, long long limitBytes)
+{
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST)
+    {
+        perror("Failed to create cache directory");
+        exit(EXIT_FAILURE);
+    }
+    cacheDirectory = directory;
+    cacheLimit = limitBytes;
+    if (residentDirectory)
+    {
+        char *resolved = realpath(directory, NULL);
+        usesResidentEntries = resolved && strcmp(resolved, residentDirectory) == 0;
+        free(resolved);
+    }
+}
+
+static int compareResidentEntries(const void *a, const void *b)
+{
+    return strcmp(((const ResidentEntry *)a)->key, ((const ResidentEntry *)b)->key);
+}
+
+static ResidentEntry *findResidentEntry(const char *key)
+{
+    ResidentEntry probe;
+    snprintf(probe.key, sizeof(probe.key), "%s", key);
+    return bsearch(&probe, residentEntries, residentCount, sizeof(ResidentEntry), compareResidentEntries);
+}
+
+// Reads the whole file at path into a new NUL-terminated buffer; NULL when it cannot
+static char *readWholeFile(const char *path, long *size)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = *size >= 0 ? malloc(*size + 1) : NULL;
+    if (!text || fread(text, 1, *size, file) != (size_t)*size)
+    {
+        free(text);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    text[*size] = '\0';
+    return text;
+}
+
+void keepFunctionCacheResident(const char *directory)
+{
+    if (!residentDirectory)
+    {
+        if (mkdir(directory, 0777) != 0 && errno != EEXIST)
+        {
+            perror("Failed to create cache directory");
+            exit(EXIT_FAILURE);
+        }
+        residentDirectory = realpath(directory, NULL);
+        if (!residentDirectory)
+        {
+            perror("Failed to resolve cache directory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    DIR *files = opendir(residentDirectory);
+    if (!files)
+        return;
+    for (int i = 0; i < residentCount; i++)
+        residentEntries[i].seen = 0;
+    int count = residentCount;
+    size_t suffixLength = strlen(ENTRY_SUFFIX);
+    for (struct dirent *file = readdir(files); file; file = readdir(files))
+    {
+        size_t length = strlen(file->d_name);
+        if (length != FUNCTION_CACHE_KEY_LENGTH + suffixLength || strcmp(file->d_name + length - suffixLength, ENTRY_SUFFIX) != 0)
+            continue;
+        char key[FUNCTION_CACHE_KEY_LENGTH + 1];
+        snprintf(key, sizeof(key), "%.*s", FUNCTION_CACHE_KEY_LENGTH, file->d_name);
+        ResidentEntry *entry = findResidentEntry(key);
+        if (entry)
+        {
+            entry->seen = 1; // Entries never change once written
+            continue;
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", residentDirectory, file->d_name);
+        long size;
+        char *text = readWholeFile(path, &size);
+        if (!text)
+            continue;
+        residentEntries = realloc(residentEntries, sizeof(ResidentEntry) * (count + 1));
+        if (!residentEntries)
+        {
+            perror("Failed to allocate resident cache entries");
+            exit(EXIT_FAILURE);
+        }
+        residentEntries[count] = (ResidentEntry){.text = text, .size = size, .seen = 1};
+        memcpy(residentEntries[count].key, key, sizeof(key));
+        count++;
+    }
+    closedir(files);
+    // Evicted entries go from memory too; the new ones join the sorted order
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (residentEntries[i].seen)
+            residentEntries[kept++] = residentEntries[i];
+        else
+            free(residentEntries[i].text);
+    }
+    residentCount = kept;
+    qsort(residentEntries, residentCount, sizeof(ResidentEntry), compareResidentEntries);
+}
+
+// An entry, one word per field:
+//   cmm-function-cache <version> <key>
+//   labels <n> temps <n> floats <n> <bits in hex>... instructions <before> <after>
+//   ir <n>, then per instruction: op arg1 arg2 result
+//   mips <n>, then per instruction: i|l|d op operands, then per operand: kind reg value label
+//   end
+// "-" stands for a missing argument or label. @L<k>, @t<k> and @F<k> are the
+// function's k-th label, temporary and float constant, renumbered on reuse.
+typedef struct EntryReader
+{
+    CachedFunction *cached;
+    char **words;
+    int count;
+    int next;
+    int build; // Otherwise the entry is only checked, before anything is renumbered
+    int failed;
+} EntryReader;
+
+static char *readWord(EntryReader *reader)
+{
+    if (reader->next == reader->count)
+    {
+        reader->failed = 1;
+        return "";
+    }
+    return reader->words[reader->next++];
+}
+
+static long readNumber(EntryReader *reader, int base)
+{
+    char *word = readWord(reader);
+    char *end;
+    long value = strtol(word, &end, base);
+    if (!*word || *end)
+        reader->failed = 1;
+    return value;
+}
+
+static void expectWord(EntryReader *reader, const char *expected)
+{
+    if (strcmp(readWord(reader), expected) != 0)
+        reader->failed = 1;
+}
+
+// The name a stored word stands for in this compile, or NULL for "-". While
+// checking, the word itself.
+static char *renumberedWord(EntryReader *reader, char *word)
+{
+    CachedFunction *cached = reader->cached;
+    if (strcmp(word, "-") == 0)
+        return NULL;
+    if (word[0] != '@')
+        return reader->build ? strdup(word) : word;
+    char *end;
+    long index = word[1] ? strtol(word + 2, &end, 10) : -1;
+    int count = word[1] == 'L' ? cached->labelCount : word[1] == 't' ? cached->tempCount
+                                                     : word[1] == 'F' ? cached->floatCount : 0;
+    if (index < 0 || *end || index >= count)
+    {
+        reader->failed = 1;
+        return NULL;
+    }
+    if (!reader->build)
+        return word;
+    if (word[1] == 'F')
+        return strdup(cached->floatLabels[index]);
+    char text[32];
+    snprintf(text, sizeof(text), "%c%ld", word[1], (word[1] == 'L' ? cached->labelBase : cached->tempBase) + index);
+    return strdup(text);
+}
+
+static void readHeader(EntryReader *reader)
+{
+    CachedFunction *cached = reader->cached;
+    expectWord(reader, "cmm-function-cache");
+    if (readNumber(reader, 10) != ENTRY_VERSION)
+        reader->failed = 1;
+    expectWord(reader, cached->key);
+    expectWord(reader, "labels");
+    cached->labelCount = (int)readNumber(reader, 10);
+    expectWord(reader, "temps");
+    cached->tempCount = (int)readNumber(reader, 10);
+    expectWord(reader, "floats");
+    cached->floatCount = (int)readNumber(reader, 10);
+    if (reader->failed || cached->labelCount < 0 || cached->tempCount < 0 || cached->floatCount < 0 ||
+        cached->floatCount > reader->count)
+    {
+        reader->failed = 1;
+        return;
+    }
+    cached->floats = malloc(sizeof(float) * (cached->floatCount + 1));
+    for (int i = 0; i < cached->floatCount; i++)
+    {
+        unsigned int bits = (unsigned int)readNumber(reader, 16);
+        memcpy(&cached->floats[i], &bits, sizeof(float));
+    }
+    expectWord(reader, "instructions");
+    cached->instructionsBefore = (int)readNumber(reader, 10);
+    cached->instructionsAfter = (int)readNumber(reader, 10);
+}
+
+static IRInstruction *readIR(EntryReader *reader)
+{
+    expectWord(reader, "ir");
+    long count = readNumber(reader, 10);
+    IRInstruction *first = NULL, *last = NULL;
+    for (long i = 0; i < count && !reader->failed; i++)
+    {
+        char *op = readWord(reader);
+        char *arg1 = renumberedWord(reader, readWord(reader));
+        char *arg2 = renumberedWord(reader, readWord(reader));
+        char *result = renumberedWord(reader, readWord(reader));
+        if (i == 0 && strcmp(op, "FUNCTION") != 0)
+            reader->failed = 1; // Every unit starts with its entry
+        if (!reader->build)
+            continue;
+        IRInstruction *instr = createInstruction(op, arg1, arg2, result);
+        if (last)
+            last->next = instr;
+        else
+            first = instr;
+        last = instr;
+    }
+    return first;
+}
+
+static int isRegisterNumber(int reg)
+{
+    return reg >= 0 && reg < MIPS_REGISTER_COUNT;
+}
+
+static MipsList *readCode(EntryReader *reader)
+{
+    expectWord(reader, "mips");
+    long count = readNumber(reader, 10);
+    MipsList *list = reader->build ? createMipsList() : NULL;
+    for (long i = 0; i < count && !reader->failed; i++)
+    {
+        char *kind = readWord(reader);
+        char *op = renumberedWord(reader, readWord(reader));
+        if (!op)
+        {
+            reader->failed = 1;
+            break;
+        }
+        if (strcmp(kind, "l") == 0)
+        {
+            if (list)
+                emitMipsLabel(list, op);
+            continue;
+        }
+        MipsOperand operands[3] = {NO_OPERAND, NO_OPERAND, NO_OPERAND};
+        long operandCount = readNumber(reader, 10);
+        if (operandCount < 0 || operandCount > 3 || (strcmp(kind, "d") == 0 && operandCount > 1) ||
+            (strcmp(kind, "d") != 0 && (strcmp(kind, "i") != 0 || !findMipsOpcode(op))))
+            reader->failed = 1;
+        for (int o = 0; o < operandCount && !reader->failed; o++)
+        {
+            operands[o].kind = (OperandKind)readNumber(reader, 10);
+            operands[o].reg = (int)readNumber(reader, 10);
+            operands[o].value = (int)readNumber(reader, 10);
+            operands[o].label = renumberedWord(reader, readWord(reader));
+            if (operands[o].kind <= OPERAND_NONE || operands[o].kind > OPERAND_MEMORY ||
+                ((operands[o].kind == OPERAND_REGISTER || operands[o].kind == OPERAND_MEMORY) &&
+                 !isRegisterNumber(operands[o].reg)))
+                reader->failed = 1;
+        }
+        if (reader->failed || !list)
+            continue;
+        if (strcmp(kind, "d") == 0)
+            emitMipsDirective(list, op, operands[0]);
+        else
+            emitMips(list, op, operands[0], operands[1], operands[2]);
+    }
+    expectWord(reader, "end");
+    return list;
+}
+
+// Reads the whole entry and splits it into words, which point into text; NULL
+// when there is no entry. A resident copy saves reading the file, as long as
+// the file is still there.
+static char **readEntryWords(const char *path, const char *key, char **text, int *count)
+{
+    ResidentEntry *entry = usesResidentEntries ? findResidentEntry(key) : NULL;
+    long size;
+    if (entry && access(path, F_OK) == 0)
+    {
+        *text = malloc(entry->size + 1);
+        if (!*text)
+        {
+            perror("Failed to allocate cache entry");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(*text, entry->text, entry->size + 1);
+    }
+    else if (!(*text = readWholeFile(path, &size)))
+    {
+        return NULL;
+    }
+
+    int capacity = 64;
+    char **words = malloc(sizeof(char *) * capacity);
+    *count = 0;
+    for (char *word = strtok(*text, " \n"); word; word = strtok(NULL, " \n"))
+    {
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            words = realloc(words, sizeof(char *) * capacity);
+        }
+        if (!words)
+        {
+            perror("Failed to allocate cache entry");
+            exit(EXIT_FAILURE);
+        }
+        words[(*count)++] = word;
+    }
+    return words;
+}
+
+CachedFunction *findCachedFunction(ASTNode *program, ASTNode *function, const char *nextUnit)
+{
+    enterPhase(PHASE_CACHE);
+    if (program != indexedProgram)
+        indexFunctions(program);
+    char key[FUNCTION_CACHE_KEY_LENGTH + 1];
+    computeKey(function, nextUnit, key);
+    if (cachedFunction(key))
+    {
+        leavePhase();
+        return NULL; // Two copies would share one entry but not their numbering
+    }
+
+    CachedFunction *cached = calloc(1, sizeof(CachedFunction));
+    if (!cached)
+    {
+        perror("Failed to allocate cached function");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(cached->key, key, sizeof(key));
+    cached->name = function->children[1]->value.strValue;
+    addFunction(cached);
+
+    char *path = entryPath(key);
+    char *text;
+    int count;
+    char **words = readEntryWords(path, key, &text, &count);
+    if (words)
+    {
+        EntryReader reader = {cached, words, count, 0, 0, 0};
+        readHeader(&reader);
+        int header = reader.next;
+        readIR(&reader);
+        readCode(&reader);
+        if (!reader.failed && reader.next == count)
+        {
+            cached->hit = 1;
+            cached->text = text;
+            cached->words = words;
+            cached->wordCount = count;
+            cached->nextWord = header;
+            utimensat(AT_FDCWD, path, NULL, 0); // Eviction goes by last use
+        }
+        else
+        {
+            fprintf(stderr, "Warning: discarding unreadable cache entry %s\n", path);
+            unlink(path);
+            free(text);
+            free(words);
+            free(cached->floats);
+            cached->floats = NULL;
+            cached->floatCount = cached->labelCount = cached->tempCount = 0;
+        }
+    }
+    free(path);
+    printf("CACHE: %s %s\n", cached->hit ? "reusing" : "compiling", cached->name);
+    if (cached->hit)
+        compilerStats.cacheHits++;
+    else
+        compilerStats.cacheMisses++;
+    leavePhase();
+    return cached;
+}
+
+static void labelFloatConstants(CachedFunction *cached)
+{
+    cached->floatLabels = malloc(sizeof(char *) * (cached->floatCount + 1));
+    if (!cached->floatLabels)
+    {
+        perror("Failed to allocate cached float labels");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < cached->floatCount; i++)
+        cached->floatLabels[i] = strdup(floatConstantLabel(cached->floats[i]));
+}
+
+IRInstruction *reuseCachedFunction(CachedFunction *cached)
+{
+    enterPhase(PHASE_CACHE);
+    labelFloatConstants(cached);
+    EntryReader reader = {cached, cached->words, cached->wordCount, cached->nextWord, 1, 0};
+    cached->ir = readIR(&reader);
+    cached->code = readCode(&reader);
+    free(cached->text);
+    free(cached->words);
+    cached->text = NULL;
+    cached->words = NULL;
+    leavePhase();
+    return cached->ir;
+}
+
+// Writes a name as stored, numbering the function's own labels, temporaries and
+// float constants from its start. Returns 0 for a name the format cannot hold.
+static int writeWord(FILE *out, CachedFunction *cached, const char *word)
+{
+    if (!word)
+    {
+        fputs(" -", out);
+        return 1;
+    }
+    if (!*word || word[0] == '@' || strcmp(word, "-") == 0 || strpbrk(word, " \t\n"))
+        return 0;
+    char *end;
+    if ((word[0] == 'L' || word[0] == 't') && word[1] >= '0' && word[1] <= '9')
+    {
+        long number = strtol(word + 1, &end, 10);
+        int base = word[0] == 'L' ? cached->labelBase : cached->tempBase;
+        int count = word[0] == 'L' ? cached->labelCount : cached->tempCount;
+        if (!*end && number >= base && number < base + count)
+        {
+            fprintf(out, " @%c%ld", word[0], number - base);
+            return 1;
+        }
+    }
+    for (int i = 0; i < cached->floatCount; i++)
+    {
+        if (strcmp(word, cached->floatLabels[i]) == 0)
+        {
+            fprintf(out, " @F%d", i);
+            return 1;
+        }
+    }
+    fprintf(out, " %s", word);
+    return 1;
+}
+
+static int writeEntry(FILE *out, CachedFunction *cached, IRInstruction *first, IRInstruction *end, MipsList *list)
+{
+    fprintf(out, "cmm-function-cache %d %s\nlabels %d temps %d floats %d", ENTRY_VERSION, cached->key,
+            cached->labelCount, cached->tempCount, cached->floatCount);
+    for (int i = 0; i < cached->floatCount; i++)
+    {
+        unsigned int bits;
+        memcpy(&bits, &cached->floats[i], sizeof(float));
+        fprintf(out, " %08x", bits);
+    }
+    fprintf(out, "\ninstructions %d %d\n", cached->instructionsBefore, cached->instructionsAfter);
+
+    int count = 0;
+    for (IRInstruction *ir = first; ir != end; ir = ir->next)
+        count++;
+    fprintf(out, "ir %d\n", count);
+    int written = 1;
+    for (IRInstruction *ir = first; ir != end && written; ir = ir->next)
+    {
+        fputs(ir->op, out);
+        written = !strpbrk(ir->op, " \t\n") && writeWord(out, cached, ir->arg1) &&
+                  writeWord(out, cached, ir->arg2) && writeWord(out, cached, ir->result);
+        fputc('\n', out);
+    }
+
+    fprintf(out, "mips %d\n", list->count);
+    for (MipsInstruction *instr = list->head; instr && written; instr = instr->next)
+    {
+        fputs(instr->kind == MIPS_LABEL ? "l" : instr->kind == MIPS_DIRECTIVE ? "d" : "i", out);
+        written = writeWord(out, cached, instr->op);
+        if (instr->kind != MIPS_LABEL)
+            fprintf(out, " %d", instr->operandCount);
+        for (int o = 0; o < instr->operandCount && written && instr->kind != MIPS_LABEL; o++)
+        {
+            MipsOperand *operand = &instr->operands[o];
+            fprintf(out, " %d %d %d", operand->kind, operand->reg, operand->value);
+            written = writeWord(out, cached, operand->label);
+        }
+        fputc('\n', out);
+    }
+    fputs("end\n", out);
+    return written;
+}
+
+void storeCachedFunction(CachedFunction *cached, IRInstruction *first, IRInstruction *end, MipsList *list,
+                         int instructionsBefore, int instructionsAfter)
+{
+    enterPhase(PHASE_CACHE);
+    cached->instructionsBefore = instructionsBefore;
+    cached->instructionsAfter = instructionsAfter;
+    labelFloatConstants(cached); // The constant pool is complete by now, so this only reads it
+
+    // Written aside and renamed into place, so a reader never sees half an entry
+    char *path = entryPath(cached->key);
+    char *temporary = malloc(strlen(path) + 8);
+    if (!temporary)
+    {
+        perror("Failed to allocate cache path");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(temporary, "%s.XXXXXX", path);
+    int fd = mkstemp(temporary);
+    FILE *out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out)
+    {
+        fprintf(stderr, "Warning: cannot write cache entry %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(temporary);
+        }
+    }
+    else
+    {
+        int written = writeEntry(out, cached, first, end, list);
+        if (fclose(out) == 0 && written && rename(temporary, path) == 0)
+            compilerStats.cacheStores++;
+        else
+            unlink(temporary); // A name no entry can hold is simply not cached
+    }
+    free(temporary);
+    free(path);
+    leavePhase();
+}
+
+typedef struct EntryFile
+{
+    char *name;
+    long long bytes;
+    struct timespec used;
+} EntryFile;
+
+static int compareUse(const void *a, const void *b)
+{
+    const EntryFile *x = a, *y = b;
+    if (x->used.tv_sec != y->used.tv_sec)
+        return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+    if (x->used.tv_nsec != y->used.tv_nsec)
+        return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+void closeFunctionCache()
+{
+    if (!cacheDirectory)
+        return;
+    enterPhase(PHASE_CACHE);
+    DIR *directory = opendir(cacheDirectory);
+    if (!directory)
+    {
+        perror("Failed to open cache directory");
+        exit(EXIT_FAILURE);
+    }
+    EntryFile *entries = NULL;
+    int entryCount = 0, entryCapacity = 0;
+    long long totalBytes = 0;
+    size_t suffixLength = strlen(ENTRY_SUFFIX);
+    for (struct dirent *file = readdir(directory); file; file = readdir(directory))
+    {
+        size_t length = strlen(file->d_name);
+        if (length <= suffixLength || strcmp(file->d_name + length - suffixLength, ENTRY_SUFFIX) != 0)
+            continue; // Not an entry, or one still being written
+        char *path = malloc(strlen(cacheDirectory) + length + 2);
+        if (!path)
+        {
+            perror("Failed to allocate cache path");
+            exit(EXIT_FAILURE);
+        }
+        sprintf(path, "%s/%s", cacheDirectory, file->d_name);
+        struct stat status;
+        if (stat(path, &status) != 0)
+        {
+            free(path); // Evicted by another compile meanwhile
+            continue;
+        }
+        if (entryCount == entryCapacity)
+        {
+            entryCapacity = entryCapacity ? 2 * entryCapacity : 64;
+            entries = realloc(entries, sizeof(EntryFile) * entryCapacity);
+            if (!entries)
+            {
+                perror("Failed to allocate cache entry list");
+                exit(EXIT_FAILURE);
+            }
+        }
+        entries[entryCount++] = (EntryFile){path, status.st_size, status.st_mtim};
+        totalBytes += status.st_size;
+    }
+    closedir(directory);
+
+    // Least recently used first
+    qsort(entries, entryCount, sizeof(EntryFile), compareUse);
+    int kept = entryCount;
+    for (int i = 0; i < entryCount && totalBytes > cacheLimit; i++)
+    {
+        if (unlink(entries[i].name) == 0)
+            compilerStats.cacheEvictions++;
+        totalBytes -= entries[i].bytes;
+        kept--;
+    }
+    for (int i = 0; i < entryCount; i++)
+        free(entries[i].name);
+    free(entries);
+    leavePhase();
+
+    printf("CACHE: %lld hits, %lld misses, %lld stored, %lld evicted; %d entries, %lld bytes in %s\n",
+           compilerStats.cacheHits, compilerStats.cacheMisses, compilerStats.cacheStores,
+           compilerStats.cacheEvictions, kept, totalBytes, cacheDirectory);
+}
@@ -0,0 +1,64 @@
+#ifndef FUNCTION_CACHE_H
+#define FUNCTION_CACHE_H
+
+#include "AST.h"
+#include "IRGeneration.h"
+#include "MipsInstruction.h"
+
+// Function-granular compile cache (--cache=<dir>). Each function is keyed by a
+// hash of everything its code depends on: its AST, the options that shape code
+// generation, the signatures of the functions it calls, the globals it names
+// and the name of the unit placed after it, whose label the peephole pass may
+// branch to. An entry holds the function's optimized IR and its finished
+// instructions, with its labels, temporaries and float constants numbered from
+// the function's start. A function whose entry exists is neither generated nor
+// translated: the entry is renumbered to where the function falls in this
+// compile and spliced in, so the output is the same as without the cache.
+// Entries are files named by their key; when the compile ends, the least
+// recently used go until the directory is within --cache-size.
+
+#define FUNCTION_CACHE_KEY_LENGTH 32 // Hex digits of the 128-bit key
+
+typedef struct CachedFunction
+{
+    char key[FUNCTION_CACHE_KEY_LENGTH + 1];
+    const char *name;
+    int hit;        // The entry exists; otherwise the function is compiled and stored
+    int labelBase;  // First L<n> label and t<n> temporary the function has in this compile
+    int labelCount;
+    int tempBase;
+    int tempCount;
+    float *floats;  // Float constants in the order the function first asks for them
+    int floatCount;
+    char **floatLabels;
+    char *text;     // Hits: the entry, split into words, until it is reused
+    char **words;
+    int wordCount;
+    int nextWord;   // The first word after the header
+    IRInstruction *ir; // Hits: the stored IR and instructions, renumbered
+    MipsList *code;
+    int instructionsBefore; // Instructions before and after the peephole pass
+    int instructionsAfter;
+} CachedFunction;
+
+void openFunctionCache(const char *directory, long long limitBytes);
+// --serve with --cache: loads the directory's entries into memory, and on later
+// calls the ones added since, dropping the evicted. Workers forked afterwards
+// whose --cache is the same directory read entries from there.
+void keepFunctionCacheResident(const char *directory);
+// Evicts down to the size limit and reports hits and misses
+void closeFunctionCache();
+
+// IR generation: the function's entry, read from the cache on a hit. NULL when
+// it cannot be cached because an identical function came before it.
+CachedFunction *findCachedFunction(ASTNode *program, ASTNode *function, const char *nextUnit);
+// Renumbers a hit from labelBase and tempBase; the float constants are asked
+// for again, so they get the labels generating the function would give them
+IRInstruction *reuseCachedFunction(CachedFunction *cached);
+// The entry a unit's FUNCTION instruction names by its key in arg1, if any
+CachedFunction *cachedFunction(const char *key);
+// After a miss is translated: [first, end) is its optimized IR, list its code
+void storeCachedFunction(CachedFunction *cached, IRInstruction *first, IRInstruction *end, MipsList *list,
+                         int instructionsBefore, int instructionsAfter);
+
+#endif // FUNCTION_CACHE_H
@@ -1,16 +1,77 @@
 #include "IRGeneration.h"
 #include "AST.h"
+#include "LoopUnrolling.h"
+#include "Vectorization.h"
+#include "Inlining.h"
+#include "Profile.h"
+#include "Options.h"
+#include "DataLayout.h"
+#include "CompilerStats.h"
+#include "FunctionCache.h"
+#include "NameTable.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 
 static int tempCount = 0;  // Counter for generating unique temporary variable names
 static int labelCount = 0; // Counter for generating unique label names
 
+// Function being generated, NULL for main; its declarations shadow globals
+static ASTNode *currentFunction = NULL;
+// The whole program, searched for the signatures of called functions
+static ASTNode *program = NULL;
+// Hash index of program's function declarations; a streamed program grows, so
+// children from indexedCount on are added on the next lookup
+static ASTNode **functionTable = NULL;
+static int functionTableSize = 0;
+static int functionTableCount = 0;
+static ASTNode *indexedProgram = NULL;
+static int indexedCount = 0;
+// Functions a streamed function called before they were declared; their values
+// and arguments were taken to be ints
+static char **undeclaredCalls = NULL;
+static int undeclaredCallCount = 0;
+// The statement before the one being generated in its block, which may give a
+// counted loop its starting value
+static ASTNode *previousStatement = NULL;
+// Where self tail calls of the function being generated jump back to, made on first use
+static char *tailCallLabel = NULL;
+// Parts of ifs the profile found cold, placed after the unit's return so that
+// the hot path runs straight through
+static IRInstruction *coldCode = NULL;
+
+// Variables and arrays in scope in the function being generated, main's inner
+// blocks included; each block drops its own when it ends
+typedef struct LocalDeclaration
+{
+    char *name;
+    char *storage; // Its name in the IR, fresh when name was taken already
+    int words;     // Elements of an array, 0 for a scalar
+    TypeCode type;
+} LocalDeclaration;
+
+static LocalDeclaration *locals = NULL;
+static int localStart = 0; // First entry belonging to the current function
+static int localCount = 0;
+static int localCapacity = 0;
+// Every name the current function has declared, in scope or not, so that a
+// redeclaration gets storage of its own
+static char **declaredNames = NULL;
+static int declaredStart = 0;
+static int declaredCount = 0;
+static int declaredCapacity = 0;
+static int storageCount = 0; // Counter for fresh storage names
+// Blocks around the statement being generated; main's own declarations, outside
+// any block, are its globals
+static int blockDepth = 0;
+
 char *newLabel()
 {
     char labelName[20];
     sprintf(labelName, "L%d", labelCount++);
+    compilerStats.labels++;
     return strdup(labelName);
 }
 
@@ -18,9 +79,178 @@ char *newTemp()
 {
     char tempName[20];
     sprintf(tempName, "t%d", tempCount++);
+    compilerStats.temps++;
     return strdup(tempName);
 }
 
+IRInstruction *createInstruction(const char *op, char *arg1, char *arg2, char *result)
+{
+    IRInstruction *instr = malloc(sizeof(IRInstruction));
+    if (!instr)
+    {
+        perror("Failed to allocate IR instruction");
+        exit(EXIT_FAILURE);
+    }
+    instr->op = strdup(op);
+    instr->arg1 = arg1;
+    instr->arg2 = arg2;
+    instr->result = result;
+    instr->next = NULL;
+    compilerStats.irInstructions++;
+    return instr;
+}
+
+static char *indexString(int index)
+{
+    char text[20];
+    sprintf(text, "%d", index);
+    return strdup(text);
+}
+
+char *immediateOperand(int value)
+{
+    char text[20];
+    sprintf(text, "#%d", value);
+    return strdup(text);
+}
+
+// True once the current function has declared name, or name is a global the
+// declaration would hide
+static int isNameTaken(const char *name)
+{
+    if (findGlobal(name))
+        return 1;
+    for (int i = declaredStart; i < declaredCount; i++)
+    {
+        if (strcmp(declaredNames[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Declares a local in the innermost scope and returns its name in the IR
+static char *declareLocal(char *name, int words, TypeCode type)
+{
+    char *storage = name;
+    if (isNameTaken(name))
+    {
+        storage = malloc(strlen(name) + 16);
+        if (!storage)
+        {
+            perror("Failed to allocate storage name");
+            exit(EXIT_FAILURE);
+        }
+        sprintf(storage, "%s.s%d", name, storageCount++);
+    }
+    if (declaredCount == declaredCapacity)
+    {
+        declaredCapacity = declaredCapacity ? 2 * declaredCapacity : 8;
+        declaredNames = realloc(declaredNames, sizeof(char *) * declaredCapacity);
+        if (!declaredNames)
+        {
+            perror("Failed to allocate declared name list");
+            exit(EXIT_FAILURE);
+        }
+    }
+    declaredNames[declaredCount++] = name;
+    if (localCount == localCapacity)
+    {
+        localCapacity = localCapacity ? 2 * localCapacity : 8;
+        locals = realloc(locals, sizeof(LocalDeclaration) * localCapacity);
+        if (!locals)
+        {
+            perror("Failed to allocate local declaration table");
+            exit(EXIT_FAILURE);
+        }
+    }
+    locals[localCount].name = name;
+    locals[localCount].storage = storage;
+    locals[localCount].words = words;
+    locals[localCount].type = type;
+    localCount++;
+    return storage;
+}
+
+// The innermost local declaration of name in the current function, if any
+static LocalDeclaration *findLocal(const char *name, int isArray)
+{
+    for (int i = localCount - 1; i >= localStart; i--)
+    {
+        if ((locals[i].words > 0) == isArray && strcmp(locals[i].name, name) == 0)
+            return &locals[i];
+    }
+    return NULL;
+}
+
+// The IR name of the variable, or array, name refers to here: its local's storage, else the global's name
+static char *storageName(const char *name, int isArray)
+{
+    LocalDeclaration *local = findLocal(name, isArray);
+    return strdup(local ? local->storage : name);
+}
+
+// Element count of the array name refers to here: the innermost local one, else the global
+static int arrayWords(const char *name)
+{
+    LocalDeclaration *local = findLocal(name, 1);
+    if (local)
+        return local->words;
+    DataObject *global = findGlobal(name);
+    if (!global || !global->isArray)
+    {
+        fprintf(stderr, "Error: %s is not an array\n", name);
+        exit(EXIT_FAILURE);
+    }
+    return global->words;
+}
+
+// A global scalar that lives in memory, not shadowed by a local in scope
+static int isMemoryVariable(const char *name)
+{
+    return !findLocal(name, 0) && isMemoryGlobal(name);
+}
+
+// Computes the address of array[index]: a bounds check, then base + index * 4.
+// Instruction selection turns the multiply into a shift and folds the base and
+// any constant part of the index into the load or store.
+static IRInstruction *generateElementAddress(ASTNode *access, char **address)
+{
+    char *name = access->children[0]->value.strValue;
+    int words = arrayWords(name);
+    IRInstruction *code = generateIRForNode(access->children[1]);
+    char *index = lastInstruction(code)->result;
+    IRInstruction *scale = createInstruction("MOV", strdup("4"), NULL, newTemp());
+    IRInstruction *offset = createInstruction("*", index, scale->result, newTemp());
+    IRInstruction *base = createInstruction("ADDR", storageName(name, 1), NULL, newTemp());
+    IRInstruction *sum = createInstruction("+", base->result, offset->result, newTemp());
+    appendInstruction(code, createInstruction("CHECK_BOUNDS", index, immediateOperand(words), NULL));
+    appendInstruction(code, scale);
+    appendInstruction(code, offset);
+    appendInstruction(code, base);
+    appendInstruction(code, sum);
+    *address = sum->result;
+    return code;
+}
+
+// A top-level scalar kept in memory whose .data slot already holds its literal initializer
+static int isPreinitializedGlobal(ASTNode *declaration)
+{
+    if (declaration->type != AST_DECLARATION)
+        return 0;
+    DataObject *global = findGlobal(declaration->children[1]->value.strValue);
+    return global->inMemory && global->initialized;
+}
+
+// Stores value into a variable: a register copy, or a store to its global slot
+static IRInstruction *generateStore(char *value, char *variable)
+{
+    if (!isMemoryVariable(variable))
+        return createInstruction("=", value, NULL, storageName(variable, 0));
+    IRInstruction *address = createInstruction("ADDR", strdup(variable), NULL, newTemp());
+    appendInstruction(address, createInstruction("STORE", value, address->result, NULL));
+    return address;
+}
+
 IRInstruction *appendInstruction(IRInstruction *list, IRInstruction *instr)
 {
     if (!list)
@@ -34,6 +264,831 @@ IRInstruction *appendInstruction(IRInstruction *list, IRInstruction *instr)
     return list;
 }
 
+// Returns the last instruction of a list; it defines the value of an expression
+IRInstruction *lastInstruction(IRInstruction *list)
+{
+    if (!list)
+        return NULL;
+    while (list->next)
+    {
+        list = list->next;
+    }
+    return list;
+}
+
+// The IR spelling of a comparison operator, or NULL when op is not one
+static const char *relationOperator(OperatorType op)
+{
+    switch (op)
+    {
+    case OP_LESS:
+        return "<";
+    case OP_LESS_EQUAL:
+        return "<=";
+    case OP_GREATER:
+        return ">";
+    case OP_GREATER_EQUAL:
+        return ">=";
+    case OP_EQUAL:
+        return "==";
+    case OP_NOT_EQUAL:
+        return "!=";
+    default:
+        return NULL;
+    }
+}
+
+static const char *negateRelation(const char *relation)
+{
+    static const char *pairs[][2] = {{"<", ">="}, {"<=", ">"}, {">", "<="}, {">=", "<"}, {"==", "!="}, {"!=", "=="}};
+    for (int i = 0; i < 6; i++)
+    {
+        if (strcmp(pairs[i][0], relation) == 0)
+            return pairs[i][1];
+    }
+    return NULL;
+}
+
+// The single-precision form of an arithmetic or comparison operator
+static const char *floatOperator(OperatorType op)
+{
+    static const char *operators[] = {"FADD", "FSUB", "FMUL", "FDIV", "FNEG", "FLT", "FLE", "FGT", "FGE", "FEQ", "FNE"};
+    return operators[op];
+}
+
+// Type of the variable, or the elements of the array, name refers to here
+static TypeCode variableType(const char *name, int isArray)
+{
+    LocalDeclaration *local = findLocal(name, isArray);
+    if (local)
+        return local->type;
+    DataObject *global = findGlobal(name);
+    return global && global->isFloat ? TypeFLOAT : TypeINT;
+}
+
+static const char *functionInSlot(const void *table, int slot)
+{
+    ASTNode *function = ((ASTNode *const *)table)[slot];
+    return function ? function->children[1]->value.strValue : NULL;
+}
+
+// Finds the slot holding the function called name, or the empty slot where it belongs
+static int probeFunction(ASTNode **table, int size, const char *name)
+{
+    return probeNameTable(table, size, functionInSlot, name);
+}
+
+static void indexFunction(ASTNode *function)
+{
+    if (2 * (functionTableCount + 1) > functionTableSize)
+    {
+        int size = functionTableSize ? 2 * functionTableSize : 64;
+        ASTNode **table = calloc(size, sizeof(ASTNode *));
+        if (!table)
+        {
+            perror("Failed to allocate function table");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < functionTableSize; i++)
+        {
+            if (functionTable[i])
+                table[probeFunction(table, size, functionTable[i]->children[1]->value.strValue)] = functionTable[i];
+        }
+        free(functionTable);
+        functionTable = table;
+        functionTableSize = size;
+    }
+    int slot = probeFunction(functionTable, functionTableSize, function->children[1]->value.strValue);
+    if (functionTable[slot])
+        return; // The first declaration of a name is the one calls see
+    functionTable[slot] = function;
+    functionTableCount++;
+}
+
+static ASTNode *findFunction(const char *name)
+{
+    if (!program)
+        return NULL;
+    if (program != indexedProgram)
+    {
+        if (functionTable)
+            memset(functionTable, 0, sizeof(ASTNode *) * functionTableSize);
+        functionTableCount = 0;
+        indexedProgram = program;
+        indexedCount = 0;
+    }
+    for (; indexedCount < program->childCount; indexedCount++)
+    {
+        ASTNode *child = program->children[indexedCount];
+        if (child->type == AST_FUNCTION_DECLARATION)
+            indexFunction(child);
+    }
+    return functionTableSize ? functionTable[probeFunction(functionTable, functionTableSize, name)] : NULL;
+}
+
+// Values are ints or floats; anything else declared (void, untyped parameters) is an int
+static TypeCode valueType(TypeCode declared)
+{
+    return declared == TypeFLOAT ? TypeFLOAT : TypeINT;
+}
+
+static TypeCode parameterType(ASTNode *parameter)
+{
+    return parameter->childCount > 0 ? valueType(parameter->children[0]->value.typeCode) : TypeINT;
+}
+
+static TypeCode expressionType(ASTNode *node);
+
+// Comparisons and arithmetic work in float when either operand is a float
+static TypeCode operandType(ASTNode *binary)
+{
+    if (expressionType(binary->children[0]) == TypeFLOAT || expressionType(binary->children[1]) == TypeFLOAT)
+        return TypeFLOAT;
+    return TypeINT;
+}
+
+static TypeCode expressionType(ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_FLOAT_LITERAL:
+        return TypeFLOAT;
+    case AST_VARIABLE:
+        return variableType(node->value.strValue, 0);
+    case AST_ARRAY_ACCESS:
+        return variableType(node->children[0]->value.strValue, 1);
+    case AST_FUNCTION_CALL:
+    {
+        ASTNode *function = findFunction(node->children[0]->value.strValue);
+        return function ? valueType(function->children[0]->value.typeCode) : TypeINT;
+    }
+    case AST_BINARY_EXPR:
+        return relationOperator(node->value.opType) ? TypeINT : operandType(node); // Comparisons give an int flag
+    case AST_UNARY_EXPR:
+        return node->value.opType == OP_NEGATE ? expressionType(node->children[0]) : TypeINT;
+    default:
+        return TypeINT;
+    }
+}
+
+// Float values have no immediate form; each literal is a load from the constant pool
+static IRInstruction *generateFloatConstant(float value)
+{
+    return createInstruction("FMOV", strdup(floatConstantLabel(value)), NULL, newTemp());
+}
+
+// Generates the value of node converted to type, as assignment, argument passing
+// and mixed arithmetic require. An int literal becomes a float constant directly.
+static IRInstruction *generateConverted(ASTNode *node, TypeCode type)
+{
+    type = valueType(type);
+    if (node->type == AST_LITERAL && type == TypeFLOAT)
+        return generateFloatConstant((float)node->value.intValue);
+    IRInstruction *code = generateIRForNode(node);
+    if (expressionType(node) == type)
+        return code;
+    char *value = lastInstruction(code)->result;
+    return appendInstruction(code, createInstruction(type == TypeFLOAT ? "ITOF" : "FTOI", value, NULL, newTemp()));
+}
+
+// Name of the function being generated, as profiles key it
+static const char *profiledFunction()
+{
+    return currentFunction ? currentFunction->children[1]->value.strValue : "main";
+}
+
+// Instrumented builds: bumps the counter of one of node's probes
+static IRInstruction *generateCount(ASTNode *node, ProbeKind kind)
+{
+    if (!compilerOptions.profileGenerate || !node->probe)
+        return NULL;
+    return createInstruction("COUNT", indexString(addProbeCounter(profiledFunction(), node->probe, kind)), NULL, NULL);
+}
+
+// return f(...) inside f: the arguments become the new parameter values and the
+// call a jump back past the parameter bindings, so the recursion runs as a loop.
+// Returns NULL when call is not a self call that can be replaced.
+static IRInstruction *generateSelfTailCall(ASTNode *call)
+{
+    if (!compilerOptions.tailCalls || !currentFunction || call->type != AST_FUNCTION_CALL ||
+        strcmp(call->children[0]->value.strValue, currentFunction->children[1]->value.strValue) != 0)
+        return NULL;
+    ASTNode *arguments = call->children[1];
+    ASTNode *parameters = currentFunction->children[2];
+    int count = parameters ? parameters->childCount : 0;
+    if (arguments->childCount != count)
+        return NULL;
+
+    // Every argument is evaluated before any parameter changes, as for a real call
+    IRInstruction *code = generateCount(call, PROBE_CALL);
+    char **values = malloc(sizeof(char *) * (count + 1));
+    for (int i = 0; i < count; i++)
+    {
+        ASTNode *argument = arguments->children[i];
+        values[i] = NULL;
+        if (argument->type == AST_VARIABLE && findLocal(argument->value.strValue, 0) == &locals[localStart + i])
+            continue; // Passed on unchanged
+        IRInstruction *value = generateConverted(argument, parameterType(parameters->children[i]));
+        values[i] = lastInstruction(value)->result;
+        code = appendInstruction(code, value);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (values[i]) // A block may hide the parameter, so it is stored to by its own storage
+            code = appendInstruction(code, createInstruction("=", values[i], NULL, strdup(locals[localStart + i].storage)));
+    }
+    free(values);
+
+    if (!tailCallLabel)
+        tailCallLabel = newLabel();
+    printf("TAIL: %s calls itself in tail position, looping to %s\n", call->children[0]->value.strValue, tailCallLabel);
+    return appendInstruction(code, createInstruction("GOTO", strdup(tailCallLabel), NULL, NULL));
+}
+
+// A float condition is true when it compares unequal to 0.0
+static IRInstruction *generateFloatTest(IRInstruction *code, const char *op)
+{
+    char *value = lastInstruction(code)->result;
+    IRInstruction *zero = generateFloatConstant(0.0f);
+    appendInstruction(code, zero);
+    return appendInstruction(code, createInstruction(op, value, zero->result, newTemp()));
+}
+
+// Evaluates condition and jumps to target when it is true (or false), as one
+// IF<relation> instruction. A comparison branches on its operands directly
+// instead of materializing 0 or 1; a missing arg2 stands for zero. Float
+// comparisons set a flag first, and the branch tests the flag.
+static IRInstruction *generateConditionalBranch(ASTNode *condition, int branchWhenTrue, char *target)
+{
+    const char *relation = NULL;
+    if (compilerOptions.fuseBranches && condition->type == AST_BINARY_EXPR && operandType(condition) == TypeINT)
+        relation = relationOperator(condition->value.opType);
+
+    IRInstruction *code;
+    char *left;
+    char *right = NULL;
+    if (relation)
+    {
+        code = generateIRForNode(condition->children[0]);
+        left = lastInstruction(code)->result;
+        ASTNode *rightNode = condition->children[1];
+        if (rightNode->type != AST_LITERAL || rightNode->value.intValue != 0)
+        {
+            IRInstruction *rightInstr = generateIRForNode(rightNode);
+            right = lastInstruction(rightInstr)->result;
+            appendInstruction(code, rightInstr);
+        }
+    }
+    else
+    {
+        code = generateIRForNode(condition);
+        if (expressionType(condition) == TypeFLOAT)
+            code = generateFloatTest(code, "FNE");
+        left = lastInstruction(code)->result;
+        relation = "!=";
+    }
+    if (!branchWhenTrue)
+        relation = negateRelation(relation);
+
+    char op[8];
+    sprintf(op, "IF%s", relation);
+    return appendInstruction(code, createInstruction(op, left, right, strdup(target)));
+}
+
+static void rememberUndeclaredCall(const char *name)
+{
+    for (int i = 0; i < undeclaredCallCount; i++)
+    {
+        if (strcmp(undeclaredCalls[i], name) == 0)
+            return;
+    }
+    undeclaredCalls = realloc(undeclaredCalls, sizeof(char *) * (undeclaredCallCount + 1));
+    if (!undeclaredCalls)
+    {
+        perror("Failed to allocate undeclared call list");
+        exit(EXIT_FAILURE);
+    }
+    undeclaredCalls[undeclaredCallCount++] = strdup(name);
+}
+
+IRInstruction *generateStreamedFunctionIR(ASTNode *programSoFar, ASTNode *function)
+{
+    program = programSoFar;
+    const char *name = function->children[1]->value.strValue;
+    for (int i = 0; i < undeclaredCallCount; i++)
+    {
+        if (strcmp(undeclaredCalls[i], name) != 0)
+            continue;
+        // Earlier callers were compiled assuming ints
+        int allInts = valueType(function->children[0]->value.typeCode) == TypeINT;
+        for (int p = 0; function->children[2] && p < function->children[2]->childCount; p++)
+            allInts = allInts && parameterType(function->children[2]->children[p]) == TypeINT;
+        if (!allInts)
+        {
+            fprintf(stderr, "Error: %s takes or returns a float and is called before its declaration, "
+                            "which --stream cannot compile\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    layOutFunctionGlobals(function);
+    return generateIRForNode(function);
+}
+
+static int comparePointers(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)*(void *const *)a, y = (uintptr_t)*(void *const *)b;
+    return x < y ? -1 : x > y;
+}
+
+void freeIRInstructions(IRInstruction **instructions, int count)
+{
+    // Sorting puts each shared instruction or string next to its copies
+    void **pointers = malloc(sizeof(void *) * (5 * count + 1));
+    if (!pointers)
+    {
+        perror("Failed to allocate IR free list");
+        exit(EXIT_FAILURE);
+    }
+    int pointerCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        IRInstruction *ir = instructions[i];
+        void *owned[] = {ir, ir->op, ir->arg1, ir->arg2, ir->result};
+        for (int k = 0; k < 5; k++)
+        {
+            if (owned[k])
+                pointers[pointerCount++] = owned[k];
+        }
+    }
+    qsort(pointers, pointerCount, sizeof(void *), comparePointers);
+    for (int i = 0; i < pointerCount; i++)
+    {
+        if (i == 0 || pointers[i] != pointers[i - 1])
+            free(pointers[i]);
+    }
+    free(pointers);
+}
+
+// --cache: a function whose entry exists is not generated; the stored IR takes
+// its place, along with the labels and temporaries generating it would have used
+static IRInstruction *generateCachedFunction(ASTNode *function, const char *nextUnit)
+{
+    CachedFunction *cached = findCachedFunction(program, function, nextUnit);
+    if (!cached)
+        return generateIRForNode(function);
+    cached->labelBase = labelCount;
+    cached->tempBase = tempCount;
+    IRInstruction *unit;
+    if (cached->hit)
+    {
+        unit = reuseCachedFunction(cached);
+    }
+    else
+    {
+        startRecordingFloatConstants();
+        unit = generateIRForNode(function);
+        cached->floats = stopRecordingFloatConstants(&cached->floatCount);
+        cached->labelCount = labelCount - cached->labelBase;
+        cached->tempCount = tempCount - cached->tempBase;
+    }
+    labelCount = cached->labelBase + cached->labelCount;
+    tempCount = cached->tempBase + cached->tempCount;
+    unit->arg1 = strdup(cached->key); // The back end reuses or stores the unit's code by it
+    return unit;
+}
+
+// The unit after a function: the next function with a body, or none
+static const char *nextUnitName(ASTNode *program, int index)
+{
+    for (int i = index + 1; i < program->childCount; i++)
+    {
+        ASTNode *child = program->children[i];
+        if (child->type == AST_FUNCTION_DECLARATION && child->children[3])
+            return child->children[1]->value.strValue;
+    }
+    return NULL;
+}
+
+static IRInstruction *generateWhileLoop(ASTNode *node)
+{
+    printf("IR: WHILE Loop\n");
+    IRInstruction *first;
+    char *bodyLabel = newLabel();
+    char *endLabel = newLabel();
+    if (compilerOptions.fuseBranches)
+    {
+        // Rotated loop: a guard skips the loop, and the test at the bottom
+        // branches back, so each iteration takes exactly one branch
+        first = generateConditionalBranch(node->children[0], 0, endLabel);
+        appendInstruction(first, createInstruction("LABEL", strdup(bodyLabel), NULL, NULL));
+        appendInstruction(first, generateCount(node, PROBE_BODY));
+        appendInstruction(first, generateIRForNode(node->children[1]));
+        appendInstruction(first, generateConditionalBranch(node->children[0], 1, bodyLabel));
+    }
+    else
+    {
+        // Test at the top: every iteration takes the jump back to the test
+        first = createInstruction("LABEL", strdup(bodyLabel), NULL, NULL);
+        appendInstruction(first, generateConditionalBranch(node->children[0], 0, endLabel));
+        appendInstruction(first, generateCount(node, PROBE_BODY));
+        appendInstruction(first, generateIRForNode(node->children[1]));
+        appendInstruction(first, createInstruction("GOTO", strdup(bodyLabel), NULL, NULL));
+    }
+    appendInstruction(first, createInstruction("LABEL", strdup(endLabel), NULL, NULL));
+    printf("IR: Loop body at %s, exit at %s\n", bodyLabel, endLabel);
+    return first;
+}
+
+// The literal statement leaves in name, when it is `name = literal` or `int name = literal`
+static int knownStart(ASTNode *statement, const char *name, int *start)
+{
+    ASTNode *target, *value;
+    if (statement && statement->type == AST_ASSIGNMENT)
+    {
+        target = statement->children[0];
+        value = statement->children[1];
+    }
+    else if (statement && statement->type == AST_DECLARATION && statement->childCount == 3)
+    {
+        target = statement->children[1];
+        value = statement->children[2];
+    }
+    else
+        return 0;
+    if (target->type != AST_VARIABLE || strcmp(target->value.strValue, name) != 0 || value->type != AST_LITERAL)
+        return 0;
+    *start = value->value.intValue;
+    return 1;
+}
+
+// A counted loop whose bound and induction variable no call in the body can change
+static int isUnrollable(ASTNode *loop, CountedLoop *counted)
+{
+    if (!findCountedLoop(loop, counted))
+        return 0;
+    const char *name = counted->induction->value.strValue;
+    const char *bound = counted->bound->type == AST_VARIABLE ? counted->bound->value.strValue : NULL;
+    if (variableType(name, 0) != TypeINT || (bound && variableType(bound, 0) != TypeINT))
+        return 0;
+    return !counted->hasCalls || (!isMemoryVariable(name) && !(bound && isMemoryVariable(bound)));
+}
+
+// Unrolls a counted loop, or returns NULL to leave it to generateWhileLoop. A
+// loop whose trip count the statement before it fixes is flattened into copies
+// of its body. Otherwise a loop runs factor copies per test while i is at least
+// factor - 1 steps short of the bound, and the original loop finishes the rest:
+//     [if (bound - distance cannot overflow)]
+//         while (i < bound - distance) { body; body; ... }
+//     while (i < bound) { body }
+// The body copies run the same statements in the same order as before, so the
+// only new arithmetic is bound - distance, which the guard keeps in range.
+static IRInstruction *generateUnrolledLoop(ASTNode *loop, ASTNode *entry, int requestedFactor)
+{
+    CountedLoop counted;
+    if (!isUnrollable(loop, &counted))
+        return NULL;
+    const char *name = counted.induction->value.strValue;
+    ASTNode *body = loop->children[1];
+
+    int start, trips;
+    if (knownStart(entry, name, &start) && (trips = constantTripCount(&counted, start)) >= 0)
+    {
+        printf("UNROLL: Loop on %s flattened into %d iterations\n", name, trips);
+        ASTNode empty = {.type = AST_BLOCK};
+        IRInstruction *code = trips == 0 ? generateIRForNode(&empty) : NULL;
+        for (int i = 0; i < trips; i++)
+            code = appendInstruction(code, generateIRForNode(body));
+        return code;
+    }
+
+    int factor = unrollFactor(&counted, requestedFactor);
+    if (factor < 2)
+        return NULL;
+    long long distance = (long long)(factor - 1) * counted.step;
+
+    // The unrolled loop's bound, as a literal or as bound - distance
+    ASTNode distanceNode = {.type = AST_LITERAL, .value.intValue = (int)distance};
+    ASTNode *limitOperands[2] = {counted.bound, &distanceNode};
+    ASTNode limitNode = {.type = AST_BINARY_EXPR, .value.opType = OP_MINUS, .children = limitOperands, .childCount = 2};
+    if (counted.bound->type == AST_LITERAL)
+    {
+        long long limit = counted.bound->value.intValue - distance;
+        if (limit < INT_MIN || limit > INT_MAX)
+            return NULL;
+        limitNode = (ASTNode){.type = AST_LITERAL, .value.intValue = (int)limit};
+    }
+    ASTNode *testOperands[2] = {counted.induction, &limitNode};
+    ASTNode test = {.type = AST_BINARY_EXPR, .value.opType = counted.relation, .children = testOperands, .childCount = 2};
+
+    ASTNode **copies = malloc(sizeof(ASTNode *) * factor);
+    if (!copies)
+    {
+        perror("Failed to allocate unrolled loop body");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < factor; i++)
+        copies[i] = body;
+    ASTNode unrolledBody = {.type = AST_BLOCK, .children = copies, .childCount = factor};
+    ASTNode *loopParts[2] = {&test, &unrolledBody};
+    ASTNode unrolled = {.type = AST_WHILE_LOOP, .children = loopParts, .childCount = 2};
+
+    printf("UNROLL: Loop on %s unrolled by %d\n", name, factor);
+    char *remainderLabel = newLabel();
+    IRInstruction *code = NULL;
+    if (counted.bound->type == AST_VARIABLE)
+    {
+        ASTNode edgeNode = {.type = AST_LITERAL,
+                            .value.intValue = distance > 0 ? INT_MIN + (int)distance : INT_MAX + (int)distance};
+        ASTNode *guardOperands[2] = {counted.bound, &edgeNode};
+        ASTNode guard = {.type = AST_BINARY_EXPR,
+                         .value.opType = distance > 0 ? OP_GREATER_EQUAL : OP_LESS_EQUAL,
+                         .children = guardOperands,
+                         .childCount = 2};
+        code = generateConditionalBranch(&guard, 0, remainderLabel);
+    }
+    code = appendInstruction(code, generateWhileLoop(&unrolled));
+    appendInstruction(code, createInstruction("LABEL", remainderLabel, NULL, NULL));
+    appendInstruction(code, generateWhileLoop(loop));
+    free(copies);
+    return code;
+}
+
+// Whether node computes the same over vectors of type as it does one element at
+// a time: every operation works in type, the type its statement stores, and
+// only literals and variables may need converting to it. Ints have no vector
+// division here.
+static int fitsVectorType(ASTNode *node, TypeCode type)
+{
+    switch (node->type)
+    {
+    case AST_ARRAY_ACCESS:
+        return variableType(node->children[0]->value.strValue, 1) == type;
+    case AST_BINARY_EXPR:
+        if (node->value.opType == OP_DIVIDE && type != TypeFLOAT)
+            return 0;
+        return operandType(node) == type && fitsVectorType(node->children[0], type) &&
+               fitsVectorType(node->children[1], type);
+    default:
+        return type == TypeFLOAT || expressionType(node) == TypeINT;
+    }
+}
+
+// A vector loop being generated
+typedef struct VectorCode
+{
+    VectorLoop *loop;
+    IRInstruction *preheader;         // Splats and array bases, computed once before the loop
+    char *bases[MAX_VECTOR_ACCESSES]; // Address of each access's element at i = 0
+    char *offset;                     // i * 4 in the iteration
+} VectorCode;
+
+// The address access reads or writes in the iteration: its base plus i * 4
+static IRInstruction *generateVectorAddress(ASTNode *access, VectorCode *vector)
+{
+    int a = findVectorAccess(vector->loop, access);
+    if (!vector->bases[a])
+    {
+        int offset = vector->loop->accesses[a].offset;
+        IRInstruction *base = createInstruction("ADDR", storageName(vector->loop->accesses[a].array, 1), NULL, newTemp());
+        if (offset != 0)
+        {
+            IRInstruction *bytes = createInstruction("MOV", indexString(4 * offset), NULL, newTemp());
+            appendInstruction(base, bytes);
+            appendInstruction(base, createInstruction("+", base->result, bytes->result, newTemp()));
+        }
+        vector->bases[a] = lastInstruction(base)->result;
+        vector->preheader = appendInstruction(vector->preheader, base);
+    }
+    return createInstruction("+", vector->bases[a], vector->offset, newTemp());
+}
+
+// Copies node, converted to type, into every lane once before the loop
+static char *generateSplat(ASTNode *node, TypeCode type, VectorCode *vector)
+{
+    IRInstruction *value = generateConverted(node, type);
+    IRInstruction *splat =
+        createInstruction(type == TypeFLOAT ? "VFFILL" : "VFILL", lastInstruction(value)->result, NULL, newTemp());
+    vector->preheader = appendInstruction(vector->preheader, appendInstruction(value, splat));
+    return splat->result;
+}
+
+// Computes node for the iteration's elements into *value. Literals and variables
+// are splats, so they add no code to the loop itself.
+static IRInstruction *generateVectorValue(ASTNode *node, TypeCode type, VectorCode *vector, char **value)
+{
+    static const char *intOperators[] = {"VADD", "VSUB", "VMUL"};
+    static const char *floatOperators[] = {"VFADD", "VFSUB", "VFMUL", "VFDIV"};
+    IRInstruction *code;
+    switch (node->type)
+    {
+    case AST_ARRAY_ACCESS:
+        code = generateVectorAddress(node, vector);
+        appendInstruction(code, createInstruction("VLOAD", code->result, NULL, newTemp()));
+        break;
+    case AST_BINARY_EXPR:
+    {
+        char *left, *right;
+        code = generateVectorValue(node->children[0], type, vector, &left);
+        code = appendInstruction(code, generateVectorValue(node->children[1], type, vector, &right));
+        const char *op = type == TypeFLOAT ? floatOperators[node->value.opType] : intOperators[node->value.opType];
+        code = appendInstruction(code, createInstruction(op, left, right, newTemp()));
+        break;
+    }
+    default:
+        *value = generateSplat(node, type, vector);
+        return NULL;
+    }
+    *value = lastInstruction(code)->result;
+    return code;
+}
+
+// Runs a counted array loop four elements per iteration with MSA instructions
+// (--msa), or returns NULL to leave it to the scalar paths. The vector loop
+// takes four elements while all of them are in the loop's range, and the
+// original loop finishes the rest:
+//     if (lowest + 3 <= bound <= limit && i >= lowest)
+//         while (i < bound - 3) { each statement over elements i to i + 3; i = i + 4; }
+//     while (i < bound) { body }
+// i at least lowest keeps every index from being negative, and bound at most
+// limit keeps every index within its array, so the vector loop needs no bounds
+// checks. A loop that would run off an array stays scalar and traps where it did.
+static IRInstruction *generateVectorLoop(ASTNode *loop, ASTNode *entry)
+{
+    VectorLoop vector;
+    if (!compilerOptions.vectorize || compilerOptions.profileGenerate || !findVectorLoop(loop, &vector))
+        return NULL;
+    CountedLoop *counted = &vector.counted;
+    const char *name = counted->induction->value.strValue;
+    const char *bound = counted->bound->type == AST_VARIABLE ? counted->bound->value.strValue : NULL;
+    if (variableType(name, 0) != TypeINT || (bound && variableType(bound, 0) != TypeINT))
+        return NULL;
+    ASTNode *body = loop->children[1];
+    for (int s = 0; s < body->childCount - 1; s++)
+    {
+        ASTNode *statement = body->children[s];
+        if (!fitsVectorType(statement->children[1], variableType(statement->children[0]->children[0]->value.strValue, 1)))
+            return NULL;
+    }
+
+    int inclusive = counted->relation == OP_LESS_EQUAL;
+    long long lowest = INT_MIN, limit = INT_MAX;
+    for (int a = 0; a < vector.accessCount; a++)
+    {
+        long long offset = vector.accesses[a].offset;
+        if (-offset > lowest)
+            lowest = -offset;
+        if (arrayWords(vector.accesses[a].array) - offset - inclusive < limit)
+            limit = arrayWords(vector.accesses[a].array) - offset - inclusive;
+    }
+    int start;
+    int started = knownStart(entry, name, &start);
+    if (limit < lowest + VECTOR_LANES - 1)
+        return NULL; // The arrays are too short for four elements
+    if (!bound && (counted->bound->value.intValue > limit || counted->bound->value.intValue < lowest + VECTOR_LANES ||
+                   (started && (long long)counted->bound->value.intValue - start + inclusive < VECTOR_LANES)))
+        return NULL;
+
+    char *scalarLabel = newLabel();
+    IRInstruction *code = NULL;
+    ASTNode limitNode = {.type = AST_LITERAL, .value.intValue = (int)limit};
+    ASTNode *aboveOperands[2] = {counted->bound, &limitNode};
+    ASTNode above = {.type = AST_BINARY_EXPR, .value.opType = OP_GREATER, .children = aboveOperands, .childCount = 2};
+    ASTNode floorNode = {.type = AST_LITERAL, .value.intValue = (int)lowest + VECTOR_LANES - 1};
+    ASTNode *belowOperands[2] = {counted->bound, &floorNode};
+    ASTNode below = {.type = AST_BINARY_EXPR, .value.opType = OP_LESS, .children = belowOperands, .childCount = 2};
+    if (bound)
+    {
+        // The second test also keeps bound - 3 from overflowing
+        code = generateConditionalBranch(&above, 1, scalarLabel);
+        appendInstruction(code, generateConditionalBranch(&below, 1, scalarLabel));
+    }
+    ASTNode lowestNode = {.type = AST_LITERAL, .value.intValue = (int)lowest};
+    ASTNode *earlyOperands[2] = {counted->induction, &lowestNode};
+    ASTNode early = {.type = AST_BINARY_EXPR, .value.opType = OP_LESS, .children = earlyOperands, .childCount = 2};
+    if (!started || start < lowest)
+        code = appendInstruction(code, generateConditionalBranch(&early, 1, scalarLabel));
+
+    // The vector loop's test: i < bound - 3, or i <= bound - 3
+    ASTNode distanceNode = {.type = AST_LITERAL, .value.intValue = VECTOR_LANES - 1};
+    ASTNode *lastOperands[2] = {counted->bound, &distanceNode};
+    ASTNode lastNode = {.type = AST_BINARY_EXPR, .value.opType = OP_MINUS, .children = lastOperands, .childCount = 2};
+    if (!bound)
+        lastNode = (ASTNode){.type = AST_LITERAL, .value.intValue = counted->bound->value.intValue - (VECTOR_LANES - 1)};
+    ASTNode *testOperands[2] = {counted->induction, &lastNode};
+    ASTNode test = {.type = AST_BINARY_EXPR, .value.opType = counted->relation, .children = testOperands, .childCount = 2};
+
+    VectorCode vectorCode = {.loop = &vector};
+    IRInstruction *iteration = generateIRForNode(counted->induction);
+    IRInstruction *scale = createInstruction("MOV", strdup("4"), NULL, newTemp());
+    IRInstruction *offset = createInstruction("*", lastInstruction(iteration)->result, scale->result, newTemp());
+    appendInstruction(iteration, scale);
+    appendInstruction(iteration, offset);
+    vectorCode.offset = offset->result;
+    for (int s = 0; s < body->childCount - 1; s++)
+    {
+        ASTNode *target = body->children[s]->children[0];
+        char *value;
+        appendInstruction(iteration, generateVectorValue(body->children[s]->children[1],
+                                                         variableType(target->children[0]->value.strValue, 1),
+                                                         &vectorCode, &value));
+        IRInstruction *address = generateVectorAddress(target, &vectorCode);
+        appendInstruction(iteration, address);
+        appendInstruction(iteration, createInstruction("VSTORE", value, address->result, NULL));
+    }
+    ASTNode lanesNode = {.type = AST_LITERAL, .value.intValue = VECTOR_LANES};
+    ASTNode *nextOperands[2] = {counted->induction, &lanesNode};
+    ASTNode next = {.type = AST_BINARY_EXPR, .value.opType = OP_PLUS, .children = nextOperands, .childCount = 2};
+    ASTNode *stepParts[2] = {counted->induction, &next};
+    ASTNode step = {.type = AST_ASSIGNMENT, .children = stepParts, .childCount = 2};
+    appendInstruction(iteration, generateIRForNode(&step));
+
+    printf("VECTORIZE: Loop on %s runs %d elements per iteration\n", name, VECTOR_LANES);
+    char *bodyLabel = newLabel();
+    code = appendInstruction(code, vectorCode.preheader);
+    if (compilerOptions.fuseBranches)
+    {
+        appendInstruction(code, generateConditionalBranch(&test, 0, scalarLabel));
+        appendInstruction(code, createInstruction("LABEL", bodyLabel, NULL, NULL));
+        appendInstruction(code, iteration);
+        appendInstruction(code, generateConditionalBranch(&test, 1, bodyLabel));
+    }
+    else
+    {
+        appendInstruction(code, createInstruction("LABEL", bodyLabel, NULL, NULL));
+        appendInstruction(code, generateConditionalBranch(&test, 0, scalarLabel));
+        appendInstruction(code, iteration);
+        appendInstruction(code, createInstruction("GOTO", strdup(bodyLabel), NULL, NULL));
+    }
+    appendInstruction(code, createInstruction("LABEL", scalarLabel, NULL, NULL));
+    appendInstruction(code, generateWhileLoop(loop));
+    return code;
+}
+
+// Body copies for a loop: the requested number, or with a profile, none for a
+// loop that ran less than twice per arrival, twice as many for the hottest
+// loops, and never more than the iterations per arrival
+static int loopUnrollFactor(ASTNode *loop)
+{
+    int factor = compilerOptions.unrollFactor;
+    if (compilerOptions.profileGenerate)
+        return 1; // Every loop keeps its one body, so its counter sees every iteration
+    long long arrivals = profileCount(profiledFunction(), loop->probe, PROBE_LOOP);
+    long long iterations = profileCount(profiledFunction(), loop->probe, PROBE_BODY);
+    if (factor < 2 || arrivals < 0 || iterations < 0)
+        return factor;
+
+    long long perArrival = arrivals > 0 ? iterations / arrivals : 0;
+    if (iterations > 0 && iterations * HOT_LOOP_SHARE >= hottestLoopBody())
+        factor *= 2;
+    if (factor > perArrival)
+        factor = perArrival > 1 ? (int)perArrival : 1;
+    printf("PROFILE: loop %d in %s ran %lld iterations in %lld arrivals, unroll by %d\n", loop->probe,
+           profiledFunction(), iterations, arrivals, factor);
+    return factor;
+}
+
+// The then part of an if, counted in instrumented builds
+static IRInstruction *generateThen(ASTNode *node)
+{
+    return appendInstruction(generateCount(node, PROBE_THEN), generateIRForNode(node->children[1]));
+}
+
+// A statement whose last step is a return, never running on to what follows
+static int endsInReturn(ASTNode *statement)
+{
+    if (statement->type == AST_BLOCK)
+        return statement->childCount > 0 && endsInReturn(statement->children[statement->childCount - 1]);
+    return statement->type == AST_RETURN_STATEMENT;
+}
+
+// Lays out an if by its profile. The colder part moves to the unit's cold code
+// and jumps back, so the hotter one falls through from the test and on past the
+// if with no jump of its own; without an else, a then part that mostly does not
+// run is the one that moves.
+static IRInstruction *generateProfiledIf(ASTNode *node, long long thens, long long elses)
+{
+    int coldThen = thens < elses;
+    char *coldLabel = newLabel();
+    char *endLabel = newLabel();
+    IRInstruction *code = generateConditionalBranch(node->children[0], coldThen, coldLabel);
+    if (!coldThen)
+        appendInstruction(code, generateThen(node));
+    else if (node->childCount > 2)
+        appendInstruction(code, generateIRForNode(node->children[2]));
+    appendInstruction(code, createInstruction("LABEL", endLabel, NULL, NULL));
+
+    IRInstruction *cold = createInstruction("LABEL", strdup(coldLabel), NULL, NULL);
+    appendInstruction(cold, coldThen ? generateThen(node) : generateIRForNode(node->children[2]));
+    // A part ending in a return needs no jump back, which would keep every value
+    // used after the if alive through the cold code
+    if (!endsInReturn(coldThen ? node->children[1] : node->children[2]))
+        appendInstruction(cold, createInstruction("GOTO", strdup(endLabel), NULL, NULL));
+    coldCode = appendInstruction(coldCode, cold);
+    printf("PROFILE: if %d in %s ran then %lld times and else %lld, %s part moved to %s\n", node->probe,
+           profiledFunction(), thens, elses, coldThen ? "then" : "else", coldLabel);
+    return code;
+}
+
 IRInstruction *generateIRForNode(ASTNode *node)
 {
     if (!node)
@@ -51,29 +1106,77 @@ IRInstruction *generateIRForNode(ASTNode *node)
     switch (node->type)
     {
     case AST_PROGRAM:
+    {
+        // Top-level statements form the body of main; each function becomes its
+        // own unit after it, so no unit falls through into another
         printf(" IR: Start Program\n");
+        program = node;
+        layOutGlobals(node);
+        if (compilerOptions.profileGenerate || compilerOptions.profileUse)
+            numberProbes(node);
+        first = createInstruction("FUNCTION", NULL, NULL, strdup("main"));
+        last = first;
+        IRInstruction *functions = NULL;
+        IRInstruction *lastFunction = NULL; // Appending to functions directly is quadratic in their number
+        int mayHaveCalled = 0; // Once a call may have run, a global's .data value can be stale
         for (int i = 0; i < node->childCount; i++)
         {
-            IRInstruction *childInstr = generateIRForNode(node->children[i]);
-            first = first ? first : childInstr;
-            last = appendInstruction(last, childInstr);
+            ASTNode *child = node->children[i];
+            if (child->type == AST_ARRAY_DECLARATION || (!mayHaveCalled && isPreinitializedGlobal(child)))
+                continue; // Already laid out in .bss or .data
+            if (child->type == AST_FUNCTION_DECLARATION && !child->children[3])
+                continue; // Streamed out already; only its signature is left
+            if (child->type != AST_FUNCTION_DECLARATION &&
+                !(child->type == AST_DECLARATION && (child->childCount < 3 || child->children[2]->type == AST_LITERAL ||
+                                                     child->children[2]->type == AST_FLOAT_LITERAL)))
+                mayHaveCalled = 1;
+            previousStatement = i > 0 ? node->children[i - 1] : NULL;
+            IRInstruction *childInstr = child->type == AST_FUNCTION_DECLARATION && compilerOptions.cacheDirectory
+                                            ? generateCachedFunction(child, nextUnitName(node, i))
+                                            : generateIRForNode(child);
+            if (node->children[i]->type == AST_FUNCTION_DECLARATION)
+            {
+                if (childInstr)
+                {
+                    if (lastFunction)
+                        lastFunction->next = childInstr;
+                    else
+                        functions = childInstr;
+                    lastFunction = lastInstruction(childInstr);
+                }
+            }
+            else
+            {
+                appendInstruction(last, childInstr);
+                last = lastInstruction(last);
+            }
         }
+        if (coldCode)
+        {
+            // main's own return comes first, so its cold code is only reached by jumps
+            appendInstruction(last, createInstruction("RETURN", NULL, NULL, NULL));
+            appendInstruction(last, coldCode);
+            coldCode = NULL;
+        }
+        appendInstruction(first, functions);
         printf(" IR: End Program\n");
-        break;
+    }
+    break;
 
     case AST_DECLARATION:
     {
         char *variableName = node->children[1]->value.strValue;
+        TypeCode type = valueType(node->children[0]->value.typeCode);
+        // The initializer still sees what the new name hides
+        IRInstruction *exprInstr = node->childCount == 3 ? generateConverted(node->children[2], type) : NULL;
+        if (currentFunction || blockDepth > 0)
+            declareLocal(variableName, 0, type);
         if (node->childCount == 3)
         { // Declaration with initialization
             printf(" IR: Declaration with initialization for %s\n", variableName);
-            IRInstruction *exprInstr = generateIRForNode(node->children[2]);
-            instr = malloc(sizeof(IRInstruction));
-            instr->op = strdup("=");
-            instr->arg1 = exprInstr->result;
-            instr->arg2 = NULL;
-            instr->result = strdup(variableName);
-            instr->next = exprInstr;
+            instr = generateStore(lastInstruction(exprInstr)->result, variableName);
+            appendInstruction(exprInstr, instr); // The value is computed before it is stored
+            first = exprInstr;
         }
         else
         { // Declaration without initialization
@@ -82,7 +1185,7 @@ IRInstruction *generateIRForNode(ASTNode *node)
             instr->op = strdup("NOP");
             instr->arg1 = NULL;
             instr->arg2 = NULL;
-            instr->result = strdup(variableName);
+            instr->result = storageName(variableName, 0);
             instr->next = NULL;
         }
     }
@@ -91,151 +1194,91 @@ IRInstruction *generateIRForNode(ASTNode *node)
     case AST_ASSIGNMENT:
     {
         printf(" IR: Assignment\n");
-        IRInstruction *valueInstr = generateIRForNode(node->children[2]);
-        instr = malloc(sizeof(IRInstruction));
-        instr->op = strdup("=");
-        instr->arg1 = valueInstr->result;
-        instr->arg2 = NULL;
-        instr->result = strdup(node->children[0]->value.strValue);
-        instr->next = valueInstr;
+        ASTNode *target = node->children[0];
+        TypeCode type = target->type == AST_ARRAY_ACCESS ? variableType(target->children[0]->value.strValue, 1)
+                                                         : variableType(target->value.strValue, 0);
+        IRInstruction *valueInstr = generateConverted(node->children[1], type);
+        char *value = lastInstruction(valueInstr)->result;
+        if (target->type == AST_ARRAY_ACCESS)
+        {
+            char *address;
+            appendInstruction(valueInstr, generateElementAddress(node->children[0], &address));
+            instr = createInstruction("STORE", value, address, NULL);
+        }
+        else
+        {
+            instr = generateStore(value, node->children[0]->value.strValue);
+        }
+        appendInstruction(valueInstr, instr);
+        first = valueInstr;
     }
     break;
 
     case AST_IF_STATEMENT:
     {
+        // if (!cond) goto else; then; goto end; else: ...; end:
+        // With no else part the false branch goes straight to end
         printf(" IR: IF Statement\n");
-        IRInstruction *condInstr = generateIRForNode(node->children[0]);
-        IRInstruction *thenInstr = generateIRForNode(node->children[1]);
-        char *label = newLabel();
-        instr = malloc(sizeof(IRInstruction));
-        instr->op = strdup("IFGOTO");
-        instr->arg1 = condInstr->result;
-        instr->arg2 = NULL;
-        instr->result = label;
-        instr->next = condInstr;
-        appendInstruction(instr, thenInstr);
-        printf(" IR: Jump to %s if true\n", label);
-
+        first = generateCount(node, PROBE_IF);
+        long long tests = profileCount(profiledFunction(), node->probe, PROBE_IF);
+        long long thens = profileCount(profiledFunction(), node->probe, PROBE_THEN);
+        if (tests > 0 && thens >= 0 && thens <= tests &&
+            (node->childCount > 2 ? 2 * thens != tests : 2 * thens < tests))
+        {
+            first = appendInstruction(first, generateProfiledIf(node, thens, tests - thens));
+            break;
+        }
+        char *endLabel = newLabel();
+        char *falseLabel = node->childCount > 2 ? newLabel() : endLabel;
+        first = appendInstruction(first, generateConditionalBranch(node->children[0], 0, falseLabel));
+        appendInstruction(first, generateThen(node));
         if (node->childCount > 2)
         { // Has ELSE part
-            IRInstruction *elseInstr = generateIRForNode(node->children[2]);
-            appendInstruction(thenInstr, elseInstr);
             printf(" IR: ELSE part\n");
+            appendInstruction(first, createInstruction("GOTO", strdup(endLabel), NULL, NULL));
+            appendInstruction(first, createInstruction("LABEL", strdup(falseLabel), NULL, NULL));
+            appendInstruction(first, generateIRForNode(node->children[2]));
         }
+        appendInstruction(first, createInstruction("LABEL", strdup(endLabel), NULL, NULL));
+        printf(" IR: Condition false jumps to %s\n", falseLabel);
     }
     break;
 
     case AST_WHILE_LOOP:
     {
-        printf("IR: WHILE Loop\n");
-
-        // Generate IR for the loop condition
-        IRInstruction *condInstr = generateIRForNode(node->children[0]); // Assuming child[0] is the condition
-        if (!condInstr)
-        {
-            fprintf(stderr, "Failed to generate IR for the loop condition.\n");
-            break;
-        }
-
-        // Generate IR for the loop body
-        IRInstruction *bodyInstr = generateIRForNode(node->children[1]); // Assuming child[1] is the body
-        if (!bodyInstr)
-        {
-            fprintf(stderr, "Failed to generate IR for the loop body.\n");
-            break;
-        }
-
-        // Create labels for the start and end of the loop
-        char *startLabel = newLabel();
-        char *endLabel = newLabel();
-
-        // Entry instruction for the loop (start label)
-        IRInstruction *entryInstr = malloc(sizeof(IRInstruction));
-        if (!entryInstr)
-        {
-            perror("Failed to allocate memory for entryInstr");
-            break;
-        }
-        entryInstr->op = strdup("LABEL");
-        entryInstr->arg1 = strdup(startLabel);
-        entryInstr->arg2 = NULL;
-        entryInstr->result = NULL;
-        entryInstr->next = condInstr; // Condition check follows
-
-        // Instruction to jump out of the loop if condition is false
-        IRInstruction *branchInstr = malloc(sizeof(IRInstruction));
-        if (!branchInstr)
-        {
-            perror("Failed to allocate memory for branchInstr");
-            break;
-        }
-        branchInstr->op = strdup("IFGOTO");
-        branchInstr->arg1 = strdup(condInstr->result);
-        branchInstr->arg2 = NULL;
-        branchInstr->result = strdup(endLabel);
-        condInstr->next = branchInstr; // Branch follows the condition
-
-        // Append the body of the loop
-        branchInstr->next = bodyInstr;
-
-        // Instruction to jump back to the start
-        IRInstruction *jumpBackInstr = malloc(sizeof(IRInstruction));
-        if (!jumpBackInstr)
-        {
-            perror("Failed to allocate memory for jumpBackInstr");
-            break;
-        }
-        jumpBackInstr->op = strdup("GOTO");
-        jumpBackInstr->arg1 = strdup(startLabel);
-        jumpBackInstr->arg2 = NULL;
-        jumpBackInstr->result = NULL;
-
-        // Find the last instruction of the body to append the jump back
-        IRInstruction *lastBodyInstr = bodyInstr;
-        while (lastBodyInstr->next != NULL)
-        {
-            lastBodyInstr = lastBodyInstr->next;
-        }
-        lastBodyInstr->next = jumpBackInstr;
-
-        // Exit label for the loop
-        IRInstruction *exitInstr = malloc(sizeof(IRInstruction));
-        if (!exitInstr)
-        {
-            perror("Failed to allocate memory for exitInstr");
-            break;
-        }
-        exitInstr->op = strdup("LABEL");
-        exitInstr->arg1 = strdup(endLabel);
-        exitInstr->arg2 = NULL;
-        exitInstr->result = NULL;
-        jumpBackInstr->next = exitInstr;
-
-        // Set the 'instr' to the entry instruction
-        instr = entryInstr;
-
-        printf("IR: Loop starts at %s and exits at %s\n", startLabel, endLabel);
+        ASTNode *entry = previousStatement;
+        IRInstruction *loop = generateVectorLoop(node, entry);
+        int factor = loop ? 1 : loopUnrollFactor(node);
+        if (factor > 1)
+            loop = generateUnrolledLoop(node, entry, factor);
+        first = appendInstruction(generateCount(node, PROBE_LOOP), loop ? loop : generateWhileLoop(node));
     }
     break;
 
     case AST_RETURN_STATEMENT:
     {
         printf(" IR: RETURN Statement\n");
-        IRInstruction *retInstr = generateIRForNode(node->children[0]);
+        first = node->childCount > 0 ? generateSelfTailCall(node->children[0]) : NULL;
+        if (first)
+            break;
+        TypeCode returnType = currentFunction ? currentFunction->children[0]->value.typeCode : TypeINT;
+        IRInstruction *retInstr = node->childCount > 0 ? generateConverted(node->children[0], returnType) : NULL;
         instr = malloc(sizeof(IRInstruction));
         instr->op = strdup("RETURN");
-        instr->arg1 = retInstr->result;
+        instr->arg1 = retInstr ? lastInstruction(retInstr)->result : NULL;
         instr->arg2 = NULL;
         instr->result = NULL;
-        instr->next = retInstr;
+        instr->next = NULL;
+        first = appendInstruction(retInstr, instr);
     }
     break;
 
     case AST_BINARY_EXPR:
     {
         printf(" IR: Start Binary Expression\n");
-        IRInstruction *leftInstr = generateIRForNode(node->children[0]);
-        IRInstruction *rightInstr = generateIRForNode(node->children[1]);
+        TypeCode type = operandType(node);
+        IRInstruction *leftInstr = generateConverted(node->children[0], type);
+        IRInstruction *rightInstr = generateConverted(node->children[1], type);
         instr = malloc(sizeof(IRInstruction));
         char *opType;
         switch (node->value.opType)
@@ -252,14 +1295,24 @@ IRInstruction *generateIRForNode(ASTNode *node)
         case OP_DIVIDE:
             opType = "/";
             break;
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+            opType = (char *)relationOperator(node->value.opType); // Produces 0 or 1
+            break;
         default:
             opType = "unknown_op";
             break;
         }
-        printf(" IR: Operation %s between %s and %s\n", opType, leftInstr->result, rightInstr->result);
+        if (type == TypeFLOAT)
+            opType = (char *)floatOperator(node->value.opType);
         instr->op = strdup(opType);
-        instr->arg1 = leftInstr->result;
-        instr->arg2 = rightInstr->result;
+        instr->arg1 = lastInstruction(leftInstr)->result;
+        instr->arg2 = lastInstruction(rightInstr)->result;
+        printf(" IR: Operation %s between %s and %s\n", opType, instr->arg1, instr->arg2);
         instr->result = newTemp();
         printf(" IR: Result stored in %s\n", instr->result);
         instr->next = NULL;
@@ -286,12 +1339,27 @@ IRInstruction *generateIRForNode(ASTNode *node)
     }
     break;
 
+    case AST_FLOAT_LITERAL:
+    {
+        first = generateFloatConstant((float)node->value.floatValue);
+        printf(" IR: Float literal %g loaded from %s\n", node->value.floatValue, first->arg1);
+    }
+    break;
+
     case AST_VARIABLE:
     {
         printf(" IR: Variable access %s\n", node->value.strValue);
+        if (isMemoryVariable(node->value.strValue))
+        {
+            first = createInstruction("ADDR", strdup(node->value.strValue), NULL, newTemp());
+            instr = createInstruction("LOADMEM", first->result, NULL, newTemp());
+            appendInstruction(first, instr);
+            printf(" IR: Load global %s into %s\n", node->value.strValue, instr->result);
+            break;
+        }
         instr = malloc(sizeof(IRInstruction));
         instr->op = strdup("LOAD");
-        instr->arg1 = strdup(node->value.strValue);
+        instr->arg1 = storageName(node->value.strValue, 0);
         instr->arg2 = NULL;
         instr->result = newTemp();
         printf(" IR: Load variable %s into %s\n", node->value.strValue, instr->result);
@@ -303,27 +1371,34 @@ IRInstruction *generateIRForNode(ASTNode *node)
     case AST_FUNCTION_CALL:
     {
         printf(" IR: Function call %s\n", node->children[0]->value.strValue);
+        ASTNode *argsNode = node->children[1];
+        ASTNode *function = findFunction(node->children[0]->value.strValue);
+        ASTNode *parameters = function ? function->children[2] : NULL;
+        if (!function && compilerOptions.stream)
+            rememberUndeclaredCall(node->children[0]->value.strValue);
         IRInstruction *argInstr = NULL;
-        for (int i = 0; i < node->childCount - 1; i++)
+        char **argValues = malloc(sizeof(char *) * (argsNode->childCount + 1));
+        for (int i = 0; i < argsNode->childCount; i++)
         {
-            IRInstruction *tempInstr = generateIRForNode(node->children[i + 1]);
-            if (i == 0)
-            {
-                argInstr = tempInstr;
-            }
-            else
-            {
-                appendInstruction(argInstr, tempInstr);
-            }
+            // Each argument is converted to its parameter's type
+            TypeCode type = parameters && i < parameters->childCount ? parameterType(parameters->children[i]) : TypeINT;
+            IRInstruction *valueInstr = generateConverted(argsNode->children[i], type);
+            argValues[i] = lastInstruction(valueInstr)->result;
+            argInstr = appendInstruction(argInstr, valueInstr);
         }
-        instr = malloc(sizeof(IRInstruction));
-        instr->op = strdup("CALL");
-        instr->arg1 = strdup(node->children[0]->value.strValue);
-        instr->arg2 = NULL;
-        instr->result = newTemp();
+        // Arguments are passed only once all are evaluated, so a call nested in
+        // a later argument cannot overwrite an argument register already set
+        for (int i = 0; i < argsNode->childCount; i++)
+        {
+            argInstr = appendInstruction(argInstr, createInstruction("ARG", argValues[i], indexString(i), NULL));
+        }
+        free(argValues);
+        instr = createInstruction("CALL", strdup(node->children[0]->value.strValue), indexString(argsNode->childCount), newTemp());
         printf(" IR: Call result stored in %s\n", instr->result);
-        instr->next = argInstr;
-        first = instr;
+        long long count = profileCount(profiledFunction(), node->probe, PROBE_CALL);
+        if (count > 0 && !compilerOptions.stream)
+            noteCallSite(instr, count); // Streamed functions are gone before calls could be inlined
+        first = appendInstruction(generateCount(node, PROBE_CALL), appendInstruction(argInstr, instr));
     }
     break;
 
@@ -336,28 +1411,26 @@ IRInstruction *generateIRForNode(ASTNode *node)
 
     case AST_ARRAY_DECLARATION:
     {
+        // Reserves a slot in the frame; the size is a literal, checked by the layout
         printf(" IR: Allocating array %s\n", node->children[1]->value.strValue);
-        instr = malloc(sizeof(IRInstruction));
-        instr->op = strdup("ALLOC_ARRAY");
-        instr->arg1 = strdup(node->children[1]->value.strValue);    // Variable name
-        instr->arg2 = generateIRForNode(node->children[2])->result; // Size expression
-        instr->result = NULL;
-        instr->next = NULL;
-        first = instr;
+        ASTNode *sizeNode = node->children[2];
+        if (sizeNode->type != AST_LITERAL || sizeNode->value.intValue <= 0)
+        {
+            fprintf(stderr, "Error: array %s needs a positive constant size\n", node->children[1]->value.strValue);
+            exit(EXIT_FAILURE);
+        }
+        char *storage = declareLocal(node->children[1]->value.strValue, sizeNode->value.intValue,
+                                     valueType(node->children[0]->value.typeCode));
+        first = createInstruction("ALLOC_ARRAY", strdup(storage), immediateOperand(sizeNode->value.intValue), NULL);
     }
     break;
 
     case AST_ARRAY_ACCESS:
     {
         printf(" IR: Accessing array %s\n", node->children[0]->value.strValue);
-        IRInstruction *indexInstr = generateIRForNode(node->children[1]);
-        instr = malloc(sizeof(IRInstruction));
-        instr->op = strdup("ARRAY_ACCESS");
-        instr->arg1 = strdup(node->children[0]->value.strValue); // Array name
-        instr->arg2 = indexInstr->result;                        // Index
-        instr->result = newTemp();
-        instr->next = indexInstr;
-        first = instr;
+        char *address;
+        first = generateElementAddress(node, &address);
+        appendInstruction(first, createInstruction("LOADMEM", address, NULL, newTemp()));
     }
     break;
 
@@ -372,19 +1445,29 @@ IRInstruction *generateIRForNode(ASTNode *node)
     {
         printf(" IR: Unary expression with operator %s\n", node->value.opType == OP_NEGATE ? "NEG" : "NOT");
         IRInstruction *operandInstr = generateIRForNode(node->children[0]);
+        if (expressionType(node->children[0]) == TypeFLOAT)
+        {
+            if (node->value.opType == OP_NEGATE)
+                first = appendInstruction(operandInstr, createInstruction("FNEG", lastInstruction(operandInstr)->result, NULL, newTemp()));
+            else
+                first = generateFloatTest(operandInstr, "FEQ");
+            break;
+        }
         instr = malloc(sizeof(IRInstruction));
         instr->op = strdup(node->value.opType == OP_NEGATE ? "NEG" : "NOT"); // Simplified unary operations
-        instr->arg1 = operandInstr->result;
+        instr->arg1 = lastInstruction(operandInstr)->result;
         instr->arg2 = NULL;
         instr->result = newTemp();
-        instr->next = operandInstr;
-        first = instr;
+        instr->next = NULL;
+        first = appendInstruction(operandInstr, instr);
     }
     break;
 
     case AST_BLOCK:
     {
         printf(" IR: Entering new block scope\n");
+        int enclosingLocalCount = localCount;
+        blockDepth++;
         IRInstruction *enterScopeInstr = malloc(sizeof(IRInstruction));
         enterScopeInstr->op = strdup("ENTER_SCOPE");
         enterScopeInstr->arg1 = NULL;
@@ -395,6 +1478,12 @@ IRInstruction *generateIRForNode(ASTNode *node)
         IRInstruction *lastInstr = enterScopeInstr;
         for (int i = 0; i < node->childCount; i++)
         {
+            if (node->children[i]->type == AST_FUNCTION_DECLARATION)
+            {
+                fprintf(stderr, "Error: Nested function declarations are not supported.\n");
+                exit(EXIT_FAILURE);
+            }
+            previousStatement = i > 0 ? node->children[i - 1] : NULL;
             IRInstruction *childInstr = generateIRForNode(node->children[i]);
             lastInstr->next = childInstr;
             while (lastInstr->next)
@@ -410,6 +1499,8 @@ IRInstruction *generateIRForNode(ASTNode *node)
         exitScopeInstr->result = NULL;
         exitScopeInstr->next = NULL;
         lastInstr->next = exitScopeInstr;
+        blockDepth--;
+        localCount = enclosingLocalCount; // The block's declarations end with it
 
         printf(" IR: Exiting block scope\n");
         first = enterScopeInstr;
@@ -452,19 +1543,41 @@ IRInstruction *generateIRForNode(ASTNode *node)
 
         char *functionName = nameNode->value.strValue;
         printf(" IR: Function %s declaration\n", functionName);
+        // main's locals are not visible inside the function
+        int enclosingLocalStart = localStart;
+        int enclosingLocalCount = localCount;
+        int enclosingDeclaredStart = declaredStart;
+        int enclosingDeclaredCount = declaredCount;
+        ASTNode *enclosingFunction = currentFunction;
+        char *enclosingTailCallLabel = tailCallLabel;
+        IRInstruction *enclosingColdCode = coldCode;
+        currentFunction = node;
+        tailCallLabel = NULL;
+        coldCode = NULL;
+        localStart = localCount;
+        declaredStart = declaredCount;
+        if (compilerOptions.profileGenerate || compilerOptions.profileUse)
+            numberProbes(node->children[3]);
 
-        // Create a label for the function entry.
-        IRInstruction *entryPoint = malloc(sizeof(IRInstruction));
-        entryPoint->op = strdup("LABEL");
-        entryPoint->arg1 = NULL;
-        entryPoint->arg2 = NULL;
-        entryPoint->result = strdup(functionName);
-        entryPoint->next = NULL;
+        // The unit starts with its entry, then binds each parameter to its incoming value
+        IRInstruction *entryPoint = createInstruction("FUNCTION", NULL, NULL, strdup(functionName));
         printf(" IR: Label %s for function entry created\n", functionName);
+        ASTNode *paramList = node->children[2];
+        for (int i = 0; paramList && i < paramList->childCount; i++)
+        {
+            ASTNode *parameter = paramList->children[i];
+            char *storage = declareLocal(parameter->value.strValue, 0, parameterType(parameter));
+            appendInstruction(entryPoint, createInstruction("PARAM", indexString(i), NULL, strdup(storage)));
+        }
 
         // Generate IR for the function body.
         printf(" IR: Function body for %s\n", functionName);
         IRInstruction *bodyInstr = generateIRForNode(node->children[3]); // Assuming body is the 4th child.
+        if (tailCallLabel)
+        {
+            // Self tail calls re-enter here with the parameters already rebound
+            appendInstruction(entryPoint, createInstruction("LABEL", tailCallLabel, NULL, NULL));
+        }
         if (bodyInstr)
         {
             appendInstruction(entryPoint, bodyInstr);
@@ -484,9 +1597,17 @@ IRInstruction *generateIRForNode(ASTNode *node)
             lastInstr = lastInstr->next; // Navigate to the last instruction.
         }
         lastInstr->next = exitPoint;
+        exitPoint->next = coldCode;
 
         printf(" IR: Exit for function %s set up\n", functionName);
         first = entryPoint;
+        currentFunction = enclosingFunction;
+        tailCallLabel = enclosingTailCallLabel;
+        coldCode = enclosingColdCode;
+        localStart = enclosingLocalStart;
+        localCount = enclosingLocalCount;
+        declaredStart = enclosingDeclaredStart;
+        declaredCount = enclosingDeclaredCount;
     }
     break;
 
@@ -518,3 +1639,166 @@ void printIRInstructions(IRInstruction *head)
         head = head->next;
     }
 }
+
+// Single-precision arithmetic and comparisons: result = arg1 op arg2. The
+// comparisons produce an int 0 or 1 like their integer counterparts.
+int isFloatOperator(const char *op)
+{
+    static const char *operators[] = {"FADD", "FSUB", "FMUL", "FDIV", "FLT", "FLE", "FGT", "FGE", "FEQ", "FNE", NULL};
+    for (int i = 0; operators[i]; i++)
+    {
+        if (strcmp(op, operators[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// True when ir reads its operands as floats
+int readsFloat(IRInstruction *ir)
+{
+    return isFloatOperator(ir->op) || strcmp(ir->op, "FNEG") == 0 || strcmp(ir->op, "FTOI") == 0 ||
+           strcmp(ir->op, "VFFILL") == 0;
+}
+
+// True when ir writes a float; copies, loads and calls take the type of their value
+int writesFloat(IRInstruction *ir)
+{
+    static const char *operators[] = {"FADD", "FSUB", "FMUL", "FDIV", "FNEG", "FMOV", "ITOF", NULL};
+    for (int i = 0; operators[i]; i++)
+    {
+        if (strcmp(ir->op, operators[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Arithmetic on four ints or floats at once: result = arg1 op arg2, all vectors
+int isVectorOperator(const char *op)
+{
+    static const char *operators[] = {"VADD", "VSUB", "VMUL", "VFADD", "VFSUB", "VFMUL", "VFDIV", NULL};
+    for (int i = 0; operators[i]; i++)
+    {
+        if (strcmp(op, operators[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// True when ir writes a vector: the arithmetic, VLOAD from the address in arg1,
+// and VFILL and VFFILL, which copy the int or float in arg1 into every lane.
+// VSTORE stores the vector arg1 at the address in arg2.
+int writesVector(IRInstruction *ir)
+{
+    return isVectorOperator(ir->op) || strcmp(ir->op, "VLOAD") == 0 || strcmp(ir->op, "VFILL") == 0 ||
+           strcmp(ir->op, "VFFILL") == 0;
+}
+
+// Arithmetic and comparisons: result = arg1 op arg2
+int isBinaryOperator(const char *op)
+{
+    static const char *operators[] = {"+", "-", "*", "/", "<<", "<", "<=", ">", ">=", "==", "!=", NULL};
+    for (int i = 0; operators[i]; i++)
+    {
+        if (strcmp(op, operators[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// The comparison a conditional branch tests: IF<relation>, or IFGOTO's test for nonzero
+const char *getBranchRelation(IRInstruction *ir)
+{
+    if (strcmp(ir->op, "IFGOTO") == 0)
+        return "!=";
+    if (strncmp(ir->op, "IF", 2) == 0 && (ir->op[2] == '<' || ir->op[2] == '>' || ir->op[2] == '=' || ir->op[2] == '!'))
+        return ir->op + 2;
+    return NULL;
+}
+
+// Instruction selection writes constant operands as "#<value>"; they name no storage
+int isImmediateOperand(const char *operand)
+{
+    return operand && operand[0] == '#';
+}
+
+int immediateValue(const char *operand)
+{
+    return atoi(operand + 1);
+}
+
+// Collects the variables and temporaries read by an IR instruction
+int getInstructionUses(IRInstruction *ir, char *uses[2])
+{
+    int count = 0;
+    if (isBinaryOperator(ir->op) || isFloatOperator(ir->op) || isVectorOperator(ir->op) ||
+        strcmp(ir->op, "VSTORE") == 0)
+    {
+        uses[count++] = ir->arg1;
+        uses[count++] = ir->arg2;
+    }
+    else if (strcmp(ir->op, "STORE") == 0)
+    {
+        uses[count++] = ir->arg1;
+        if (ir->arg2) // No base register when the address is a bare symbol
+            uses[count++] = ir->arg2;
+    }
+    else if (getBranchRelation(ir))
+    {
+        uses[count++] = ir->arg1;
+        if (ir->arg2)
+            uses[count++] = ir->arg2;
+    }
+    else if (strcmp(ir->op, "=") == 0 || strcmp(ir->op, "LOAD") == 0 || strcmp(ir->op, "LOADMEM") == 0 ||
+             strcmp(ir->op, "NEG") == 0 || strcmp(ir->op, "NOT") == 0 || strcmp(ir->op, "FNEG") == 0 ||
+             strcmp(ir->op, "ITOF") == 0 || strcmp(ir->op, "FTOI") == 0 ||
+             strcmp(ir->op, "RETURN") == 0 || strcmp(ir->op, "ARG") == 0 || strcmp(ir->op, "CHECK_BOUNDS") == 0 ||
+             strcmp(ir->op, "VLOAD") == 0 || strcmp(ir->op, "VFILL") == 0 || strcmp(ir->op, "VFFILL") == 0)
+    {
+        if (ir->arg1)
+            uses[count++] = ir->arg1;
+    }
+    if (count == 2 && isImmediateOperand(uses[1]))
+        count--;
+    if (count > 0 && isImmediateOperand(uses[0]))
+        uses[0] = uses[--count];
+    return count;
+}
+
+// Returns the variable or temporary written by an IR instruction, or NULL
+char *getInstructionDefinition(IRInstruction *ir)
+{
+    if (isBinaryOperator(ir->op) || isFloatOperator(ir->op) || strcmp(ir->op, "=") == 0 || strcmp(ir->op, "MOV") == 0 ||
+        strcmp(ir->op, "FMOV") == 0 || strcmp(ir->op, "FNEG") == 0 || strcmp(ir->op, "ITOF") == 0 ||
+        strcmp(ir->op, "FTOI") == 0 ||
+        strcmp(ir->op, "LOAD") == 0 || strcmp(ir->op, "LOADMEM") == 0 || strcmp(ir->op, "ADDR") == 0 ||
+        strcmp(ir->op, "NEG") == 0 || strcmp(ir->op, "NOT") == 0 || strcmp(ir->op, "CALL") == 0 ||
+        strcmp(ir->op, "PARAM") == 0 || writesVector(ir))
+    {
+        return ir->result;
+    }
+    return NULL;
+}
+
+// Loop labels carry their name in arg1, function entries in result
+char *getLabelName(IRInstruction *ir)
+{
+    if (strcmp(ir->op, "FUNCTION") == 0)
+        return ir->result;
+    if (strcmp(ir->op, "LABEL") != 0)
+        return NULL;
+    return ir->arg1 ? ir->arg1 : ir->result;
+}
+
+char *getBranchTarget(IRInstruction *ir)
+{
+    if (getBranchRelation(ir))
+        return ir->result;
+    if (strcmp(ir->op, "GOTO") == 0)
+        return ir->arg1;
+    return NULL;
+}
+
+int isBlockTerminator(IRInstruction *ir)
+{
+    return getBranchRelation(ir) || strcmp(ir->op, "GOTO") == 0 || strcmp(ir->op, "RETURN") == 0;
+}
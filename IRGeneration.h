@@ -15,8 +15,34 @@ typedef struct IRInstruction
 
 char *newLabel();
 char *newTemp();
+IRInstruction *createInstruction(const char *op, char *arg1, char *arg2, char *result);
 IRInstruction *appendInstruction(IRInstruction *list, IRInstruction *instr);
+IRInstruction *lastInstruction(IRInstruction *list);
 IRInstruction *generateIRForNode(ASTNode *node);
 void printIRInstructions(IRInstruction *head);
 
+// Streaming: lowers a function as soon as the parser completes it, against the
+// top-level statements seen so far
+IRInstruction *generateStreamedFunctionIR(ASTNode *programSoFar, ASTNode *function);
+// Frees the instructions and every string they hold. Instructions share strings
+// and may be listed more than once.
+void freeIRInstructions(IRInstruction **instructions, int count);
+
+// Operand queries shared by the optimization and code generation passes
+int isBinaryOperator(const char *op);
+int isFloatOperator(const char *op);
+int readsFloat(IRInstruction *ir);
+int writesFloat(IRInstruction *ir);
+int isVectorOperator(const char *op);
+int writesVector(IRInstruction *ir);
+int isImmediateOperand(const char *operand);
+int immediateValue(const char *operand);
+char *immediateOperand(int value);
+const char *getBranchRelation(IRInstruction *ir);
+int getInstructionUses(IRInstruction *ir, char *uses[2]);
+char *getInstructionDefinition(IRInstruction *ir);
+char *getLabelName(IRInstruction *ir);
+char *getBranchTarget(IRInstruction *ir);
+int isBlockTerminator(IRInstruction *ir);
+
 #endif
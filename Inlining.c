@@ -0,0 +1,294 @@
+#include "Inlining.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct CallSite
+{
+    IRInstruction *call;
+    long long count;
+    struct Callee *callee; // Set once the site is chosen
+} CallSite;
+
+typedef struct Callee
+{
+    IRInstruction *entry; // Its FUNCTION instruction
+    IRInstruction *end;   // The next unit's, or NULL
+    int size;
+    int parameterCount;
+    int inlinable;
+} Callee;
+
+static CallSite *sites = NULL;
+static int siteCount = 0;
+static int siteCapacity = 0;
+static int copyCount = 0;
+
+void noteCallSite(IRInstruction *call, long long count)
+{
+    if (siteCount == siteCapacity)
+    {
+        siteCapacity = siteCapacity ? 2 * siteCapacity : 32;
+        sites = realloc(sites, sizeof(CallSite) * siteCapacity);
+        if (!sites)
+        {
+            perror("Failed to allocate call sites");
+            exit(EXIT_FAILURE);
+        }
+    }
+    sites[siteCount++] = (CallSite){call, count, NULL};
+}
+
+static int compareSites(const void *a, const void *b)
+{
+    long long left = ((const CallSite *)a)->count;
+    long long right = ((const CallSite *)b)->count;
+    return left < right ? 1 : left > right ? -1 : 0;
+}
+
+static Callee *findCallee(Callee *callees, int calleeCount, const char *name)
+{
+    for (int i = 0; i < calleeCount; i++)
+    {
+        if (strcmp(callees[i].entry->result, name) == 0)
+            return &callees[i];
+    }
+    return NULL;
+}
+
+// Splits the program into its units and measures each
+static Callee *findCallees(IRInstruction *program, int *count)
+{
+    int capacity = 16;
+    Callee *callees = malloc(sizeof(Callee) * capacity);
+    if (!callees)
+    {
+        perror("Failed to allocate callees");
+        exit(EXIT_FAILURE);
+    }
+    *count = 0;
+    for (IRInstruction *ir = program; ir; ir = ir->next)
+    {
+        if (strcmp(ir->op, "FUNCTION") == 0)
+        {
+            if (*count == capacity)
+            {
+                capacity *= 2;
+                callees = realloc(callees, sizeof(Callee) * capacity);
+                if (!callees)
+                {
+                    perror("Failed to allocate callees");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            if (*count > 0)
+                callees[*count - 1].end = ir;
+            // main is entered only once, and only from the startup code
+            callees[(*count)++] = (Callee){ir, NULL, 0, 0, strcmp(ir->result, "main") != 0};
+        }
+        Callee *callee = &callees[*count - 1];
+        callee->size++;
+        if (strcmp(ir->op, "PARAM") == 0)
+            callee->parameterCount++;
+        if (strcmp(ir->op, "CALL") == 0 || strcmp(ir->op, "ARG") == 0 || strcmp(ir->op, "ALLOC_ARRAY") == 0)
+            callee->inlinable = 0;
+    }
+    for (int i = 0; i < *count; i++)
+    {
+        if (callees[i].size > INLINE_CALLEE_LIMIT)
+            callees[i].inlinable = 0;
+    }
+    return callees;
+}
+
+// The callee's own name for something in copy n
+static char *renamed(const char *name, int copy)
+{
+    char *copyName = malloc(strlen(name) + 16);
+    if (!copyName)
+    {
+        perror("Failed to allocate inlined name");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(copyName, "%s.i%d", name, copy);
+    return copyName;
+}
+
+// The copy's label for one of the callee's
+static char *copiedLabel(char **labels, char **copies, int labelCount, const char *label)
+{
+    for (int i = 0; i < labelCount; i++)
+    {
+        if (strcmp(labels[i], label) == 0)
+            return strdup(copies[i]);
+    }
+    fprintf(stderr, "Error: Inlined branch to unknown label %s\n", label);
+    exit(EXIT_FAILURE);
+}
+
+// A copy of one operand: variables and temporaries get the copy's names, labels
+// its fresh labels, and symbols and literals stay as they are
+static char *copyOperand(IRInstruction *ir, char *operand, char **uses, int useCount, char **labels, char **copies,
+                         int labelCount, int copy)
+{
+    if (!operand)
+        return NULL;
+    if (operand == getLabelName(ir) || operand == getBranchTarget(ir))
+        return copiedLabel(labels, copies, labelCount, operand);
+    if (operand == getInstructionDefinition(ir))
+        return renamed(operand, copy);
+    for (int i = 0; i < useCount; i++)
+    {
+        if (operand == uses[i])
+            return renamed(operand, copy);
+    }
+    return strdup(operand);
+}
+
+// The callee's body with its own names, returning into result and then to end
+static IRInstruction *copyCallee(Callee *callee, char *result, char *end, int copy)
+{
+    int labelCount = 0;
+    for (IRInstruction *ir = callee->entry; ir != callee->end; ir = ir->next)
+        labelCount += strcmp(ir->op, "LABEL") == 0;
+    char **labels = malloc(sizeof(char *) * (labelCount + 1));
+    char **copies = malloc(sizeof(char *) * (labelCount + 1));
+    labelCount = 0;
+    for (IRInstruction *ir = callee->entry; ir != callee->end; ir = ir->next)
+    {
+        if (strcmp(ir->op, "LABEL") == 0)
+        {
+            labels[labelCount] = getLabelName(ir);
+            copies[labelCount++] = newLabel();
+        }
+    }
+
+    IRInstruction *code = NULL;
+    for (IRInstruction *ir = callee->entry->next; ir != callee->end; ir = ir->next)
+    {
+        if (strcmp(ir->op, "PARAM") == 0)
+            continue; // Bound by the arguments
+        if (strcmp(ir->op, "RETURN") == 0)
+        {
+            IRInstruction *value = ir->arg1 ? createInstruction("=", renamed(ir->arg1, copy), NULL, result)
+                                            : createInstruction("MOV", strdup("0"), NULL, result);
+            code = appendInstruction(code, value);
+            code = appendInstruction(code, createInstruction("GOTO", strdup(end), NULL, NULL));
+            continue;
+        }
+        char *uses[2];
+        int useCount = getInstructionUses(ir, uses);
+        IRInstruction *instr = createInstruction(ir->op, NULL, NULL, NULL);
+        instr->arg1 = copyOperand(ir, ir->arg1, uses, useCount, labels, copies, labelCount, copy);
+        instr->arg2 = copyOperand(ir, ir->arg2, uses, useCount, labels, copies, labelCount, copy);
+        instr->result = copyOperand(ir, ir->result, uses, useCount, labels, copies, labelCount, copy);
+        code = appendInstruction(code, instr);
+    }
+    for (int i = 0; i < labelCount; i++)
+        free(copies[i]);
+    free(labels);
+    free(copies);
+    return code;
+}
+
+// The name parameter index has inside callee
+static char *parameterName(Callee *callee, const char *index)
+{
+    for (IRInstruction *ir = callee->entry->next; ir != callee->end; ir = ir->next)
+    {
+        if (strcmp(ir->op, "PARAM") == 0 && strcmp(ir->arg1, index) == 0)
+            return ir->result;
+    }
+    return NULL;
+}
+
+// The arguments become copies into the parameters, the callee's body follows
+// them, and the call itself becomes the label its returns jump to
+static void inlineCall(IRInstruction *previous, IRInstruction *firstArg, IRInstruction *call, Callee *callee)
+{
+    int copy = ++copyCount;
+    for (IRInstruction *arg = firstArg; arg && arg != call; arg = arg->next)
+    {
+        char *parameter = parameterName(callee, arg->arg2);
+        free(arg->op);
+        free(arg->arg2);
+        arg->op = strdup("=");
+        arg->arg2 = NULL;
+        arg->result = renamed(parameter, copy);
+    }
+    char *end = newLabel();
+    IRInstruction *body = copyCallee(callee, call->result, end, copy);
+    printf("PROFILE: call to %s inlined as copy %d, returning to %s\n", call->arg1, copy, end);
+
+    free(call->op);
+    free(call->arg1);
+    free(call->arg2);
+    call->op = strdup("LABEL");
+    call->arg1 = end;
+    call->arg2 = NULL;
+    call->result = NULL; // Still the result of the copy's returns
+    if (body)
+    {
+        previous->next = body;
+        lastInstruction(body)->next = call;
+    }
+}
+
+void inlineHotCalls(IRInstruction *program)
+{
+    if (siteCount == 0)
+        return;
+    int calleeCount;
+    Callee *callees = findCallees(program, &calleeCount);
+
+    qsort(sites, siteCount, sizeof(CallSite), compareSites);
+    int growth = 0;
+    int chosen = 0;
+    for (int i = 0; i < siteCount; i++)
+    {
+        CallSite *site = &sites[i];
+        if (site->count * HOT_CALL_SHARE < sites[0].count)
+            break;
+        Callee *callee = findCallee(callees, calleeCount, site->call->arg1);
+        if (!callee || !callee->inlinable || callee->parameterCount != atoi(site->call->arg2) ||
+            growth + callee->size > INLINE_GROWTH_LIMIT)
+            continue;
+        growth += callee->size;
+        site->callee = callee;
+        chosen++;
+    }
+    printf("PROFILE: %d of %d profiled calls chosen for inlining, %d instructions added\n", chosen, siteCount, growth);
+
+    // The ARGs of a call directly precede it, after every argument is computed
+    IRInstruction *previous = NULL;
+    IRInstruction *firstArg = NULL;
+    for (IRInstruction *ir = program; ir; ir = ir->next)
+    {
+        if (strcmp(ir->op, "ARG") == 0)
+        {
+            if (!firstArg)
+                firstArg = ir;
+        }
+        else if (strcmp(ir->op, "CALL") == 0)
+        {
+            for (int i = 0; i < siteCount; i++)
+            {
+                if (sites[i].call == ir && sites[i].callee)
+                {
+                    inlineCall(previous, firstArg, ir, sites[i].callee);
+                    break;
+                }
+            }
+            firstArg = NULL;
+        }
+        else
+        {
+            firstArg = NULL;
+        }
+        previous = ir;
+    }
+    free(callees);
+    free(sites);
+    sites = NULL;
+    siteCount = siteCapacity = 0;
+}
@@ -0,0 +1,26 @@
+#ifndef INLINING_H
+#define INLINING_H
+
+#include "IRGeneration.h"
+
+// Profile-driven inlining of the hottest calls. IR generation notes every call
+// the profile saw run; once the whole program is lowered, the calls that ran at
+// least 1/HOT_CALL_SHARE as often as the hottest one are replaced by a copy of
+// their callee, hottest first, as long as the program grows by no more than
+// INLINE_GROWTH_LIMIT instructions. Only small leaf functions are copied: one
+// with no calls and no local arrays needs nothing from a frame of its own, so its
+// parameters become plain copies of the arguments and its returns jumps to the
+// end of the copy.
+
+// IR instructions a callee may have, PARAMs and labels included
+#define INLINE_CALLEE_LIMIT 48
+// IR instructions inlining may add to the whole program
+#define INLINE_GROWTH_LIMIT 512
+#define HOT_CALL_SHARE 64
+
+// Remembers a CALL instruction the profile counted count times
+void noteCallSite(IRInstruction *call, long long count);
+// Inlines the hot calls noted into program, the IR of main and every function
+void inlineHotCalls(IRInstruction *program);
+
+#endif // INLINING_H
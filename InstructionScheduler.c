@@ -0,0 +1,453 @@
+#include "InstructionScheduler.h"
+#include "CompilerStats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A classic five-stage pipeline: one load delay slot, multi-cycle HI/LO unit and
+// a pipelined FPU beside it
+const LatencyModel defaultLatencyModel = {1, 2, 5, 20, 1, 4, 12};
+
+typedef struct ScheduleNode
+{
+    MipsInstruction *instr;
+    int latency;
+    int order;            // Position in the original block; breaks priority ties
+    int priority;         // Longest latency-weighted path to the end of the block
+    int earliest;         // First cycle at which every operand is ready
+    int predecessorCount; // Unscheduled instructions this one depends on
+    int *successors;
+    int *edgeLatency;
+    int successorCount;
+    int successorCapacity;
+} ScheduleNode;
+
+// Parses "load=2,mul=5,div=20,hilo=1,alu=1,fpu=4,fdiv=12"; unnamed fields keep their current value
+int parseLatencyModel(const char *spec, LatencyModel *model)
+{
+    char *copy = strdup(spec);
+    int ok = 1;
+    for (char *field = strtok(copy, ","); field && ok; field = strtok(NULL, ","))
+    {
+        char *equals = strchr(field, '=');
+        if (!equals)
+        {
+            ok = 0;
+            break;
+        }
+        *equals = '\0';
+        int value = atoi(equals + 1);
+        if (value < 1)
+            ok = 0;
+        else if (strcmp(field, "alu") == 0)
+            model->alu = value;
+        else if (strcmp(field, "load") == 0)
+            model->load = value;
+        else if (strcmp(field, "mul") == 0)
+            model->multiply = value;
+        else if (strcmp(field, "div") == 0)
+            model->divide = value;
+        else if (strcmp(field, "hilo") == 0)
+            model->hiLo = value;
+        else if (strcmp(field, "fpu") == 0)
+            model->fpu = value;
+        else if (strcmp(field, "fdiv") == 0)
+            model->fpuDivide = value;
+        else
+            ok = 0;
+    }
+    free(copy);
+    return ok;
+}
+
+int instructionLatency(MipsInstruction *instr, const LatencyModel *model)
+{
+    if (mipsHasFlag(instr, MIPS_FLAG_LOAD))
+        return model->load;
+    if (isMipsInstruction(instr, "mul") || isMipsInstruction(instr, "mult") || isMipsInstruction(instr, "mulv.w"))
+        return model->multiply;
+    if (isMipsInstruction(instr, "div"))
+        return model->divide;
+    if (isMipsInstruction(instr, "mfhi") || isMipsInstruction(instr, "mflo"))
+        return model->hiLo;
+    if (isMipsInstruction(instr, "div.s") || isMipsInstruction(instr, "fdiv.w"))
+        return model->fpuDivide;
+    if (isMipsInstruction(instr, "addv.w") || isMipsInstruction(instr, "subv.w") || isMipsInstruction(instr, "fill.w"))
+        return model->alu; // Integer lanes go through the ALU
+    if (strchr(instr->op, '.')) // add.s, c.lt.s, cvt.s.w, fadd.w and the rest of the floating-point set
+        return model->fpu;
+    return model->alu;
+}
+
+// Instructions that end a block stay in place and are never reordered
+static int isSchedulingBarrier(MipsInstruction *instr)
+{
+    return instr->kind != MIPS_INSTRUCTION ||
+           mipsHasFlag(instr, MIPS_FLAG_BRANCH | MIPS_FLAG_JUMP | MIPS_FLAG_CALL | MIPS_FLAG_TRAP);
+}
+
+// Counts the cycles an in-order single-issue pipeline would lose waiting on operands
+int estimateStallCycles(MipsList *list, const LatencyModel *model)
+{
+    int readyAt[MIPS_REGISTER_COUNT] = {0};
+    int cycle = 0;
+    int stalls = 0;
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        if (instr->kind == MIPS_LABEL)
+        {
+            memset(readyAt, 0, sizeof(readyAt)); // Unknown predecessor; assume operands are ready
+            cycle = 0;
+            continue;
+        }
+        if (instr->kind != MIPS_INSTRUCTION)
+            continue;
+
+        int uses[4];
+        int useCount = getMipsUses(instr, uses);
+        int issue = cycle;
+        for (int i = 0; i < useCount; i++)
+        {
+            if (readyAt[uses[i]] > issue)
+                issue = readyAt[uses[i]];
+        }
+        stalls += issue - cycle;
+        cycle = issue + 1;
+
+        int defs[3];
+        int defCount = getMipsDefs(instr, defs);
+        for (int i = 0; i < defCount; i++)
+            readyAt[defs[i]] = issue + instructionLatency(instr, model);
+    }
+    return stalls;
+}
+
+static void addEdge(ScheduleNode *nodes, int from, int to, int latency)
+{
+    if (from < 0 || from == to)
+        return;
+    ScheduleNode *node = &nodes[from];
+    for (int i = 0; i < node->successorCount; i++)
+    {
+        if (node->successors[i] == to)
+        {
+            if (latency > node->edgeLatency[i])
+                node->edgeLatency[i] = latency;
+            return;
+        }
+    }
+    if (node->successorCount == node->successorCapacity)
+    {
+        node->successorCapacity = node->successorCapacity ? 2 * node->successorCapacity : 4;
+        node->successors = realloc(node->successors, sizeof(int) * node->successorCapacity);
+        node->edgeLatency = realloc(node->edgeLatency, sizeof(int) * node->successorCapacity);
+        if (!node->successors || !node->edgeLatency)
+        {
+            perror("Failed to allocate scheduler edges");
+            exit(EXIT_FAILURE);
+        }
+    }
+    node->successors[node->successorCount] = to;
+    node->edgeLatency[node->successorCount] = latency;
+    node->successorCount++;
+    nodes[to].predecessorCount++;
+}
+
+// Builds true, anti and output dependencies by remembering, per register, the
+// last writer and the readers since then. Memory accesses are kept in order
+// unless they provably address different stack slots.
+static void buildDependencies(ScheduleNode *nodes, int count)
+{
+    int lastDef[MIPS_REGISTER_COUNT];
+    int *readers[MIPS_REGISTER_COUNT];
+    int readerCount[MIPS_REGISTER_COUNT];
+    for (int r = 0; r < MIPS_REGISTER_COUNT; r++)
+    {
+        lastDef[r] = -1;
+        readers[r] = malloc(sizeof(int) * (count + 1));
+        readerCount[r] = 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        MipsInstruction *instr = nodes[i].instr;
+        int uses[4];
+        int useCount = getMipsUses(instr, uses);
+        for (int u = 0; u < useCount; u++)
+        {
+            int r = uses[u];
+            if (r == MIPS_REG_ZERO)
+                continue;
+            if (lastDef[r] >= 0)
+                addEdge(nodes, lastDef[r], i, nodes[lastDef[r]].latency);
+            readers[r][readerCount[r]++] = i;
+        }
+
+        int defs[3];
+        int defCount = getMipsDefs(instr, defs);
+        for (int d = 0; d < defCount; d++)
+        {
+            int r = defs[d];
+            if (r == MIPS_REG_ZERO)
+                continue;
+            addEdge(nodes, lastDef[r], i, 1);
+            for (int k = 0; k < readerCount[r]; k++)
+                addEdge(nodes, readers[r][k], i, 0);
+            lastDef[r] = i;
+            readerCount[r] = 0;
+        }
+
+        if (mipsHasFlag(instr, MIPS_FLAG_LOAD | MIPS_FLAG_STORE))
+        {
+            MipsOperand address = instr->operands[1];
+            for (int j = i - 1; j >= 0; j--)
+            {
+                MipsInstruction *earlier = nodes[j].instr;
+                if (!mipsHasFlag(earlier, MIPS_FLAG_STORE) &&
+                    !(mipsHasFlag(instr, MIPS_FLAG_STORE) && mipsHasFlag(earlier, MIPS_FLAG_LOAD)))
+                    continue;
+                MipsOperand other = earlier->operands[1];
+                int disjointSlots = address.reg == MIPS_REG_SP && other.reg == MIPS_REG_SP && address.value != other.value;
+                if (!disjointSlots)
+                    addEdge(nodes, j, i, mipsHasFlag(earlier, MIPS_FLAG_STORE) ? 1 : 0);
+            }
+        }
+    }
+
+    for (int r = 0; r < MIPS_REGISTER_COUNT; r++)
+        free(readers[r]);
+}
+
+static void computePriorities(ScheduleNode *nodes, int count)
+{
+    for (int i = count - 1; i >= 0; i--)
+    {
+        int priority = nodes[i].latency;
+        for (int s = 0; s < nodes[i].successorCount; s++)
+        {
+            int path = nodes[i].edgeLatency[s] + nodes[nodes[i].successors[s]].priority;
+            if (path > priority)
+                priority = path;
+        }
+        nodes[i].priority = priority;
+    }
+}
+
+// Cycle-driven list scheduling of one block: each cycle issue the ready
+// instruction on the longest remaining path; if none is ready, stall.
+static void scheduleBlock(MipsList *list, MipsInstruction *first, MipsInstruction *end, int count, const LatencyModel *model)
+{
+    ScheduleNode *nodes = calloc(count, sizeof(ScheduleNode));
+    int *order = malloc(sizeof(int) * count);
+    if (!nodes || !order)
+    {
+        perror("Failed to allocate scheduler state");
+        exit(EXIT_FAILURE);
+    }
+
+    MipsInstruction *instr = first;
+    for (int i = 0; i < count; i++, instr = instr->next)
+    {
+        nodes[i].instr = instr;
+        nodes[i].order = i;
+        nodes[i].latency = instructionLatency(instr, model);
+    }
+    buildDependencies(nodes, count);
+    computePriorities(nodes, count);
+
+    int cycle = 0;
+    for (int scheduled = 0; scheduled < count; scheduled++)
+    {
+        int best = -1;
+        int nextReady = -1;
+        for (int i = 0; i < count; i++)
+        {
+            if (nodes[i].predecessorCount != 0)
+                continue;
+            if (nodes[i].earliest <= cycle)
+            {
+                if (best < 0 || nodes[i].priority > nodes[best].priority)
+                    best = i;
+            }
+            else if (nextReady < 0 || nodes[i].earliest < nodes[nextReady].earliest)
+            {
+                nextReady = i;
+            }
+        }
+        if (best < 0)
+        {
+            best = nextReady;
+            cycle = nodes[best].earliest;
+        }
+
+        order[scheduled] = best;
+        nodes[best].predecessorCount = -1; // Scheduled
+        for (int s = 0; s < nodes[best].successorCount; s++)
+        {
+            ScheduleNode *successor = &nodes[nodes[best].successors[s]];
+            if (cycle + nodes[best].edgeLatency[s] > successor->earliest)
+                successor->earliest = cycle + nodes[best].edgeLatency[s];
+            successor->predecessorCount--;
+        }
+        cycle++;
+    }
+
+    // Relink the block in scheduled order between its neighbours
+    MipsInstruction *before = first->prev;
+    for (int i = 0; i < count; i++)
+    {
+        MipsInstruction *current = nodes[order[i]].instr;
+        current->prev = before;
+        if (before)
+            before->next = current;
+        else
+            list->head = current;
+        before = current;
+    }
+    before->next = end;
+    if (end)
+        end->prev = before;
+    else
+        list->tail = before;
+
+    for (int i = 0; i < count; i++)
+    {
+        free(nodes[i].successors);
+        free(nodes[i].edgeLatency);
+    }
+    free(nodes);
+    free(order);
+}
+
+void scheduleInstructions(MipsList *list, const LatencyModel *model)
+{
+    int stallsBefore = estimateStallCycles(list, model);
+    int blocks = 0;
+
+    MipsInstruction *instr = list->head;
+    while (instr)
+    {
+        if (isSchedulingBarrier(instr))
+        {
+            instr = instr->next;
+            continue;
+        }
+        MipsInstruction *first = instr;
+        int count = 0;
+        while (instr && !isSchedulingBarrier(instr))
+        {
+            count++;
+            instr = instr->next;
+        }
+        if (count > 1)
+        {
+            scheduleBlock(list, first, instr, count, model);
+            blocks++;
+        }
+    }
+
+    fprintf(diagnostics(), "SCHED: %d blocks scheduled, estimated stall cycles %d -> %d\n",
+            blocks, stallsBefore, estimateStallCycles(list, model));
+}
+
+// Pseudo-instructions that may assemble to more than one word cannot sit in a delay slot
+static int isSingleMachineInstruction(MipsInstruction *instr)
+{
+    if (isMipsInstruction(instr, "la"))
+        return 0;
+    // A global's address needs a lui before the access itself
+    if (mipsHasFlag(instr, MIPS_FLAG_LOAD | MIPS_FLAG_STORE) && instr->operands[1].label)
+        return 0;
+    if (isMipsInstruction(instr, "li"))
+        return instr->operands[1].value >= -32768 && instr->operands[1].value <= 65535;
+    return 1;
+}
+
+static int sharesRegister(int *a, int aCount, int *b, int bCount)
+{
+    for (int i = 0; i < aCount; i++)
+    {
+        for (int j = 0; j < bCount; j++)
+        {
+            if (a[i] == b[j] && a[i] != MIPS_REG_ZERO)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// True when candidate can move past every instruction from candidate->next up to and including branch
+static int canMoveIntoSlot(MipsInstruction *candidate, MipsInstruction *branch)
+{
+    int defs[3], uses[4];
+    int defCount = getMipsDefs(candidate, defs);
+    int useCount = getMipsUses(candidate, uses);
+    int touchesMemory = mipsHasFlag(candidate, MIPS_FLAG_LOAD | MIPS_FLAG_STORE);
+
+    for (MipsInstruction *scan = candidate->next;; scan = scan->next)
+    {
+        int scanDefs[3], scanUses[4];
+        int scanDefCount = getMipsDefs(scan, scanDefs);
+        int scanUseCount = getMipsUses(scan, scanUses);
+        if (sharesRegister(defs, defCount, scanUses, scanUseCount) ||
+            sharesRegister(defs, defCount, scanDefs, scanDefCount) ||
+            sharesRegister(uses, useCount, scanDefs, scanDefCount))
+            return 0;
+        if (touchesMemory && mipsHasFlag(scan, MIPS_FLAG_STORE | (mipsHasFlag(candidate, MIPS_FLAG_STORE) ? MIPS_FLAG_LOAD : 0)))
+            return 0;
+        if (scan == branch)
+            return 1;
+    }
+}
+
+// Fills the delay slot after every branch, jump and call with an earlier
+// instruction from the same block, or a nop when nothing can move safely.
+// The output then has to be assembled with .set noreorder semantics.
+void fillDelaySlots(MipsList *list)
+{
+    int slots = 0;
+    int filled = 0;
+
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        if (!mipsHasFlag(instr, MIPS_FLAG_BRANCH | MIPS_FLAG_JUMP | MIPS_FLAG_CALL))
+            continue;
+        slots++;
+
+        // An earlier branch's filled slot ends the block just like the branch itself
+        MipsInstruction *chosen = NULL;
+        for (MipsInstruction *candidate = instr->prev;
+             candidate && !isSchedulingBarrier(candidate) &&
+             !mipsHasFlag(candidate->prev, MIPS_FLAG_BRANCH | MIPS_FLAG_JUMP | MIPS_FLAG_CALL);
+             candidate = candidate->prev)
+        {
+            if (isSingleMachineInstruction(candidate) && canMoveIntoSlot(candidate, instr))
+            {
+                chosen = candidate;
+                break;
+            }
+        }
+
+        if (chosen)
+        {
+            unlinkMipsInstruction(list, chosen);
+            insertMipsAfter(list, instr, chosen);
+            filled++;
+        }
+        else
+        {
+            insertMipsAfter(list, instr, createMipsInstruction("nop", NO_OPERAND, NO_OPERAND, NO_OPERAND));
+        }
+        instr = instr->next; // Skip over the slot
+    }
+
+    // Tell the assembler the slots are already filled. A list of single units
+    // has no .text; whoever writes the section's header adds the directive.
+    MipsInstruction *directive = list->head;
+    while (directive && !(directive->kind == MIPS_DIRECTIVE && strcmp(directive->op, ".text") == 0))
+        directive = directive->next;
+    if (directive)
+        insertMipsAfter(list, directive, createMipsDirective(".set", mipsLabelOperand("noreorder")));
+
+    fprintf(diagnostics(), "SCHED: %d of %d delay slots filled\n", filled, slots);
+}
@@ -0,0 +1,26 @@
+#ifndef INSTRUCTION_SCHEDULER_H
+#define INSTRUCTION_SCHEDULER_H
+
+#include "MipsInstruction.h"
+
+// Cycles from an instruction issuing until a dependent instruction can issue without stalling
+typedef struct LatencyModel
+{
+    int alu;
+    int load;
+    int multiply;
+    int divide;
+    int hiLo; // mfhi/mflo
+    int fpu;  // Coprocessor 1 arithmetic, compares and conversions
+    int fpuDivide;
+} LatencyModel;
+
+extern const LatencyModel defaultLatencyModel;
+
+int parseLatencyModel(const char *spec, LatencyModel *model);
+int instructionLatency(MipsInstruction *instr, const LatencyModel *model);
+int estimateStallCycles(MipsList *list, const LatencyModel *model);
+void scheduleInstructions(MipsList *list, const LatencyModel *model);
+void fillDelaySlots(MipsList *list);
+
+#endif // INSTRUCTION_SCHEDULER_H
@@ -0,0 +1,908 @@
+#include "InstructionSelection.h"
+#include "NameTable.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COST_INFINITE (1 << 20)
+
+typedef enum
+{
+    NODE_REG,
+    NODE_CONST,
+    NODE_ADD,
+    NODE_SUB,
+    NODE_MUL,
+    NODE_DIV,
+    NODE_LT,
+    NODE_LE,
+    NODE_GT,
+    NODE_GE,
+    NODE_EQ,
+    NODE_NE,
+    NODE_MEM,
+    NODE_SYM,
+    NODE_KIND_COUNT
+} NodeKind;
+
+static const char *nodeKindNames[NODE_KIND_COUNT] = {"REG", "CONST", "ADD", "SUB", "MUL", "DIV", "LT",
+                                                     "LE", "GT", "GE", "EQ", "NE", "MEM", "SYM"};
+
+typedef enum
+{
+    NT_REG,      // Value in a register
+    NT_CONST,    // Value known at compile time
+    NT_IMM16,    // Constant that fits a signed 16-bit immediate
+    NT_NEGIMM16, // Constant whose negation fits one, so x - c can be addi x, -c
+    NT_SHIFT,    // Power of two, multiplied by as a left shift
+    NT_ADDR,     // Optional base register plus a displacement, which may name a symbol
+    NONTERMINAL_COUNT
+} Nonterminal;
+
+static const char *nonterminalNames[NONTERMINAL_COUNT] = {"reg", "const", "imm16", "negimm16", "shift", "addr"};
+
+// A parsed rule pattern: an operator node with kids, or a nonterminal leaf
+typedef struct Pattern
+{
+    int isLeaf;
+    Nonterminal nonterminal;
+    NodeKind kind;
+    int kidCount;
+    struct Pattern *kids[2];
+} Pattern;
+
+struct SelectionRule;
+
+typedef struct SelectionNode
+{
+    NodeKind kind;
+    char *name; // Register a NODE_REG leaf reads, or the temporary an operator defines
+    int value;  // Literal of a NODE_CONST, and the folded value of any node that reduces to const
+    char *symbol; // Global or frame array a NODE_SYM stands for
+    struct SelectionNode *kids[2];
+    int labelled;
+    int cost[NONTERMINAL_COUNT];
+    struct SelectionRule *rule[NONTERMINAL_COUNT];
+    struct SelectionNode *allocatedNext;
+} SelectionNode;
+
+typedef struct Selector Selector;
+
+// One tile. A rule whose pattern is a bare nonterminal is a chain rule. Tiles
+// that emit code name an IR op and which pattern leaves become arg1 and arg2,
+// or supply an emit function when that is not enough.
+typedef struct SelectionRule
+{
+    const char *name;
+    Nonterminal result;
+    const char *patternText;
+    int cost; // Instructions the tile emits
+    int (*applies)(SelectionNode *node);
+    const char *op;
+    const char *operands;
+    void (*emit)(Selector *selector, SelectionNode *node, char *result);
+    Pattern *pattern;
+    _Atomic int hits; // --jobs workers share the rules
+} SelectionRule;
+
+typedef struct NameInfo
+{
+    char *name;
+    int definitions;
+    int uses;
+    int useIndex; // Instruction holding the last use
+} NameInfo;
+
+typedef struct PendingTree
+{
+    char *name;
+    SelectionNode *node;
+} PendingTree;
+
+struct Selector
+{
+    IRInstruction **code;
+    int count;
+    NameInfo *names;
+    int nameCount;
+    int *nameTable;
+    int nameTableSize;
+    PendingTree *pending; // Folded definitions waiting for their use
+    int pendingCount;
+    SelectionNode *nodes;
+    IRInstruction *head;
+    IRInstruction *tail;
+    int emitted;
+};
+
+static _Atomic int instructionsIn = 0;
+static _Atomic int instructionsOut = 0;
+
+static int fitsImmediate(SelectionNode *node)
+{
+    return node->value >= -32768 && node->value <= 32767;
+}
+
+static int negationFitsImmediate(SelectionNode *node)
+{
+    return node->value >= -32767 && node->value <= 32768;
+}
+
+static int isPowerOfTwo(SelectionNode *node)
+{
+    return node->value > 0 && (node->value & (node->value - 1)) == 0;
+}
+
+static int hasSafeDivisor(SelectionNode *node)
+{
+    int divisor = node->kids[1]->value;
+    return divisor != 0 && !(divisor == -1 && node->kids[0]->value == (int)0x80000000);
+}
+
+// ADD(ADD(x, c1), c2) becomes one addi when c1 + c2 still fits
+static int combinedAddFits(SelectionNode *node)
+{
+    long long sum = (long long)node->kids[0]->kids[1]->value + node->kids[1]->value;
+    return sum >= -32768 && sum <= 32767;
+}
+
+// ADD(SYM, MUL(ADD(x, c), 2^k)) folds c << k into the displacement
+static int scaledOffsetFits(SelectionNode *node)
+{
+    SelectionNode *scaled = node->kids[1];
+    long long offset = (long long)scaled->kids[0]->kids[1]->value * scaled->kids[1]->value;
+    if (scaled->kids[0]->kind == NODE_SUB)
+        offset = -offset;
+    return offset >= -32768 && offset <= 32767;
+}
+
+static void emitLoadImmediate(Selector *selector, SelectionNode *node, char *result);
+static void emitLoadAddress(Selector *selector, SelectionNode *node, char *result);
+static void emitCombinedAdd(Selector *selector, SelectionNode *node, char *result);
+static void emitLoadWord(Selector *selector, SelectionNode *node, char *result);
+
+// Ties go to the earlier rule. New tiles go here.
+static SelectionRule rules[] = {
+    // name, result, pattern, cost, applies, op, operands, emit
+    {"reg", NT_REG, "REG", 0, NULL, NULL, NULL, NULL},
+    {"const", NT_CONST, "CONST", 0, NULL, NULL, NULL, NULL},
+    {"fold-add", NT_CONST, "ADD(const,const)", 0, NULL, NULL, NULL, NULL},
+    {"fold-sub", NT_CONST, "SUB(const,const)", 0, NULL, NULL, NULL, NULL},
+    {"fold-mul", NT_CONST, "MUL(const,const)", 0, NULL, NULL, NULL, NULL},
+    {"fold-div", NT_CONST, "DIV(const,const)", 0, hasSafeDivisor, NULL, NULL, NULL},
+    {"imm16", NT_IMM16, "const", 0, fitsImmediate, NULL, NULL, NULL},
+    {"negimm16", NT_NEGIMM16, "const", 0, negationFitsImmediate, NULL, NULL, NULL},
+    {"shift", NT_SHIFT, "const", 0, isPowerOfTwo, NULL, NULL, NULL},
+    {"li", NT_REG, "const", 1, NULL, NULL, NULL, emitLoadImmediate},
+    {"add", NT_REG, "ADD(reg,reg)", 1, NULL, "+", "01", NULL},
+    {"addi", NT_REG, "ADD(reg,imm16)", 1, NULL, "+", "01", NULL},
+    {"addi", NT_REG, "ADD(imm16,reg)", 1, NULL, "+", "10", NULL},
+    {"addi-addi", NT_REG, "ADD(ADD(reg,const),const)", 1, combinedAddFits, NULL, NULL, emitCombinedAdd},
+    {"sub", NT_REG, "SUB(reg,reg)", 1, NULL, "-", "01", NULL},
+    {"subi", NT_REG, "SUB(reg,negimm16)", 1, NULL, "+", "01", NULL},
+    {"mul", NT_REG, "MUL(reg,reg)", 1, NULL, "*", "01", NULL},
+    {"sll", NT_REG, "MUL(reg,shift)", 1, NULL, "<<", "01", NULL},
+    {"sll", NT_REG, "MUL(shift,reg)", 1, NULL, "<<", "10", NULL},
+    {"div", NT_REG, "DIV(reg,reg)", 2, NULL, "/", "01", NULL},
+    {"slt", NT_REG, "LT(reg,reg)", 1, NULL, "<", "01", NULL},
+    {"slti", NT_REG, "LT(reg,imm16)", 1, NULL, "<", "01", NULL},
+    {"sgt", NT_REG, "GT(reg,reg)", 1, NULL, ">", "01", NULL},
+    {"sle", NT_REG, "LE(reg,reg)", 2, NULL, "<=", "01", NULL},
+    {"sge", NT_REG, "GE(reg,reg)", 2, NULL, ">=", "01", NULL},
+    {"sgei", NT_REG, "GE(reg,imm16)", 2, NULL, ">=", "01", NULL},
+    {"seq", NT_REG, "EQ(reg,reg)", 2, NULL, "==", "01", NULL},
+    {"sne", NT_REG, "NE(reg,reg)", 2, NULL, "!=", "01", NULL},
+    {"base", NT_ADDR, "reg", 0, NULL, NULL, NULL, NULL},
+    {"displacement", NT_ADDR, "ADD(reg,imm16)", 0, NULL, NULL, NULL, NULL},
+    {"displacement", NT_ADDR, "ADD(imm16,reg)", 0, NULL, NULL, NULL, NULL},
+    {"symbol", NT_ADDR, "SYM", 0, NULL, NULL, NULL, NULL},
+    {"symbol+offset", NT_ADDR, "ADD(SYM,imm16)", 0, NULL, NULL, NULL, NULL},
+    {"symbol+index", NT_ADDR, "ADD(SYM,reg)", 0, NULL, NULL, NULL, NULL},
+    {"symbol+scaled", NT_ADDR, "ADD(SYM,MUL(ADD(reg,imm16),shift))", 1, scaledOffsetFits, NULL, NULL, NULL},
+    {"symbol+scaled", NT_ADDR, "ADD(SYM,MUL(SUB(reg,negimm16),shift))", 1, scaledOffsetFits, NULL, NULL, NULL},
+    {"la", NT_REG, "SYM", 1, NULL, NULL, NULL, emitLoadAddress},
+    {"lw", NT_REG, "MEM(addr)", 1, NULL, NULL, NULL, emitLoadWord},
+    {NULL, NT_REG, NULL, 0, NULL, NULL, NULL, NULL}};
+
+static int lookupName(const char *name, int length, const char **names, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if ((int)strlen(names[i]) == length && strncmp(names[i], name, length) == 0)
+            return i;
+    }
+    fprintf(stderr, "Error: unknown name '%.*s' in selection pattern\n", length, name);
+    exit(EXIT_FAILURE);
+}
+
+// pattern := name | NAME '(' pattern [',' pattern] ')', lower case names being nonterminals
+static Pattern *parsePattern(const char **text)
+{
+    Pattern *pattern = calloc(1, sizeof(Pattern));
+    if (!pattern)
+    {
+        perror("Failed to allocate selection pattern");
+        exit(EXIT_FAILURE);
+    }
+    const char *start = *text;
+    while (isalnum((unsigned char)**text))
+        (*text)++;
+    int length = (int)(*text - start);
+
+    if (islower((unsigned char)start[0]))
+    {
+        pattern->isLeaf = 1;
+        pattern->nonterminal = lookupName(start, length, nonterminalNames, NONTERMINAL_COUNT);
+        return pattern;
+    }
+    pattern->kind = lookupName(start, length, nodeKindNames, NODE_KIND_COUNT);
+    if (**text == '(')
+    {
+        do
+        {
+            (*text)++;
+            pattern->kids[pattern->kidCount++] = parsePattern(text);
+        } while (**text == ',' && pattern->kidCount < 2);
+        (*text)++; // ')'
+    }
+    return pattern;
+}
+
+static void parseRules()
+{
+    for (SelectionRule *rule = rules; rule->name; rule++)
+    {
+        if (!rule->pattern)
+        {
+            const char *text = rule->patternText;
+            rule->pattern = parsePattern(&text);
+        }
+    }
+}
+
+// Cost of covering node with pattern, given the costs already labelled below it
+static int matchCost(Pattern *pattern, SelectionNode *node)
+{
+    if (pattern->isLeaf)
+        return node->cost[pattern->nonterminal];
+    if (node->kind != pattern->kind)
+        return COST_INFINITE;
+    int total = 0;
+    for (int i = 0; i < pattern->kidCount; i++)
+    {
+        int cost = matchCost(pattern->kids[i], node->kids[i]);
+        if (cost >= COST_INFINITE)
+            return COST_INFINITE;
+        total += cost;
+    }
+    return total;
+}
+
+// Wrapping arithmetic, as the folded instructions would compute it
+static int foldConstant(SelectionNode *node)
+{
+    if (node->kind == NODE_CONST)
+        return node->value;
+    unsigned int left = (unsigned int)node->kids[0]->value;
+    unsigned int right = (unsigned int)node->kids[1]->value;
+    switch (node->kind)
+    {
+    case NODE_ADD:
+        return (int)(left + right);
+    case NODE_SUB:
+        return (int)(left - right);
+    case NODE_MUL:
+        return (int)(left * right);
+    case NODE_DIV:
+        return node->kids[0]->value / node->kids[1]->value;
+    default:
+        return node->value;
+    }
+}
+
+static void record(SelectionNode *node, SelectionRule *rule, int cost)
+{
+    if (cost < node->cost[rule->result])
+    {
+        node->cost[rule->result] = cost;
+        node->rule[rule->result] = rule;
+    }
+}
+
+// Bottom-up dynamic programming: the cheapest rule producing each nonterminal at node
+static void label(SelectionNode *node)
+{
+    if (node->labelled)
+        return;
+    node->labelled = 1;
+    for (int i = 0; i < 2; i++)
+    {
+        if (node->kids[i])
+            label(node->kids[i]);
+    }
+    for (int nt = 0; nt < NONTERMINAL_COUNT; nt++)
+    {
+        node->cost[nt] = COST_INFINITE;
+        node->rule[nt] = NULL;
+    }
+
+    for (SelectionRule *rule = rules; rule->name; rule++)
+    {
+        if (rule->pattern->isLeaf)
+            continue;
+        int cost = matchCost(rule->pattern, node);
+        if (cost >= COST_INFINITE || (rule->applies && !rule->applies(node)))
+            continue;
+        if (rule->result == NT_CONST)
+            node->value = foldConstant(node);
+        record(node, rule, cost + rule->cost);
+    }
+
+    // Chain rules until nothing gets cheaper
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (SelectionRule *rule = rules; rule->name; rule++)
+        {
+            if (!rule->pattern->isLeaf || node->cost[rule->pattern->nonterminal] >= COST_INFINITE)
+                continue;
+            int cost = node->cost[rule->pattern->nonterminal] + rule->cost;
+            if (cost < node->cost[rule->result] && (!rule->applies || rule->applies(node)))
+            {
+                record(node, rule, cost);
+                changed = 1;
+            }
+        }
+    }
+}
+
+typedef struct LeafMatch
+{
+    Nonterminal nonterminal;
+    SelectionNode *node;
+} LeafMatch;
+
+static void collectLeaves(Pattern *pattern, SelectionNode *node, LeafMatch *leaves, int *count)
+{
+    if (pattern->isLeaf)
+    {
+        leaves[*count].nonterminal = pattern->nonterminal;
+        leaves[*count].node = node;
+        (*count)++;
+        return;
+    }
+    for (int i = 0; i < pattern->kidCount; i++)
+        collectLeaves(pattern->kids[i], node->kids[i], leaves, count);
+}
+
+static void append(Selector *selector, IRInstruction *ir)
+{
+    ir->next = NULL;
+    if (selector->tail)
+        selector->tail->next = ir;
+    else
+        selector->head = ir;
+    selector->tail = ir;
+    selector->emitted++;
+}
+
+static char *reduce(Selector *selector, SelectionNode *node, char *result);
+
+static int shiftAmount(int powerOfTwo)
+{
+    int shift = 0;
+    while ((1 << shift) != powerOfTwo)
+        shift++;
+    return shift;
+}
+
+static char *leafOperand(Selector *selector, LeafMatch *leaf)
+{
+    int value = leaf->node->value;
+    switch (leaf->nonterminal)
+    {
+    case NT_REG:
+        return reduce(selector, leaf->node, NULL);
+    case NT_NEGIMM16:
+        return immediateOperand(-value);
+    case NT_SHIFT:
+        return immediateOperand(shiftAmount(value));
+    default:
+        return immediateOperand(value);
+    }
+}
+
+// Emits node's tile and the tiles below it, leaving the value in result (or the
+// node's own name when result is NULL); returns where the value ended up
+static char *reduce(Selector *selector, SelectionNode *node, char *result)
+{
+    SelectionRule *rule = node->rule[NT_REG];
+    if (!rule)
+    {
+        fprintf(stderr, "Error: no instruction covers %s\n", nodeKindNames[node->kind]);
+        exit(EXIT_FAILURE);
+    }
+    if (node->kind == NODE_REG && !rule->op && !rule->emit)
+    {
+        if (!result || strcmp(result, node->name) == 0)
+            return node->name;
+        append(selector, createInstruction("=", node->name, NULL, result));
+        return result;
+    }
+
+    char *target = result ? result : node->name;
+    rule->hits++;
+    if (rule->emit)
+    {
+        rule->emit(selector, node, target);
+        return target;
+    }
+
+    LeafMatch leaves[4];
+    int leafCount = 0;
+    collectLeaves(rule->pattern, node, leaves, &leafCount);
+    char *operands[2] = {NULL, NULL};
+    for (int i = 0; rule->operands[i]; i++)
+        operands[i] = leafOperand(selector, &leaves[rule->operands[i] - '0']);
+    append(selector, createInstruction(rule->op, operands[0], operands[1], target));
+    return target;
+}
+
+typedef struct AddressTerms
+{
+    char *base;
+    char *symbol;
+    int offset;
+} AddressTerms;
+
+// Collects the symbol, base register and constant displacement an address
+// pattern covers. Under a MUL by 2^k the register is shifted into the MUL's
+// temporary and the constant is scaled, so a[i + c] becomes sym+4c(i << 2).
+static void addressTerms(Selector *selector, Pattern *pattern, SelectionNode *node, SelectionNode *scaled, int scale,
+                         AddressTerms *terms)
+{
+    if (!pattern->isLeaf)
+    {
+        if (pattern->kind == NODE_SYM)
+        {
+            terms->symbol = node->symbol;
+        }
+        else if (pattern->kind == NODE_MUL)
+        {
+            addressTerms(selector, pattern->kids[0], node->kids[0], node, scale * node->kids[1]->value, terms);
+        }
+        else
+        {
+            addressTerms(selector, pattern->kids[0], node->kids[0], scaled, scale, terms);
+            addressTerms(selector, pattern->kids[1], node->kids[1], scaled,
+                         pattern->kind == NODE_SUB ? -scale : scale, terms);
+        }
+        return;
+    }
+    if (pattern->nonterminal != NT_REG)
+    {
+        terms->offset += node->value * scale;
+        return;
+    }
+    terms->base = reduce(selector, node, NULL);
+    if (scaled)
+    {
+        append(selector, createInstruction("<<", terms->base, immediateOperand(shiftAmount(scale)), scaled->name));
+        terms->base = scaled->name;
+    }
+}
+
+// Splits an address into a base register, NULL when there is none, and a
+// displacement operand: "#offset", or "&symbol+offset" for an array or global
+static char *reduceAddress(Selector *selector, SelectionNode *node, char **displacement)
+{
+    SelectionRule *rule = node->rule[NT_ADDR];
+    AddressTerms terms = {NULL, NULL, 0};
+    rule->hits++;
+    addressTerms(selector, rule->pattern, node, NULL, 1, &terms);
+    if (terms.symbol)
+    {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "&%s%+d", terms.symbol, terms.offset);
+        *displacement = strdup(buffer);
+    }
+    else
+    {
+        *displacement = immediateOperand(terms.offset);
+    }
+    return terms.base;
+}
+
+static void emitLoadImmediate(Selector *selector, SelectionNode *node, char *result)
+{
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%d", node->value);
+    append(selector, createInstruction("MOV", strdup(buffer), NULL, result));
+}
+
+static void emitLoadAddress(Selector *selector, SelectionNode *node, char *result)
+{
+    append(selector, createInstruction("ADDR", node->symbol, NULL, result));
+}
+
+static void emitCombinedAdd(Selector *selector, SelectionNode *node, char *result)
+{
+    char *base = reduce(selector, node->kids[0]->kids[0], NULL);
+    append(selector, createInstruction("+", base, immediateOperand(node->kids[0]->kids[1]->value + node->kids[1]->value), result));
+}
+
+static void emitLoadWord(Selector *selector, SelectionNode *node, char *result)
+{
+    char *displacement;
+    char *base = reduceAddress(selector, node->kids[0], &displacement);
+    append(selector, createInstruction("LOADMEM", base, displacement, result));
+}
+
+static const char *nameInSlot(const void *table, int slot)
+{
+    const Selector *selector = table;
+    int index = selector->nameTable[slot];
+    return index < 0 ? NULL : selector->names[index].name;
+}
+
+static NameInfo *findName(Selector *selector, const char *name, int create)
+{
+    int slot = probeNameTable(selector, selector->nameTableSize, nameInSlot, name);
+    if (selector->nameTable[slot] >= 0)
+        return &selector->names[selector->nameTable[slot]];
+    if (!create)
+        return NULL;
+    NameInfo *info = &selector->names[selector->nameCount];
+    info->name = (char *)name;
+    info->definitions = info->uses = 0;
+    info->useIndex = -1;
+    selector->nameTable[slot] = selector->nameCount++;
+    return info;
+}
+
+// The tree kind an IR instruction computes, or -1 when it is not an expression
+static int expressionKind(IRInstruction *ir)
+{
+    static const char *ops[] = {"LOAD", "MOV", "+", "-", "*", "/", "<", "<=", ">", ">=", "==", "!="};
+    for (int kind = NODE_REG; kind <= NODE_NE; kind++)
+    {
+        if (strcmp(ir->op, ops[kind]) == 0)
+            return kind;
+    }
+    if (strcmp(ir->op, "LOADMEM") == 0 && !ir->arg2)
+        return NODE_MEM;
+    if (strcmp(ir->op, "ADDR") == 0)
+        return NODE_SYM;
+    return -1;
+}
+
+static SelectionNode *newNode(Selector *selector, NodeKind kind, char *name)
+{
+    SelectionNode *node = calloc(1, sizeof(SelectionNode));
+    if (!node)
+    {
+        perror("Failed to allocate selection node");
+        exit(EXIT_FAILURE);
+    }
+    node->kind = kind;
+    node->name = name;
+    node->allocatedNext = selector->nodes;
+    selector->nodes = node;
+    return node;
+}
+
+static SelectionNode *takePending(Selector *selector, const char *name)
+{
+    for (int i = selector->pendingCount - 1; i >= 0; i--)
+    {
+        if (strcmp(selector->pending[i].name, name) == 0)
+        {
+            SelectionNode *node = selector->pending[i].node;
+            selector->pending[i] = selector->pending[--selector->pendingCount];
+            return node;
+        }
+    }
+    return NULL;
+}
+
+// The tree computing operand: its folded definition, or a leaf reading the register
+static SelectionNode *operandNode(Selector *selector, char *operand)
+{
+    SelectionNode *node = takePending(selector, operand);
+    return node ? node : newNode(selector, NODE_REG, operand);
+}
+
+static SelectionNode *buildNode(Selector *selector, IRInstruction *ir, NodeKind kind)
+{
+    if (kind == NODE_REG)
+        return newNode(selector, NODE_REG, ir->arg1);
+    SelectionNode *node = newNode(selector, kind, ir->result);
+    if (kind == NODE_CONST)
+    {
+        node->value = atoi(ir->arg1);
+        return node;
+    }
+    if (kind == NODE_SYM)
+    {
+        node->symbol = ir->arg1;
+        return node;
+    }
+    node->kids[0] = operandNode(selector, ir->arg1);
+    if (kind != NODE_MEM)
+        node->kids[1] = operandNode(selector, ir->arg2);
+    return node;
+}
+
+// True when some instruction in (from, to) writes a register the tree reads,
+// or writes memory the tree loads
+static int treeClobbered(Selector *selector, SelectionNode *node, int from, int to)
+{
+    if (node->kind == NODE_REG)
+    {
+        for (int k = from + 1; k < to; k++)
+        {
+            char *def = getInstructionDefinition(selector->code[k]);
+            if (def && strcmp(def, node->name) == 0)
+                return 1;
+        }
+        return 0;
+    }
+    if (node->kind == NODE_MEM)
+    {
+        for (int k = from + 1; k < to; k++)
+        {
+            if (strcmp(selector->code[k]->op, "STORE") == 0 || strcmp(selector->code[k]->op, "VSTORE") == 0 ||
+                strcmp(selector->code[k]->op, "CALL") == 0)
+                return 1;
+        }
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        if (node->kids[i] && treeClobbered(selector, node->kids[i], from, to))
+            return 1;
+    }
+    return 0;
+}
+
+// A definition folds into its use when it is the only one of each, both sit in
+// the same basic block, and evaluating it late still reads the same values
+static int canFold(Selector *selector, int index, SelectionNode *node)
+{
+    NameInfo *info = findName(selector, selector->code[index]->result, 0);
+    if (!info || info->definitions != 1 || info->uses != 1 || info->useIndex <= index)
+        return 0;
+    for (int k = index + 1; k <= info->useIndex; k++)
+    {
+        IRInstruction *scan = selector->code[k];
+        if (strcmp(scan->op, "LABEL") == 0)
+            return 0;
+        if (k < info->useIndex && isBlockTerminator(scan))
+            return 0;
+    }
+    return !treeClobbered(selector, node, index, info->useIndex);
+}
+
+static SelectionNode *takeLabelled(Selector *selector, char *operand)
+{
+    SelectionNode *node = operandNode(selector, operand);
+    label(node);
+    return node;
+}
+
+static int isConstantNode(SelectionNode *node)
+{
+    return node->cost[NT_CONST] < COST_INFINITE;
+}
+
+static const char *branchOp(const char *relation)
+{
+    static const char *ops[] = {"IF<", "IF<=", "IF>", "IF>=", "IF==", "IF!="};
+    for (int i = 0; i < 6; i++)
+    {
+        if (strcmp(ops[i] + 2, relation) == 0)
+            return ops[i];
+    }
+    return NULL;
+}
+
+// Compares against zero or a 16-bit immediate instead of loading the constant:
+// a > c tests a >= c + 1 and a <= c tests a < c + 1, which slti can do
+static void selectBranch(Selector *selector, IRInstruction *ir, const char *relation)
+{
+    SelectionNode *left = takeLabelled(selector, ir->arg1);
+    SelectionNode *right = ir->arg2 ? takeLabelled(selector, ir->arg2) : NULL;
+    char *rightOperand = NULL;
+
+    if (right && isConstantNode(left) && !isConstantNode(right))
+    {
+        static const char *mirrored[][2] = {{"<", ">"}, {">", "<"}, {"<=", ">="}, {">=", "<="}};
+        for (int i = 0; i < 4; i++)
+        {
+            if (strcmp(relation, mirrored[i][0]) == 0)
+            {
+                relation = mirrored[i][1];
+                break;
+            }
+        }
+        SelectionNode *swap = left;
+        left = right;
+        right = swap;
+    }
+
+    if (right && isConstantNode(right))
+    {
+        long long value = right->value;
+        int adjust = strcmp(relation, ">") == 0 || strcmp(relation, "<=") == 0;
+        if (value == 0)
+        {
+            right = NULL;
+        }
+        else if (strcmp(relation, "==") != 0 && strcmp(relation, "!=") != 0 &&
+                 value + adjust >= -32768 && value + adjust <= 32767)
+        {
+            if (adjust)
+                relation = strcmp(relation, ">") == 0 ? ">=" : "<";
+            rightOperand = immediateOperand((int)(value + adjust));
+            right = NULL;
+        }
+    }
+
+    if (strcmp(ir->op, "IFGOTO") != 0 || strcmp(relation, "!=") != 0 || right || rightOperand)
+    {
+        char *op = strdup(branchOp(relation)); // relation may point into the old op
+        free(ir->op);
+        ir->op = op;
+    }
+    ir->arg1 = reduce(selector, left, NULL);
+    ir->arg2 = right ? reduce(selector, right, NULL) : rightOperand;
+    append(selector, ir);
+}
+
+// A statement: its operand trees are reduced in front of it, using immediate
+// and displacement forms where the lowering supports them
+static void selectStatement(Selector *selector, IRInstruction *ir)
+{
+    const char *relation = getBranchRelation(ir);
+    if (relation)
+    {
+        selectBranch(selector, ir, relation);
+        return;
+    }
+
+    SelectionNode *node;
+    if (strcmp(ir->op, "=") == 0 && (node = takePending(selector, ir->arg1)))
+    {
+        // The tree's last tile writes the variable directly
+        label(node);
+        reduce(selector, node, ir->result);
+        return;
+    }
+    if ((strcmp(ir->op, "ARG") == 0 || strcmp(ir->op, "RETURN") == 0) && ir->arg1 &&
+        (node = takePending(selector, ir->arg1)))
+    {
+        label(node);
+        ir->arg1 = isConstantNode(node) ? immediateOperand(node->value) : reduce(selector, node, NULL);
+        append(selector, ir);
+        return;
+    }
+    if (strcmp(ir->op, "STORE") == 0 && !ir->result)
+    {
+        ir->arg1 = reduce(selector, takeLabelled(selector, ir->arg1), NULL);
+        ir->arg2 = reduceAddress(selector, takeLabelled(selector, ir->arg2), &ir->result);
+        append(selector, ir);
+        return;
+    }
+
+    char *uses[2];
+    int useCount = getInstructionUses(ir, uses);
+    for (int i = 0; i < useCount; i++)
+    {
+        if (!(node = takePending(selector, uses[i])))
+            continue;
+        label(node);
+        char *reg = reduce(selector, node, NULL);
+        if (ir->arg1 == uses[i])
+            ir->arg1 = reg;
+        if (ir->arg2 == uses[i])
+            ir->arg2 = reg;
+    }
+    append(selector, ir);
+}
+
+static void freeSelector(Selector *selector)
+{
+    while (selector->nodes)
+    {
+        SelectionNode *next = selector->nodes->allocatedNext;
+        free(selector->nodes);
+        selector->nodes = next;
+    }
+    free(selector->code);
+    free(selector->names);
+    free(selector->nameTable);
+    free(selector->pending);
+}
+
+IRInstruction *selectInstructions(IRInstruction *first, IRInstruction *end)
+{
+    static pthread_once_t rulesParsed = PTHREAD_ONCE_INIT;
+    pthread_once(&rulesParsed, parseRules); // --jobs workers may get here together
+
+    Selector selector;
+    memset(&selector, 0, sizeof(selector));
+    for (IRInstruction *current = first; current != end; current = current->next)
+        selector.count++;
+    selector.code = malloc(sizeof(IRInstruction *) * (selector.count + 1));
+    selector.names = malloc(sizeof(NameInfo) * (3 * selector.count + 1));
+    selector.nameTableSize = 16;
+    while (selector.nameTableSize < 6 * selector.count)
+        selector.nameTableSize *= 2;
+    selector.nameTable = malloc(sizeof(int) * selector.nameTableSize);
+    selector.pending = malloc(sizeof(PendingTree) * (selector.count + 1));
+    if (!selector.code || !selector.names || !selector.nameTable || !selector.pending)
+    {
+        perror("Failed to allocate instruction selector");
+        exit(EXIT_FAILURE);
+    }
+    memset(selector.nameTable, -1, sizeof(int) * selector.nameTableSize);
+
+    int index = 0;
+    for (IRInstruction *current = first; current != end; current = current->next)
+    {
+        selector.code[index] = current;
+        char *uses[2];
+        int useCount = getInstructionUses(current, uses);
+        for (int i = 0; i < useCount; i++)
+        {
+            NameInfo *info = findName(&selector, uses[i], 1);
+            info->uses++;
+            info->useIndex = index;
+        }
+        char *def = getInstructionDefinition(current);
+        if (def)
+            findName(&selector, def, 1)->definitions++;
+        index++;
+    }
+
+    for (index = 0; index < selector.count; index++)
+    {
+        IRInstruction *ir = selector.code[index];
+        int kind = expressionKind(ir);
+        if (kind < 0)
+        {
+            selectStatement(&selector, ir);
+            continue;
+        }
+        SelectionNode *node = buildNode(&selector, ir, kind);
+        if (canFold(&selector, index, node))
+        {
+            selector.pending[selector.pendingCount].name = ir->result;
+            selector.pending[selector.pendingCount].node = node;
+            selector.pendingCount++;
+            continue;
+        }
+        label(node);
+        reduce(&selector, node, ir->result);
+    }
+
+    instructionsIn += selector.count;
+    instructionsOut += selector.emitted;
+    IRInstruction *head = selector.head;
+    if (selector.tail)
+        selector.tail->next = end;
+    freeSelector(&selector);
+    return head ? head : end;
+}
+
+void printSelectionStatistics()
+{
+    for (SelectionRule *rule = rules; rule->name; rule++)
+    {
+        if (rule->hits > 0)
+            printf("SELECT: %s %s %d\n", rule->name, rule->patternText, rule->hits);
+    }
+    printf("SELECT: %d IR instructions in, %d selected\n", instructionsIn, instructionsOut);
+}
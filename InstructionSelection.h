@@ -0,0 +1,18 @@
+#ifndef INSTRUCTION_SELECTION_H
+#define INSTRUCTION_SELECTION_H
+
+#include "IRGeneration.h"
+
+// Tree-pattern instruction selection over the IR of one unit, run before register
+// allocation. Temporaries defined and used once within a basic block are folded
+// into expression trees, the trees are tiled at least cost using the rule table
+// in InstructionSelection.c, and each tile becomes one machine-level IR
+// instruction. Constant operands of the selected instructions are written
+// "#<value>" and lower to immediate forms (addi, slti, sll, lw/sw displacements).
+
+// Rewrites [first, end) in place and returns the new first instruction; the
+// last selected instruction links to end
+IRInstruction *selectInstructions(IRInstruction *first, IRInstruction *end);
+void printSelectionStatistics();
+
+#endif // INSTRUCTION_SELECTION_H
@@ -0,0 +1,150 @@
+#include "LoopUnrolling.h"
+#include <limits.h>
+#include <string.h>
+
+typedef struct BodyScan
+{
+    int inductionAssignments;
+    int assignsBound;
+    int nested; // A loop or declaration, which the body copies must not repeat
+    int calls;
+} BodyScan;
+
+static int isVariable(ASTNode *node, const char *name)
+{
+    return node->type == AST_VARIABLE && strcmp(node->value.strValue, name) == 0;
+}
+
+static int countNodes(ASTNode *node)
+{
+    int count = 1;
+    for (int i = 0; i < node->childCount; i++)
+        count += countNodes(node->children[i]);
+    return count;
+}
+
+static void scanBody(ASTNode *node, const char *induction, const char *bound, BodyScan *scan)
+{
+    switch (node->type)
+    {
+    case AST_ASSIGNMENT:
+        if (isVariable(node->children[0], induction))
+            scan->inductionAssignments++;
+        if (bound && isVariable(node->children[0], bound))
+            scan->assignsBound = 1;
+        break;
+    case AST_WHILE_LOOP:
+    case AST_DECLARATION:
+    case AST_ARRAY_DECLARATION:
+        scan->nested = 1;
+        break;
+    case AST_FUNCTION_CALL:
+        scan->calls = 1;
+        break;
+    default:
+        break;
+    }
+    for (int i = 0; i < node->childCount; i++)
+        scanBody(node->children[i], induction, bound, scan);
+}
+
+// The step of `i = i + c`, `i = c + i` or `i = i - c`, or 0 for anything else
+static int stepOf(ASTNode *statement, const char *name)
+{
+    if (statement->type != AST_ASSIGNMENT || !isVariable(statement->children[0], name))
+        return 0;
+    ASTNode *value = statement->children[1];
+    if (value->type != AST_BINARY_EXPR)
+        return 0;
+    ASTNode *left = value->children[0];
+    ASTNode *right = value->children[1];
+    if (value->value.opType == OP_PLUS && isVariable(left, name) && right->type == AST_LITERAL)
+        return right->value.intValue;
+    if (value->value.opType == OP_PLUS && isVariable(right, name) && left->type == AST_LITERAL)
+        return left->value.intValue;
+    if (value->value.opType == OP_MINUS && isVariable(left, name) && right->type == AST_LITERAL &&
+        right->value.intValue != INT_MIN)
+        return -right->value.intValue;
+    return 0;
+}
+
+static int relationHolds(OperatorType relation, long long left, long long right)
+{
+    switch (relation)
+    {
+    case OP_LESS:
+        return left < right;
+    case OP_LESS_EQUAL:
+        return left <= right;
+    case OP_GREATER:
+        return left > right;
+    default:
+        return left >= right;
+    }
+}
+
+int findCountedLoop(ASTNode *loop, CountedLoop *counted)
+{
+    ASTNode *condition = loop->children[0];
+    ASTNode *body = loop->children[1];
+    if (condition->type != AST_BINARY_EXPR || body->type != AST_BLOCK || body->childCount == 0)
+        return 0;
+    OperatorType relation = condition->value.opType;
+    int upward = relation == OP_LESS || relation == OP_LESS_EQUAL;
+    if (!upward && relation != OP_GREATER && relation != OP_GREATER_EQUAL)
+        return 0;
+
+    ASTNode *induction = condition->children[0];
+    ASTNode *bound = condition->children[1];
+    if (induction->type != AST_VARIABLE || (bound->type != AST_LITERAL && bound->type != AST_VARIABLE))
+        return 0;
+    const char *name = induction->value.strValue;
+    if (isVariable(bound, name))
+        return 0;
+
+    // Stepping away from the bound never ends, or ends by overflowing
+    int step = stepOf(body->children[body->childCount - 1], name);
+    if (upward ? step <= 0 : step >= 0)
+        return 0;
+
+    BodyScan scan = {0};
+    scanBody(body, name, bound->type == AST_VARIABLE ? bound->value.strValue : NULL, &scan);
+    if (scan.inductionAssignments != 1 || scan.assignsBound || scan.nested)
+        return 0;
+
+    counted->induction = induction;
+    counted->bound = bound;
+    counted->relation = relation;
+    counted->step = step;
+    counted->bodySize = countNodes(body);
+    counted->hasCalls = scan.calls;
+    return 1;
+}
+
+int constantTripCount(CountedLoop *counted, int start)
+{
+    if (counted->bound->type != AST_LITERAL)
+        return -1;
+    long long value = start;
+    for (int trips = 0; trips <= MAX_FULL_UNROLL && trips * counted->bodySize <= UNROLL_BUDGET; trips++)
+    {
+        if (!relationHolds(counted->relation, value, counted->bound->value.intValue))
+            return trips;
+        value += counted->step;
+        if (value < INT_MIN || value > INT_MAX)
+            return -1;
+    }
+    return -1;
+}
+
+int unrollFactor(CountedLoop *counted, int requested)
+{
+    int factor = requested;
+    while (factor > 1 && factor * counted->bodySize > UNROLL_BUDGET)
+        factor--;
+    // The unrolled test compares against the bound less (factor - 1) steps
+    long long distance = (long long)(factor - 1) * counted->step;
+    if (distance > INT_MAX / 2 || distance < INT_MIN / 2)
+        return 1;
+    return factor;
+}
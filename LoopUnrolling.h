@@ -0,0 +1,40 @@
+#ifndef LOOP_UNROLLING_H
+#define LOOP_UNROLLING_H
+
+#include "AST.h"
+
+// Recognizes counted while loops in the AST for IR generation to unroll:
+//     while (i < bound) { ...; i = i + step; }
+// where the relation is <, <=, > or >=, step is a literal moving i toward bound,
+// that final assignment is the only one to i, bound is a literal or a variable
+// the body never assigns, and the body holds no loop or declaration of its own.
+// Every iteration then runs its test with i one step further, so k iterations
+// can be checked at once and run without tests in between.
+
+// AST nodes of all body copies an unrolled loop may generate; bounds code size
+#define UNROLL_BUDGET 128
+// Iterations a loop with a constant trip count may be flattened into
+#define MAX_FULL_UNROLL 16
+
+typedef struct CountedLoop
+{
+    ASTNode *induction; // The variable in the condition
+    ASTNode *bound;     // Literal or loop-invariant variable
+    OperatorType relation;
+    int step;     // Signed, toward the bound
+    int bodySize; // AST nodes in the body
+    int hasCalls; // A call could change a global induction variable or bound
+} CountedLoop;
+
+// Fills counted and returns 1 when loop has the shape above
+int findCountedLoop(ASTNode *loop, CountedLoop *counted);
+
+// Iterations the loop runs when i starts at start and the bound is a literal,
+// or -1 when that is more than MAX_FULL_UNROLL or i would overflow first
+int constantTripCount(CountedLoop *counted, int start);
+
+// Copies of the body per unrolled iteration: at most requested, within
+// UNROLL_BUDGET; 1 when the loop should stay as it is
+int unrollFactor(CountedLoop *counted, int requested);
+
+#endif // LOOP_UNROLLING_H
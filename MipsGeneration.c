@@ -1,187 +1,1106 @@
 #include "MipsGeneration.h"
+#include "Peephole.h"
+#include "InstructionSelection.h"
+#include "DataLayout.h"
+#include "RangeAnalysis.h"
+#include "Options.h"
+#include "ObjectEmitter.h"
+#include "MipsSimulator.h"
+#include "CompilerStats.h"
+#include "Profile.h"
+#include "ThreadPool.h"
+#include "FunctionCache.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_REGISTERS 10
+// The state of translating one unit is per thread, since --jobs translates
+// several at once
 
-char *registers[MAX_REGISTERS] = {"$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7", "$t8", "$t9"};
-int registerUsed[MAX_REGISTERS] = {0}; // Array to track whether a register is in use
+// Allocation for the unit being translated; set up by translateUnit
+static _Thread_local RegisterAllocation *currentAllocation = NULL;
+// Spilled value each scratch register of each class currently holds, so
+// back-to-back uses reload once
+static _Thread_local LiveInterval *scratchContents[REGISTER_CLASS_COUNT][SCRATCH_REGISTER_COUNT];
+static _Thread_local int scratchRegisterNumbers[REGISTER_CLASS_COUNT][SCRATCH_REGISTER_COUNT];
 
-int getAvailableRegister()
+// o32 frame of the unit being translated, addressed from $sp with no frame pointer:
+//   size-4            saved $ra (non-leaf units)
+//   saveBase..        saved $s, then $f, registers the unit uses
+//   arrayBase..       arrays the unit declares
+//   spillBase..       spill slots
+//   0..spillBase      outgoing argument area, at least the four o32 home slots
+// Incoming stack arguments sit just above it, at size + 4 * index.
+typedef struct StackFrame
 {
-    for (int i = 0; i < MAX_REGISTERS; i++)
+    int size;
+    int spillBase;
+    int arrayBase;
+    int saveBase;
+    int savesReturnAddress;
+} StackFrame;
+
+static _Thread_local StackFrame frame;
+static _Thread_local FrameArrays frameArrays;
+// The RETURN after a call translated as a tail jump, which leaves nothing for it to do
+static _Thread_local IRInstruction *tailCallReturn = NULL;
+
+const char *mapTempToReg(const char *temp)
+{
+    LiveInterval *interval = findInterval(currentAllocation, temp);
+    if (!interval)
     {
-        if (!registerUsed[i])
+        fprintf(stderr, "Error: No register allocated for %s\n", temp);
+        exit(EXIT_FAILURE);
+    }
+    return interval->reg; // NULL when the value lives in a spill slot
+}
+
+// Register number assigned to temp, or -1 when it is spilled
+static int registerOf(const char *temp)
+{
+    const char *reg = mapTempToReg(temp);
+    return reg ? mipsRegisterNumber(reg) : -1;
+}
+
+static int isFloatValue(const char *temp)
+{
+    mapTempToReg(temp); // Reports values the allocator never saw
+    return findInterval(currentAllocation, temp)->registerClass == REGISTER_CLASS_FLOAT;
+}
+
+static void forgetScratchContents()
+{
+    for (int c = 0; c < REGISTER_CLASS_COUNT; c++)
+    {
+        for (int i = 0; i < SCRATCH_REGISTER_COUNT; i++)
         {
-            registerUsed[i] = 1; // Mark the register as used
-            return i;
+            scratchContents[c][i] = NULL;
+            scratchRegisterNumbers[c][i] = mipsRegisterNumber(scratchRegisters[c][i]);
         }
     }
-    fprintf(stderr, "Out of registers\n");
-    exit(1); // Ideally, implement spill code instead of exiting
 }
 
-char *mapTempToReg(char *temp)
+// Returns a register holding the value of temp, reloading it into a scratch register if spilled
+static int readOperand(const char *temp, int scratch, MipsList *list)
+{
+    int reg = registerOf(temp);
+    if (reg >= 0)
+        return reg;
+
+    LiveInterval *interval = findInterval(currentAllocation, temp);
+    RegisterClass class = interval->registerClass;
+    for (int i = 0; i < SCRATCH_REGISTER_COUNT; i++)
+    {
+        if (scratchContents[class][i] == interval)
+            return scratchRegisterNumbers[class][i];
+    }
+    emitMips(list, class == REGISTER_CLASS_FLOAT ? "lwc1" : "lw", mipsRegister(scratchRegisterNumbers[class][scratch]),
+             mipsMemory(frame.spillBase + 4 * interval->spillSlot, MIPS_REG_SP), NO_OPERAND);
+    scratchContents[class][scratch] = interval;
+    compilerStats.spillReloads++;
+    return scratchRegisterNumbers[class][scratch];
+}
+
+// The MSA register holding a vector; the vectorizer keeps loops within the
+// vector registers, so none is ever spilled
+static int vectorRegister(const char *temp)
+{
+    int reg = registerOf(temp);
+    if (reg < 0)
+    {
+        fprintf(stderr, "Error: Vector %s was spilled\n", temp);
+        exit(EXIT_FAILURE);
+    }
+    return reg;
+}
+
+// Picks the scratch register for a second operand so it cannot evict the first
+static int scratchAvoiding(int reg)
+{
+    return reg == scratchRegisterNumbers[REGISTER_CLASS_INT][1] || reg == scratchRegisterNumbers[REGISTER_CLASS_FLOAT][1] ? 0 : 1;
+}
+
+// Returns the register an instruction should write temp into
+static int resultRegister(const char *temp, int scratch)
+{
+    int reg = registerOf(temp);
+    return reg >= 0 ? reg : scratchRegisterNumbers[findInterval(currentAllocation, temp)->registerClass][scratch];
+}
+
+// Stores a freshly written spilled value back to its slot
+static void commitResult(const char *temp, int reg, MipsList *list)
+{
+    LiveInterval *interval = findInterval(currentAllocation, temp);
+    if (interval->reg)
+        return;
+
+    RegisterClass class = interval->registerClass;
+    emitMips(list, class == REGISTER_CLASS_FLOAT ? "swc1" : "sw", mipsRegister(reg),
+             mipsMemory(frame.spillBase + 4 * interval->spillSlot, MIPS_REG_SP), NO_OPERAND);
+    compilerStats.spillStores++;
+    for (int i = 0; i < SCRATCH_REGISTER_COUNT; i++)
+    {
+        if (scratchContents[class][i] == interval)
+            scratchContents[class][i] = NULL;
+        if (scratchRegisterNumbers[class][i] == reg)
+            scratchContents[class][i] = interval;
+    }
+}
+
+// Sizes the frame from the allocation and the unit's arrays; a leaf that spills
+// nothing, declares no array and uses no $s register gets no frame at all
+static void layOutFrame()
 {
-    static char tempToRegMap[100][10]; // Assuming a maximum of 100 temporaries
-    static int tempCount = 0;
+    RegisterAllocation *allocation = currentAllocation;
+    int outgoing = 0;
+    if (!allocation->isLeaf)
+        outgoing = 4 * (allocation->maxCallArguments > 4 ? allocation->maxCallArguments : 4);
+
+    int savedCount = __builtin_popcount(allocation->calleeSavedUsed) + __builtin_popcount(allocation->floatCalleeSavedUsed);
+    frame.savesReturnAddress = !allocation->isLeaf;
+    frame.spillBase = outgoing;
+    frame.arrayBase = outgoing + 4 * allocation->spillSlotCount;
+    frame.saveBase = frame.arrayBase + frameArrays.bytes;
+    frame.size = frame.saveBase + 4 * (savedCount + frame.savesReturnAddress);
+    frame.size = (frame.size + 7) & ~7; // $sp stays doubleword aligned
+}
 
-    // Check if this temporary has already been mapped to a register
-    for (int i = 0; i < tempCount; i++)
+// Emits a save or restore of every register the frame preserves
+static void saveOrRestoreRegisters(MipsList *list, int restore)
+{
+    int offset = frame.saveBase;
+    for (int r = 0; r < 8; r++)
     {
-        if (strcmp(tempToRegMap[i], temp) == 0)
+        if (currentAllocation->calleeSavedUsed & (1u << r))
         {
-            return strdup(registers[i % MAX_REGISTERS]);
+            emitMips(list, restore ? "lw" : "sw", mipsRegister(mipsRegisterNumber("$s0") + r), mipsMemory(offset, MIPS_REG_SP), NO_OPERAND);
+            offset += 4;
         }
     }
+    for (int r = 0; r < 6; r++)
+    {
+        if (currentAllocation->floatCalleeSavedUsed & (1u << r))
+        {
+            emitMips(list, restore ? "lwc1" : "swc1", mipsRegister(MIPS_REG_F0 + 20 + 2 * r), mipsMemory(offset, MIPS_REG_SP), NO_OPERAND);
+            offset += 4;
+        }
+    }
+    if (frame.savesReturnAddress)
+        emitMips(list, restore ? "lw" : "sw", mipsRegister(MIPS_REG_RA), mipsMemory(frame.size - 4, MIPS_REG_SP), NO_OPERAND);
+}
+
+static void emitPrologue(MipsList *list)
+{
+    if (frame.size > 0)
+        emitMips(list, "addiu", mipsRegister(MIPS_REG_SP), mipsRegister(MIPS_REG_SP), mipsImmediate(-frame.size));
+    saveOrRestoreRegisters(list, 0);
+}
 
-    // Assign a new register to this temporary
-    int regIndex = getAvailableRegister();
-    if (tempCount < 100)
+static void emitReturn(MipsList *list)
+{
+    saveOrRestoreRegisters(list, 1);
+    if (frame.size > 0)
+        emitMips(list, "addiu", mipsRegister(MIPS_REG_SP), mipsRegister(MIPS_REG_SP), mipsImmediate(frame.size));
+    emitMips(list, "jr", mipsRegister(MIPS_REG_RA), NO_OPERAND, NO_OPERAND);
+}
+
+// A call whose value the next instruction returns unchanged: the callee can return
+// straight to our caller, in $v0 either way. Arguments past the fourth would go in
+// our caller's outgoing area, which is sized for our own call, so those calls stay.
+static int isTailCall(IRInstruction *ir)
+{
+    IRInstruction *next = ir->next;
+    return compilerOptions.tailCalls && atoi(ir->arg2) <= 4 && next && strcmp(next->op, "RETURN") == 0 &&
+           next->arg1 && strcmp(next->arg1, ir->result) == 0;
+}
+
+// Restores what the prologue saved, $ra included, drops the frame and jumps; the
+// arguments are already in $a0-$a3
+static void emitTailJump(IRInstruction *call, MipsList *list)
+{
+    saveOrRestoreRegisters(list, 1);
+    if (frame.size > 0)
+        emitMips(list, "addiu", mipsRegister(MIPS_REG_SP), mipsRegister(MIPS_REG_SP), mipsImmediate(frame.size));
+    emitMips(list, "j", mipsLabelOperand(call->arg1), NO_OPERAND, NO_OPERAND);
+    tailCallReturn = call->next;
+    fprintf(diagnostics(), "TAIL: call to %s jumps with the caller's frame released\n", call->arg1);
+}
+
+// Emits a three-register arithmetic instruction, or its immediate form when
+// instruction selection left a constant second operand
+static void translateBinary(IRInstruction *ir, const char *mnemonic, const char *immediateMnemonic, MipsList *list)
+{
+    int mipsReg1 = readOperand(ir->arg1, 0, list);
+    MipsOperand operand2;
+    if (isImmediateOperand(ir->arg2))
     {
-        strcpy(tempToRegMap[tempCount], temp);
-        tempCount++;
+        mnemonic = immediateMnemonic;
+        operand2 = mipsImmediate(immediateValue(ir->arg2));
     }
     else
     {
-        fprintf(stderr, "Too many temporaries\n");
-        exit(1);
+        operand2 = mipsRegister(readOperand(ir->arg2, scratchAvoiding(mipsReg1), list));
     }
+    int mipsRegResult = resultRegister(ir->result, 0);
+    emitMips(list, mnemonic, mipsRegister(mipsRegResult), mipsRegister(mipsReg1), operand2);
+    commitResult(ir->result, mipsRegResult, list);
+}
+
+// The memory operand for base (-1 for none) plus a displacement operand left by
+// instruction selection: "#offset", "&symbol+offset" or NULL. Globals are
+// addressed by name; a frame array is an offset from $sp, so a base register is
+// first added to $sp in the given scratch register.
+static MipsOperand memoryOperand(const char *displacement, int base, int scratch, MipsList *list)
+{
+    if (!displacement || displacement[0] != '&')
+        return mipsMemory(displacement ? immediateValue(displacement) : 0, base);
+
+    char symbol[256];
+    size_t length = strcspn(displacement + 1, "+-");
+    snprintf(symbol, sizeof(symbol), "%.*s", (int)length, displacement + 1);
+    int offset = atoi(displacement + 1 + length);
+    FrameArray *array = findFrameArray(&frameArrays, symbol);
+    if (!array)
+        return mipsSymbolMemory(findGlobal(symbol)->name, offset, base < 0 ? MIPS_REG_ZERO : base);
+
+    offset += frame.arrayBase + array->offset;
+    if (base < 0)
+        return mipsMemory(offset, MIPS_REG_SP);
+    int address = scratchRegisterNumbers[REGISTER_CLASS_INT][scratch];
+    scratchContents[REGISTER_CLASS_INT][scratch] = NULL;
+    emitMips(list, "addu", mipsRegister(address), mipsRegister(base), mipsRegister(MIPS_REG_SP));
+    return mipsMemory(offset, address);
+}
+
+// Copies one value into another; coalesced copies share a register and vanish
+static void translateMove(char *source, char *dest, MipsList *list)
+{
+    if (findInterval(currentAllocation, source) == findInterval(currentAllocation, dest))
+        return;
 
-    return strdup(registers[regIndex]);
+    int sourceReg = readOperand(source, 0, list);
+    int destReg = registerOf(dest);
+    if (destReg < 0)
+    {
+        commitResult(dest, sourceReg, list);
+    }
+    else if (destReg != sourceReg)
+    {
+        emitMips(list, isFloatValue(dest) ? "mov.s" : "move", mipsRegister(destReg), mipsRegister(sourceReg), NO_OPERAND);
+    }
 }
 
-void releaseRegister(char *reg)
+// Branches on a comparison without materializing it: one beq/bne, a branch
+// against $zero, or slt into a scratch register followed by beqz/bnez
+static void translateConditionalBranch(IRInstruction *ir, MipsList *list)
 {
-    for (int i = 0; i < MAX_REGISTERS; i++)
+    static const char *zeroBranches[][2] = {{"==", "beqz"}, {"!=", "bnez"}, {"<", "bltz"}, {"<=", "blez"}, {">", "bgtz"}, {">=", "bgez"}};
+    const char *relation = getBranchRelation(ir);
+    MipsOperand target = mipsLabelOperand(getBranchTarget(ir));
+    int left = readOperand(ir->arg1, 0, list);
+
+    if (!ir->arg2)
     {
-        if (strcmp(registers[i], reg) == 0)
+        for (int i = 0; i < 6; i++)
         {
-            registerUsed[i] = 0;
-            return;
+            if (strcmp(zeroBranches[i][0], relation) == 0)
+                emitMips(list, zeroBranches[i][1], mipsRegister(left), target, NO_OPERAND);
         }
+        return;
+    }
+
+    int flag = scratchRegisterNumbers[REGISTER_CLASS_INT][0];
+    if (isImmediateOperand(ir->arg2))
+    {
+        // Selection only leaves immediates on < and >=, which slti tests directly
+        scratchContents[REGISTER_CLASS_INT][0] = NULL;
+        emitMips(list, "slti", mipsRegister(flag), mipsRegister(left), mipsImmediate(immediateValue(ir->arg2)));
+        emitMips(list, relation[0] == '<' ? "bnez" : "beqz", mipsRegister(flag), target, NO_OPERAND);
+        return;
+    }
+
+    int right = readOperand(ir->arg2, scratchAvoiding(left), list);
+    if (strcmp(relation, "==") == 0 || strcmp(relation, "!=") == 0)
+    {
+        emitMips(list, relation[0] == '=' ? "beq" : "bne", mipsRegister(left), mipsRegister(right), target);
+        return;
+    }
+
+    // a < b and a >= b test slt a, b; a > b and a <= b test slt b, a
+    int swapped = relation[0] == '>' ? strcmp(relation, ">=") != 0 : strcmp(relation, "<=") == 0;
+    int whenSet = strcmp(relation, "<") == 0 || strcmp(relation, ">") == 0;
+    scratchContents[REGISTER_CLASS_INT][0] = NULL;
+    emitMips(list, "slt", mipsRegister(flag), mipsRegister(swapped ? right : left), mipsRegister(swapped ? left : right));
+    emitMips(list, whenSet ? "bnez" : "beqz", mipsRegister(flag), target, NO_OPERAND);
+}
+
+// A comparison used as a value produces 0 or 1
+static void translateComparison(IRInstruction *ir, MipsList *list)
+{
+    const char *relation = ir->op;
+    int left = readOperand(ir->arg1, 0, list);
+    int result = resultRegister(ir->result, 0);
+    MipsOperand resultOperand = mipsRegister(result);
+
+    if (isImmediateOperand(ir->arg2))
+    {
+        // < and >= against a 16-bit constant, as instruction selection produces them
+        emitMips(list, "slti", resultOperand, mipsRegister(left), mipsImmediate(immediateValue(ir->arg2)));
+        if (strcmp(relation, ">=") == 0)
+            emitMips(list, "xori", resultOperand, resultOperand, mipsImmediate(1));
+        commitResult(ir->result, result, list);
+        return;
+    }
+
+    int right = readOperand(ir->arg2, scratchAvoiding(left), list);
+    if (strcmp(relation, "==") == 0 || strcmp(relation, "!=") == 0)
+    {
+        emitMips(list, "xor", resultOperand, mipsRegister(left), mipsRegister(right));
+        if (relation[0] == '=')
+            emitMips(list, "sltiu", resultOperand, resultOperand, mipsImmediate(1));
+        else
+            emitMips(list, "sltu", resultOperand, mipsRegister(MIPS_REG_ZERO), resultOperand);
+    }
+    else
+    {
+        int swapped = strcmp(relation, ">") == 0 || strcmp(relation, "<=") == 0;
+        emitMips(list, "slt", resultOperand, mipsRegister(swapped ? right : left), mipsRegister(swapped ? left : right));
+        if (strcmp(relation, "<=") == 0 || strcmp(relation, ">=") == 0)
+            emitMips(list, "xori", resultOperand, resultOperand, mipsImmediate(1));
+    }
+    commitResult(ir->result, result, list);
+}
+
+// Single-precision arithmetic on coprocessor 1 registers
+static void translateFloatBinary(IRInstruction *ir, MipsList *list)
+{
+    static const char *mnemonics[][2] = {{"FADD", "add.s"}, {"FSUB", "sub.s"}, {"FMUL", "mul.s"}, {"FDIV", "div.s"}};
+    const char *mnemonic = NULL;
+    for (int i = 0; i < 4; i++)
+    {
+        if (strcmp(mnemonics[i][0], ir->op) == 0)
+            mnemonic = mnemonics[i][1];
     }
+    int left = readOperand(ir->arg1, 0, list);
+    int right = readOperand(ir->arg2, scratchAvoiding(left), list);
+    int result = resultRegister(ir->result, 0);
+    emitMips(list, mnemonic, mipsRegister(result), mipsRegister(left), mipsRegister(right));
+    commitResult(ir->result, result, list);
+}
+
+// A float comparison produces 0 or 1 without branching: c.<cond>.s sets the
+// FPU condition flag, and a conditional move clears a preloaded 1 on the
+// outcome that means false. > and >= test < and <= with the operands swapped.
+static void translateFloatComparison(IRInstruction *ir, MipsList *list)
+{
+    static const struct
+    {
+        const char *op;
+        const char *compare;
+        int swapped;
+        const char *clear; // movf clears when the flag is false, movt when it is true
+    } comparisons[] = {{"FLT", "c.lt.s", 0, "movf"}, {"FLE", "c.le.s", 0, "movf"}, {"FGT", "c.lt.s", 1, "movf"},
+                       {"FGE", "c.le.s", 1, "movf"}, {"FEQ", "c.eq.s", 0, "movf"}, {"FNE", "c.eq.s", 0, "movt"}};
+    int c = 0;
+    while (strcmp(comparisons[c].op, ir->op) != 0)
+        c++;
+    int left = readOperand(ir->arg1, 0, list);
+    int right = readOperand(ir->arg2, scratchAvoiding(left), list);
+    int result = resultRegister(ir->result, 0);
+    emitMips(list, "li", mipsRegister(result), mipsImmediate(1), NO_OPERAND);
+    emitMips(list, comparisons[c].compare, mipsRegister(comparisons[c].swapped ? right : left),
+             mipsRegister(comparisons[c].swapped ? left : right), NO_OPERAND);
+    emitMips(list, comparisons[c].clear, mipsRegister(result), mipsRegister(MIPS_REG_ZERO), mipsRegister(MIPS_REG_FCC));
+    commitResult(ir->result, result, list);
+}
+
+// Conversions between the register files: cvt.s.w and trunc.w.s only work on
+// $f registers, so ints cross with mtc1 and mfc1. Float to int truncates, as C does.
+static void translateConversion(IRInstruction *ir, MipsList *list)
+{
+    int source = readOperand(ir->arg1, 0, list);
+    int result = resultRegister(ir->result, 0);
+    if (strcmp(ir->op, "ITOF") == 0)
+    {
+        emitMips(list, "mtc1", mipsRegister(source), mipsRegister(result), NO_OPERAND);
+        emitMips(list, "cvt.s.w", mipsRegister(result), mipsRegister(result), NO_OPERAND);
+    }
+    else
+    {
+        int scratch = scratchAvoiding(source);
+        int truncated = scratchRegisterNumbers[REGISTER_CLASS_FLOAT][scratch];
+        scratchContents[REGISTER_CLASS_FLOAT][scratch] = NULL;
+        emitMips(list, "trunc.w.s", mipsRegister(truncated), mipsRegister(source), NO_OPERAND);
+        emitMips(list, "mfc1", mipsRegister(result), mipsRegister(truncated), NO_OPERAND);
+    }
+    commitResult(ir->result, result, list);
 }
 
 // Translate a single IR instruction to MIPS
-void translateIRInstruction(IRInstruction *ir, FILE *outFile)
+void translateIRInstruction(IRInstruction *ir, MipsList *list)
 {
     if (ir == NULL)
     {
         fprintf(stderr, "Error: NULL IR instruction passed to translateIRInstruction.\n");
         return;
     }
-    if (outFile == NULL)
+    if (list == NULL)
     {
-        fprintf(stderr, "Error: NULL outFile passed to translateIRInstruction.\n");
+        fprintf(stderr, "Error: NULL instruction list passed to translateIRInstruction.\n");
         return;
     }
 
-    char *mipsReg1, *mipsReg2, *mipsRegResult;
+    int mipsReg1, mipsReg2, mipsRegResult;
 
     if (strcmp(ir->op, "+") == 0)
     {
-        mipsReg1 = mapTempToReg(ir->arg1);
-        mipsReg2 = mapTempToReg(ir->arg2);
-        mipsRegResult = mapTempToReg(ir->result);
-        fprintf(outFile, "add %s, %s, %s\n", mipsRegResult, mipsReg1, mipsReg2);
+        translateBinary(ir, "add", "addi", list);
     }
     else if (strcmp(ir->op, "-") == 0)
     {
-        mipsReg1 = mapTempToReg(ir->arg1);
-        mipsReg2 = mapTempToReg(ir->arg2);
-        mipsRegResult = mapTempToReg(ir->result);
-        fprintf(outFile, "sub %s, %s, %s\n", mipsRegResult, mipsReg1, mipsReg2);
+        translateBinary(ir, "sub", NULL, list);
     }
     else if (strcmp(ir->op, "*") == 0)
     {
-        mipsReg1 = mapTempToReg(ir->arg1);
-        mipsReg2 = mapTempToReg(ir->arg2);
-        mipsRegResult = mapTempToReg(ir->result);
-        fprintf(outFile, "mul %s, %s, %s\n", mipsRegResult, mipsReg1, mipsReg2);
+        translateBinary(ir, "mul", NULL, list);
+    }
+    else if (strcmp(ir->op, "<<") == 0)
+    {
+        translateBinary(ir, "sllv", "sll", list);
     }
     else if (strcmp(ir->op, "/") == 0)
     {
-        mipsReg1 = mapTempToReg(ir->arg1);
-        mipsReg2 = mapTempToReg(ir->arg2);
-        mipsRegResult = mapTempToReg(ir->result);
-        fprintf(outFile, "div %s, %s\n", mipsReg1, mipsReg2);
-        fprintf(outFile, "mflo %s\n", mipsRegResult);
+        mipsReg1 = readOperand(ir->arg1, 0, list);
+        mipsReg2 = readOperand(ir->arg2, scratchAvoiding(mipsReg1), list);
+        mipsRegResult = resultRegister(ir->result, 0);
+        emitMips(list, "div", mipsRegister(mipsReg1), mipsRegister(mipsReg2), NO_OPERAND);
+        emitMips(list, "mflo", mipsRegister(mipsRegResult), NO_OPERAND, NO_OPERAND);
+        commitResult(ir->result, mipsRegResult, list);
+    }
+    else if (isBinaryOperator(ir->op))
+    {
+        translateComparison(ir, list);
+    }
+    else if (isFloatOperator(ir->op) && writesFloat(ir))
+    {
+        translateFloatBinary(ir, list);
+    }
+    else if (isFloatOperator(ir->op))
+    {
+        translateFloatComparison(ir, list);
+    }
+    else if (strcmp(ir->op, "ITOF") == 0 || strcmp(ir->op, "FTOI") == 0)
+    {
+        translateConversion(ir, list);
+    }
+    else if (strcmp(ir->op, "FMOV") == 0)
+    {
+        // arg1 names the literal's constant pool entry
+        mipsRegResult = resultRegister(ir->result, 0);
+        emitMips(list, "lwc1", mipsRegister(mipsRegResult), mipsSymbolMemory(ir->arg1, 0, MIPS_REG_ZERO), NO_OPERAND);
+        commitResult(ir->result, mipsRegResult, list);
+    }
+    else if (strcmp(ir->op, "FNEG") == 0)
+    {
+        mipsReg1 = readOperand(ir->arg1, 0, list);
+        mipsRegResult = resultRegister(ir->result, 0);
+        emitMips(list, "neg.s", mipsRegister(mipsRegResult), mipsRegister(mipsReg1), NO_OPERAND);
+        commitResult(ir->result, mipsRegResult, list);
+    }
+    else if (isVectorOperator(ir->op))
+    {
+        static const char *operators[][2] = {{"VADD", "addv.w"},  {"VSUB", "subv.w"},  {"VMUL", "mulv.w"},
+                                             {"VFADD", "fadd.w"}, {"VFSUB", "fsub.w"}, {"VFMUL", "fmul.w"},
+                                             {"VFDIV", "fdiv.w"}};
+        int o = 0;
+        while (strcmp(operators[o][0], ir->op) != 0)
+            o++;
+        emitMips(list, operators[o][1], mipsRegister(vectorRegister(ir->result)), mipsRegister(vectorRegister(ir->arg1)),
+                 mipsRegister(vectorRegister(ir->arg2)));
+    }
+    else if (strcmp(ir->op, "VLOAD") == 0)
+    {
+        mipsReg1 = readOperand(ir->arg1, 0, list);
+        emitMips(list, "ld.w", mipsRegister(vectorRegister(ir->result)), mipsMemory(0, mipsReg1), NO_OPERAND);
+    }
+    else if (strcmp(ir->op, "VSTORE") == 0)
+    {
+        mipsReg2 = readOperand(ir->arg2, 0, list);
+        emitMips(list, "st.w", mipsRegister(vectorRegister(ir->arg1)), mipsMemory(0, mipsReg2), NO_OPERAND);
+    }
+    else if (strcmp(ir->op, "VFILL") == 0)
+    {
+        mipsReg1 = readOperand(ir->arg1, 0, list);
+        emitMips(list, "fill.w", mipsRegister(vectorRegister(ir->result)), mipsRegister(mipsReg1), NO_OPERAND);
+    }
+    else if (strcmp(ir->op, "VFFILL") == 0)
+    {
+        // fill.w takes a general register, so the float's bits go through $t8
+        mipsReg1 = readOperand(ir->arg1, 0, list);
+        int bits = scratchRegisterNumbers[REGISTER_CLASS_INT][0];
+        scratchContents[REGISTER_CLASS_INT][0] = NULL;
+        emitMips(list, "mfc1", mipsRegister(bits), mipsRegister(mipsReg1), NO_OPERAND);
+        emitMips(list, "fill.w", mipsRegister(vectorRegister(ir->result)), mipsRegister(bits), NO_OPERAND);
     }
     else if (strcmp(ir->op, "MOV") == 0)
     {
-        mipsRegResult = mapTempToReg(ir->result);
-        fprintf(outFile, "li %s, %s\n", mipsRegResult, ir->arg1);
+        mipsRegResult = resultRegister(ir->result, 0);
+        emitMips(list, "li", mipsRegister(mipsRegResult), mipsImmediate(atoi(ir->arg1)), NO_OPERAND);
+        commitResult(ir->result, mipsRegResult, list);
     }
-    else if (strcmp(ir->op, "LOAD") == 0)
+    else if (strcmp(ir->op, "LOAD") == 0 || strcmp(ir->op, "=") == 0)
     {
-        mipsRegResult = mapTempToReg(ir->result);
-        fprintf(outFile, "lw %s, 0(%s)\n", mipsRegResult, mapTempToReg(ir->arg1));
+        // Variables are register allocated like temporaries, so both are copies
+        translateMove(ir->arg1, ir->result, list);
     }
     else if (strcmp(ir->op, "STORE") == 0)
     {
-        mipsReg1 = mapTempToReg(ir->arg1);
-        fprintf(outFile, "sw %s, 0(%s)\n", mipsReg1, mapTempToReg(ir->arg2));
+        // Stores arg1 at the address in arg2, plus the displacement selection may put in result
+        mipsReg1 = readOperand(ir->arg1, 0, list);
+        mipsReg2 = ir->arg2 ? readOperand(ir->arg2, scratchAvoiding(mipsReg1), list) : -1;
+        MipsOperand address = memoryOperand(ir->result, mipsReg2, scratchAvoiding(mipsReg1), list);
+        emitMips(list, isFloatValue(ir->arg1) ? "swc1" : "sw", mipsRegister(mipsReg1), address, NO_OPERAND);
+    }
+    else if (strcmp(ir->op, "LOADMEM") == 0)
+    {
+        mipsReg1 = ir->arg1 ? readOperand(ir->arg1, 0, list) : -1;
+        MipsOperand address = memoryOperand(ir->arg2, mipsReg1, 0, list);
+        mipsRegResult = resultRegister(ir->result, 0);
+        emitMips(list, isFloatValue(ir->result) ? "lwc1" : "lw", mipsRegister(mipsRegResult), address, NO_OPERAND);
+        commitResult(ir->result, mipsRegResult, list);
+    }
+    else if (strcmp(ir->op, "ADDR") == 0)
+    {
+        FrameArray *array = findFrameArray(&frameArrays, ir->arg1);
+        mipsRegResult = resultRegister(ir->result, 0);
+        if (array)
+            emitMips(list, "addiu", mipsRegister(mipsRegResult), mipsRegister(MIPS_REG_SP),
+                     mipsImmediate(frame.arrayBase + array->offset));
+        else
+            emitMips(list, "la", mipsRegister(mipsRegResult), mipsLabelOperand(findGlobal(ir->arg1)->name), NO_OPERAND);
+        commitResult(ir->result, mipsRegResult, list);
+    }
+    else if (strcmp(ir->op, "COUNT") == 0)
+    {
+        // Profiling counter arg1 of the instrumented build, bumped in memory
+        int counter = scratchRegisterNumbers[REGISTER_CLASS_INT][0];
+        MipsOperand slot = mipsSymbolMemory(findGlobal(PROFILE_COUNTERS)->name, 4 * atoi(ir->arg1), MIPS_REG_ZERO);
+        scratchContents[REGISTER_CLASS_INT][0] = NULL;
+        emitMips(list, "lw", mipsRegister(counter), slot, NO_OPERAND);
+        emitMips(list, "addiu", mipsRegister(counter), mipsRegister(counter), mipsImmediate(1));
+        emitMips(list, "sw", mipsRegister(counter), slot, NO_OPERAND);
+    }
+    else if (strcmp(ir->op, "CHECK_BOUNDS") == 0)
+    {
+        // One unsigned compare catches negative indexes too; it traps when out of range
+        mipsReg1 = readOperand(ir->arg1, 0, list);
+        int size = immediateValue(ir->arg2);
+        if (size <= 32767)
+        {
+            emitMips(list, "tgeiu", mipsRegister(mipsReg1), mipsImmediate(size), NO_OPERAND);
+        }
+        else
+        {
+            int limit = scratchAvoiding(mipsReg1);
+            int limitReg = scratchRegisterNumbers[REGISTER_CLASS_INT][limit];
+            scratchContents[REGISTER_CLASS_INT][limit] = NULL;
+            emitMips(list, "li", mipsRegister(limitReg), mipsImmediate(size), NO_OPERAND);
+            emitMips(list, "tgeu", mipsRegister(mipsReg1), mipsRegister(limitReg), NO_OPERAND);
+        }
+    }
+    else if (strcmp(ir->op, "NEG") == 0 || strcmp(ir->op, "NOT") == 0)
+    {
+        mipsReg1 = readOperand(ir->arg1, 0, list);
+        mipsRegResult = resultRegister(ir->result, 0);
+        if (strcmp(ir->op, "NEG") == 0)
+            emitMips(list, "sub", mipsRegister(mipsRegResult), mipsRegister(MIPS_REG_ZERO), mipsRegister(mipsReg1));
+        else
+            emitMips(list, "sltiu", mipsRegister(mipsRegResult), mipsRegister(mipsReg1), mipsImmediate(1));
+        commitResult(ir->result, mipsRegResult, list);
+    }
+    else if (strcmp(ir->op, "FUNCTION") == 0)
+    {
+        emitMipsLabel(list, ir->result);
+        emitPrologue(list);
+    }
+    else if (strcmp(ir->op, "PARAM") == 0)
+    {
+        int index = atoi(ir->arg1);
+        if (index < 4 && isFloatValue(ir->result))
+        {
+            // Floats are passed in the integer argument registers too
+            mipsRegResult = resultRegister(ir->result, 0);
+            emitMips(list, "mtc1", mipsRegister(MIPS_REG_A0 + index), mipsRegister(mipsRegResult), NO_OPERAND);
+            commitResult(ir->result, mipsRegResult, list);
+        }
+        else if (index < 4)
+        {
+            // Arrives in $a<index>; in a leaf it is usually allocated there already
+            int argumentReg = MIPS_REG_A0 + index;
+            mipsRegResult = registerOf(ir->result);
+            if (mipsRegResult < 0)
+                commitResult(ir->result, argumentReg, list);
+            else if (mipsRegResult != argumentReg)
+                emitMips(list, "move", mipsRegister(mipsRegResult), mipsRegister(argumentReg), NO_OPERAND);
+        }
+        else
+        {
+            mipsRegResult = resultRegister(ir->result, 0);
+            emitMips(list, isFloatValue(ir->result) ? "lwc1" : "lw", mipsRegister(mipsRegResult),
+                     mipsMemory(frame.size + 4 * index, MIPS_REG_SP), NO_OPERAND);
+            commitResult(ir->result, mipsRegResult, list);
+        }
+    }
+    else if (strcmp(ir->op, "ARG") == 0)
+    {
+        int index = atoi(ir->arg2);
+        if (isImmediateOperand(ir->arg1) && index < 4)
+        {
+            emitMips(list, "li", mipsRegister(MIPS_REG_A0 + index), mipsImmediate(immediateValue(ir->arg1)), NO_OPERAND);
+            return;
+        }
+        if (isImmediateOperand(ir->arg1))
+        {
+            mipsReg1 = scratchRegisterNumbers[REGISTER_CLASS_INT][0];
+            scratchContents[REGISTER_CLASS_INT][0] = NULL;
+            emitMips(list, "li", mipsRegister(mipsReg1), mipsImmediate(immediateValue(ir->arg1)), NO_OPERAND);
+        }
+        else
+        {
+            mipsReg1 = readOperand(ir->arg1, 0, list);
+        }
+        int isFloat = !isImmediateOperand(ir->arg1) && isFloatValue(ir->arg1);
+        if (index < 4)
+            emitMips(list, isFloat ? "mfc1" : "move", mipsRegister(MIPS_REG_A0 + index), mipsRegister(mipsReg1), NO_OPERAND);
+        else
+            emitMips(list, isFloat ? "swc1" : "sw", mipsRegister(mipsReg1), mipsMemory(4 * index, MIPS_REG_SP), NO_OPERAND);
+    }
+    else if (strcmp(ir->op, "LABEL") == 0)
+    {
+        emitMipsLabel(list, getLabelName(ir));
+        forgetScratchContents(); // Control can arrive here from elsewhere
+    }
+    else if (getBranchRelation(ir))
+    {
+        translateConditionalBranch(ir, list);
+    }
+    else if (strcmp(ir->op, "GOTO") == 0)
+    {
+        emitMips(list, "b", mipsLabelOperand(getBranchTarget(ir)), NO_OPERAND, NO_OPERAND); // Branch to label
     }
-    else if (strcmp(ir->op, "IFGOTO") == 0 || strcmp(ir->op, "GOTO") == 0)
+    else if (strcmp(ir->op, "CALL") == 0 && isTailCall(ir))
     {
-        fprintf(outFile, "b %s\n", ir->result); // Branch to label
+        emitTailJump(ir, list);
     }
     else if (strcmp(ir->op, "CALL") == 0)
     {
-        fprintf(outFile, "jal %s\n", ir->arg1); // Jump and link to function
+        emitMips(list, "jal", mipsLabelOperand(ir->arg1), NO_OPERAND, NO_OPERAND); // Jump and link to function
+        forgetScratchContents();                                                   // Scratch registers are caller-saved
+        mipsRegResult = resultRegister(ir->result, 0);
+        if (isFloatValue(ir->result))
+            emitMips(list, "mtc1", mipsRegister(MIPS_REG_V0), mipsRegister(mipsRegResult), NO_OPERAND); // Floats come back in $v0 too
+        else
+            emitMips(list, "move", mipsRegister(mipsRegResult), mipsRegister(MIPS_REG_V0), NO_OPERAND);
+        commitResult(ir->result, mipsRegResult, list);
     }
-    else if (strcmp(ir->op, "RETURN") == 0)
+    else if (strcmp(ir->op, "RETURN") == 0 && ir != tailCallReturn)
     {
-        if (ir->arg1 != NULL)
+        if (isImmediateOperand(ir->arg1))
         {
-            fprintf(outFile, "move $v0, %s\n", mapTempToReg(ir->arg1)); // Move return value to $v0
+            emitMips(list, "li", mipsRegister(MIPS_REG_V0), mipsImmediate(immediateValue(ir->arg1)), NO_OPERAND);
         }
-        fprintf(outFile, "jr $ra\n"); // Jump back to return address
+        else if (ir->arg1 != NULL)
+        {
+            mipsReg1 = readOperand(ir->arg1, 0, list);
+            emitMips(list, isFloatValue(ir->arg1) ? "mfc1" : "move", mipsRegister(MIPS_REG_V0), mipsRegister(mipsReg1), NO_OPERAND); // Move return value to $v0
+        }
+        emitReturn(list); // Restore saved registers and jump back to the return address
+    }
+}
+
+// Checks, selects, allocates, lays out and translates one function: the IR in [first, end)
+// Returns the unit's first instruction, which instruction selection may replace
+static IRInstruction *translateUnit(IRInstruction *first, IRInstruction *end, MipsList *list)
+{
+    if (compilerOptions.eliminateChecks)
+    {
+        enterPhase(PHASE_BOUNDS_CHECKS);
+        eliminateBoundsChecks(first, end);
+        leavePhase();
+    }
+    if (compilerOptions.selectInstructions)
+    {
+        enterPhase(PHASE_SELECT);
+        first = selectInstructions(first, end);
+        leavePhase();
     }
-    else if (strcmp(ir->op, "WHILE") == 0)
+    enterPhase(PHASE_REGALLOC);
+    currentAllocation = allocateRegisters(first, end);
+    leavePhase();
+    enterPhase(PHASE_DUMP);
+    printRegisterAllocation(currentAllocation);
+    leavePhase();
+    forgetScratchContents();
+    frameArrays = layOutFrameArrays(first, end);
+    layOutFrame();
+
+    for (IRInstruction *current = first; current != end; current = current->next)
     {
-        char *startLabel = ir->arg1;
-        char *endLabel = ir->result;
+        translateIRInstruction(current, list);
+    }
+    emitReturn(list); // Falling off the end returns; the peephole pass drops it when unreachable
 
-        // Label for the start of the loop
-        fprintf(outFile, "%s:\n", startLabel);
+    FILE *out = diagnostics();
+    fprintf(out, "MIPS: frame %s %d bytes, %s, %d spill slots, %d array bytes, saved $s mask 0x%x%s",
+            getLabelName(first), frame.size, currentAllocation->isLeaf ? "leaf" : "non-leaf",
+            currentAllocation->spillSlotCount, frameArrays.bytes, currentAllocation->calleeSavedUsed,
+            frame.savesReturnAddress ? " and $ra" : "");
+    if (currentAllocation->floatCalleeSavedUsed)
+        fprintf(out, ", saved $f20-$f30 mask 0x%x", currentAllocation->floatCalleeSavedUsed);
+    fprintf(out, "\n");
+    freeFrameArrays(&frameArrays);
+    freeRegisterAllocation(currentAllocation);
+    currentAllocation = NULL;
+    return first;
+}
 
-        IRInstruction *conditionCheck = ir->next;
-        fprintf(outFile, "beqz %s, %s\n", mapTempToReg(conditionCheck->result), endLabel); // exit loop if condition is zero
+// The machine-level passes, over a list of whole units. Returns the instruction
+// count after the peephole pass, before scheduling adds any delay slot nops.
+static int optimizeUnits(MipsList *list)
+{
+    enterPhase(PHASE_PEEPHOLE);
+    optimizePeephole(list);
+    leavePhase();
+    int count = countMipsInstructions(list);
+    if (compilerOptions.schedule)
+    {
+        enterPhase(PHASE_SCHEDULE);
+        scheduleInstructions(list, &compilerOptions.latency);
+        leavePhase();
+    }
+    if (compilerOptions.fillDelaySlots)
+    {
+        enterPhase(PHASE_DELAY_SLOTS);
+        fillDelaySlots(list);
+        leavePhase();
+    }
+    return count;
+}
+
+static void reportInstructionCounts(int instructionsBefore, int instructionsAfter)
+{
+    if (compilerOptions.selectInstructions)
+        printSelectionStatistics();
+    printPeepholeStatistics();
+    printf("MIPS: %d instructions emitted (%d before peephole), %lld spill reloads, %lld spill stores\n",
+           instructionsAfter, instructionsBefore, compilerStats.spillReloads, compilerStats.spillStores);
+}
 
-        IRInstruction *bodyStart = conditionCheck->next;
-        IRInstruction *current = bodyStart;
-        while (current != NULL && strcmp(current->op, "GOTO") != 0)
-        {                                             // stop when reaching the jump back instruction
-            translateIRInstruction(current, outFile); // recursively translate each IR instruction in the loop body
-            current = current->next;
+// Simulates the finished program if asked, then writes it as assembly or an object
+static void finishProgram(MipsList *list, AsmEmitter *out)
+{
+    compilerStats.mipsInstructions = countMipsInstructions(list);
+    if (compilerOptions.simulate || compilerOptions.profileGenerate)
+    {
+        SimulationResult result;
+        DataObject *counters = compilerOptions.profileGenerate ? findGlobal(PROFILE_COUNTERS) : NULL;
+        int counterCount = counters ? counters->words : 0;
+        unsigned int *counts = calloc(counterCount + 1, sizeof(unsigned int));
+        enterPhase(PHASE_SIMULATE);
+        simulateMipsReading(list, &compilerOptions.latency, &result, counters ? counters->name : NULL, counts,
+                            counterCount);
+        leavePhase();
+        printSimulationResult(&result);
+        if (compilerOptions.profileGenerate)
+        {
+            if (!result.completed)
+                fprintf(stderr, "Warning: the profiling run did not finish; its counts are partial\n");
+            writeProfile(compilerOptions.profileGenerate, counts);
         }
+        free(counts);
+    }
 
-        fprintf(outFile, "j %s\n", startLabel);
+    enterPhase(PHASE_WRITE);
+    if (compilerOptions.emitObject)
+        writeElfObject(out, list);
+    else
+        writeMipsList(out, list);
+    flushEmitter(out);
+    leavePhase();
+}
 
-        fprintf(outFile, "%s:\n", endLabel);
+// One unit of a parallel translation: its IR, then its finished instructions
+// and the diagnostic lines printed on the way, until they are put in order
+typedef struct ParallelUnit
+{
+    IRInstruction *first;
+    IRInstruction *end;
+    MipsList *list;
+    char *diagnostics;
+    size_t diagnosticsSize;
+    int instructionsBefore;
+    int instructionsAfter;
+} ParallelUnit;
+
+typedef struct ParallelTranslation
+{
+    ParallelUnit *units;
+    MipsList *program;
+    int instructionsBefore;
+    int instructionsAfter;
+} ParallelTranslation;
+
+// Units share nothing but read-only globals once their bounds are known, so
+// each is translated and optimized on its own, as --stream does
+static void translateParallelUnit(int index, void *context)
+{
+    ParallelUnit *unit = &((ParallelTranslation *)context)->units[index];
+    // A FUNCTION with a key in arg1 is in the --cache: reused as it is, or stored once translated
+    CachedFunction *cached = unit->first->arg1 ? cachedFunction(unit->first->arg1) : NULL;
+    if (cached && cached->hit)
+    {
+        unit->list = cached->code;
+        cached->code = NULL;
+        unit->instructionsBefore = cached->instructionsBefore;
+        unit->instructionsAfter = cached->instructionsAfter;
+        return;
     }
+    FILE *lines = open_memstream(&unit->diagnostics, &unit->diagnosticsSize);
+    if (!lines)
+    {
+        perror("Failed to open diagnostics buffer");
+        exit(EXIT_FAILURE);
+    }
+    setDiagnostics(lines);
+    enterPhase(PHASE_MIPS);
+    unit->list = createMipsList();
+    IRInstruction *first = translateUnit(unit->first, unit->end, unit->list);
+    unit->instructionsBefore = countMipsInstructions(unit->list);
+    // The next unit's label stands in for it, so a jump to it at the end of
+    // this one is still dropped as a branch to the next instruction
+    MipsInstruction *next = unit->end ? emitMipsLabel(unit->list, unit->end->result) : NULL;
+    unit->instructionsAfter = optimizeUnits(unit->list);
+    if (next)
+        removeMipsInstruction(unit->list, next);
+    if (cached)
+        storeCachedFunction(cached, first, unit->end, unit->list, unit->instructionsBefore, unit->instructionsAfter);
+    leavePhase();
+    setDiagnostics(NULL);
+    fclose(lines);
+}
+
+// Runs in source order, so the program and stdout read as a serial compile's would
+static void finishParallelUnit(int index, void *context)
+{
+    ParallelTranslation *translation = context;
+    ParallelUnit *unit = &translation->units[index];
+    if (unit->diagnosticsSize)
+        fwrite(unit->diagnostics, 1, unit->diagnosticsSize, stdout);
+    free(unit->diagnostics);
+    translation->instructionsBefore += unit->instructionsBefore;
+    translation->instructionsAfter += unit->instructionsAfter;
+    spliceMipsList(translation->program, unit->list);
+    freeMipsList(unit->list);
 }
 
-// Main function to generate MIPS from a list of IR instructions
-void generateMIPS(IRInstruction *irList, const char *filename)
+// --jobs and --cache: the units are found first, then spread over the threads.
+// Each unit's instructions and diagnostics are spliced back in source order, so
+// the output matches a serial compile, but the scheduler's SCHED lines come per
+// unit rather than once. --time-phases charges the back-end phases with the main
+// thread's share of the work plus its wait for the others.
+static void translateInParallel(IRInstruction *irList, MipsList *list, int *instructionsBefore, int *instructionsAfter)
 {
-    FILE *outFile = fopen(filename, "w+");
-    if (!outFile)
+    int unitCount = 0;
+    for (IRInstruction *ir = irList; ir; ir = ir->next)
+        unitCount += strcmp(ir->op, "FUNCTION") == 0;
+    ParallelTranslation translation = {calloc(unitCount + 1, sizeof(ParallelUnit)), list, 0, 0};
+    if (!translation.units)
     {
-        perror("Failed to open file");
+        perror("Failed to allocate unit table");
         exit(EXIT_FAILURE);
     }
+    int index = -1;
+    for (IRInstruction *ir = irList; ir; ir = ir->next)
+    {
+        if (strcmp(ir->op, "FUNCTION") != 0)
+            continue;
+        if (index >= 0)
+            translation.units[index].end = ir;
+        translation.units[++index].first = ir;
+    }
+
+    runTasks(compilerOptions.jobs, unitCount, translateParallelUnit, finishParallelUnit, &translation);
+    *instructionsBefore = translation.instructionsBefore;
+    *instructionsAfter = translation.instructionsAfter;
+    free(translation.units);
+}
+
+// --msa code needs the 64-bit FPU mode MSA runs in, and the assembler told it may use MSA
+static void emitVectorDirectives(MipsList *list)
+{
+    if (!compilerOptions.vectorize)
+        return;
+    emitMipsDirective(list, ".set", mipsLabelOperand("fp=64"));
+    emitMipsDirective(list, ".set", mipsLabelOperand("msa"));
+}
+
+// Main function to generate MIPS from a list of IR instructions. The list is a
+// sequence of units, each starting with a FUNCTION instruction.
+void generateMIPS(IRInstruction *irList, AsmEmitter *out)
+{
+    MipsList *list = createMipsList();
+    emitDataSections(list);
+    emitMipsDirective(list, ".text", NO_OPERAND);
+    compilerStats.spillReloads = compilerStats.spillStores = 0;
+
+    int instructionsBefore, instructionsAfter;
+    if (compilerOptions.jobs > 1 || compilerOptions.cacheDirectory)
+    {
+        if (compilerOptions.fillDelaySlots)
+            emitMipsDirective(list, ".set", mipsLabelOperand("noreorder"));
+        emitVectorDirectives(list);
+        emitMipsDirective(list, ".globl", mipsLabelOperand("main"));
+        translateInParallel(irList, list, &instructionsBefore, &instructionsAfter);
+    }
+    else
+    {
+        emitVectorDirectives(list);
+        emitMipsDirective(list, ".globl", mipsLabelOperand("main"));
+        IRInstruction *unit = irList;
+        while (unit)
+        {
+            IRInstruction *end = unit->next;
+            while (end && strcmp(end->op, "FUNCTION") != 0)
+                end = end->next;
+            translateUnit(unit, end, list);
+            unit = end;
+        }
+        instructionsBefore = countMipsInstructions(list);
+        instructionsAfter = optimizeUnits(list);
+    }
+    reportInstructionCounts(instructionsBefore, instructionsAfter);
+    finishProgram(list, out);
+    freeMipsList(list);
+}
+
+// State of a streamed compile. The object writer and the simulator need the
+// whole program, so for them the finished units are kept in program.
+static struct
+{
+    AsmEmitter *out;
+    MipsList *program;
+    int instructionsBefore;
+    int instructionsAfter;
+} stream;
+
+// Labels in a unit's instructions point into its IR, which is about to be freed
+static void copyLabels(MipsList *list)
+{
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        if (instr->kind == MIPS_LABEL)
+            instr->op = strdup(instr->op);
+        for (int i = 0; i < instr->operandCount; i++)
+        {
+            if (instr->operands[i].label) // Label operands, and symbols in memory operands
+                instr->operands[i].label = strdup(instr->operands[i].label);
+        }
+    }
+}
+
+// Writes finished instructions straight out, or keeps them when the whole program is needed
+static void streamOut(MipsList *list)
+{
+    if (!stream.program)
+    {
+        compilerStats.mipsInstructions += countMipsInstructions(list);
+        enterPhase(PHASE_WRITE);
+        writeMipsList(stream.out, list);
+        leavePhase();
+        freeMipsList(list);
+        return;
+    }
+    copyLabels(list);
+    spliceMipsList(stream.program, list);
+    freeMipsList(list);
+}
+
+void beginStreamingMIPS(AsmEmitter *out)
+{
+    stream.out = out;
+    stream.program = compilerOptions.emitObject || compilerOptions.simulate || compilerOptions.profileGenerate
+                         ? createMipsList()
+                         : NULL;
+    stream.instructionsBefore = stream.instructionsAfter = 0;
+    compilerStats.spillReloads = compilerStats.spillStores = 0;
 
-    fprintf(outFile, ".text\n.globl main\nmain:\n");
+    MipsList *header = createMipsList();
+    emitMipsDirective(header, ".text", NO_OPERAND);
+    if (compilerOptions.fillDelaySlots)
+        emitMipsDirective(header, ".set", mipsLabelOperand("noreorder"));
+    emitVectorDirectives(header);
+    emitMipsDirective(header, ".globl", mipsLabelOperand("main"));
+    streamOut(header);
+}
+
+// Every instruction a streamed unit held, so all of them can be freed together
+typedef struct UnitInstructions
+{
+    IRInstruction **instructions;
+    int count;
+    int capacity;
+} UnitInstructions;
 
-    for (IRInstruction *current = irList; current != NULL; current = current->next)
+static void rememberInstructions(UnitInstructions *unit, IRInstruction *first)
+{
+    for (IRInstruction *ir = first; ir; ir = ir->next)
     {
-        translateIRInstruction(current, outFile);
+        if (unit->count == unit->capacity)
+        {
+            unit->capacity = unit->capacity ? 2 * unit->capacity : 64;
+            unit->instructions = realloc(unit->instructions, sizeof(IRInstruction *) * unit->capacity);
+            if (!unit->instructions)
+            {
+                perror("Failed to allocate unit instruction table");
+                exit(EXIT_FAILURE);
+            }
+        }
+        unit->instructions[unit->count++] = ir;
     }
+}
+
+void generateStreamedUnit(IRInstruction *first)
+{
+    // Selection and bounds check elimination drop instructions from the list,
+    // so the instructions before and after translation are both remembered
+    UnitInstructions unit = {NULL, 0, 0};
+    rememberInstructions(&unit, first);
 
-    fprintf(outFile, "jr $ra\n");
-    fclose(outFile);
+    MipsList *list = createMipsList();
+    first = translateUnit(first, NULL, list);
+    stream.instructionsBefore += countMipsInstructions(list);
+    stream.instructionsAfter += optimizeUnits(list);
+    streamOut(list);
+
+    rememberInstructions(&unit, first);
+    freeIRInstructions(unit.instructions, unit.count);
+    free(unit.instructions);
+}
+
+void finishStreamingMIPS()
+{
+    // Only now are all globals and float constants known
+    MipsList *data = createMipsList();
+    emitDataSections(data);
+    streamOut(data);
+
+    reportInstructionCounts(stream.instructionsBefore, stream.instructionsAfter);
+    if (stream.program)
+    {
+        finishProgram(stream.program, stream.out);
+        freeMipsList(stream.program);
+        return;
+    }
+    flushEmitter(stream.out);
 }
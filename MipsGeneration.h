@@ -3,12 +3,17 @@
 
 #include <stdio.h>
 #include "IRGeneration.h"
+#include "RegisterAllocation.h"
+#include "MipsInstruction.h"
 
-char *mapTempToReg(char *temp);
-void translateIRInstruction(IRInstruction *ir, FILE *outFile);
-void generateMIPS(IRInstruction *irList, const char *filename);
-void releaseRegister(char *reg);
-char *mapTempToReg(char *temp);
-int getAvailableRegister();
+const char *mapTempToReg(const char *temp);
+void translateIRInstruction(IRInstruction *ir, MipsList *list);
+void generateMIPS(IRInstruction *irList, AsmEmitter *out);
+
+// Streaming: each unit is translated, optimized and written as soon as it is
+// complete, and its IR freed; data sections follow the code at the end
+void beginStreamingMIPS(AsmEmitter *out);
+void generateStreamedUnit(IRInstruction *unit);
+void finishStreamingMIPS();
 
 #endif // MIPS_GENERATION_H
@@ -0,0 +1,474 @@
+#include "MipsInstruction.h"
+#include <stdlib.h>
+#include <string.h>
+
+const char *mipsRegisterNames[MIPS_REGISTER_COUNT] = {
+    "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra",
+    "$hi", "$lo",
+    "$f0", "$f1", "$f2", "$f3", "$f4", "$f5", "$f6", "$f7",
+    "$f8", "$f9", "$f10", "$f11", "$f12", "$f13", "$f14", "$f15",
+    "$f16", "$f17", "$f18", "$f19", "$f20", "$f21", "$f22", "$f23",
+    "$f24", "$f25", "$f26", "$f27", "$f28", "$f29", "$f30", "$f31",
+    "$fcc0",
+    "$w0", "$w1", "$w2", "$w3", "$w4", "$w5", "$w6", "$w7",
+    "$w8", "$w9", "$w10", "$w11", "$w12", "$w13", "$w14", "$w15",
+    "$w16", "$w17", "$w18", "$w19", "$w20", "$w21", "$w22", "$w23",
+    "$w24", "$w25", "$w26", "$w27", "$w28", "$w29", "$w30", "$w31"};
+
+const MipsOperand NO_OPERAND = {OPERAND_NONE, 0, 0, NULL};
+
+#define NONE {-1, -1}
+#define USES_1 0x2
+#define USES_0_1 0x3
+#define USES_1_2 0x6
+#define USES_0_1_2 0x7
+
+// Register effects of every opcode the backend emits. Operand 0 is the
+// destination for arithmetic; stores and branches only read their operands.
+// mtc1 writes its second operand, and movf/movt also read the old destination.
+static const MipsOpcodeInfo opcodeTable[] = {
+    {"add", 0, USES_1_2, 0, NONE, NONE},
+    {"addu", 0, USES_1_2, 0, NONE, NONE},
+    {"sub", 0, USES_1_2, 0, NONE, NONE},
+    {"subu", 0, USES_1_2, 0, NONE, NONE},
+    {"mul", 0, USES_1_2, 0, NONE, NONE},
+    {"and", 0, USES_1_2, 0, NONE, NONE},
+    {"or", 0, USES_1_2, 0, NONE, NONE},
+    {"xor", 0, USES_1_2, 0, NONE, NONE},
+    {"nor", 0, USES_1_2, 0, NONE, NONE},
+    {"slt", 0, USES_1_2, 0, NONE, NONE},
+    {"sllv", 0, USES_1_2, 0, NONE, NONE},
+    {"sltu", 0, USES_1_2, 0, NONE, NONE},
+    {"addi", 0, USES_1, 0, NONE, NONE},
+    {"addiu", 0, USES_1, 0, NONE, NONE},
+    {"andi", 0, USES_1, 0, NONE, NONE},
+    {"ori", 0, USES_1, 0, NONE, NONE},
+    {"xori", 0, USES_1, 0, NONE, NONE},
+    {"slti", 0, USES_1, 0, NONE, NONE},
+    {"sltiu", 0, USES_1, 0, NONE, NONE},
+    {"sll", 0, USES_1, 0, NONE, NONE},
+    {"srl", 0, USES_1, 0, NONE, NONE},
+    {"sra", 0, USES_1, 0, NONE, NONE},
+    {"li", 0, 0, 0, NONE, NONE},
+    {"lui", 0, 0, 0, NONE, NONE},
+    {"la", 0, 0, 0, NONE, NONE},
+    {"move", 0, USES_1, 0, NONE, NONE},
+    {"lw", 0, USES_1, MIPS_FLAG_LOAD, NONE, NONE},
+    {"sw", -1, USES_0_1, MIPS_FLAG_STORE, NONE, NONE},
+    {"div", -1, USES_0_1, 0, {MIPS_REG_HI, MIPS_REG_LO}, NONE},
+    {"mult", -1, USES_0_1, 0, {MIPS_REG_HI, MIPS_REG_LO}, NONE},
+    {"mfhi", 0, 0, 0, NONE, {MIPS_REG_HI, -1}},
+    {"mflo", 0, 0, 0, NONE, {MIPS_REG_LO, -1}},
+    {"b", -1, 0, MIPS_FLAG_BRANCH | MIPS_FLAG_JUMP, NONE, NONE},
+    {"j", -1, 0, MIPS_FLAG_BRANCH | MIPS_FLAG_JUMP, NONE, NONE},
+    {"beq", -1, USES_0_1, MIPS_FLAG_BRANCH, NONE, NONE},
+    {"bne", -1, USES_0_1, MIPS_FLAG_BRANCH, NONE, NONE},
+    {"beqz", -1, 0x1, MIPS_FLAG_BRANCH, NONE, NONE},
+    {"bnez", -1, 0x1, MIPS_FLAG_BRANCH, NONE, NONE},
+    {"blez", -1, 0x1, MIPS_FLAG_BRANCH, NONE, NONE},
+    {"bgtz", -1, 0x1, MIPS_FLAG_BRANCH, NONE, NONE},
+    {"bltz", -1, 0x1, MIPS_FLAG_BRANCH, NONE, NONE},
+    {"bgez", -1, 0x1, MIPS_FLAG_BRANCH, NONE, NONE},
+    {"jal", -1, 0, MIPS_FLAG_CALL, {MIPS_REG_RA, MIPS_REG_V0}, NONE},
+    {"jr", -1, 0x1, MIPS_FLAG_JUMP, NONE, NONE},
+    {"tgeu", -1, USES_0_1, MIPS_FLAG_TRAP, NONE, NONE},
+    {"tgeiu", -1, 0x1, MIPS_FLAG_TRAP, NONE, NONE},
+    {"add.s", 0, USES_1_2, 0, NONE, NONE},
+    {"sub.s", 0, USES_1_2, 0, NONE, NONE},
+    {"mul.s", 0, USES_1_2, 0, NONE, NONE},
+    {"div.s", 0, USES_1_2, 0, NONE, NONE},
+    {"neg.s", 0, USES_1, 0, NONE, NONE},
+    {"mov.s", 0, USES_1, 0, NONE, NONE},
+    {"cvt.s.w", 0, USES_1, 0, NONE, NONE},
+    {"trunc.w.s", 0, USES_1, 0, NONE, NONE},
+    {"mtc1", 1, 0x1, 0, NONE, NONE},
+    {"mfc1", 0, USES_1, 0, NONE, NONE},
+    {"lwc1", 0, USES_1, MIPS_FLAG_LOAD, NONE, NONE},
+    {"swc1", -1, USES_0_1, MIPS_FLAG_STORE, NONE, NONE},
+    {"c.lt.s", -1, USES_0_1, 0, {MIPS_REG_FCC, -1}, NONE},
+    {"c.le.s", -1, USES_0_1, 0, {MIPS_REG_FCC, -1}, NONE},
+    {"c.eq.s", -1, USES_0_1, 0, {MIPS_REG_FCC, -1}, NONE},
+    {"movf", 0, USES_0_1_2, 0, NONE, NONE},
+    {"movt", 0, USES_0_1_2, 0, NONE, NONE},
+    {"ld.w", 0, USES_1, MIPS_FLAG_LOAD, NONE, NONE},
+    {"st.w", -1, USES_0_1, MIPS_FLAG_STORE, NONE, NONE},
+    {"addv.w", 0, USES_1_2, 0, NONE, NONE},
+    {"subv.w", 0, USES_1_2, 0, NONE, NONE},
+    {"mulv.w", 0, USES_1_2, 0, NONE, NONE},
+    {"fadd.w", 0, USES_1_2, 0, NONE, NONE},
+    {"fsub.w", 0, USES_1_2, 0, NONE, NONE},
+    {"fmul.w", 0, USES_1_2, 0, NONE, NONE},
+    {"fdiv.w", 0, USES_1_2, 0, NONE, NONE},
+    {"fill.w", 0, USES_1, 0, NONE, NONE},
+    {"nop", -1, 0, 0, NONE, NONE},
+    {NULL, -1, 0, 0, NONE, NONE}};
+
+MipsOperand mipsRegister(int reg)
+{
+    MipsOperand operand = {OPERAND_REGISTER, reg, 0, NULL};
+    return operand;
+}
+
+MipsOperand mipsImmediate(int value)
+{
+    MipsOperand operand = {OPERAND_IMMEDIATE, 0, value, NULL};
+    return operand;
+}
+
+MipsOperand mipsLabelOperand(const char *label)
+{
+    MipsOperand operand = {OPERAND_LABEL, 0, 0, label};
+    return operand;
+}
+
+MipsOperand mipsMemory(int offset, int base)
+{
+    MipsOperand operand = {OPERAND_MEMORY, base, offset, NULL};
+    return operand;
+}
+
+// A global's address plus offset, from base; $zero as base gives an absolute address
+MipsOperand mipsSymbolMemory(const char *symbol, int offset, int base)
+{
+    MipsOperand operand = {OPERAND_MEMORY, base, offset, symbol};
+    return operand;
+}
+
+int mipsRegisterNumber(const char *name)
+{
+    for (int i = 0; i < MIPS_REGISTER_COUNT; i++)
+    {
+        if (strcmp(mipsRegisterNames[i], name) == 0)
+            return i;
+    }
+    fprintf(stderr, "Error: Unknown MIPS register %s\n", name);
+    exit(EXIT_FAILURE);
+}
+
+const MipsOpcodeInfo *findMipsOpcode(const char *mnemonic)
+{
+    for (const MipsOpcodeInfo *info = opcodeTable; info->mnemonic; info++)
+    {
+        if (strcmp(info->mnemonic, mnemonic) == 0)
+            return info;
+    }
+    return NULL;
+}
+
+MipsList *createMipsList()
+{
+    MipsList *list = calloc(1, sizeof(MipsList));
+    if (!list)
+    {
+        perror("Failed to allocate MIPS instruction list");
+        exit(EXIT_FAILURE);
+    }
+    return list;
+}
+
+static MipsInstruction *allocateMipsInstruction(MipsKind kind, const char *op)
+{
+    MipsInstruction *instr = calloc(1, sizeof(MipsInstruction));
+    if (!instr)
+    {
+        perror("Failed to allocate MIPS instruction");
+        exit(EXIT_FAILURE);
+    }
+    instr->kind = kind;
+    instr->op = op;
+    return instr;
+}
+
+MipsInstruction *createMipsInstruction(const char *op, MipsOperand a, MipsOperand b, MipsOperand c)
+{
+    MipsInstruction *instr = allocateMipsInstruction(MIPS_INSTRUCTION, op);
+    instr->info = findMipsOpcode(op);
+    if (!instr->info)
+    {
+        fprintf(stderr, "Error: Unknown MIPS opcode %s\n", op);
+        exit(EXIT_FAILURE);
+    }
+    MipsOperand operands[3] = {a, b, c};
+    for (int i = 0; i < 3 && operands[i].kind != OPERAND_NONE; i++)
+    {
+        instr->operands[i] = operands[i];
+        instr->operandCount++;
+    }
+    return instr;
+}
+
+static void appendMips(MipsList *list, MipsInstruction *instr)
+{
+    instr->prev = list->tail;
+    instr->next = NULL;
+    if (list->tail)
+        list->tail->next = instr;
+    else
+        list->head = instr;
+    list->tail = instr;
+    list->count++;
+}
+
+MipsInstruction *emitMips(MipsList *list, const char *op, MipsOperand a, MipsOperand b, MipsOperand c)
+{
+    MipsInstruction *instr = createMipsInstruction(op, a, b, c);
+    appendMips(list, instr);
+    return instr;
+}
+
+MipsInstruction *emitMipsLabel(MipsList *list, const char *name)
+{
+    MipsInstruction *instr = allocateMipsInstruction(MIPS_LABEL, name);
+    appendMips(list, instr);
+    return instr;
+}
+
+MipsInstruction *createMipsDirective(const char *directive, MipsOperand a)
+{
+    MipsInstruction *instr = allocateMipsInstruction(MIPS_DIRECTIVE, directive);
+    if (a.kind != OPERAND_NONE)
+    {
+        instr->operands[0] = a;
+        instr->operandCount = 1;
+    }
+    return instr;
+}
+
+MipsInstruction *emitMipsDirective(MipsList *list, const char *directive, MipsOperand a)
+{
+    MipsInstruction *instr = createMipsDirective(directive, a);
+    appendMips(list, instr);
+    return instr;
+}
+
+void insertMipsBefore(MipsList *list, MipsInstruction *position, MipsInstruction *instr)
+{
+    if (!position)
+    {
+        appendMips(list, instr);
+        return;
+    }
+    instr->next = position;
+    instr->prev = position->prev;
+    if (position->prev)
+        position->prev->next = instr;
+    else
+        list->head = instr;
+    position->prev = instr;
+    list->count++;
+}
+
+void insertMipsAfter(MipsList *list, MipsInstruction *position, MipsInstruction *instr)
+{
+    if (!position || !position->next)
+    {
+        appendMips(list, instr);
+        return;
+    }
+    insertMipsBefore(list, position->next, instr);
+}
+
+// Moves every instruction of other to the end of list, leaving other empty
+void spliceMipsList(MipsList *list, MipsList *other)
+{
+    if (!other->head)
+        return;
+    other->head->prev = list->tail;
+    if (list->tail)
+        list->tail->next = other->head;
+    else
+        list->head = other->head;
+    list->tail = other->tail;
+    list->count += other->count;
+    other->head = other->tail = NULL;
+    other->count = 0;
+}
+
+// Detaches instr from the list without freeing it, so it can be inserted elsewhere
+void unlinkMipsInstruction(MipsList *list, MipsInstruction *instr)
+{
+    if (instr->prev)
+        instr->prev->next = instr->next;
+    else
+        list->head = instr->next;
+    if (instr->next)
+        instr->next->prev = instr->prev;
+    else
+        list->tail = instr->prev;
+    instr->prev = NULL;
+    instr->next = NULL;
+    list->count--;
+}
+
+void removeMipsInstruction(MipsList *list, MipsInstruction *instr)
+{
+    unlinkMipsInstruction(list, instr);
+    free(instr);
+}
+
+void freeMipsList(MipsList *list)
+{
+    MipsInstruction *instr = list->head;
+    while (instr)
+    {
+        MipsInstruction *next = instr->next;
+        free(instr);
+        instr = next;
+    }
+    free(list);
+}
+
+// Counts real instructions, leaving out labels and directives
+int countMipsInstructions(MipsList *list)
+{
+    int count = 0;
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        if (instr->kind == MIPS_INSTRUCTION)
+            count++;
+    }
+    return count;
+}
+
+// Collects the registers an instruction writes, including HI/LO and $ra
+int getMipsDefs(MipsInstruction *instr, int defs[3])
+{
+    int count = 0;
+    if (instr->kind != MIPS_INSTRUCTION)
+        return 0;
+    if (instr->info->definedOperand >= 0)
+        defs[count++] = instr->operands[instr->info->definedOperand].reg;
+    for (int i = 0; i < 2 && instr->info->implicitDefs[i] >= 0; i++)
+        defs[count++] = instr->info->implicitDefs[i];
+    return count;
+}
+
+// Collects the registers an instruction reads; memory operands read their base
+int getMipsUses(MipsInstruction *instr, int uses[4])
+{
+    int count = 0;
+    if (instr->kind != MIPS_INSTRUCTION)
+        return 0;
+    for (int i = 0; i < instr->operandCount; i++)
+    {
+        if (!(instr->info->usedMask & (1u << i)))
+            continue;
+        if (instr->operands[i].kind == OPERAND_REGISTER || instr->operands[i].kind == OPERAND_MEMORY)
+            uses[count++] = instr->operands[i].reg;
+    }
+    for (int i = 0; i < 2 && instr->info->implicitUses[i] >= 0; i++)
+        uses[count++] = instr->info->implicitUses[i];
+    return count;
+}
+
+int isMipsInstruction(MipsInstruction *instr, const char *mnemonic)
+{
+    return instr && instr->kind == MIPS_INSTRUCTION && strcmp(instr->op, mnemonic) == 0;
+}
+
+int mipsHasFlag(MipsInstruction *instr, int flag)
+{
+    return instr && instr->kind == MIPS_INSTRUCTION && (instr->info->flags & flag);
+}
+
+const char *getMipsBranchTarget(MipsInstruction *instr)
+{
+    if (!mipsHasFlag(instr, MIPS_FLAG_BRANCH))
+        return NULL;
+    return instr->operands[instr->operandCount - 1].label;
+}
+
+int sameMipsOperand(MipsOperand a, MipsOperand b)
+{
+    if (a.kind != b.kind)
+        return 0;
+    switch (a.kind)
+    {
+    case OPERAND_REGISTER:
+        return a.reg == b.reg;
+    case OPERAND_IMMEDIATE:
+        return a.value == b.value;
+    case OPERAND_LABEL:
+        return strcmp(a.label, b.label) == 0;
+    case OPERAND_MEMORY:
+        return a.reg == b.reg && a.value == b.value &&
+               (a.label == b.label || (a.label && b.label && strcmp(a.label, b.label) == 0));
+    default:
+        return 1;
+    }
+}
+
+static void writeRegister(AsmEmitter *out, int reg)
+{
+    static size_t nameLengths[MIPS_REGISTER_COUNT];
+    if (!nameLengths[reg])
+        nameLengths[reg] = strlen(mipsRegisterNames[reg]);
+    emitBytes(out, mipsRegisterNames[reg], nameLengths[reg]);
+}
+
+static void writeMipsOperand(AsmEmitter *out, MipsOperand operand)
+{
+    switch (operand.kind)
+    {
+    case OPERAND_REGISTER:
+        writeRegister(out, operand.reg);
+        break;
+    case OPERAND_IMMEDIATE:
+        emitInt(out, operand.value);
+        break;
+    case OPERAND_LABEL:
+        emitString(out, operand.label);
+        break;
+    case OPERAND_MEMORY:
+        if (operand.label)
+        {
+            emitString(out, operand.label);
+            if (operand.value > 0)
+                emitChar(out, '+');
+            if (operand.value != 0)
+                emitInt(out, operand.value);
+            if (operand.reg == MIPS_REG_ZERO)
+                break;
+        }
+        else
+        {
+            emitInt(out, operand.value);
+        }
+        emitChar(out, '(');
+        writeRegister(out, operand.reg);
+        emitChar(out, ')');
+        break;
+    default:
+        break;
+    }
+}
+
+void writeMipsInstruction(AsmEmitter *out, MipsInstruction *instr)
+{
+    emitString(out, instr->op);
+    if (instr->kind == MIPS_LABEL)
+    {
+        emitBytes(out, ":\n", 2);
+        return;
+    }
+    for (int i = 0; i < instr->operandCount; i++)
+    {
+        if (i == 0)
+            emitChar(out, ' ');
+        else
+            emitBytes(out, ", ", 2);
+        writeMipsOperand(out, instr->operands[i]);
+    }
+    emitChar(out, '\n');
+}
+
+void writeMipsList(AsmEmitter *out, MipsList *list)
+{
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        writeMipsInstruction(out, instr);
+    }
+}
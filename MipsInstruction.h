@@ -0,0 +1,117 @@
+#ifndef MIPS_INSTRUCTION_H
+#define MIPS_INSTRUCTION_H
+
+#include <stdio.h>
+#include "AsmEmitter.h"
+
+// Pseudo register numbers so HI/LO dependencies look like any other register;
+// the coprocessor 1 registers, its condition flag and the MSA vector registers follow
+#define MIPS_REG_HI 32
+#define MIPS_REG_LO 33
+#define MIPS_REG_F0 34
+#define MIPS_REG_FCC 66
+#define MIPS_REG_W0 67
+#define MIPS_REGISTER_COUNT 99
+
+#define MIPS_REG_ZERO 0
+#define MIPS_REG_V0 2
+#define MIPS_REG_A0 4
+#define MIPS_REG_SP 29
+#define MIPS_REG_RA 31
+
+typedef enum
+{
+    MIPS_INSTRUCTION,
+    MIPS_LABEL,
+    MIPS_DIRECTIVE
+} MipsKind;
+
+typedef enum
+{
+    OPERAND_NONE,
+    OPERAND_REGISTER,
+    OPERAND_IMMEDIATE,
+    OPERAND_LABEL,
+    OPERAND_MEMORY // value(reg), or label+value(reg) when label is set
+} OperandKind;
+
+typedef struct MipsOperand
+{
+    OperandKind kind;
+    int reg;
+    int value;
+    const char *label;
+} MipsOperand;
+
+// Flags describing how an opcode affects control flow and memory
+#define MIPS_FLAG_BRANCH 0x01 // Conditional or unconditional branch to a label
+#define MIPS_FLAG_JUMP 0x02   // Unconditional transfer; the next instruction is not its successor
+#define MIPS_FLAG_CALL 0x04
+#define MIPS_FLAG_LOAD 0x08
+#define MIPS_FLAG_STORE 0x10
+#define MIPS_FLAG_TRAP 0x20   // May raise an exception, so it stays in program order
+
+typedef struct MipsOpcodeInfo
+{
+    const char *mnemonic;
+    int definedOperand;     // Operand index written, or -1
+    unsigned int usedMask;  // Bit i set when operand i is read
+    int flags;
+    int implicitDefs[2];    // Extra registers written (HI/LO, $ra), -1 terminated
+    int implicitUses[2];    // Extra registers read, -1 terminated
+} MipsOpcodeInfo;
+
+typedef struct MipsInstruction
+{
+    MipsKind kind;
+    const char *op; // Mnemonic, label name or directive
+    const MipsOpcodeInfo *info;
+    MipsOperand operands[3];
+    int operandCount;
+    struct MipsInstruction *prev;
+    struct MipsInstruction *next;
+} MipsInstruction;
+
+typedef struct MipsList
+{
+    MipsInstruction *head;
+    MipsInstruction *tail;
+    int count;
+} MipsList;
+
+extern const char *mipsRegisterNames[MIPS_REGISTER_COUNT];
+extern const MipsOperand NO_OPERAND;
+
+MipsOperand mipsRegister(int reg);
+MipsOperand mipsImmediate(int value);
+MipsOperand mipsLabelOperand(const char *label);
+MipsOperand mipsMemory(int offset, int base);
+MipsOperand mipsSymbolMemory(const char *symbol, int offset, int base);
+int mipsRegisterNumber(const char *name);
+
+MipsList *createMipsList();
+MipsInstruction *emitMips(MipsList *list, const char *op, MipsOperand a, MipsOperand b, MipsOperand c);
+MipsInstruction *emitMipsLabel(MipsList *list, const char *name);
+MipsInstruction *emitMipsDirective(MipsList *list, const char *directive, MipsOperand a);
+MipsInstruction *createMipsInstruction(const char *op, MipsOperand a, MipsOperand b, MipsOperand c);
+MipsInstruction *createMipsDirective(const char *directive, MipsOperand a);
+void insertMipsBefore(MipsList *list, MipsInstruction *position, MipsInstruction *instr);
+void insertMipsAfter(MipsList *list, MipsInstruction *position, MipsInstruction *instr);
+void unlinkMipsInstruction(MipsList *list, MipsInstruction *instr);
+void spliceMipsList(MipsList *list, MipsList *other);
+void removeMipsInstruction(MipsList *list, MipsInstruction *instr);
+void freeMipsList(MipsList *list);
+int countMipsInstructions(MipsList *list);
+
+const MipsOpcodeInfo *findMipsOpcode(const char *mnemonic);
+int getMipsDefs(MipsInstruction *instr, int defs[3]);
+int getMipsUses(MipsInstruction *instr, int uses[4]);
+int isMipsInstruction(MipsInstruction *instr, const char *mnemonic);
+int mipsHasFlag(MipsInstruction *instr, int flag);
+const char *getMipsBranchTarget(MipsInstruction *instr);
+int sameMipsOperand(MipsOperand a, MipsOperand b);
+
+void writeMipsInstruction(AsmEmitter *out, MipsInstruction *instr);
+void writeMipsList(AsmEmitter *out, MipsList *list);
+
+#endif // MIPS_INSTRUCTION_H
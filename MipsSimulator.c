@@ -0,0 +1,559 @@
+#include "MipsSimulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DATA_BASE 0x10010000u
+#define STACK_TOP 0x7ffffffcu
+#define STACK_WORDS (1 << 20)
+#define RETURN_SENTINEL 0xfffffff0u // $ra on entry; jumping there ends the run
+#define STEP_LIMIT 1000000000LL
+
+typedef enum
+{
+    OP_ADD, OP_SUB, OP_AND, OP_OR, OP_XOR, OP_NOR, OP_SLT, OP_SLTU, OP_MUL, OP_SLLV,
+    OP_SLL, OP_SRL, OP_SRA, OP_MULT, OP_DIV, OP_MFHI, OP_MFLO,
+    OP_ADDI, OP_SLTI, OP_SLTIU, OP_ANDI, OP_ORI, OP_XORI, OP_LUI, OP_LI, OP_LA, OP_MOVE,
+    OP_LOAD, OP_STORE,
+    OP_BEQ, OP_BNE, OP_BEQZ, OP_BNEZ, OP_BLEZ, OP_BGTZ, OP_BLTZ, OP_BGEZ, OP_B, OP_J, OP_JAL, OP_JR,
+    OP_TGEU, OP_TGEIU,
+    OP_ADD_S, OP_SUB_S, OP_MUL_S, OP_DIV_S, OP_NEG_S, OP_MOV_S, OP_CVT_S_W, OP_TRUNC_W_S,
+    OP_MTC1, OP_MFC1, OP_C_LT_S, OP_C_LE_S, OP_C_EQ_S, OP_MOVF, OP_MOVT,
+    OP_LD_W, OP_ST_W, OP_ADDV_W, OP_SUBV_W, OP_MULV_W, OP_FADD_W, OP_FSUB_W, OP_FMUL_W, OP_FDIV_W, OP_FILL_W, OP_NOP
+} SimOp;
+
+static const struct
+{
+    const char *mnemonic;
+    SimOp op;
+} simOps[] = {
+    {"add", OP_ADD}, {"addu", OP_ADD}, {"sub", OP_SUB}, {"subu", OP_SUB}, {"and", OP_AND}, {"or", OP_OR},
+    {"xor", OP_XOR}, {"nor", OP_NOR}, {"slt", OP_SLT}, {"sltu", OP_SLTU}, {"mul", OP_MUL}, {"sllv", OP_SLLV},
+    {"sll", OP_SLL}, {"srl", OP_SRL}, {"sra", OP_SRA}, {"mult", OP_MULT}, {"div", OP_DIV}, {"mfhi", OP_MFHI},
+    {"mflo", OP_MFLO}, {"addi", OP_ADDI}, {"addiu", OP_ADDI}, {"slti", OP_SLTI}, {"sltiu", OP_SLTIU},
+    {"andi", OP_ANDI}, {"ori", OP_ORI}, {"xori", OP_XORI}, {"lui", OP_LUI}, {"li", OP_LI}, {"la", OP_LA},
+    {"move", OP_MOVE}, {"lw", OP_LOAD}, {"lwc1", OP_LOAD}, {"sw", OP_STORE}, {"swc1", OP_STORE},
+    {"beq", OP_BEQ}, {"bne", OP_BNE}, {"beqz", OP_BEQZ}, {"bnez", OP_BNEZ}, {"blez", OP_BLEZ},
+    {"bgtz", OP_BGTZ}, {"bltz", OP_BLTZ}, {"bgez", OP_BGEZ}, {"b", OP_B}, {"j", OP_J}, {"jal", OP_JAL},
+    {"jr", OP_JR}, {"tgeu", OP_TGEU}, {"tgeiu", OP_TGEIU}, {"add.s", OP_ADD_S}, {"sub.s", OP_SUB_S},
+    {"mul.s", OP_MUL_S}, {"div.s", OP_DIV_S}, {"neg.s", OP_NEG_S}, {"mov.s", OP_MOV_S},
+    {"cvt.s.w", OP_CVT_S_W}, {"trunc.w.s", OP_TRUNC_W_S}, {"mtc1", OP_MTC1}, {"mfc1", OP_MFC1},
+    {"c.lt.s", OP_C_LT_S}, {"c.le.s", OP_C_LE_S}, {"c.eq.s", OP_C_EQ_S}, {"movf", OP_MOVF},
+    {"movt", OP_MOVT}, {"ld.w", OP_LD_W}, {"st.w", OP_ST_W}, {"addv.w", OP_ADDV_W}, {"subv.w", OP_SUBV_W},
+    {"mulv.w", OP_MULV_W}, {"fadd.w", OP_FADD_W}, {"fsub.w", OP_FSUB_W}, {"fmul.w", OP_FMUL_W},
+    {"fdiv.w", OP_FDIV_W}, {"fill.w", OP_FILL_W}, {"nop", OP_NOP}, {NULL, OP_NOP}};
+
+// An instruction decoded once before the run
+typedef struct SimInstruction
+{
+    MipsInstruction *instr;
+    SimOp op;
+    int target;           // Instruction index a branch or jump goes to
+    unsigned int address; // Of a la, or a memory operand's symbol plus offset
+    int words;            // Machine instructions it assembles to
+    int latency;
+    StallCause cause;     // Charged to readers that wait on its results
+    int uses[4];
+    int useCount;
+    int defs[3];
+    int defCount;
+} SimInstruction;
+
+typedef struct SimLabel
+{
+    const char *name;
+    int isCode;
+    unsigned int value; // Instruction index, or data address
+} SimLabel;
+
+typedef struct Simulator
+{
+    SimInstruction *code;
+    int codeCount;
+    SimLabel *labels;
+    int labelCount;
+    unsigned int *data; // Static data, one entry per word from DATA_BASE
+    unsigned int dataWords;
+    unsigned int *stack;
+    unsigned int regs[MIPS_REGISTER_COUNT]; // $f registers hold raw single-precision bits
+    int delaySlots;                         // .set noreorder: the slot instruction is the program's
+    unsigned int vectors[32][4];            // MSA registers, lane 0 at the lowest address
+} Simulator;
+
+static void *allocateOrDie(size_t size, const char *what)
+{
+    void *memory = calloc(1, size);
+    if (!memory)
+    {
+        fprintf(stderr, "Failed to allocate %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+static SimLabel *findLabel(Simulator *sim, const char *name)
+{
+    for (int i = 0; i < sim->labelCount; i++)
+    {
+        if (strcmp(sim->labels[i].name, name) == 0)
+            return &sim->labels[i];
+    }
+    fprintf(stderr, "Error: Simulator cannot find label %s\n", name);
+    exit(EXIT_FAILURE);
+}
+
+// Same expansion the assembler applies: la and global accesses take a lui first,
+// and a li that fits neither 16-bit form takes lui and ori
+static int machineWords(MipsInstruction *instr)
+{
+    if (isMipsInstruction(instr, "la"))
+        return 2;
+    if (isMipsInstruction(instr, "li"))
+    {
+        int value = instr->operands[1].value;
+        return value >= -32768 && value <= 65535 ? 1 : (value & 0xffff) ? 2 : 1;
+    }
+    if (mipsHasFlag(instr, MIPS_FLAG_LOAD | MIPS_FLAG_STORE) && instr->operands[1].label)
+        return instr->operands[1].reg == MIPS_REG_ZERO ? 2 : 3;
+    return 1;
+}
+
+static StallCause stallCauseOf(MipsInstruction *instr)
+{
+    if (mipsHasFlag(instr, MIPS_FLAG_LOAD))
+        return STALL_LOAD_USE;
+    if (isMipsInstruction(instr, "mul") || isMipsInstruction(instr, "mult") || isMipsInstruction(instr, "div") ||
+        isMipsInstruction(instr, "mfhi") || isMipsInstruction(instr, "mflo") || isMipsInstruction(instr, "mulv.w"))
+        return STALL_MULTIPLY_DIVIDE;
+    if (isMipsInstruction(instr, "addv.w") || isMipsInstruction(instr, "subv.w") || isMipsInstruction(instr, "fill.w"))
+        return STALL_ALU;
+    if (strchr(instr->op, '.'))
+        return STALL_FPU;
+    return STALL_ALU;
+}
+
+// Lays out the data directives from DATA_BASE and numbers the instructions
+static void loadProgram(Simulator *sim, MipsList *list, const LatencyModel *model)
+{
+    int labelCapacity = 0;
+    unsigned int dataBytes = 0;
+    int inText = 0;
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        if (instr->kind == MIPS_INSTRUCTION)
+        {
+            sim->codeCount++;
+            continue;
+        }
+        if (instr->kind == MIPS_LABEL)
+        {
+            if (sim->labelCount == labelCapacity)
+            {
+                labelCapacity = labelCapacity ? 2 * labelCapacity : 64;
+                sim->labels = realloc(sim->labels, sizeof(SimLabel) * labelCapacity);
+                if (!sim->labels)
+                {
+                    perror("Failed to allocate simulator labels");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            SimLabel *label = &sim->labels[sim->labelCount++];
+            label->name = instr->op;
+            label->isCode = inText;
+            label->value = inText ? (unsigned int)sim->codeCount : DATA_BASE + dataBytes;
+            continue;
+        }
+        if (strcmp(instr->op, ".text") == 0)
+            inText = 1;
+        else if (strcmp(instr->op, ".data") == 0 || strcmp(instr->op, ".bss") == 0 || strcmp(instr->op, ".rdata") == 0)
+            inText = 0;
+        else if (strcmp(instr->op, ".set") == 0 && strcmp(instr->operands[0].label, "noreorder") == 0)
+            sim->delaySlots = 1;
+        else if (strcmp(instr->op, ".set") == 0 && strcmp(instr->operands[0].label, "reorder") == 0)
+            sim->delaySlots = 0;
+        else if (strcmp(instr->op, ".align") == 0)
+            dataBytes = (dataBytes + (1u << instr->operands[0].value) - 1) & ~((1u << instr->operands[0].value) - 1);
+        else if (strcmp(instr->op, ".space") == 0)
+            dataBytes += instr->operands[0].value;
+        else if (strcmp(instr->op, ".word") == 0 || strcmp(instr->op, ".float") == 0)
+            dataBytes += 4;
+    }
+
+    // Second pass fills in initial values now that the size is known
+    sim->dataWords = (dataBytes + 3) / 4;
+    sim->data = allocateOrDie(sizeof(unsigned int) * (sim->dataWords + 1), "simulated data");
+    sim->code = allocateOrDie(sizeof(SimInstruction) * (sim->codeCount + 1), "simulated code");
+    dataBytes = 0;
+    int index = 0;
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        if (instr->kind == MIPS_DIRECTIVE)
+        {
+            if (strcmp(instr->op, ".align") == 0)
+                dataBytes = (dataBytes + (1u << instr->operands[0].value) - 1) & ~((1u << instr->operands[0].value) - 1);
+            else if (strcmp(instr->op, ".space") == 0)
+                dataBytes += instr->operands[0].value;
+            else if (strcmp(instr->op, ".word") == 0)
+                sim->data[(dataBytes += 4) / 4 - 1] = instr->operands[0].value;
+            else if (strcmp(instr->op, ".float") == 0)
+            {
+                float value = strtof(instr->operands[0].label, NULL);
+                memcpy(&sim->data[(dataBytes += 4) / 4 - 1], &value, sizeof(value));
+            }
+            continue;
+        }
+        if (instr->kind != MIPS_INSTRUCTION)
+            continue;
+
+        SimInstruction *decoded = &sim->code[index++];
+        decoded->instr = instr;
+        decoded->op = OP_NOP;
+        for (int i = 0; simOps[i].mnemonic; i++)
+        {
+            if (strcmp(simOps[i].mnemonic, instr->op) == 0)
+            {
+                decoded->op = simOps[i].op;
+                break;
+            }
+        }
+        if (decoded->op == OP_NOP && strcmp(instr->op, "nop") != 0)
+        {
+            fprintf(stderr, "Error: Simulator cannot execute %s\n", instr->op);
+            exit(EXIT_FAILURE);
+        }
+        const char *target = getMipsBranchTarget(instr);
+        if (!target && isMipsInstruction(instr, "jal"))
+            target = instr->operands[0].label;
+        if (target)
+            decoded->target = findLabel(sim, target)->value;
+        for (int i = 0; i < instr->operandCount; i++)
+        {
+            MipsOperand operand = instr->operands[i];
+            if (operand.kind == OPERAND_MEMORY || (decoded->op == OP_LA && operand.label))
+                decoded->address = (operand.label ? findLabel(sim, operand.label)->value : 0) + operand.value;
+        }
+        decoded->words = machineWords(instr);
+        decoded->latency = instructionLatency(instr, model);
+        decoded->cause = stallCauseOf(instr);
+        decoded->useCount = getMipsUses(instr, decoded->uses);
+        decoded->defCount = getMipsDefs(instr, decoded->defs);
+    }
+    sim->stack = allocateOrDie(sizeof(unsigned int) * STACK_WORDS, "simulated stack");
+}
+
+// Returns the word at address, or NULL when it is unaligned or outside data and stack
+static unsigned int *wordAt(Simulator *sim, unsigned int address)
+{
+    if (address & 3)
+        return NULL;
+    if (address >= DATA_BASE && (address - DATA_BASE) / 4 < sim->dataWords)
+        return &sim->data[(address - DATA_BASE) / 4];
+    unsigned int stackBase = STACK_TOP + 4 - 4u * STACK_WORDS;
+    if (address >= stackBase && address <= STACK_TOP)
+        return &sim->stack[(address - stackBase) / 4];
+    return NULL;
+}
+
+static float floatOf(unsigned int bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static unsigned int bitsOf(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// The FPU's invalid-operation result for NaN and out-of-range values
+static unsigned int truncateToWord(float value)
+{
+    if (!(value > -2147483648.0f && value < 2147483648.0f))
+        return 0x7fffffff;
+    return (unsigned int)(int)value;
+}
+
+static void stopRun(SimulationResult *result, SimInstruction *at, const char *reason)
+{
+    printf("SIM: %s at %s\n", reason, at->instr->op);
+    result->completed = 0;
+}
+
+void simulateMips(MipsList *list, const LatencyModel *model, SimulationResult *result)
+{
+    simulateMipsReading(list, model, result, NULL, NULL, 0);
+}
+
+void simulateMipsReading(MipsList *list, const LatencyModel *model, SimulationResult *result, const char *symbol,
+                         unsigned int *words, int count)
+{
+    Simulator sim;
+    memset(&sim, 0, sizeof(sim));
+    memset(result, 0, sizeof(SimulationResult));
+    loadProgram(&sim, list, model);
+
+    unsigned int *regs = sim.regs;
+    long long readyAt[MIPS_REGISTER_COUNT] = {0};
+    StallCause producer[MIPS_REGISTER_COUNT] = {0};
+    regs[MIPS_REG_SP] = STACK_TOP + 4 - 16; // Room for the caller's argument save area
+    regs[MIPS_REG_RA] = RETURN_SENTINEL;
+
+    int pc = findLabel(&sim, "main")->value;
+    int pendingTarget = -1; // Taken branch waiting for its delay slot
+    long long cycle = 0;
+    result->completed = 1;
+    while (1)
+    {
+        if (pc < 0 || pc >= sim.codeCount)
+        {
+            if ((unsigned int)pc == RETURN_SENTINEL)
+                break;
+            printf("SIM: jump outside the program\n");
+            result->completed = 0;
+            break;
+        }
+        if (result->instructions > STEP_LIMIT)
+        {
+            printf("SIM: stopped after %lld instructions\n", result->instructions);
+            result->completed = 0;
+            break;
+        }
+
+        SimInstruction *current = &sim.code[pc];
+        MipsOperand *operands = current->instr->operands;
+        int rd = operands[0].reg;
+        int rs = operands[1].reg;
+        int rt = operands[2].reg;
+        int immediate = operands[current->instr->operandCount - 1].value;
+        unsigned int a = regs[rs];
+        unsigned int b = regs[rt];
+        int next = pc + 1;
+        int target = 0;
+        int taken = 0;
+        int stopped = 0;
+        unsigned int address = 0;
+        unsigned int *word = NULL;
+
+        // Wait for operands, then issue every machine word the instruction expands to
+        long long issue = cycle;
+        StallCause cause = STALL_ALU;
+        for (int i = 0; i < current->useCount; i++)
+        {
+            if (readyAt[current->uses[i]] > issue)
+            {
+                issue = readyAt[current->uses[i]];
+                cause = producer[current->uses[i]];
+            }
+        }
+        result->stalls[cause] += issue - cycle;
+        cycle = issue + current->words;
+        result->instructions += current->words;
+        for (int i = 0; i < current->defCount; i++)
+        {
+            readyAt[current->defs[i]] = issue + current->words - 1 + current->latency;
+            producer[current->defs[i]] = current->cause;
+        }
+
+        if (current->op == OP_LOAD || current->op == OP_STORE)
+        {
+            address = regs[operands[1].reg] + current->address;
+            word = wordAt(&sim, address);
+            if (!word)
+            {
+                stopRun(result, current, "bad memory access");
+                break;
+            }
+        }
+        unsigned int *lanes[4] = {NULL};
+        if (current->op == OP_LD_W || current->op == OP_ST_W)
+        {
+            address = regs[operands[1].reg] + current->address;
+            for (int lane = 0; lane < 4; lane++)
+                stopped |= !(lanes[lane] = wordAt(&sim, address + 4 * lane));
+            if (stopped)
+            {
+                stopRun(result, current, "bad memory access");
+                break;
+            }
+        }
+        // Vector operands, as MSA register numbers
+        unsigned int *wd = sim.vectors[(rd - MIPS_REG_W0) & 31];
+        unsigned int *ws = sim.vectors[(rs - MIPS_REG_W0) & 31];
+        unsigned int *wt = sim.vectors[(rt - MIPS_REG_W0) & 31];
+
+        switch (current->op)
+        {
+        case OP_ADD: regs[rd] = a + b; break;
+        case OP_SUB: regs[rd] = a - b; break;
+        case OP_AND: regs[rd] = a & b; break;
+        case OP_OR: regs[rd] = a | b; break;
+        case OP_XOR: regs[rd] = a ^ b; break;
+        case OP_NOR: regs[rd] = ~(a | b); break;
+        case OP_SLT: regs[rd] = (int)a < (int)b; break;
+        case OP_SLTU: regs[rd] = a < b; break;
+        case OP_MUL: regs[rd] = a * b; break;
+        case OP_SLLV: regs[rd] = a << (b & 31); break;
+        case OP_SLL: regs[rd] = a << (immediate & 31); break;
+        case OP_SRL: regs[rd] = a >> (immediate & 31); break;
+        case OP_SRA: regs[rd] = (unsigned int)((int)a >> (immediate & 31)); break;
+        case OP_MULT:
+        {
+            long long product = (long long)(int)regs[rd] * (int)regs[rs];
+            regs[MIPS_REG_LO] = (unsigned int)product;
+            regs[MIPS_REG_HI] = (unsigned int)(product >> 32);
+            break;
+        }
+        case OP_DIV:
+        {
+            int dividend = (int)regs[rd];
+            int divisor = (int)regs[rs];
+            if (divisor == 0)
+                break; // Unpredictable on hardware; HI and LO keep their values
+            if (dividend == (int)0x80000000 && divisor == -1)
+            {
+                regs[MIPS_REG_LO] = 0x80000000u;
+                regs[MIPS_REG_HI] = 0;
+                break;
+            }
+            regs[MIPS_REG_LO] = (unsigned int)(dividend / divisor);
+            regs[MIPS_REG_HI] = (unsigned int)(dividend % divisor);
+            break;
+        }
+        case OP_MFHI: regs[rd] = regs[MIPS_REG_HI]; break;
+        case OP_MFLO: regs[rd] = regs[MIPS_REG_LO]; break;
+        case OP_ADDI: regs[rd] = a + immediate; break;
+        case OP_SLTI: regs[rd] = (int)a < immediate; break;
+        case OP_SLTIU: regs[rd] = a < (unsigned int)immediate; break;
+        case OP_ANDI: regs[rd] = a & immediate; break;
+        case OP_ORI: regs[rd] = a | immediate; break;
+        case OP_XORI: regs[rd] = a ^ immediate; break;
+        case OP_LUI: regs[rd] = (unsigned int)immediate << 16; break;
+        case OP_LI: regs[rd] = immediate; break;
+        case OP_LA: regs[rd] = current->address; break;
+        case OP_MOVE: regs[rd] = a; break;
+        case OP_LOAD: regs[rd] = *word; break;
+        case OP_STORE: *word = regs[rd]; break;
+        case OP_BEQ: taken = regs[rd] == a; break;
+        case OP_BNE: taken = regs[rd] != a; break;
+        case OP_BEQZ: taken = regs[rd] == 0; break;
+        case OP_BNEZ: taken = regs[rd] != 0; break;
+        case OP_BLEZ: taken = (int)regs[rd] <= 0; break;
+        case OP_BGTZ: taken = (int)regs[rd] > 0; break;
+        case OP_BLTZ: taken = (int)regs[rd] < 0; break;
+        case OP_BGEZ: taken = (int)regs[rd] >= 0; break;
+        case OP_B:
+        case OP_J: taken = 1; break;
+        case OP_JAL:
+            // Returns past the delay slot, which is the assembler's nop in reorder mode
+            regs[MIPS_REG_RA] = sim.delaySlots ? pc + 2 : pc + 1;
+            taken = 1;
+            break;
+        case OP_JR:
+            target = (int)regs[rd];
+            taken = 1;
+            break;
+        case OP_TGEU:
+        case OP_TGEIU:
+            if (regs[rd] >= (current->op == OP_TGEU ? a : (unsigned int)immediate))
+            {
+                stopRun(result, current, "array bounds trap");
+                stopped = 1;
+            }
+            break;
+        case OP_ADD_S: regs[rd] = bitsOf(floatOf(a) + floatOf(b)); break;
+        case OP_SUB_S: regs[rd] = bitsOf(floatOf(a) - floatOf(b)); break;
+        case OP_MUL_S: regs[rd] = bitsOf(floatOf(a) * floatOf(b)); break;
+        case OP_DIV_S: regs[rd] = bitsOf(floatOf(a) / floatOf(b)); break;
+        case OP_NEG_S: regs[rd] = a ^ 0x80000000u; break;
+        case OP_MOV_S: regs[rd] = a; break;
+        case OP_CVT_S_W: regs[rd] = bitsOf((float)(int)a); break;
+        case OP_TRUNC_W_S: regs[rd] = truncateToWord(floatOf(a)); break;
+        case OP_MTC1: regs[rs] = regs[rd]; break;
+        case OP_MFC1: regs[rd] = a; break;
+        case OP_C_LT_S: regs[MIPS_REG_FCC] = floatOf(regs[rd]) < floatOf(a); break;
+        case OP_C_LE_S: regs[MIPS_REG_FCC] = floatOf(regs[rd]) <= floatOf(a); break;
+        case OP_C_EQ_S: regs[MIPS_REG_FCC] = floatOf(regs[rd]) == floatOf(a); break;
+        case OP_MOVF:
+            if (!regs[MIPS_REG_FCC])
+                regs[rd] = a;
+            break;
+        case OP_MOVT:
+            if (regs[MIPS_REG_FCC])
+                regs[rd] = a;
+            break;
+        case OP_LD_W:
+            for (int lane = 0; lane < 4; lane++)
+                wd[lane] = *lanes[lane];
+            break;
+        case OP_ST_W:
+            for (int lane = 0; lane < 4; lane++)
+                *lanes[lane] = wd[lane];
+            break;
+        case OP_ADDV_W: for (int lane = 0; lane < 4; lane++) wd[lane] = ws[lane] + wt[lane]; break;
+        case OP_SUBV_W: for (int lane = 0; lane < 4; lane++) wd[lane] = ws[lane] - wt[lane]; break;
+        case OP_MULV_W: for (int lane = 0; lane < 4; lane++) wd[lane] = ws[lane] * wt[lane]; break;
+        case OP_FADD_W: for (int lane = 0; lane < 4; lane++) wd[lane] = bitsOf(floatOf(ws[lane]) + floatOf(wt[lane])); break;
+        case OP_FSUB_W: for (int lane = 0; lane < 4; lane++) wd[lane] = bitsOf(floatOf(ws[lane]) - floatOf(wt[lane])); break;
+        case OP_FMUL_W: for (int lane = 0; lane < 4; lane++) wd[lane] = bitsOf(floatOf(ws[lane]) * floatOf(wt[lane])); break;
+        case OP_FDIV_W: for (int lane = 0; lane < 4; lane++) wd[lane] = bitsOf(floatOf(ws[lane]) / floatOf(wt[lane])); break;
+        case OP_FILL_W: for (int lane = 0; lane < 4; lane++) wd[lane] = a; break;
+        case OP_NOP:
+            result->stalls[STALL_BRANCH_DELAY]++;
+            break;
+        }
+        regs[MIPS_REG_ZERO] = 0;
+        if (stopped)
+            break;
+        if (taken && current->op != OP_JR)
+            target = current->target;
+
+        int transfers = mipsHasFlag(current->instr, MIPS_FLAG_BRANCH | MIPS_FLAG_JUMP | MIPS_FLAG_CALL);
+        if (transfers && !sim.delaySlots)
+        {
+            // The assembler's nop
+            cycle++;
+            result->instructions++;
+            result->stalls[STALL_BRANCH_DELAY]++;
+        }
+        if (taken)
+            result->takenBranches++;
+
+        if (pendingTarget != -1)
+        {
+            next = pendingTarget;
+            pendingTarget = -1;
+        }
+        else if (taken)
+        {
+            if (sim.delaySlots)
+                pendingTarget = target;
+            else
+                next = target;
+        }
+        pc = next;
+    }
+
+    result->returnValue = (int)regs[MIPS_REG_V0];
+    result->cycles = cycle + 4; // Drain the pipeline behind the last instruction
+    if (symbol)
+        memcpy(words, &sim.data[(findLabel(&sim, symbol)->value - DATA_BASE) / 4], sizeof(unsigned int) * count);
+    free(sim.code);
+    free(sim.labels);
+    free(sim.data);
+    free(sim.stack);
+}
+
+void printSimulationResult(const SimulationResult *result)
+{
+    if (result->completed)
+        printf("SIM: main returned %d\n", result->returnValue);
+    printf("SIM: %lld instructions, %lld cycles, CPI %.2f, %lld taken branches\n", result->instructions,
+           result->cycles, result->instructions ? (double)result->cycles / result->instructions : 0.0,
+           result->takenBranches);
+    printf("SIM: stall cycles %lld load-use, %lld multiply/divide, %lld fpu, %lld alu, %lld branch delay\n",
+           result->stalls[STALL_LOAD_USE], result->stalls[STALL_MULTIPLY_DIVIDE], result->stalls[STALL_FPU],
+           result->stalls[STALL_ALU], result->stalls[STALL_BRANCH_DELAY]);
+}
@@ -0,0 +1,38 @@
+#ifndef MIPS_SIMULATOR_H
+#define MIPS_SIMULATOR_H
+
+#include "MipsInstruction.h"
+#include "InstructionScheduler.h"
+
+// Where the cycles an in-order pipeline loses go
+typedef enum
+{
+    STALL_LOAD_USE,
+    STALL_MULTIPLY_DIVIDE, // Waiting on mul, HI/LO or mfhi/mflo
+    STALL_FPU,
+    STALL_ALU,
+    STALL_BRANCH_DELAY,    // nops executed in branch delay slots
+    STALL_CAUSE_COUNT
+} StallCause;
+
+typedef struct SimulationResult
+{
+    int returnValue; // $v0 when main returns
+    int completed;   // 0 after a trap, a bad access or the step limit
+    long long instructions;
+    long long cycles;
+    long long stalls[STALL_CAUSE_COUNT];
+    long long takenBranches;
+} SimulationResult;
+
+// Runs a whole program, as generateMIPS leaves it, from main until main returns.
+// Timing is a single-issue five-stage pipeline with full forwarding: an operand
+// not ready per model stalls the reader, and a branch's delay slot is a wasted
+// cycle when the assembler or the delay slot filler had to put a nop there.
+void simulateMips(MipsList *list, const LatencyModel *model, SimulationResult *result);
+// The same, then copies count words of data from symbol, as the run left them
+void simulateMipsReading(MipsList *list, const LatencyModel *model, SimulationResult *result, const char *symbol,
+                         unsigned int *words, int count);
+void printSimulationResult(const SimulationResult *result);
+
+#endif // MIPS_SIMULATOR_H
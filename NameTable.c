@@ -0,0 +1,24 @@
+#include "NameTable.h"
+#include <string.h>
+
+unsigned int hashName(const char *name)
+{
+    unsigned int hash = 2166136261u;
+    while (*name)
+    {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int probeNameTable(const void *table, int size, SlotName slotName, const char *name)
+{
+    unsigned int slot = hashName(name) & (size - 1);
+    const char *held;
+    while ((held = slotName(table, slot)) && strcmp(held, name) != 0)
+    {
+        slot = (slot + 1) & (size - 1);
+    }
+    return slot;
+}
@@ -0,0 +1,18 @@
+#ifndef NAME_TABLE_H
+#define NAME_TABLE_H
+
+// Open-addressed tables keyed by name: a power-of-two number of slots, probed
+// linearly from the name's hash. Each pass keeps its own slots and entries and
+// tells probeNameTable how to read them.
+
+// FNV-1a of the name
+unsigned int hashName(const char *name);
+
+// The name of the entry in slot, or NULL when the slot is empty
+typedef const char *(*SlotName)(const void *table, int slot);
+
+// The slot holding name, or the empty slot where it belongs. The table must
+// have an empty slot.
+int probeNameTable(const void *table, int size, SlotName slotName, const char *name);
+
+#endif // NAME_TABLE_H
@@ -0,0 +1,1054 @@
+#include "ObjectEmitter.h"
+#include "NameTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIPS_REG_AT 1
+
+// The parts of the ELF32 and MIPS psABI formats an o32 relocatable object needs
+#define ELF_HEADER_SIZE 52
+#define ELF_SECTION_HEADER_SIZE 40
+#define ELF_SYMBOL_SIZE 16
+#define ELF_RELOCATION_SIZE 8
+#define ET_REL 1
+#define EM_MIPS 8
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_NOBITS 8
+#define SHT_REL 9
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_SECTION 3
+#define EF_MIPS_NOREORDER 0x00000001
+#define EF_MIPS_FP64 0x00000200
+#define EF_MIPS_ABI_O32 0x00001000
+#define EF_MIPS_ARCH_32 0x50000000
+#define R_MIPS_26 4
+#define R_MIPS_HI16 5
+#define R_MIPS_LO16 6
+
+typedef enum
+{
+    SECTION_TEXT,
+    SECTION_DATA,
+    SECTION_RODATA,
+    SECTION_BSS,
+    SECTION_COUNT
+} SectionId;
+
+typedef enum
+{
+    FIXUP_BRANCH, // Word displacement from the delay slot, resolved here
+    FIXUP_JUMP,   // R_MIPS_26
+    FIXUP_HIGH,   // R_MIPS_HI16, rounded so the paired low half can be sign extended
+    FIXUP_LOW     // R_MIPS_LO16
+} FixupKind;
+
+typedef struct Fixup
+{
+    FixupKind kind;
+    int offset; // Of the instruction word within its section
+    const char *symbol;
+    int addend;
+} Fixup;
+
+typedef struct Relocation
+{
+    int offset;
+    int type;
+    int symbol; // Index into the writer's symbols
+} Relocation;
+
+typedef struct ByteBuffer
+{
+    unsigned char *bytes;
+    int size;
+    int capacity;
+} ByteBuffer;
+
+typedef struct ObjectSection
+{
+    const char *name;
+    int type;
+    int flags;
+    int alignment;
+    int used;
+    ByteBuffer contents; // Only size is kept for .bss
+    Fixup *fixups;
+    int fixupCount;
+    int fixupCapacity;
+    Relocation *relocations;
+    int relocationCount;
+    int relocationCapacity;
+    int symbol;      // Its STT_SECTION symbol
+    int index;       // In the section header table
+    int fileOffset;
+} ObjectSection;
+
+typedef struct ObjectSymbol
+{
+    const char *name;
+    int section; // -1 while undefined
+    int value;
+    int isGlobal;
+    int isSection;
+    int index;   // In .symtab
+} ObjectSymbol;
+
+typedef struct ObjectWriter
+{
+    ObjectSection sections[SECTION_COUNT];
+    ObjectSymbol *symbols;
+    int symbolCount;
+    int symbolCapacity;
+    int *nameTable; // Open addressing over labels, -1 when empty
+    int nameTableSize;
+    int current;    // Section being filled
+    int reorder;    // Outside .set noreorder the assembler owns the delay slots
+    int usedNoreorder;
+    int usedFp64;   // .set fp=64, which MSA code needs
+    int inDelaySlot;
+} ObjectWriter;
+
+typedef enum
+{
+    FORMAT_REGISTER,          // rd, rs, rt
+    FORMAT_SHIFT_VARIABLE,    // rd, rt, rs
+    FORMAT_SHIFT,             // rd, rt, shamt
+    FORMAT_HILO,              // rs, rt into HI/LO
+    FORMAT_MOVE_FROM_HILO,    // rd
+    FORMAT_SIGNED_IMMEDIATE,  // rt, rs, imm
+    FORMAT_UNSIGNED_IMMEDIATE,
+    FORMAT_UPPER_IMMEDIATE,   // rt, imm
+    FORMAT_MEMORY,            // rt, offset(base) or symbol+offset(base)
+    FORMAT_BRANCH_COMPARE,    // rs, rt, label
+    FORMAT_BRANCH_ZERO,       // rs, label; field is the rt code
+    FORMAT_JUMP,              // label
+    FORMAT_JUMP_REGISTER,     // rs
+    FORMAT_TRAP,              // rs, rt
+    FORMAT_TRAP_IMMEDIATE,    // rs, imm; field is the REGIMM code
+    FORMAT_FLOAT_ARITHMETIC,  // fd, fs, ft; field is fmt
+    FORMAT_FLOAT_UNARY,       // fd, fs
+    FORMAT_FLOAT_COMPARE,     // fs, ft
+    FORMAT_FLOAT_TRANSFER,    // rt, fs; field is the move direction
+    FORMAT_CONDITIONAL_MOVE,  // rd, rs, $fccN; field is the true/false bit
+    FORMAT_VECTOR_ARITHMETIC, // wd, ws, wt; field is the operation and format bits, function the minor opcode
+    FORMAT_VECTOR_FILL,       // wd, rs
+    FORMAT_VECTOR_MEMORY,     // wd, offset(base), the offset in words
+    FORMAT_PSEUDO             // li, la, move, b and nop
+} EncodingFormat;
+
+typedef struct MachineEncoding
+{
+    const char *mnemonic;
+    EncodingFormat format;
+    unsigned int opcode;
+    unsigned int field;
+    unsigned int function;
+    const char *registerForm; // Used through $at when an immediate does not fit
+} MachineEncoding;
+
+// Every opcode in MipsInstruction.c's table needs an entry here
+static const MachineEncoding encodingTable[] = {
+    {"add", FORMAT_REGISTER, 0x00, 0, 0x20, NULL},
+    {"addu", FORMAT_REGISTER, 0x00, 0, 0x21, NULL},
+    {"sub", FORMAT_REGISTER, 0x00, 0, 0x22, NULL},
+    {"subu", FORMAT_REGISTER, 0x00, 0, 0x23, NULL},
+    {"and", FORMAT_REGISTER, 0x00, 0, 0x24, NULL},
+    {"or", FORMAT_REGISTER, 0x00, 0, 0x25, NULL},
+    {"xor", FORMAT_REGISTER, 0x00, 0, 0x26, NULL},
+    {"nor", FORMAT_REGISTER, 0x00, 0, 0x27, NULL},
+    {"slt", FORMAT_REGISTER, 0x00, 0, 0x2a, NULL},
+    {"sltu", FORMAT_REGISTER, 0x00, 0, 0x2b, NULL},
+    {"mul", FORMAT_REGISTER, 0x1c, 0, 0x02, NULL},
+    {"sllv", FORMAT_SHIFT_VARIABLE, 0x00, 0, 0x04, NULL},
+    {"sll", FORMAT_SHIFT, 0x00, 0, 0x00, NULL},
+    {"srl", FORMAT_SHIFT, 0x00, 0, 0x02, NULL},
+    {"sra", FORMAT_SHIFT, 0x00, 0, 0x03, NULL},
+    {"mult", FORMAT_HILO, 0x00, 0, 0x18, NULL},
+    {"div", FORMAT_HILO, 0x00, 0, 0x1a, NULL},
+    {"mfhi", FORMAT_MOVE_FROM_HILO, 0x00, 0, 0x10, NULL},
+    {"mflo", FORMAT_MOVE_FROM_HILO, 0x00, 0, 0x12, NULL},
+    {"addi", FORMAT_SIGNED_IMMEDIATE, 0x08, 0, 0, "add"},
+    {"addiu", FORMAT_SIGNED_IMMEDIATE, 0x09, 0, 0, "addu"},
+    {"slti", FORMAT_SIGNED_IMMEDIATE, 0x0a, 0, 0, "slt"},
+    {"sltiu", FORMAT_SIGNED_IMMEDIATE, 0x0b, 0, 0, "sltu"},
+    {"andi", FORMAT_UNSIGNED_IMMEDIATE, 0x0c, 0, 0, "and"},
+    {"ori", FORMAT_UNSIGNED_IMMEDIATE, 0x0d, 0, 0, "or"},
+    {"xori", FORMAT_UNSIGNED_IMMEDIATE, 0x0e, 0, 0, "xor"},
+    {"lui", FORMAT_UPPER_IMMEDIATE, 0x0f, 0, 0, NULL},
+    {"lw", FORMAT_MEMORY, 0x23, 0, 0, NULL},
+    {"sw", FORMAT_MEMORY, 0x2b, 0, 0, NULL},
+    {"lwc1", FORMAT_MEMORY, 0x31, 0, 0, NULL},
+    {"swc1", FORMAT_MEMORY, 0x39, 0, 0, NULL},
+    {"beq", FORMAT_BRANCH_COMPARE, 0x04, 0, 0, NULL},
+    {"bne", FORMAT_BRANCH_COMPARE, 0x05, 0, 0, NULL},
+    {"beqz", FORMAT_BRANCH_ZERO, 0x04, 0, 0, NULL},
+    {"bnez", FORMAT_BRANCH_ZERO, 0x05, 0, 0, NULL},
+    {"blez", FORMAT_BRANCH_ZERO, 0x06, 0, 0, NULL},
+    {"bgtz", FORMAT_BRANCH_ZERO, 0x07, 0, 0, NULL},
+    {"bltz", FORMAT_BRANCH_ZERO, 0x01, 0x00, 0, NULL},
+    {"bgez", FORMAT_BRANCH_ZERO, 0x01, 0x01, 0, NULL},
+    {"j", FORMAT_JUMP, 0x02, 0, 0, NULL},
+    {"jal", FORMAT_JUMP, 0x03, 0, 0, NULL},
+    {"jr", FORMAT_JUMP_REGISTER, 0x00, 0, 0x08, NULL},
+    {"tgeu", FORMAT_TRAP, 0x00, 0, 0x31, NULL},
+    {"tgeiu", FORMAT_TRAP_IMMEDIATE, 0x01, 0x09, 0, "tgeu"},
+    {"add.s", FORMAT_FLOAT_ARITHMETIC, 0x11, 0x10, 0x00, NULL},
+    {"sub.s", FORMAT_FLOAT_ARITHMETIC, 0x11, 0x10, 0x01, NULL},
+    {"mul.s", FORMAT_FLOAT_ARITHMETIC, 0x11, 0x10, 0x02, NULL},
+    {"div.s", FORMAT_FLOAT_ARITHMETIC, 0x11, 0x10, 0x03, NULL},
+    {"mov.s", FORMAT_FLOAT_UNARY, 0x11, 0x10, 0x06, NULL},
+    {"neg.s", FORMAT_FLOAT_UNARY, 0x11, 0x10, 0x07, NULL},
+    {"trunc.w.s", FORMAT_FLOAT_UNARY, 0x11, 0x10, 0x0d, NULL},
+    {"cvt.s.w", FORMAT_FLOAT_UNARY, 0x11, 0x14, 0x20, NULL},
+    {"c.eq.s", FORMAT_FLOAT_COMPARE, 0x11, 0x10, 0x32, NULL},
+    {"c.lt.s", FORMAT_FLOAT_COMPARE, 0x11, 0x10, 0x3c, NULL},
+    {"c.le.s", FORMAT_FLOAT_COMPARE, 0x11, 0x10, 0x3e, NULL},
+    {"mfc1", FORMAT_FLOAT_TRANSFER, 0x11, 0x00, 0, NULL},
+    {"mtc1", FORMAT_FLOAT_TRANSFER, 0x11, 0x04, 0, NULL},
+    {"movf", FORMAT_CONDITIONAL_MOVE, 0x00, 0, 0x01, NULL},
+    {"movt", FORMAT_CONDITIONAL_MOVE, 0x00, 1, 0x01, NULL},
+    {"addv.w", FORMAT_VECTOR_ARITHMETIC, 0x1e, 0x00400000, 0x0e, NULL},
+    {"subv.w", FORMAT_VECTOR_ARITHMETIC, 0x1e, 0x00c00000, 0x0e, NULL},
+    {"mulv.w", FORMAT_VECTOR_ARITHMETIC, 0x1e, 0x00400000, 0x12, NULL},
+    {"fadd.w", FORMAT_VECTOR_ARITHMETIC, 0x1e, 0x00000000, 0x1b, NULL},
+    {"fsub.w", FORMAT_VECTOR_ARITHMETIC, 0x1e, 0x00400000, 0x1b, NULL},
+    {"fmul.w", FORMAT_VECTOR_ARITHMETIC, 0x1e, 0x00800000, 0x1b, NULL},
+    {"fdiv.w", FORMAT_VECTOR_ARITHMETIC, 0x1e, 0x00c00000, 0x1b, NULL},
+    {"fill.w", FORMAT_VECTOR_FILL, 0x1e, 0x03020000, 0x1e, NULL},
+    {"ld.w", FORMAT_VECTOR_MEMORY, 0x1e, 0, 0x22, NULL},
+    {"st.w", FORMAT_VECTOR_MEMORY, 0x1e, 0, 0x26, NULL},
+    {"li", FORMAT_PSEUDO, 0, 0, 0, NULL},
+    {"la", FORMAT_PSEUDO, 0, 0, 0, NULL},
+    {"move", FORMAT_PSEUDO, 0, 0, 0, NULL},
+    {"b", FORMAT_PSEUDO, 0, 0, 0, NULL},
+    {"nop", FORMAT_PSEUDO, 0, 0, 0, NULL},
+    {NULL, FORMAT_PSEUDO, 0, 0, 0, NULL}};
+
+static const MachineEncoding *findEncoding(const char *mnemonic)
+{
+    for (const MachineEncoding *encoding = encodingTable; encoding->mnemonic; encoding++)
+    {
+        if (strcmp(encoding->mnemonic, mnemonic) == 0)
+            return encoding;
+    }
+    fprintf(stderr, "Error: No machine encoding for %s\n", mnemonic);
+    exit(EXIT_FAILURE);
+}
+
+static void *growArray(void *array, int *capacity, int count, size_t size, const char *what)
+{
+    if (count < *capacity)
+        return array;
+    *capacity = *capacity ? 2 * *capacity : 16;
+    array = realloc(array, size * *capacity);
+    if (!array)
+    {
+        fprintf(stderr, "Failed to allocate %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+static void appendBytes(ByteBuffer *buffer, const void *data, int length)
+{
+    while (buffer->size + length > buffer->capacity)
+        buffer->bytes = growArray(buffer->bytes, &buffer->capacity, buffer->size + length, 1, "object section");
+    memcpy(buffer->bytes + buffer->size, data, length);
+    buffer->size += length;
+}
+
+static void putWord(unsigned char *bytes, unsigned int value)
+{
+    bytes[0] = value >> 24;
+    bytes[1] = value >> 16;
+    bytes[2] = value >> 8;
+    bytes[3] = value;
+}
+
+static unsigned int getWord(const unsigned char *bytes)
+{
+    return (unsigned int)bytes[0] << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
+}
+
+static const char *symbolInSlot(const void *table, int slot)
+{
+    const ObjectWriter *writer = table;
+    int index = writer->nameTable[slot];
+    return index < 0 ? NULL : writer->symbols[index].name;
+}
+
+static int probeSymbol(ObjectWriter *writer, const char *name)
+{
+    return probeNameTable(writer, writer->nameTableSize, symbolInSlot, name);
+}
+
+static int addSymbol(ObjectWriter *writer, const char *name, int section, int isSection)
+{
+    writer->symbols = growArray(writer->symbols, &writer->symbolCapacity, writer->symbolCount,
+                                sizeof(ObjectSymbol), "object symbols");
+    ObjectSymbol *symbol = &writer->symbols[writer->symbolCount];
+    symbol->name = name;
+    symbol->section = section;
+    symbol->value = 0;
+    symbol->isGlobal = 0;
+    symbol->isSection = isSection;
+    symbol->index = 0;
+    return writer->symbolCount++;
+}
+
+// Returns the label's symbol, adding it as undefined the first time it is named
+static ObjectSymbol *internSymbol(ObjectWriter *writer, const char *name)
+{
+    if (2 * (writer->symbolCount + 1) > writer->nameTableSize)
+    {
+        free(writer->nameTable);
+        writer->nameTableSize = writer->nameTableSize ? 2 * writer->nameTableSize : 64;
+        writer->nameTable = malloc(sizeof(int) * writer->nameTableSize);
+        if (!writer->nameTable)
+        {
+            perror("Failed to allocate object symbol table");
+            exit(EXIT_FAILURE);
+        }
+        memset(writer->nameTable, -1, sizeof(int) * writer->nameTableSize);
+        for (int i = 0; i < writer->symbolCount; i++)
+        {
+            if (!writer->symbols[i].isSection)
+                writer->nameTable[probeSymbol(writer, writer->symbols[i].name)] = i;
+        }
+    }
+    int slot = probeSymbol(writer, name);
+    if (writer->nameTable[slot] < 0)
+        writer->nameTable[slot] = addSymbol(writer, name, -1, 0);
+    return &writer->symbols[writer->nameTable[slot]];
+}
+
+static void initializeWriter(ObjectWriter *writer)
+{
+    static const char *names[SECTION_COUNT] = {".text", ".data", ".rodata", ".bss"};
+    static const int types[SECTION_COUNT] = {SHT_PROGBITS, SHT_PROGBITS, SHT_PROGBITS, SHT_NOBITS};
+    static const int flags[SECTION_COUNT] = {SHF_ALLOC | SHF_EXECINSTR, SHF_ALLOC | SHF_WRITE, SHF_ALLOC,
+                                             SHF_ALLOC | SHF_WRITE};
+    memset(writer, 0, sizeof(ObjectWriter));
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        ObjectSection *section = &writer->sections[i];
+        section->name = names[i];
+        section->type = types[i];
+        section->flags = flags[i];
+        section->alignment = 4;
+        section->symbol = addSymbol(writer, names[i], i, 1);
+    }
+    writer->sections[SECTION_TEXT].used = 1;
+    writer->current = SECTION_TEXT;
+    writer->reorder = 1;
+}
+
+static ObjectSection *currentSection(ObjectWriter *writer)
+{
+    return &writer->sections[writer->current];
+}
+
+static void reserveBytes(ObjectWriter *writer, int length)
+{
+    ObjectSection *section = currentSection(writer);
+    if (section->type == SHT_NOBITS)
+    {
+        section->contents.size += length;
+        return;
+    }
+    static const unsigned char zeros[16];
+    while (length > 0)
+    {
+        int chunk = length < (int)sizeof(zeros) ? length : (int)sizeof(zeros);
+        appendBytes(&section->contents, zeros, chunk);
+        length -= chunk;
+    }
+}
+
+static void emitDataWord(ObjectWriter *writer, unsigned int value)
+{
+    ObjectSection *section = currentSection(writer);
+    if (section->type == SHT_NOBITS)
+    {
+        fprintf(stderr, "Error: Initialized data in %s\n", section->name);
+        exit(EXIT_FAILURE);
+    }
+    unsigned char bytes[4];
+    putWord(bytes, value);
+    appendBytes(&section->contents, bytes, 4);
+}
+
+static void emitWord(ObjectWriter *writer, unsigned int word)
+{
+    if (writer->inDelaySlot > 1)
+        fprintf(stderr, "Warning: Macro expanded into several instructions in a branch delay slot\n");
+    if (writer->inDelaySlot)
+        writer->inDelaySlot++;
+    emitDataWord(writer, word);
+}
+
+// Records that the next word emitted refers to symbol
+static void addFixup(ObjectWriter *writer, FixupKind kind, const char *symbol, int addend)
+{
+    ObjectSection *section = currentSection(writer);
+    section->fixups = growArray(section->fixups, &section->fixupCapacity, section->fixupCount, sizeof(Fixup),
+                                "object fixups");
+    Fixup *fixup = &section->fixups[section->fixupCount++];
+    fixup->kind = kind;
+    fixup->offset = section->contents.size;
+    fixup->symbol = symbol;
+    fixup->addend = addend;
+}
+
+static unsigned int encodeRegister(unsigned int opcode, int rs, int rt, int rd, int shift, unsigned int function)
+{
+    return opcode << 26 | (unsigned int)rs << 21 | (unsigned int)rt << 16 | (unsigned int)rd << 11 |
+           (unsigned int)shift << 6 | function;
+}
+
+static unsigned int encodeImmediate(unsigned int opcode, int rs, int rt, int immediate)
+{
+    return opcode << 26 | (unsigned int)rs << 21 | (unsigned int)rt << 16 | (immediate & 0xffff);
+}
+
+// MSA's register-to-register forms: field holds everything above wt
+static unsigned int encodeVector(unsigned int opcode, unsigned int field, int wt, int ws, int wd, unsigned int function)
+{
+    return opcode << 26 | field | (unsigned int)wt << 16 | (unsigned int)ws << 11 | (unsigned int)wd << 6 | function;
+}
+
+// Hardware register field: general registers as is, $fN and $wN as N and $fccN as N
+static int fieldOf(MipsOperand operand)
+{
+    if (operand.reg >= MIPS_REG_F0 && operand.reg < MIPS_REG_F0 + 32)
+        return operand.reg - MIPS_REG_F0;
+    if (operand.reg >= MIPS_REG_W0 && operand.reg < MIPS_REG_W0 + 32)
+        return operand.reg - MIPS_REG_W0;
+    if (operand.reg == MIPS_REG_FCC)
+        return 0;
+    return operand.reg;
+}
+
+static int fitsSigned(int value)
+{
+    return value >= -32768 && value <= 32767;
+}
+
+static int fitsUnsigned(int value)
+{
+    return value >= 0 && value <= 65535;
+}
+
+// addiu for 16-bit signed values, ori for 16-bit unsigned, otherwise lui and an ori of any low half
+static void loadImmediate(ObjectWriter *writer, int rt, int value)
+{
+    if (fitsSigned(value))
+    {
+        emitWord(writer, encodeImmediate(0x09, MIPS_REG_ZERO, rt, value));
+    }
+    else if (fitsUnsigned(value))
+    {
+        emitWord(writer, encodeImmediate(0x0d, MIPS_REG_ZERO, rt, value));
+    }
+    else
+    {
+        emitWord(writer, encodeImmediate(0x0f, 0, rt, (unsigned int)value >> 16));
+        if (value & 0xffff)
+            emitWord(writer, encodeImmediate(0x0d, rt, rt, value));
+    }
+}
+
+static void encodeRegisterForm(ObjectWriter *writer, const MachineEncoding *encoding, int rd, int rs, int value)
+{
+    const MachineEncoding *wide = findEncoding(encoding->registerForm);
+    loadImmediate(writer, MIPS_REG_AT, value);
+    emitWord(writer, encodeRegister(wide->opcode, rs, MIPS_REG_AT, rd, 0, wide->function));
+}
+
+// A symbol address takes a lui of its high half; the low half goes into the access itself.
+// Loads into a general register build the address in the destination unless it is also
+// the base, everything else goes through $at.
+static void encodeMemory(ObjectWriter *writer, const MachineEncoding *encoding, MipsInstruction *instr)
+{
+    int rt = fieldOf(instr->operands[0]);
+    MipsOperand address = instr->operands[1];
+    if (!address.label && fitsSigned(address.value))
+    {
+        emitWord(writer, encodeImmediate(encoding->opcode, address.reg, rt, address.value));
+        return;
+    }
+
+    int temporary = MIPS_REG_AT;
+    if (encoding->opcode == 0x23 && rt != address.reg && rt != MIPS_REG_ZERO)
+        temporary = rt;
+    if (address.label)
+        addFixup(writer, FIXUP_HIGH, address.label, address.value);
+    emitWord(writer, encodeImmediate(0x0f, 0, temporary, address.label ? 0 : (address.value + 0x8000) >> 16));
+    if (address.reg != MIPS_REG_ZERO)
+        emitWord(writer, encodeRegister(0x00, temporary, address.reg, temporary, 0, 0x21));
+    if (address.label)
+        addFixup(writer, FIXUP_LOW, address.label, address.value);
+    emitWord(writer, encodeImmediate(encoding->opcode, temporary, rt, address.label ? 0 : address.value));
+}
+
+static void encodePseudo(ObjectWriter *writer, MipsInstruction *instr)
+{
+    if (strcmp(instr->op, "li") == 0)
+    {
+        loadImmediate(writer, fieldOf(instr->operands[0]), instr->operands[1].value);
+    }
+    else if (strcmp(instr->op, "la") == 0)
+    {
+        int rd = fieldOf(instr->operands[0]);
+        addFixup(writer, FIXUP_HIGH, instr->operands[1].label, instr->operands[1].value);
+        emitWord(writer, encodeImmediate(0x0f, 0, rd, 0));
+        addFixup(writer, FIXUP_LOW, instr->operands[1].label, instr->operands[1].value);
+        emitWord(writer, encodeImmediate(0x09, rd, rd, 0));
+    }
+    else if (strcmp(instr->op, "move") == 0)
+    {
+        emitWord(writer, encodeRegister(0x00, fieldOf(instr->operands[1]), MIPS_REG_ZERO, fieldOf(instr->operands[0]),
+                                        0, 0x25));
+    }
+    else if (strcmp(instr->op, "b") == 0)
+    {
+        addFixup(writer, FIXUP_BRANCH, instr->operands[0].label, 0);
+        emitWord(writer, encodeImmediate(0x04, MIPS_REG_ZERO, MIPS_REG_ZERO, 0));
+    }
+    else
+    {
+        emitWord(writer, 0); // nop
+    }
+}
+
+static void encodeInstruction(ObjectWriter *writer, MipsInstruction *instr)
+{
+    const MachineEncoding *encoding = findEncoding(instr->op);
+    MipsOperand *operands = instr->operands;
+    int value = operands[instr->operandCount - 1].value;
+
+    switch (encoding->format)
+    {
+    case FORMAT_REGISTER:
+        emitWord(writer, encodeRegister(encoding->opcode, fieldOf(operands[1]), fieldOf(operands[2]),
+                                        fieldOf(operands[0]), 0, encoding->function));
+        break;
+    case FORMAT_SHIFT_VARIABLE:
+        emitWord(writer, encodeRegister(0x00, fieldOf(operands[2]), fieldOf(operands[1]), fieldOf(operands[0]), 0,
+                                        encoding->function));
+        break;
+    case FORMAT_SHIFT:
+        emitWord(writer, encodeRegister(0x00, 0, fieldOf(operands[1]), fieldOf(operands[0]), value & 31,
+                                        encoding->function));
+        break;
+    case FORMAT_HILO:
+        emitWord(writer, encodeRegister(0x00, fieldOf(operands[0]), fieldOf(operands[1]), 0, 0, encoding->function));
+        break;
+    case FORMAT_MOVE_FROM_HILO:
+        emitWord(writer, encodeRegister(0x00, 0, 0, fieldOf(operands[0]), 0, encoding->function));
+        break;
+    case FORMAT_SIGNED_IMMEDIATE:
+    case FORMAT_UNSIGNED_IMMEDIATE:
+        if (encoding->format == FORMAT_SIGNED_IMMEDIATE ? fitsSigned(value) : fitsUnsigned(value))
+            emitWord(writer, encodeImmediate(encoding->opcode, fieldOf(operands[1]), fieldOf(operands[0]), value));
+        else
+            encodeRegisterForm(writer, encoding, fieldOf(operands[0]), fieldOf(operands[1]), value);
+        break;
+    case FORMAT_UPPER_IMMEDIATE:
+        emitWord(writer, encodeImmediate(encoding->opcode, 0, fieldOf(operands[0]), value));
+        break;
+    case FORMAT_MEMORY:
+        encodeMemory(writer, encoding, instr);
+        break;
+    case FORMAT_BRANCH_COMPARE:
+        addFixup(writer, FIXUP_BRANCH, operands[2].label, 0);
+        emitWord(writer, encodeImmediate(encoding->opcode, fieldOf(operands[0]), fieldOf(operands[1]), 0));
+        break;
+    case FORMAT_BRANCH_ZERO:
+        addFixup(writer, FIXUP_BRANCH, operands[1].label, 0);
+        emitWord(writer, encodeImmediate(encoding->opcode, fieldOf(operands[0]), encoding->field, 0));
+        break;
+    case FORMAT_JUMP:
+        addFixup(writer, FIXUP_JUMP, operands[0].label, 0);
+        emitWord(writer, encoding->opcode << 26);
+        break;
+    case FORMAT_JUMP_REGISTER:
+        emitWord(writer, encodeRegister(0x00, fieldOf(operands[0]), 0, 0, 0, encoding->function));
+        break;
+    case FORMAT_TRAP:
+        emitWord(writer, encodeRegister(0x00, fieldOf(operands[0]), fieldOf(operands[1]), 0, 0, encoding->function));
+        break;
+    case FORMAT_TRAP_IMMEDIATE:
+        if (fitsSigned(value))
+        {
+            emitWord(writer, encodeImmediate(encoding->opcode, fieldOf(operands[0]), encoding->field, value));
+        }
+        else
+        {
+            const MachineEncoding *wide = findEncoding(encoding->registerForm);
+            loadImmediate(writer, MIPS_REG_AT, value);
+            emitWord(writer, encodeRegister(0x00, fieldOf(operands[0]), MIPS_REG_AT, 0, 0, wide->function));
+        }
+        break;
+    case FORMAT_FLOAT_ARITHMETIC:
+        emitWord(writer, encodeRegister(encoding->opcode, encoding->field, fieldOf(operands[2]), fieldOf(operands[1]),
+                                        fieldOf(operands[0]), encoding->function));
+        break;
+    case FORMAT_FLOAT_UNARY:
+        emitWord(writer, encodeRegister(encoding->opcode, encoding->field, 0, fieldOf(operands[1]),
+                                        fieldOf(operands[0]), encoding->function));
+        break;
+    case FORMAT_FLOAT_COMPARE:
+        emitWord(writer, encodeRegister(encoding->opcode, encoding->field, fieldOf(operands[1]), fieldOf(operands[0]),
+                                        0, encoding->function));
+        break;
+    case FORMAT_FLOAT_TRANSFER:
+        emitWord(writer, encodeRegister(encoding->opcode, encoding->field, fieldOf(operands[0]), fieldOf(operands[1]),
+                                        0, 0));
+        break;
+    case FORMAT_CONDITIONAL_MOVE:
+        emitWord(writer, encodeRegister(0x00, fieldOf(operands[1]), fieldOf(operands[2]) << 2 | encoding->field,
+                                        fieldOf(operands[0]), 0, encoding->function));
+        break;
+    case FORMAT_VECTOR_ARITHMETIC:
+        emitWord(writer, encodeVector(encoding->opcode, encoding->field, fieldOf(operands[2]), fieldOf(operands[1]),
+                                      fieldOf(operands[0]), encoding->function));
+        break;
+    case FORMAT_VECTOR_FILL:
+        emitWord(writer, encodeVector(encoding->opcode, encoding->field, 0, fieldOf(operands[1]), fieldOf(operands[0]),
+                                      encoding->function));
+        break;
+    case FORMAT_VECTOR_MEMORY:
+        // The generator only ever addresses vectors through a register, at offset 0
+        emitWord(writer, encodeVector(encoding->opcode, (unsigned int)(operands[1].value / 4 & 0x3ff) << 16, 0,
+                                      operands[1].reg, fieldOf(operands[0]), encoding->function));
+        break;
+    case FORMAT_PSEUDO:
+        encodePseudo(writer, instr);
+        break;
+    }
+}
+
+static void defineLabel(ObjectWriter *writer, const char *name)
+{
+    ObjectSymbol *symbol = internSymbol(writer, name);
+    if (symbol->section >= 0)
+    {
+        fprintf(stderr, "Error: Label %s defined twice\n", name);
+        exit(EXIT_FAILURE);
+    }
+    symbol->section = writer->current;
+    symbol->value = currentSection(writer)->contents.size;
+}
+
+static void encodeDirective(ObjectWriter *writer, MipsInstruction *instr)
+{
+    const char *directive = instr->op;
+    MipsOperand operand = instr->operands[0];
+    if (strcmp(directive, ".text") == 0 || strcmp(directive, ".data") == 0 || strcmp(directive, ".bss") == 0 ||
+        strcmp(directive, ".rdata") == 0 || strcmp(directive, ".rodata") == 0)
+    {
+        // The assembler puts .rdata in .rodata on ELF targets
+        writer->current = directive[1] == 't' ? SECTION_TEXT : directive[1] == 'd' ? SECTION_DATA
+                                                           : directive[1] == 'b' ? SECTION_BSS
+                                                                                 : SECTION_RODATA;
+        currentSection(writer)->used = 1;
+    }
+    else if (strcmp(directive, ".align") == 0)
+    {
+        ObjectSection *section = currentSection(writer);
+        int alignment = 1 << operand.value;
+        if (alignment > section->alignment)
+            section->alignment = alignment;
+        reserveBytes(writer, (alignment - section->contents.size % alignment) % alignment);
+    }
+    else if (strcmp(directive, ".globl") == 0)
+    {
+        internSymbol(writer, operand.label)->isGlobal = 1;
+    }
+    else if (strcmp(directive, ".set") == 0 && strcmp(operand.label, "noreorder") == 0)
+    {
+        writer->reorder = 0;
+        writer->usedNoreorder = 1;
+    }
+    else if (strcmp(directive, ".set") == 0 && strcmp(operand.label, "reorder") == 0)
+    {
+        writer->reorder = 1;
+    }
+    else if (strcmp(directive, ".set") == 0 && (strcmp(operand.label, "fp=64") == 0 || strcmp(operand.label, "msa") == 0))
+    {
+        writer->usedFp64 = 1; // MSA runs with the 64-bit FPU registers
+    }
+    else if (strcmp(directive, ".word") == 0 && operand.kind == OPERAND_IMMEDIATE)
+    {
+        emitDataWord(writer, operand.value);
+    }
+    else if (strcmp(directive, ".float") == 0)
+    {
+        float value = strtof(operand.label, NULL);
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        emitDataWord(writer, bits);
+    }
+    else if (strcmp(directive, ".space") == 0)
+    {
+        reserveBytes(writer, operand.value);
+    }
+    else
+    {
+        fprintf(stderr, "Error: Cannot encode directive %s\n", directive);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void addRelocation(ObjectSection *section, int offset, int type, int symbol)
+{
+    section->relocations = growArray(section->relocations, &section->relocationCapacity, section->relocationCount,
+                                     sizeof(Relocation), "object relocations");
+    Relocation *relocation = &section->relocations[section->relocationCount++];
+    relocation->offset = offset;
+    relocation->type = type;
+    relocation->symbol = symbol;
+}
+
+// Branches are resolved here; everything else becomes a REL relocation with its
+// addend in the instruction. Local labels are relocated against their section
+// symbol, the way the assembler does it, so only globals need to be in .symtab.
+static void resolveFixups(ObjectWriter *writer)
+{
+    static const int relocationTypes[] = {0, R_MIPS_26, R_MIPS_HI16, R_MIPS_LO16};
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        ObjectSection *section = &writer->sections[s];
+        for (int i = 0; i < section->fixupCount; i++)
+        {
+            Fixup *fixup = &section->fixups[i];
+            ObjectSymbol *symbol = internSymbol(writer, fixup->symbol);
+            unsigned char *word = section->contents.bytes + fixup->offset;
+            unsigned int instruction = getWord(word);
+
+            if (fixup->kind == FIXUP_BRANCH)
+            {
+                int displacement = (symbol->value - (fixup->offset + 4)) >> 2;
+                if (symbol->section != s || !fitsSigned(displacement))
+                {
+                    fprintf(stderr, "Error: Branch to %s is out of range\n", fixup->symbol);
+                    exit(EXIT_FAILURE);
+                }
+                putWord(word, instruction | (displacement & 0xffff));
+                continue;
+            }
+
+            int target = symbol - writer->symbols;
+            int addend = fixup->addend;
+            if (symbol->section >= 0 && !symbol->isGlobal)
+            {
+                target = writer->sections[symbol->section].symbol;
+                addend += symbol->value;
+            }
+            else if (symbol->section < 0)
+            {
+                symbol->isGlobal = 1; // Left for the linker
+            }
+            if (fixup->kind == FIXUP_JUMP)
+                instruction |= ((unsigned int)addend >> 2) & 0x3ffffff;
+            else if (fixup->kind == FIXUP_HIGH)
+                instruction |= ((unsigned int)(addend + 0x8000) >> 16) & 0xffff;
+            else
+                instruction |= addend & 0xffff;
+            putWord(word, instruction);
+            addRelocation(section, fixup->offset, relocationTypes[fixup->kind], target);
+        }
+    }
+}
+
+static void emitWordTo(AsmEmitter *out, unsigned int value)
+{
+    unsigned char bytes[4];
+    putWord(bytes, value);
+    emitBytes(out, (const char *)bytes, 4);
+}
+
+static void emitHalfTo(AsmEmitter *out, unsigned int value)
+{
+    char bytes[2] = {(char)(value >> 8), (char)value};
+    emitBytes(out, bytes, 2);
+}
+
+static void padTo(AsmEmitter *out, int *position, int offset)
+{
+    static const char zeros[16];
+    while (*position < offset)
+    {
+        int chunk = offset - *position < (int)sizeof(zeros) ? offset - *position : (int)sizeof(zeros);
+        emitBytes(out, zeros, chunk);
+        *position += chunk;
+    }
+}
+
+static int addString(ByteBuffer *table, const char *text)
+{
+    int offset = table->size;
+    appendBytes(table, text, strlen(text) + 1);
+    return offset;
+}
+
+static void emitSectionHeader(AsmEmitter *out, int name, int type, int flags, int offset, int size, int link,
+                              int info, int alignment, int entrySize)
+{
+    emitWordTo(out, name);
+    emitWordTo(out, type);
+    emitWordTo(out, flags);
+    emitWordTo(out, 0); // sh_addr
+    emitWordTo(out, offset);
+    emitWordTo(out, size);
+    emitWordTo(out, link);
+    emitWordTo(out, info);
+    emitWordTo(out, alignment);
+    emitWordTo(out, entrySize);
+}
+
+static int alignUp(int value, int alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Layout: ELF header, section contents, relocations, .symtab, .strtab, .shstrtab,
+// then the section header table
+static void writeElf(ObjectWriter *writer, AsmEmitter *out)
+{
+    ByteBuffer strings = {NULL, 0, 0};
+    ByteBuffer sectionNames = {NULL, 0, 0};
+    addString(&strings, "");
+    addString(&sectionNames, "");
+
+    // Section header indices: contents, then their relocations, then the tables
+    int sectionCount = 1;
+    int relocationNames[SECTION_COUNT];
+    int contentNames[SECTION_COUNT];
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        ObjectSection *section = &writer->sections[s];
+        if (!section->used)
+            continue;
+        section->index = sectionCount++;
+        contentNames[s] = addString(&sectionNames, section->name);
+    }
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        ObjectSection *section = &writer->sections[s];
+        if (!section->relocationCount)
+            continue;
+        char name[32];
+        snprintf(name, sizeof(name), ".rel%s", section->name);
+        relocationNames[s] = addString(&sectionNames, name);
+        sectionCount++;
+    }
+    int symbolTableIndex = sectionCount++;
+    int stringTableIndex = sectionCount++;
+    int sectionNameIndex = sectionCount++;
+    int symbolTableName = addString(&sectionNames, ".symtab");
+    int stringTableName = addString(&sectionNames, ".strtab");
+    int sectionNameName = addString(&sectionNames, ".shstrtab");
+
+    // Locals first: section symbols, then labels; sh_info is the first global
+    int *order = malloc(sizeof(int) * writer->symbolCount);
+    int *nameOffsets = malloc(sizeof(int) * writer->symbolCount);
+    if (!order || !nameOffsets)
+    {
+        perror("Failed to allocate symbol order");
+        exit(EXIT_FAILURE);
+    }
+    int symbolCount = 1;
+    for (int pass = 0; pass < 3; pass++)
+    {
+        for (int i = 0; i < writer->symbolCount; i++)
+        {
+            ObjectSymbol *symbol = &writer->symbols[i];
+            int group = symbol->isSection ? 0 : symbol->isGlobal ? 2 : 1;
+            if (group != pass || (symbol->isSection && !writer->sections[symbol->section].used))
+                continue;
+            symbol->index = symbolCount;
+            order[symbolCount - 1] = i;
+            nameOffsets[i] = symbol->isSection ? 0 : addString(&strings, symbol->name);
+            symbolCount++;
+        }
+    }
+    int firstGlobal = 1;
+    while (firstGlobal < symbolCount && !writer->symbols[order[firstGlobal - 1]].isGlobal)
+        firstGlobal++;
+
+    int position = ELF_HEADER_SIZE;
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        ObjectSection *section = &writer->sections[s];
+        if (!section->used)
+            continue;
+        position = alignUp(position, section->alignment);
+        section->fileOffset = position;
+        if (section->type != SHT_NOBITS)
+            position += section->contents.size;
+    }
+    int relocationOffsets[SECTION_COUNT];
+    position = alignUp(position, 4);
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        relocationOffsets[s] = position;
+        position += ELF_RELOCATION_SIZE * writer->sections[s].relocationCount;
+    }
+    int symbolTableOffset = position;
+    position += ELF_SYMBOL_SIZE * symbolCount;
+    int stringTableOffset = position;
+    position += strings.size;
+    int sectionNameOffset = position;
+    position += sectionNames.size;
+    int sectionHeaderOffset = alignUp(position, 4);
+
+    // ELF header
+    static const char identification[16] = {0x7f, 'E', 'L', 'F', 1, 2, 1}; // 32-bit, big-endian, version 1
+    emitBytes(out, identification, sizeof(identification));
+    emitHalfTo(out, ET_REL);
+    emitHalfTo(out, EM_MIPS);
+    emitWordTo(out, 1);
+    emitWordTo(out, 0); // e_entry
+    emitWordTo(out, 0); // e_phoff
+    emitWordTo(out, sectionHeaderOffset);
+    emitWordTo(out, EF_MIPS_ARCH_32 | EF_MIPS_ABI_O32 | (writer->usedNoreorder ? EF_MIPS_NOREORDER : 0) |
+                        (writer->usedFp64 ? EF_MIPS_FP64 : 0));
+    emitHalfTo(out, ELF_HEADER_SIZE);
+    emitHalfTo(out, 0);
+    emitHalfTo(out, 0);
+    emitHalfTo(out, ELF_SECTION_HEADER_SIZE);
+    emitHalfTo(out, sectionCount);
+    emitHalfTo(out, sectionNameIndex);
+
+    position = ELF_HEADER_SIZE;
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        ObjectSection *section = &writer->sections[s];
+        if (!section->used || section->type == SHT_NOBITS)
+            continue;
+        padTo(out, &position, section->fileOffset);
+        emitBytes(out, (const char *)section->contents.bytes, section->contents.size);
+        position += section->contents.size;
+    }
+    padTo(out, &position, alignUp(position, 4));
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        ObjectSection *section = &writer->sections[s];
+        for (int i = 0; i < section->relocationCount; i++)
+        {
+            Relocation *relocation = &section->relocations[i];
+            emitWordTo(out, relocation->offset);
+            emitWordTo(out, writer->symbols[relocation->symbol].index << 8 | relocation->type);
+        }
+        position += ELF_RELOCATION_SIZE * section->relocationCount;
+    }
+
+    // Null symbol, then the ordered table
+    for (int i = 0; i < 4; i++)
+        emitWordTo(out, 0);
+    for (int n = 1; n < symbolCount; n++)
+    {
+        ObjectSymbol *symbol = &writer->symbols[order[n - 1]];
+        int defined = symbol->section >= 0;
+        emitWordTo(out, nameOffsets[order[n - 1]]);
+        emitWordTo(out, symbol->isSection ? 0 : symbol->value);
+        emitWordTo(out, 0); // st_size
+        emitChar(out, (symbol->isGlobal ? STB_GLOBAL : STB_LOCAL) << 4 | (symbol->isSection ? STT_SECTION : STT_NOTYPE));
+        emitChar(out, 0);
+        emitHalfTo(out, defined ? writer->sections[symbol->section].index : 0);
+    }
+    position += ELF_SYMBOL_SIZE * symbolCount;
+    emitBytes(out, (const char *)strings.bytes, strings.size);
+    emitBytes(out, (const char *)sectionNames.bytes, sectionNames.size);
+    position += strings.size + sectionNames.size;
+    padTo(out, &position, sectionHeaderOffset);
+
+    // Section header table
+    emitSectionHeader(out, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        ObjectSection *section = &writer->sections[s];
+        if (section->used)
+            emitSectionHeader(out, contentNames[s], section->type, section->flags, section->fileOffset,
+                              section->contents.size, 0, 0, section->alignment, 0);
+    }
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        ObjectSection *section = &writer->sections[s];
+        if (section->relocationCount)
+            emitSectionHeader(out, relocationNames[s], SHT_REL, SHF_INFO_LINK, relocationOffsets[s],
+                              ELF_RELOCATION_SIZE * section->relocationCount, symbolTableIndex, section->index, 4,
+                              ELF_RELOCATION_SIZE);
+    }
+    emitSectionHeader(out, symbolTableName, SHT_SYMTAB, 0, symbolTableOffset, ELF_SYMBOL_SIZE * symbolCount,
+                      stringTableIndex, firstGlobal, 4, ELF_SYMBOL_SIZE);
+    emitSectionHeader(out, stringTableName, SHT_STRTAB, 0, stringTableOffset, strings.size, 0, 0, 1, 0);
+    emitSectionHeader(out, sectionNameName, SHT_STRTAB, 0, sectionNameOffset, sectionNames.size, 0, 0, 1, 0);
+
+    free(order);
+    free(nameOffsets);
+    free(strings.bytes);
+    free(sectionNames.bytes);
+}
+
+static void freeWriter(ObjectWriter *writer)
+{
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        free(writer->sections[s].contents.bytes);
+        free(writer->sections[s].fixups);
+        free(writer->sections[s].relocations);
+    }
+    free(writer->symbols);
+    free(writer->nameTable);
+}
+
+void writeElfObject(AsmEmitter *out, MipsList *list)
+{
+    ObjectWriter writer;
+    initializeWriter(&writer);
+
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        if (instr->kind == MIPS_LABEL)
+        {
+            defineLabel(&writer, instr->op);
+        }
+        else if (instr->kind == MIPS_DIRECTIVE)
+        {
+            encodeDirective(&writer, instr);
+        }
+        else
+        {
+            int transfersControl = mipsHasFlag(instr, MIPS_FLAG_BRANCH | MIPS_FLAG_JUMP | MIPS_FLAG_CALL);
+            encodeInstruction(&writer, instr);
+            // The assembler fills the delay slot with a nop unless told the code already does
+            if (transfersControl && writer.reorder)
+                emitWord(&writer, 0);
+            writer.inDelaySlot = transfersControl && !writer.reorder;
+        }
+    }
+    resolveFixups(&writer);
+
+    int relocations = 0;
+    for (int s = 0; s < SECTION_COUNT; s++)
+        relocations += writer.sections[s].relocationCount;
+    printf("OBJECT: %d bytes of code, %d of data, %d relocations\n", writer.sections[SECTION_TEXT].contents.size,
+           writer.sections[SECTION_DATA].contents.size + writer.sections[SECTION_RODATA].contents.size +
+               writer.sections[SECTION_BSS].contents.size,
+           relocations);
+
+    writeElf(&writer, out);
+    freeWriter(&writer);
+}
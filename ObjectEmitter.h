@@ -0,0 +1,13 @@
+#ifndef OBJECT_EMITTER_H
+#define OBJECT_EMITTER_H
+
+#include "AsmEmitter.h"
+#include "MipsInstruction.h"
+
+// Encodes a whole program (data directives, labels and instructions, as
+// writeMipsList would print them) straight into MIPS32 machine words and writes
+// a big-endian relocatable ELF32 object to out. Pseudo-instructions are expanded
+// the way the assembler expands them, so the sections match byte for byte.
+void writeElfObject(AsmEmitter *out, MipsList *list);
+
+#endif // OBJECT_EMITTER_H
@@ -0,0 +1,226 @@
+#include "Options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+CompilerOptions compilerOptions;
+
+void printUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [options] [input.cmm, or - for stdin]\n", program);
+    fprintf(stderr, "  -o <file>             Write assembly to <file>, or stdout for - (default output.asm)\n");
+    fprintf(stderr, "  --object              Write a relocatable ELF32 object instead of assembly (default output.o)\n");
+    fprintf(stderr, "  --no-fuse-branches    Materialize conditions and test loops at the top\n");
+    fprintf(stderr, "  --no-select           Translate each IR instruction on its own, without tree tiling\n");
+    fprintf(stderr, "  --keep-bounds-checks  Check every array index, even when provably in range\n");
+    fprintf(stderr, "  --unroll=<n>          Run counted loops n iterations per test, flattening short ones (default 4)\n");
+    fprintf(stderr, "  --no-unroll           Keep every loop as written\n");
+    fprintf(stderr, "  --no-tail-calls       Call and return for calls in tail position too\n");
+    fprintf(stderr, "  --msa                 Vectorize counted array loops with MIPS MSA instructions\n");
+    fprintf(stderr, "  --no-schedule         Keep instructions in generation order\n");
+    fprintf(stderr, "  --delay-slots         Fill branch delay slots and emit .set noreorder\n");
+    fprintf(stderr, "  --simulate            Run the program on the pipeline model and report cycles and stalls\n");
+    fprintf(stderr, "  --profile-generate=<file> Count branches, loops and calls on a simulated run into <file>\n");
+    fprintf(stderr, "  --profile-use=<file>  Lay out branches, unroll loops and inline calls by the counts in <file>\n");
+    fprintf(stderr, "  --parser=<name>       Parse with bison (default) or pratt, the hand-written parser\n");
+    fprintf(stderr, "  --syntax-only         Parse and print the AST, then stop; fails on a syntax error\n");
+    fprintf(stderr, "  --stream              Compile and write each function as soon as it is parsed, in bounded memory\n");
+    fprintf(stderr, "  --jobs=<n>            Translate and optimize functions on n threads (default 1; not with --stream)\n");
+    fprintf(stderr, "  --cache=<dir>         Reuse the code of unchanged functions from earlier compiles (not with --stream or profiles)\n");
+    fprintf(stderr, "  --cache-size=<MB>     Keep at most this many megabytes of cache entries (default 64)\n");
+    fprintf(stderr, "  --stats[=<file>]      Append counters and allocations per phase as JSON to <file> (default stderr)\n");
+    fprintf(stderr, "  --time-phases         Include time per phase in the JSON record\n");
+    fprintf(stderr, "  --serve=<socket>      Stay running and compile requests sent to a Unix socket\n");
+    fprintf(stderr, "  --client=<socket>     Send this compile to a --serve process instead of running it here\n");
+    fprintf(stderr, "  --latency=<spec>      Scheduler latencies, e.g. load=2,mul=5,div=20,hilo=1,alu=1,fpu=4,fdiv=12\n");
+}
+
+// Returns 0 and prints usage when an option is not recognised
+int parseCompilerOptions(int argc, char *argv[])
+{
+    compilerOptions.inputFile = "test1.cmm";
+    compilerOptions.outputFile = NULL;
+    compilerOptions.fuseBranches = 1;
+    compilerOptions.selectInstructions = 1;
+    compilerOptions.eliminateChecks = 1;
+    compilerOptions.schedule = 1;
+    compilerOptions.unrollFactor = 4;
+    compilerOptions.tailCalls = 1;
+    compilerOptions.vectorize = 0;
+    compilerOptions.fillDelaySlots = 0;
+    compilerOptions.emitObject = 0;
+    compilerOptions.simulate = 0;
+    compilerOptions.stream = 0;
+    compilerOptions.jobs = 1;
+    compilerOptions.prattParser = 0;
+    compilerOptions.syntaxOnly = 0;
+    compilerOptions.profileGenerate = NULL;
+    compilerOptions.profileUse = NULL;
+    compilerOptions.cacheDirectory = NULL;
+    compilerOptions.cacheLimit = 64LL << 20;
+    compilerOptions.stats = 0;
+    compilerOptions.timePhases = 0;
+    compilerOptions.statsFile = NULL;
+    compilerOptions.serveSocket = NULL;
+    compilerOptions.clientSocket = NULL;
+    compilerOptions.latency = defaultLatencyModel;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-o") == 0 && i + 1 < argc)
+        {
+            compilerOptions.outputFile = argv[++i];
+        }
+        else if (strcmp(arg, "--no-fuse-branches") == 0)
+        {
+            compilerOptions.fuseBranches = 0;
+        }
+        else if (strcmp(arg, "--no-select") == 0)
+        {
+            compilerOptions.selectInstructions = 0;
+        }
+        else if (strcmp(arg, "--keep-bounds-checks") == 0)
+        {
+            compilerOptions.eliminateChecks = 0;
+        }
+        else if (strncmp(arg, "--unroll=", 9) == 0)
+        {
+            char *end;
+            long factor = strtol(arg + 9, &end, 10);
+            if (*end || factor < 1 || factor > 64)
+            {
+                fprintf(stderr, "Invalid unroll factor '%s'\n", arg + 9);
+                return 0;
+            }
+            compilerOptions.unrollFactor = (int)factor;
+        }
+        else if (strcmp(arg, "--no-unroll") == 0)
+        {
+            compilerOptions.unrollFactor = 1;
+        }
+        else if (strcmp(arg, "--no-tail-calls") == 0)
+        {
+            compilerOptions.tailCalls = 0;
+        }
+        else if (strcmp(arg, "--msa") == 0)
+        {
+            compilerOptions.vectorize = 1;
+        }
+        else if (strcmp(arg, "--no-schedule") == 0)
+        {
+            compilerOptions.schedule = 0;
+        }
+        else if (strcmp(arg, "--delay-slots") == 0)
+        {
+            compilerOptions.fillDelaySlots = 1;
+        }
+        else if (strcmp(arg, "--object") == 0)
+        {
+            compilerOptions.emitObject = 1;
+        }
+        else if (strcmp(arg, "--simulate") == 0)
+        {
+            compilerOptions.simulate = 1;
+        }
+        else if (strcmp(arg, "--stream") == 0)
+        {
+            compilerOptions.stream = 1;
+        }
+        else if (strncmp(arg, "--jobs=", 7) == 0)
+        {
+            char *end;
+            long jobs = strtol(arg + 7, &end, 10);
+            if (*end || jobs < 1 || jobs > 256)
+            {
+                fprintf(stderr, "Invalid job count '%s'\n", arg + 7);
+                return 0;
+            }
+            compilerOptions.jobs = (int)jobs;
+        }
+        else if (strcmp(arg, "--parser=bison") == 0 || strcmp(arg, "--parser=pratt") == 0)
+        {
+            compilerOptions.prattParser = strcmp(arg + 9, "pratt") == 0;
+        }
+        else if (strcmp(arg, "--syntax-only") == 0)
+        {
+            compilerOptions.syntaxOnly = 1;
+        }
+        else if (strncmp(arg, "--profile-generate=", 19) == 0)
+        {
+            compilerOptions.profileGenerate = arg + 19;
+        }
+        else if (strncmp(arg, "--profile-use=", 14) == 0)
+        {
+            compilerOptions.profileUse = arg + 14;
+        }
+        else if (strncmp(arg, "--cache=", 8) == 0)
+        {
+            compilerOptions.cacheDirectory = arg + 8;
+        }
+        else if (strncmp(arg, "--cache-size=", 13) == 0)
+        {
+            char *end;
+            long long megabytes = strtoll(arg + 13, &end, 10);
+            if (*end || megabytes < 1 || megabytes > 1 << 20)
+            {
+                fprintf(stderr, "Invalid cache size '%s'\n", arg + 13);
+                return 0;
+            }
+            compilerOptions.cacheLimit = megabytes << 20;
+        }
+        else if (strcmp(arg, "--stats") == 0)
+        {
+            compilerOptions.stats = 1;
+        }
+        else if (strncmp(arg, "--stats=", 8) == 0)
+        {
+            compilerOptions.stats = 1;
+            compilerOptions.statsFile = arg + 8;
+        }
+        else if (strcmp(arg, "--time-phases") == 0)
+        {
+            compilerOptions.timePhases = 1;
+        }
+        else if (strncmp(arg, "--serve=", 8) == 0)
+        {
+            compilerOptions.serveSocket = arg + 8;
+        }
+        else if (strncmp(arg, "--client=", 9) == 0)
+        {
+            compilerOptions.clientSocket = arg + 9;
+        }
+        else if (strncmp(arg, "--latency=", 10) == 0)
+        {
+            if (!parseLatencyModel(arg + 10, &compilerOptions.latency))
+            {
+                fprintf(stderr, "Invalid latency specification '%s'\n", arg + 10);
+                return 0;
+            }
+        }
+        else if (arg[0] == '-' && arg[1])
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else
+        {
+            compilerOptions.inputFile = arg;
+        }
+    }
+    if (compilerOptions.syntaxOnly)
+        compilerOptions.stream = 0; // Streaming would compile functions as they are parsed
+    // Streamed functions are written before the whole program is known, and
+    // profiles number probes and inline across functions
+    if (compilerOptions.syntaxOnly || compilerOptions.stream || compilerOptions.profileGenerate ||
+        compilerOptions.profileUse)
+        compilerOptions.cacheDirectory = NULL;
+    if (compilerOptions.profileGenerate && compilerOptions.profileUse)
+    {
+        fprintf(stderr, "--profile-generate and --profile-use cannot be combined\n");
+        return 0;
+    }
+    if (!compilerOptions.outputFile)
+        compilerOptions.outputFile = compilerOptions.emitObject ? "output.o" : "output.asm";
+    return 1;
+}
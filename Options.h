@@ -0,0 +1,45 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "InstructionScheduler.h"
+
+// Bumped whenever the same source and options may compile to different code;
+// --cache keys include it, so entries from an older compiler become misses
+#define COMPILER_VERSION "1.1"
+
+typedef struct CompilerOptions
+{
+    const char *inputFile;
+    const char *outputFile;
+    int fuseBranches;       // Branch on comparisons directly and rotate loops
+    int selectInstructions; // Tile expression trees instead of translating IR one to one
+    int eliminateChecks;    // Drop array bounds checks that range analysis proves redundant
+    int schedule;           // Reorder instructions within basic blocks
+    int unrollFactor;       // Body copies per test of a counted loop; 1 leaves loops alone
+    int tailCalls;          // Loop self tail calls and turn other tail calls into jumps
+    int vectorize;          // Run counted array loops four elements at a time with MIPS MSA instructions
+    int fillDelaySlots;     // Emit .set noreorder and fill branch delay slots
+    int emitObject;         // Encode machine code into an ELF object instead of writing assembly
+    int simulate;           // Run the generated program and report cycles and stalls
+    int stream;             // Compile each function as soon as it is parsed, then free it
+    int jobs;               // Threads translating and optimizing functions; 1 keeps the back end serial
+    int prattParser;        // Parse with the hand-written recursive descent parser instead of bison
+    int syntaxOnly;         // Stop after parsing and printing the AST; write no output
+    const char *profileGenerate; // Count ifs, loops and calls, run the program and write the counts here
+    const char *profileUse;      // Lay out, unroll and inline by the counts in this profile
+    const char *cacheDirectory;  // Reuse the code of functions compiled before from here; NULL for none
+    long long cacheLimit;        // Bytes of entries kept there; the least recently used go first
+    int stats;              // Report counters and allocations per phase
+    int timePhases;         // Report time per phase
+    const char *statsFile;  // Where the JSON record goes, appended; NULL for stderr
+    const char *serveSocket;  // Listen here and compile each request in a forked worker
+    const char *clientSocket; // Hand this compile to the server listening here
+    LatencyModel latency;
+} CompilerOptions;
+
+extern CompilerOptions compilerOptions;
+
+int parseCompilerOptions(int argc, char *argv[]);
+void printUsage(const char *program);
+
+#endif // OPTIONS_H
@@ -0,0 +1,226 @@
+#include "Peephole.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How far forward a rule may look for the second half of a pattern
+#define PEEPHOLE_WINDOW 8
+// Passes are repeated until nothing fires; this only guards against rule ping-pong
+#define PEEPHOLE_MAX_PASSES 16
+
+// True when control may enter or leave at instr, which ends a window
+static int endsWindow(MipsInstruction *instr)
+{
+    return instr->kind != MIPS_INSTRUCTION ||
+           mipsHasFlag(instr, MIPS_FLAG_BRANCH | MIPS_FLAG_JUMP | MIPS_FLAG_CALL);
+}
+
+static int definesRegister(MipsInstruction *instr, int reg)
+{
+    int defs[3];
+    int count = getMipsDefs(instr, defs);
+    for (int i = 0; i < count; i++)
+    {
+        if (defs[i] == reg)
+            return 1;
+    }
+    return 0;
+}
+
+static int usesRegister(MipsInstruction *instr, int reg)
+{
+    int uses[4];
+    int count = getMipsUses(instr, uses);
+    for (int i = 0; i < count; i++)
+    {
+        if (uses[i] == reg)
+            return 1;
+    }
+    return 0;
+}
+
+// move r, r
+static int removeSelfMove(MipsList *list, MipsInstruction *instr)
+{
+    if (!isMipsInstruction(instr, "move") || instr->operands[0].reg != instr->operands[1].reg)
+        return 0;
+    removeMipsInstruction(list, instr);
+    return 1;
+}
+
+// move a, b ... move b, a with neither register written in between
+static int removeCopyBack(MipsList *list, MipsInstruction *instr)
+{
+    if (!isMipsInstruction(instr, "move"))
+        return 0;
+    int dest = instr->operands[0].reg;
+    int source = instr->operands[1].reg;
+    MipsInstruction *scan = instr->next;
+    for (int i = 0; scan && i < PEEPHOLE_WINDOW && !endsWindow(scan); i++, scan = scan->next)
+    {
+        if (isMipsInstruction(scan, "move") && scan->operands[0].reg == source && scan->operands[1].reg == dest)
+        {
+            removeMipsInstruction(list, scan);
+            return 1;
+        }
+        if (definesRegister(scan, dest) || definesRegister(scan, source))
+            return 0;
+    }
+    return 0;
+}
+
+// li r, c ... li r, c with r unchanged in between
+static int removeRedundantLoadImmediate(MipsList *list, MipsInstruction *instr)
+{
+    if (!isMipsInstruction(instr, "li"))
+        return 0;
+    int reg = instr->operands[0].reg;
+    MipsInstruction *scan = instr->next;
+    for (int i = 0; scan && i < PEEPHOLE_WINDOW && !endsWindow(scan); i++, scan = scan->next)
+    {
+        if (isMipsInstruction(scan, "li") && scan->operands[0].reg == reg &&
+            scan->operands[1].value == instr->operands[1].value)
+        {
+            removeMipsInstruction(list, scan);
+            return 1;
+        }
+        if (definesRegister(scan, reg))
+            return 0;
+    }
+    return 0;
+}
+
+// b L / j L / beq ... L immediately followed by L:
+static int removeBranchToNext(MipsList *list, MipsInstruction *instr)
+{
+    const char *target = getMipsBranchTarget(instr);
+    if (!target)
+        return 0;
+    for (MipsInstruction *scan = instr->next; scan && scan->kind == MIPS_LABEL; scan = scan->next)
+    {
+        if (strcmp(scan->op, target) == 0)
+        {
+            removeMipsInstruction(list, instr);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// sw r, m ... lw r2, m becomes move r2, r while r, the base and memory are unchanged
+static int forwardStoreToLoad(MipsList *list, MipsInstruction *instr)
+{
+    if (!isMipsInstruction(instr, "sw"))
+        return 0;
+    int stored = instr->operands[0].reg;
+    MipsOperand slot = instr->operands[1];
+    MipsInstruction *scan = instr->next;
+    for (int i = 0; scan && i < PEEPHOLE_WINDOW && !endsWindow(scan); i++, scan = scan->next)
+    {
+        if (isMipsInstruction(scan, "lw") && sameMipsOperand(scan->operands[1], slot))
+        {
+            int loaded = scan->operands[0].reg;
+            if (loaded == stored)
+            {
+                removeMipsInstruction(list, scan);
+            }
+            else
+            {
+                insertMipsBefore(list, scan, createMipsInstruction("move", mipsRegister(loaded), mipsRegister(stored), NO_OPERAND));
+                removeMipsInstruction(list, scan);
+            }
+            return 1;
+        }
+        if (mipsHasFlag(scan, MIPS_FLAG_STORE) || definesRegister(scan, stored) || definesRegister(scan, slot.reg))
+            return 0;
+    }
+    return 0;
+}
+
+// A write to $v0 that is overwritten before anything reads it
+static int removeDeadReturnValue(MipsList *list, MipsInstruction *instr)
+{
+    if (instr->kind != MIPS_INSTRUCTION || mipsHasFlag(instr, MIPS_FLAG_CALL) ||
+        instr->info->definedOperand < 0 || instr->operands[instr->info->definedOperand].reg != MIPS_REG_V0)
+        return 0;
+    MipsInstruction *scan = instr->next;
+    for (int i = 0; scan && i < PEEPHOLE_WINDOW; i++, scan = scan->next)
+    {
+        if (usesRegister(scan, MIPS_REG_V0))
+            return 0;
+        if (definesRegister(scan, MIPS_REG_V0))
+        {
+            removeMipsInstruction(list, instr);
+            return 1;
+        }
+        if (endsWindow(scan))
+            return 0; // $v0 may be read after the jump; jal is caught above as a definition
+    }
+    return 0;
+}
+
+// Instructions after an unconditional jump and before the next label can never run
+static int removeUnreachable(MipsList *list, MipsInstruction *instr)
+{
+    if (!mipsHasFlag(instr, MIPS_FLAG_JUMP))
+        return 0;
+    int removed = 0;
+    while (instr->next && instr->next->kind == MIPS_INSTRUCTION)
+    {
+        removeMipsInstruction(list, instr->next);
+        removed = 1;
+    }
+    return removed;
+}
+
+// New rules go here; each is tried in order at every instruction
+static PeepholeRule rules[] = {
+    {"self-move", removeSelfMove, 0},
+    {"copy-back", removeCopyBack, 0},
+    {"redundant-li", removeRedundantLoadImmediate, 0},
+    {"branch-to-next", removeBranchToNext, 0},
+    {"store-load-forward", forwardStoreToLoad, 0},
+    {"dead-v0-write", removeDeadReturnValue, 0},
+    {"unreachable", removeUnreachable, 0},
+    {NULL, NULL, 0}};
+
+void optimizePeephole(MipsList *list)
+{
+    int changed = 1;
+    for (int pass = 0; changed && pass < PEEPHOLE_MAX_PASSES; pass++)
+    {
+        changed = 0;
+        MipsInstruction *instr = list->head;
+        while (instr)
+        {
+            MipsInstruction *prev = instr->prev;
+            int fired = 0;
+            for (PeepholeRule *rule = rules; rule->name && !fired; rule++)
+            {
+                if (rule->apply(list, instr))
+                {
+                    rule->hits++;
+                    fired = 1;
+                }
+            }
+            if (fired)
+            {
+                // Re-examine from the previous instruction; the rewrite may expose another match
+                changed = 1;
+                instr = prev ? prev : list->head;
+            }
+            else
+            {
+                instr = instr->next;
+            }
+        }
+    }
+}
+
+void printPeepholeStatistics()
+{
+    for (PeepholeRule *rule = rules; rule->name; rule++)
+    {
+        printf("PEEPHOLE: %s %d\n", rule->name, rule->hits);
+    }
+}
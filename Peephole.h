@@ -0,0 +1,20 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "MipsInstruction.h"
+
+// A rewrite over a short window of instructions starting at instr.
+// Rules may only change or remove instr and the instructions after it.
+typedef int (*PeepholeRewrite)(MipsList *list, MipsInstruction *instr);
+
+typedef struct PeepholeRule
+{
+    const char *name;
+    PeepholeRewrite apply;
+    _Atomic int hits; // --jobs workers share the rules
+} PeepholeRule;
+
+void optimizePeephole(MipsList *list);
+void printPeepholeStatistics();
+
+#endif // PEEPHOLE_H
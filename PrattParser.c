@@ -0,0 +1,369 @@
+#include "PrattParser.h"
+#include "parser.tab.h"
+#include <setjmp.h>
+
+// The next token and its value; a second token is read only to tell statements apart
+static int token;
+static YYSTYPE tokenValue;
+static jmp_buf syntaxError;
+
+static void advance()
+{
+    token = countedLex();
+    tokenValue = yylval;
+}
+
+static void fail()
+{
+    yyerror("syntax error");
+    longjmp(syntaxError, 1);
+}
+
+static void expect(int expected)
+{
+    if (token != expected)
+        fail();
+    advance();
+}
+
+// Takes the text of the IDENTIFIER token just read; the lexer made it for us
+static char *takeIdentifier()
+{
+    if (token != IDENTIFIER)
+        fail();
+    char *name = tokenValue.identifier;
+    advance();
+    return name;
+}
+
+static ASTNode *variableNode(char *name)
+{
+    ASTNode *node = createASTNode(AST_VARIABLE);
+    node->value.strValue = name;
+    return node;
+}
+
+static int isTypeToken(int candidate)
+{
+    return candidate == INT || candidate == FLOAT || candidate == STRING || candidate == VOID;
+}
+
+static TypeCode takeType()
+{
+    TypeCode type = token == INT ? TypeINT : token == FLOAT ? TypeFLOAT : token == STRING ? TypeSTRING : TypeVOID;
+    advance();
+    return type;
+}
+
+// Binding power of a binary operator token, 0 for anything else, as declared in
+// parser.y: == and != loosest, then the relations, then + and -, then * and /
+static int precedence(int operator)
+{
+    switch (operator)
+    {
+    case EQ:
+    case NE:
+        return 1;
+    case LT:
+    case GT:
+    case LE:
+    case GE:
+        return 2;
+    case PLUS:
+    case MINUS:
+        return 3;
+    case MULTIPLY:
+    case DIVIDE:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static OperatorType operatorType(int operator)
+{
+    switch (operator)
+    {
+    case PLUS:
+        return OP_PLUS;
+    case MINUS:
+        return OP_MINUS;
+    case MULTIPLY:
+        return OP_MULTIPLY;
+    case DIVIDE:
+        return OP_DIVIDE;
+    case LT:
+        return OP_LESS;
+    case LE:
+        return OP_LESS_EQUAL;
+    case GT:
+        return OP_GREATER;
+    case GE:
+        return OP_GREATER_EQUAL;
+    case EQ:
+        return OP_EQUAL;
+    default:
+        return OP_NOT_EQUAL;
+    }
+}
+
+static ASTNode *parseExpression(int minimum);
+
+// name( arguments ), once name and the parenthesis are read
+static ASTNode *parseCallRest(char *name)
+{
+    ASTNode *call = createASTNode(AST_FUNCTION_CALL);
+    addChildNode(call, variableNode(name));
+    ASTNode *arguments = createASTNode(AST_ARGUMENTS);
+    if (token != RPAREN)
+    {
+        addChildNode(arguments, parseExpression(1));
+        while (token == COMMA)
+        {
+            advance();
+            addChildNode(arguments, parseExpression(1));
+        }
+    }
+    expect(RPAREN);
+    addChildNode(call, arguments);
+    return call;
+}
+
+// name[ index ], once name and the bracket are read
+static ASTNode *parseAccessRest(char *name)
+{
+    ASTNode *access = createASTNode(AST_ARRAY_ACCESS);
+    addChildNode(access, variableNode(name));
+    addChildNode(access, parseExpression(1));
+    expect(RBRACKET);
+    return access;
+}
+
+// A variable, call or array access, once its name is read
+static ASTNode *parseNamed(char *name)
+{
+    if (token == LPAREN)
+    {
+        advance();
+        return parseCallRest(name);
+    }
+    if (token == LBRACKET)
+    {
+        advance();
+        return parseAccessRest(name);
+    }
+    return variableNode(name);
+}
+
+static ASTNode *parsePrimary()
+{
+    ASTNode *node;
+    switch (token)
+    {
+    case NUMBER:
+        node = createASTNode(AST_LITERAL);
+        node->value.intValue = tokenValue.intValue;
+        advance();
+        return node;
+    case FLOAT_LITERAL:
+        node = createASTNode(AST_FLOAT_LITERAL);
+        node->value.floatValue = tokenValue.floatValue;
+        advance();
+        return node;
+    case IDENTIFIER:
+        return parseNamed(takeIdentifier());
+    case LPAREN:
+        advance();
+        node = parseExpression(1);
+        expect(RPAREN);
+        return node;
+    default:
+        fail();
+        return NULL;
+    }
+}
+
+// Extends left with every operator binding at least as tightly as minimum.
+// Equal precedence associates left; the comparisons do not associate at all.
+static ASTNode *parseOperators(ASTNode *left, int minimum)
+{
+    while (precedence(token) >= minimum && precedence(token) > 0)
+    {
+        int operator = token;
+        advance();
+        ASTNode *node = createASTNode(AST_BINARY_EXPR);
+        node->value.opType = operatorType(operator);
+        addChildNode(node, left);
+        addChildNode(node, parseExpression(precedence(operator) + 1));
+        left = node;
+        if (precedence(operator) <= 2 && precedence(token) == precedence(operator))
+            fail();
+    }
+    return left;
+}
+
+static ASTNode *parseExpression(int minimum)
+{
+    return parseOperators(parsePrimary(), minimum);
+}
+
+static ASTNode *parseStatement();
+
+// { statements }, in a scope of its own
+static ASTNode *parseBlock()
+{
+    expect(LBRACE);
+    pushScope(symbolTable);
+    ASTNode *block = createASTNode(AST_BLOCK);
+    while (token != RBRACE)
+        addChildNode(block, parseStatement());
+    popScope(symbolTable);
+    advance();
+    return block;
+}
+
+// Typed parameters are declared in the enclosing scope, as the grammar does
+static ASTNode *parseParameters()
+{
+    ASTNode *list = createASTNode(AST_PARAMETER_LIST);
+    if (token == RPAREN)
+        return list;
+    while (1)
+    {
+        int typed = isTypeToken(token);
+        TypeCode type = typed ? takeType() : TypeVOID;
+        ASTNode *parameter = createASTNode(AST_PARAMETER);
+        parameter->value.strValue = takeIdentifier();
+        if (typed)
+        {
+            addChildNode(parameter, createTypeNode(AST_TYPE, type));
+            addSymbolToCurrentScope(symbolTable, parameter->value.strValue, type);
+        }
+        addChildNode(list, parameter);
+        if (token != COMMA)
+            return list;
+        advance();
+    }
+}
+
+// A declaration, array declaration or function, once its type is read
+static ASTNode *parseDeclaration(TypeCode type)
+{
+    char *name = takeIdentifier();
+    ASTNode *typeNode = createASTNode(AST_TYPE);
+    typeNode->value.typeCode = type;
+    ASTNode *node;
+    if (token == LPAREN)
+    {
+        advance();
+        node = createASTNode(AST_FUNCTION_DECLARATION);
+        addChildNode(node, typeNode);
+        addChildNode(node, variableNode(name));
+        addChildNode(node, parseParameters());
+        expect(RPAREN);
+        addChildNode(node, parseBlock());
+        addSymbolToCurrentScope(symbolTable, name, type);
+        return node;
+    }
+    node = createASTNode(token == LBRACKET ? AST_ARRAY_DECLARATION : AST_DECLARATION);
+    addChildNode(node, typeNode);
+    addChildNode(node, variableNode(name));
+    if (token == LBRACKET || token == ASSIGN)
+    {
+        int bracket = token == LBRACKET;
+        advance();
+        addChildNode(node, parseExpression(1));
+        if (bracket)
+            expect(RBRACKET);
+    }
+    addSymbolToCurrentScope(symbolTable, name, type);
+    expect(SEMICOLON);
+    return node;
+}
+
+static ASTNode *parseAssignment(ASTNode *target)
+{
+    advance();
+    ASTNode *assignment = createASTNode(AST_ASSIGNMENT);
+    addChildNode(assignment, target);
+    addChildNode(assignment, parseExpression(1));
+    if (target->type == AST_VARIABLE && !findSymbol(symbolTable, target->value.strValue))
+        printf("Undefined variable %s\n", target->value.strValue);
+    return assignment;
+}
+
+// if and while: keyword ( condition ) block
+static ASTNode *parseConditional(NodeType type)
+{
+    advance();
+    ASTNode *node = createASTNode(type);
+    expect(LPAREN);
+    addChildNode(node, parseExpression(1));
+    expect(RPAREN);
+    addChildNode(node, parseBlock());
+    if (type == AST_IF_STATEMENT && token == ELSE)
+    {
+        advance();
+        addChildNode(node, parseBlock());
+    }
+    return node;
+}
+
+static ASTNode *parseStatement()
+{
+    ASTNode *node;
+    if (isTypeToken(token))
+        return parseDeclaration(takeType());
+    switch (token)
+    {
+    case IF:
+        return parseConditional(AST_IF_STATEMENT);
+    case WHILE:
+        return parseConditional(AST_WHILE_LOOP);
+    case RETURN:
+        advance();
+        node = createASTNode(AST_RETURN_STATEMENT);
+        if (token != SEMICOLON)
+            addChildNode(node, parseExpression(1));
+        break;
+    case IDENTIFIER:
+    {
+        // A variable or element followed by = is assigned; anything else starts an expression
+        char *name = takeIdentifier();
+        if (token == ASSIGN)
+        {
+            node = parseAssignment(variableNode(name));
+            break;
+        }
+        node = parseNamed(name);
+        if (node->type == AST_ARRAY_ACCESS && token == ASSIGN)
+            node = parseAssignment(node);
+        else
+            node = parseOperators(node, 1);
+        break;
+    }
+    default:
+        node = parseExpression(1);
+        break;
+    }
+    expect(SEMICOLON);
+    return node;
+}
+
+int prattParse(void (*topLevel)(ASTNode *statement))
+{
+    astRoot = NULL;
+    if (setjmp(syntaxError))
+        return 1;
+    advance();
+    while (token != YYEOF)
+    {
+        ASTNode *statement = parseStatement();
+        if (!astRoot)
+            astRoot = createASTNode(AST_PROGRAM);
+        addChildNode(astRoot, statement);
+        if (topLevel)
+            topLevel(statement);
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef PRATT_PARSER_H
+#define PRATT_PARSER_H
+
+#include "AST.h"
+
+// Hand-written recursive descent parser for the grammar in parser.y, selected
+// with --parser=pratt. Statements are told apart by at most two tokens of
+// lookahead; expressions are parsed by precedence climbing over the same table
+// as the grammar's %left and %nonassoc declarations, so a chain such as
+// a < b < c is rejected just as bison rejects it. It builds the same AST
+// through createASTNode and addChildNode and makes the same symbol table calls,
+// but without a table lookup per token or a diagnostic line per reduction.
+
+// Parses yyin into astRoot, handing each top-level statement to topLevel (if
+// not NULL) as soon as it is complete. Returns 0 on success and 1 after a
+// syntax error, which is reported through yyerror, like yyparse.
+int prattParse(void (*topLevel)(ASTNode *statement));
+
+#endif // PRATT_PARSER_H
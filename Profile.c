@@ -0,0 +1,198 @@
+#include "Profile.h"
+#include "DataLayout.h"
+#include "NameTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *kindNames[PROBE_KIND_COUNT] = {"if", "then", "loop", "body", "call"};
+
+typedef struct ProbeCount
+{
+    char *function;
+    int probe;
+    ProbeKind kind;
+    long long count; // Unused for the instrumented build's counters
+} ProbeCount;
+
+// Counters of the instrumented build, by index
+static ProbeCount *counters = NULL;
+static int counterCount = 0;
+static int counterCapacity = 0;
+static DataObject *counterArray = NULL;
+
+// The loaded profile, hashed by function, probe and kind
+static ProbeCount *entries = NULL;
+static int entryCount = 0;
+static int *entryTable = NULL;
+static int entryTableSize = 0;
+static long long hottestBody = 0;
+
+static int numberFrom(ASTNode *node, int next)
+{
+    if (node->type == AST_FUNCTION_DECLARATION)
+        return next;
+    if (node->type == AST_IF_STATEMENT || node->type == AST_WHILE_LOOP || node->type == AST_FUNCTION_CALL)
+        node->probe = next++;
+    for (int i = 0; i < node->childCount; i++)
+    {
+        if (node->children[i])
+            next = numberFrom(node->children[i], next);
+    }
+    return next;
+}
+
+void numberProbes(ASTNode *node)
+{
+    int next = 1;
+    for (int i = 0; i < node->childCount; i++)
+        next = numberFrom(node->children[i], next);
+}
+
+int addProbeCounter(const char *function, int probe, ProbeKind kind)
+{
+    if (counterCount == counterCapacity)
+    {
+        counterCapacity = counterCapacity ? 2 * counterCapacity : 64;
+        counters = realloc(counters, sizeof(ProbeCount) * counterCapacity);
+        if (!counters)
+        {
+            perror("Failed to allocate profile counters");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Streamed functions are freed before the profile is written
+    counters[counterCount].function = strdup(function);
+    counters[counterCount].probe = probe;
+    counters[counterCount].kind = kind;
+    if (!counterArray)
+        counterArray = declareInternalArray(strdup(PROFILE_COUNTERS));
+    counterArray->words++;
+    return counterCount++;
+}
+
+void writeProfile(const char *path, const unsigned int *counts)
+{
+    FILE *out = fopen(path, "w");
+    if (!out)
+    {
+        perror("Failed to open profile");
+        exit(EXIT_FAILURE);
+    }
+    fprintf(out, "# function probe kind count\n");
+    for (int i = 0; i < counterCount; i++)
+        fprintf(out, "%s %d %s %u\n", counters[i].function, counters[i].probe, kindNames[counters[i].kind], counts[i]);
+    if (fclose(out) != 0)
+    {
+        perror("Failed to write profile");
+        exit(EXIT_FAILURE);
+    }
+    printf("PROFILE: %d counters written to %s\n", counterCount, path);
+}
+
+static unsigned int hashProbe(const char *function, int probe, ProbeKind kind)
+{
+    return (hashName(function) ^ (unsigned int)probe * 31u ^ (unsigned int)kind) * 16777619u;
+}
+
+// The table slot holding the probe, or the empty slot where it would go
+static int *findEntry(const char *function, int probe, ProbeKind kind)
+{
+    unsigned int slot = hashProbe(function, probe, kind) & (entryTableSize - 1);
+    while (entryTable[slot] >= 0)
+    {
+        ProbeCount *entry = &entries[entryTable[slot]];
+        if (entry->probe == probe && entry->kind == kind && strcmp(entry->function, function) == 0)
+            break;
+        slot = (slot + 1) & (entryTableSize - 1);
+    }
+    return &entryTable[slot];
+}
+
+void loadProfile(const char *path)
+{
+    FILE *in = fopen(path, "r");
+    if (!in)
+    {
+        perror("Failed to open profile");
+        exit(EXIT_FAILURE);
+    }
+    int capacity = 0;
+    char line[512];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), in))
+    {
+        lineNumber++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        char function[256];
+        char kindName[16];
+        int probe;
+        long long count;
+        if (sscanf(line, "%255s %d %15s %lld", function, &probe, kindName, &count) != 4)
+        {
+            fprintf(stderr, "Error: %s:%d is not a profile line\n", path, lineNumber);
+            exit(EXIT_FAILURE);
+        }
+        int kind = 0;
+        while (kind < PROBE_KIND_COUNT && strcmp(kindNames[kind], kindName) != 0)
+            kind++;
+        if (kind == PROBE_KIND_COUNT)
+        {
+            fprintf(stderr, "Error: %s:%d has unknown probe kind %s\n", path, lineNumber, kindName);
+            exit(EXIT_FAILURE);
+        }
+        if (entryCount == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 64;
+            entries = realloc(entries, sizeof(ProbeCount) * capacity);
+            if (!entries)
+            {
+                perror("Failed to allocate profile");
+                exit(EXIT_FAILURE);
+            }
+        }
+        entries[entryCount++] = (ProbeCount){strdup(function), probe, kind, count};
+    }
+    fclose(in);
+
+    entryTableSize = 16;
+    while (entryTableSize < 2 * entryCount)
+        entryTableSize *= 2;
+    entryTable = malloc(sizeof(int) * entryTableSize);
+    if (!entryTable)
+    {
+        perror("Failed to allocate profile table");
+        exit(EXIT_FAILURE);
+    }
+    memset(entryTable, -1, sizeof(int) * entryTableSize);
+    for (int i = 0; i < entryCount; i++)
+    {
+        // A probe generated more than once has a line per copy; they add up
+        int *slot = findEntry(entries[i].function, entries[i].probe, entries[i].kind);
+        if (*slot >= 0)
+            entries[*slot].count += entries[i].count;
+        else
+            *slot = i;
+    }
+    for (int i = 0; i < entryTableSize; i++)
+    {
+        ProbeCount *entry = entryTable[i] >= 0 ? &entries[entryTable[i]] : NULL;
+        if (entry && entry->kind == PROBE_BODY && entry->count > hottestBody)
+            hottestBody = entry->count;
+    }
+    printf("PROFILE: %d counts read from %s\n", entryCount, path);
+}
+
+long long profileCount(const char *function, int probe, ProbeKind kind)
+{
+    if (!entryTable || probe == 0)
+        return -1;
+    int index = *findEntry(function, probe, kind);
+    return index >= 0 ? entries[index].count : -1;
+}
+
+long long hottestLoopBody()
+{
+    return hottestBody;
+}
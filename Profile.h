@@ -0,0 +1,46 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "AST.h"
+
+// Profile-guided optimization. An instrumented build (--profile-generate) gives
+// every if, while loop and call a counter in a .bss array that the generated code
+// increments, runs the program on the simulator and writes the counts to a
+// profile, one "function probe kind count" line each. A later compile
+// (--profile-use) reads them back to lay out ifs so the hot path falls through,
+// to unroll hot loops further and leave cold ones alone, and to inline the
+// hottest calls. Probes are numbered per function in source order, so a profile
+// holds for as long as the source is unchanged, whatever options either compile had.
+
+// Symbol of the instrumented build's counters, one word each
+#define PROFILE_COUNTERS "__profile"
+// A loop running at least 1/HOT_LOOP_SHARE of the hottest loop's iterations is hot
+#define HOT_LOOP_SHARE 8
+
+typedef enum
+{
+    PROBE_IF,   // Tests of an if
+    PROBE_THEN, // Runs of its then part
+    PROBE_LOOP, // Arrivals at a while loop
+    PROBE_BODY, // Runs of its body
+    PROBE_CALL, // Runs of a call
+    PROBE_KIND_COUNT
+} ProbeKind;
+
+// Numbers the ifs, loops and calls under node from 1, skipping function
+// declarations, so main's probes can be numbered from the program node
+void numberProbes(ASTNode *node);
+
+// Instrumented build: a new counter for a probe of function; returns its index
+int addProbeCounter(const char *function, int probe, ProbeKind kind);
+// Writes the counts a run left in the counter array
+void writeProfile(const char *path, const unsigned int *counts);
+
+// Reads a profile for profileCount; exits when the file cannot be read
+void loadProfile(const char *path);
+// The loaded count of a probe, or -1 when the profile has none
+long long profileCount(const char *function, int probe, ProbeKind kind);
+// The most iterations any one loop ran
+long long hottestLoopBody();
+
+#endif // PROFILE_H
@@ -0,0 +1,753 @@
+#include "RangeAnalysis.h"
+#include "CompilerStats.h"
+#include "NameTable.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Loop headers whose entry range grows more often than this are widened
+#define WIDEN_AFTER 2
+// Passes that recompute the ranges from their predecessors once widening settles
+#define NARROWING_PASSES 2
+
+typedef struct Range
+{
+    long long low;
+    long long high;
+} Range;
+
+static const Range FULL_RANGE = {INT_MIN, INT_MAX};
+
+typedef struct RangeBlock
+{
+    int first; // Index of the first instruction
+    int last;  // Index of the last instruction
+    int successors[2];
+    int successorCount;
+    int isLoopHeader; // Target of a branch from itself or a later block
+    int reached;
+    int updates;
+    Range *in; // Range of every name live across blocks on entry
+} RangeBlock;
+
+// A label and the block it starts, sorted by label for lookup
+typedef struct BlockLabel
+{
+    const char *label;
+    int block;
+} BlockLabel;
+
+// An entry of the state an edge narrowed, put back once the edge is merged
+typedef struct NarrowedName
+{
+    int name;
+    Range range;
+} NarrowedName;
+
+typedef struct RangeAnalysis
+{
+    IRInstruction **code;
+    int count;
+    int *def; // Name each instruction writes, or -1
+    int *arg1; // Name arg1 reads, or -1 when it is no use or an immediate
+    int *arg2;
+    char **names;
+    int nameCount;
+    // Names used in a block that does not define them first come before the
+    // rest, the temporaries of one block, and only they are kept per block
+    int crossCount;
+    int *nameTable;
+    int nameTableSize;
+    RangeBlock *blocks;
+    int blockCount;
+    BlockLabel *labels;
+    int labelCount;
+    int *worklist; // Heap of the blocks whose entry state grew, lowest first
+    int worklistCount;
+    char *queued;
+    NarrowedName narrowedNames[4]; // What the edge being merged changed in the exit state
+    int narrowedCount;
+    long long *thresholds; // Sorted bounds widening jumps to: the unit's constants and their neighbours
+    int thresholdCount;
+} RangeAnalysis;
+
+static const char *nameInSlot(const void *table, int slot)
+{
+    const RangeAnalysis *analysis = table;
+    int index = analysis->nameTable[slot];
+    return index < 0 ? NULL : analysis->names[index];
+}
+
+static int internName(RangeAnalysis *analysis, char *name)
+{
+    int slot = probeNameTable(analysis, analysis->nameTableSize, nameInSlot, name);
+    if (analysis->nameTable[slot] >= 0)
+        return analysis->nameTable[slot];
+    analysis->names[analysis->nameCount] = name;
+    analysis->nameTable[slot] = analysis->nameCount;
+    return analysis->nameCount++;
+}
+
+static int compareLabels(const void *a, const void *b)
+{
+    return strcmp(((const BlockLabel *)a)->label, ((const BlockLabel *)b)->label);
+}
+
+static int findLabel(RangeAnalysis *analysis, const char *label)
+{
+    BlockLabel key = {label, -1};
+    BlockLabel *found = bsearch(&key, analysis->labels, analysis->labelCount, sizeof(BlockLabel), compareLabels);
+    return found ? found->block : -1;
+}
+
+static void buildBlocks(RangeAnalysis *analysis)
+{
+    analysis->blocks = calloc(analysis->count + 1, sizeof(RangeBlock));
+    if (!analysis->blocks)
+    {
+        perror("Failed to allocate range analysis blocks");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < analysis->count; i++)
+    {
+        if (i == 0 || strcmp(analysis->code[i]->op, "LABEL") == 0 || isBlockTerminator(analysis->code[i - 1]))
+            analysis->blocks[analysis->blockCount++].first = i;
+        analysis->blocks[analysis->blockCount - 1].last = i;
+    }
+    analysis->labels = malloc(sizeof(BlockLabel) * (analysis->blockCount + 1));
+    if (!analysis->labels)
+    {
+        perror("Failed to allocate range analysis labels");
+        exit(EXIT_FAILURE);
+    }
+    for (int b = 0; b < analysis->blockCount; b++)
+    {
+        char *label = getLabelName(analysis->code[analysis->blocks[b].first]);
+        if (label)
+            analysis->labels[analysis->labelCount++] = (BlockLabel){label, b};
+    }
+    qsort(analysis->labels, analysis->labelCount, sizeof(BlockLabel), compareLabels);
+    for (int b = 0; b < analysis->blockCount; b++)
+    {
+        RangeBlock *block = &analysis->blocks[b];
+        IRInstruction *last = analysis->code[block->last];
+        char *target = getBranchTarget(last);
+        int successor = target ? findLabel(analysis, target) : -1;
+        if (successor >= 0)
+        {
+            block->successors[block->successorCount++] = successor;
+            if (successor <= b)
+                analysis->blocks[successor].isLoopHeader = 1;
+        }
+        if (strcmp(last->op, "GOTO") != 0 && strcmp(last->op, "RETURN") != 0 && b + 1 < analysis->blockCount)
+            block->successors[block->successorCount++] = b + 1;
+    }
+}
+
+static Range makeRange(long long low, long long high)
+{
+    if (low < INT_MIN || high > INT_MAX)
+        return FULL_RANGE; // The 32-bit result may wrap
+    Range range = {low, high};
+    return range;
+}
+
+// add and sub trap on overflow, so a sum past either end never reaches later code
+static Range saturatedRange(long long low, long long high)
+{
+    if (low < INT_MIN)
+        low = INT_MIN;
+    if (high > INT_MAX)
+        high = INT_MAX;
+    return makeRange(low, high);
+}
+
+static Range operandRange(Range *state, int name, const char *operand)
+{
+    if (name >= 0)
+        return state[name];
+    if (isImmediateOperand(operand))
+        return makeRange(immediateValue(operand), immediateValue(operand));
+    return FULL_RANGE;
+}
+
+static Range multiplyRanges(Range a, Range b)
+{
+    long long products[4] = {a.low * b.low, a.low * b.high, a.high * b.low, a.high * b.high};
+    long long low = products[0], high = products[0];
+    for (int i = 1; i < 4; i++)
+    {
+        if (products[i] < low)
+            low = products[i];
+        if (products[i] > high)
+            high = products[i];
+    }
+    return makeRange(low, high);
+}
+
+// Range of the value instruction i writes, given the ranges before it
+static Range evaluate(RangeAnalysis *analysis, Range *state, int i)
+{
+    IRInstruction *ir = analysis->code[i];
+    if (strcmp(ir->op, "MOV") == 0)
+        return makeRange(atoi(ir->arg1), atoi(ir->arg1));
+    if (strcmp(ir->op, "LOAD") == 0 || strcmp(ir->op, "=") == 0)
+        return operandRange(state, analysis->arg1[i], ir->arg1);
+    if (strcmp(ir->op, "NOT") == 0)
+        return makeRange(0, 1);
+    if (strcmp(ir->op, "NEG") == 0)
+    {
+        Range value = operandRange(state, analysis->arg1[i], ir->arg1);
+        return makeRange(-value.high, -value.low);
+    }
+    if (!isBinaryOperator(ir->op))
+        return FULL_RANGE; // Calls, parameters and memory
+
+    Range a = operandRange(state, analysis->arg1[i], ir->arg1);
+    Range b = operandRange(state, analysis->arg2[i], ir->arg2);
+    switch (ir->op[0])
+    {
+    case '+':
+        return saturatedRange(a.low + b.low, a.high + b.high);
+    case '-':
+        return saturatedRange(a.low - b.high, a.high - b.low);
+    case '*':
+        return multiplyRanges(a, b);
+    case '/':
+        // Truncating division by a positive constant keeps the order
+        if (b.low == b.high && b.low > 0)
+            return makeRange(a.low / b.low, a.high / b.low);
+        return FULL_RANGE;
+    }
+    if (strcmp(ir->op, "<<") == 0 && b.low == b.high && b.low >= 0 && b.low < 31)
+        return multiplyRanges(a, makeRange(1LL << b.low, 1LL << b.low));
+    return makeRange(0, 1); // Comparisons
+}
+
+static void transfer(RangeAnalysis *analysis, Range *state, int i)
+{
+    if (analysis->def[i] >= 0)
+        state[analysis->def[i]] = evaluate(analysis, state, i);
+}
+
+// The variable name was copied from just before the branch at index last, so a
+// test of the copy also tells us about the variable
+static int copySource(RangeAnalysis *analysis, RangeBlock *block, int name)
+{
+    for (int j = block->last - 1; j >= block->first; j--)
+    {
+        if (analysis->def[j] != name)
+            continue;
+        IRInstruction *ir = analysis->code[j];
+        int source = analysis->arg1[j];
+        if ((strcmp(ir->op, "LOAD") != 0 && strcmp(ir->op, "=") != 0) || source < 0)
+            return -1;
+        for (int k = j + 1; k < block->last; k++)
+        {
+            if (analysis->def[k] == source)
+                return -1;
+        }
+        return source;
+    }
+    return -1;
+}
+
+// The opposite relation, or NULL when relation is not a comparison
+static const char *negateRelation(const char *relation)
+{
+    static const char *pairs[][2] = {{"<", ">="}, {">=", "<"}, {">", "<="}, {"<=", ">"}, {"==", "!="}, {"!=", "=="}};
+    for (int i = 0; i < 6; i++)
+    {
+        if (strcmp(pairs[i][0], relation) == 0)
+            return pairs[i][1];
+    }
+    return NULL;
+}
+
+// Index of the comparison in block that computed the flag name, when neither of
+// its operands changes before the branch; -1 otherwise
+static int comparisonFeeding(RangeAnalysis *analysis, RangeBlock *block, int name)
+{
+    for (int j = block->last - 1; j >= block->first; j--)
+    {
+        if (analysis->def[j] != name)
+            continue;
+        if (!negateRelation(analysis->code[j]->op))
+            return -1;
+        for (int k = j + 1; k < block->last; k++)
+        {
+            if (analysis->def[k] >= 0 && (analysis->def[k] == analysis->arg1[j] || analysis->def[k] == analysis->arg2[j]))
+                return -1;
+        }
+        return j;
+    }
+    return -1;
+}
+
+// Remembers state[name] before an edge narrows it
+static void saveName(RangeAnalysis *analysis, Range *state, int name)
+{
+    analysis->narrowedNames[analysis->narrowedCount++] = (NarrowedName){name, state[name]};
+}
+
+static void narrowName(RangeAnalysis *analysis, RangeBlock *block, Range *state, int name, Range range)
+{
+    if (name < 0)
+        return;
+    saveName(analysis, state, name);
+    state[name] = range;
+    int source = copySource(analysis, block, name);
+    if (source >= 0)
+    {
+        saveName(analysis, state, source);
+        if (range.low > state[source].low)
+            state[source].low = range.low;
+        if (range.high < state[source].high)
+            state[source].high = range.high;
+    }
+}
+
+// Narrows the state to the values for which "arg1 relation arg2" of instruction
+// i holds at the end of block; returns 0 when no value can satisfy it, so the
+// edge is never taken
+static int assumeRelation(RangeAnalysis *analysis, RangeBlock *block, Range *state, int i, const char *relation)
+{
+    IRInstruction *ir = analysis->code[i];
+    Range a = operandRange(state, analysis->arg1[i], ir->arg1);
+    Range b = ir->arg2 ? operandRange(state, analysis->arg2[i], ir->arg2) : makeRange(0, 0);
+
+    if (strcmp(relation, "<") == 0 || strcmp(relation, "<=") == 0)
+    {
+        long long gap = relation[1] ? 0 : 1;
+        if (b.high - gap < a.high)
+            a.high = b.high - gap;
+        if (a.low + gap > b.low)
+            b.low = a.low + gap;
+    }
+    else if (strcmp(relation, ">") == 0 || strcmp(relation, ">=") == 0)
+    {
+        long long gap = relation[1] ? 0 : 1;
+        if (b.low + gap > a.low)
+            a.low = b.low + gap;
+        if (a.high - gap < b.high)
+            b.high = a.high - gap;
+    }
+    else if (strcmp(relation, "==") == 0)
+    {
+        a.low = b.low = a.low > b.low ? a.low : b.low;
+        a.high = b.high = a.high < b.high ? a.high : b.high;
+    }
+    else if (b.low == b.high)
+    {
+        // a != c only trims c off either end of a
+        if (a.low == b.low)
+            a.low++;
+        if (a.high == b.low)
+            a.high--;
+    }
+    if (a.low > a.high || b.low > b.high)
+        return 0;
+    narrowName(analysis, block, state, analysis->arg1[i], a);
+    narrowName(analysis, block, state, ir->arg2 ? analysis->arg2[i] : -1, b);
+    return 1;
+}
+
+// Narrows out, the exit state of block, to the state on the edge to its
+// successor-th successor; 0 when the edge is infeasible. restoreExit undoes it.
+static int edgeState(RangeAnalysis *analysis, RangeBlock *block, Range *out, int successor)
+{
+    analysis->narrowedCount = 0;
+    int i = block->last;
+    IRInstruction *last = analysis->code[i];
+    const char *relation = getBranchRelation(last);
+    if (!relation || block->successorCount != 2 || block->successors[0] == block->successors[1])
+        return 1;
+
+    // Without fused branches the condition is a flag tested against zero
+    int comparison = last->arg2 ? -1 : comparisonFeeding(analysis, block, analysis->arg1[i]);
+    if (comparison >= 0 && (strcmp(relation, "==") == 0 || strcmp(relation, "!=") == 0))
+    {
+        const char *tested = analysis->code[comparison]->op;
+        relation = relation[0] == '!' ? tested : negateRelation(tested);
+        i = comparison;
+    }
+    return assumeRelation(analysis, block, out, i, successor == 0 ? relation : negateRelation(relation));
+}
+
+static void restoreExit(RangeAnalysis *analysis, Range *out)
+{
+    while (analysis->narrowedCount > 0)
+    {
+        NarrowedName *saved = &analysis->narrowedNames[--analysis->narrowedCount];
+        out[saved->name] = saved->range;
+    }
+}
+
+static int compareBounds(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Loop bounds are almost always constants of the unit, so widening stops at
+// c - 1, c and c + 1 for each constant c before giving up on a bound entirely
+static void collectThresholds(RangeAnalysis *analysis)
+{
+    analysis->thresholds = malloc(sizeof(long long) * (3 * analysis->count + 2));
+    if (!analysis->thresholds)
+    {
+        perror("Failed to allocate widening thresholds");
+        exit(EXIT_FAILURE);
+    }
+    int count = 0;
+    analysis->thresholds[count++] = INT_MIN;
+    analysis->thresholds[count++] = INT_MAX;
+    for (int i = 0; i < analysis->count; i++)
+    {
+        if (strcmp(analysis->code[i]->op, "MOV") != 0)
+            continue;
+        long long value = atoi(analysis->code[i]->arg1);
+        for (long long bound = value - 1; bound <= value + 1; bound++)
+        {
+            if (bound >= INT_MIN && bound <= INT_MAX)
+                analysis->thresholds[count++] = bound;
+        }
+    }
+    qsort(analysis->thresholds, count, sizeof(long long), compareBounds);
+    analysis->thresholdCount = count;
+}
+
+// The smallest threshold at least bound; INT_MAX is one, so there always is one
+static long long widenUp(RangeAnalysis *analysis, long long bound)
+{
+    int low = 0, high = analysis->thresholdCount - 1;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (analysis->thresholds[middle] < bound)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return analysis->thresholds[low];
+}
+
+// The largest threshold at most bound
+static long long widenDown(RangeAnalysis *analysis, long long bound)
+{
+    int low = 0, high = analysis->thresholdCount - 1;
+    while (low < high)
+    {
+        int middle = (low + high + 1) / 2;
+        if (analysis->thresholds[middle] > bound)
+            high = middle - 1;
+        else
+            low = middle;
+    }
+    return analysis->thresholds[low];
+}
+
+// Joins edge into the entry state of block; returns 1 when it grew
+static int mergeInto(RangeAnalysis *analysis, RangeBlock *block, Range *edge)
+{
+    if (!block->reached)
+    {
+        memcpy(block->in, edge, sizeof(Range) * analysis->crossCount);
+        block->reached = 1;
+        return 1;
+    }
+    int widen = block->isLoopHeader && block->updates >= WIDEN_AFTER;
+    int grew = 0;
+    for (int n = 0; n < analysis->crossCount; n++)
+    {
+        Range *in = &block->in[n];
+        if (edge[n].low < in->low)
+        {
+            in->low = widen ? widenDown(analysis, edge[n].low) : edge[n].low;
+            grew = 1;
+        }
+        if (edge[n].high > in->high)
+        {
+            in->high = widen ? widenUp(analysis, edge[n].high) : edge[n].high;
+            grew = 1;
+        }
+    }
+    if (grew)
+        block->updates++;
+    return grew;
+}
+
+// Runs the block from its entry state, leaving the exit state in out. The rest
+// of out is stale, but the block defines each of those names before reading it.
+static void runBlock(RangeAnalysis *analysis, RangeBlock *block, Range *out)
+{
+    memcpy(out, block->in, sizeof(Range) * analysis->crossCount);
+    for (int i = block->first; i <= block->last; i++)
+        transfer(analysis, out, i);
+}
+
+static void queueBlock(RangeAnalysis *analysis, int b)
+{
+    if (analysis->queued[b])
+        return;
+    analysis->queued[b] = 1;
+    int i = analysis->worklistCount++;
+    while (i > 0 && analysis->worklist[(i - 1) / 2] > b)
+    {
+        analysis->worklist[i] = analysis->worklist[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    analysis->worklist[i] = b;
+}
+
+static int nextQueuedBlock(RangeAnalysis *analysis)
+{
+    int b = analysis->worklist[0];
+    int last = analysis->worklist[--analysis->worklistCount];
+    int i = 0;
+    for (;;)
+    {
+        int child = 2 * i + 1;
+        if (child >= analysis->worklistCount)
+            break;
+        if (child + 1 < analysis->worklistCount && analysis->worklist[child + 1] < analysis->worklist[child])
+            child++;
+        if (analysis->worklist[child] >= last)
+            break;
+        analysis->worklist[i] = analysis->worklist[child];
+        i = child;
+    }
+    analysis->worklist[i] = last;
+    analysis->queued[b] = 0;
+    return b;
+}
+
+static void solve(RangeAnalysis *analysis)
+{
+    int names = analysis->crossCount;
+    Range *out = malloc(sizeof(Range) * (analysis->nameCount + 1));
+    Range *next = malloc(sizeof(Range) * (names + 1) * analysis->blockCount);
+    int *nextReached = malloc(sizeof(int) * analysis->blockCount);
+    analysis->worklist = malloc(sizeof(int) * analysis->blockCount);
+    analysis->queued = calloc(analysis->blockCount, 1);
+    if (!out || !next || !nextReached || !analysis->worklist || !analysis->queued)
+    {
+        perror("Failed to allocate range analysis state");
+        exit(EXIT_FAILURE);
+    }
+    for (int b = 0; b < analysis->blockCount; b++)
+        analysis->blocks[b].in = next + (long)b * (names + 1);
+    for (int n = 0; n < names; n++)
+        analysis->blocks[0].in[n] = FULL_RANGE;
+    analysis->blocks[0].reached = 1;
+
+    // Grow the ranges to a fixed point, widening at loop headers. Only blocks
+    // whose entry grew run again, in program order.
+    queueBlock(analysis, 0);
+    while (analysis->worklistCount > 0)
+    {
+        RangeBlock *block = &analysis->blocks[nextQueuedBlock(analysis)];
+        runBlock(analysis, block, out);
+        for (int s = 0; s < block->successorCount; s++)
+        {
+            int target = block->successors[s];
+            if (edgeState(analysis, block, out, s) && mergeInto(analysis, &analysis->blocks[target], out))
+                queueBlock(analysis, target);
+            restoreExit(analysis, out);
+        }
+    }
+
+    // Widening overshoots; recomputing every entry from its predecessors stays sound
+    Range *narrowed = malloc(sizeof(Range) * (names + 1) * analysis->blockCount);
+    if (!narrowed)
+    {
+        perror("Failed to allocate range analysis state");
+        exit(EXIT_FAILURE);
+    }
+    for (int pass = 0; pass < NARROWING_PASSES; pass++)
+    {
+        for (int b = 1; b < analysis->blockCount; b++)
+            nextReached[b] = 0;
+        for (int b = 0; b < analysis->blockCount; b++)
+        {
+            RangeBlock *block = &analysis->blocks[b];
+            if (!block->reached)
+                continue;
+            runBlock(analysis, block, out);
+            for (int s = 0; s < block->successorCount; s++)
+            {
+                int target = block->successors[s];
+                Range *joined = narrowed + (long)target * (names + 1);
+                if (target != 0 && edgeState(analysis, block, out, s))
+                {
+                    for (int n = 0; n < names; n++)
+                    {
+                        if (!nextReached[target] || out[n].low < joined[n].low)
+                            joined[n].low = out[n].low;
+                        if (!nextReached[target] || out[n].high > joined[n].high)
+                            joined[n].high = out[n].high;
+                    }
+                    nextReached[target] = 1;
+                }
+                restoreExit(analysis, out);
+            }
+        }
+        for (int b = 1; b < analysis->blockCount; b++)
+        {
+            if (nextReached[b])
+                memcpy(analysis->blocks[b].in, narrowed + (long)b * (names + 1), sizeof(Range) * names);
+            analysis->blocks[b].reached = nextReached[b];
+        }
+    }
+    free(narrowed);
+    free(nextReached);
+    free(analysis->worklist);
+    free(analysis->queued);
+    free(out);
+}
+
+// Numbers the names live across blocks first, so block states need only hold those
+static void orderNames(RangeAnalysis *analysis)
+{
+    int *definedIn = malloc(sizeof(int) * (analysis->nameCount + 1));
+    int *number = malloc(sizeof(int) * (analysis->nameCount + 1));
+    char **names = malloc(sizeof(char *) * (analysis->nameCount + 1));
+    if (!definedIn || !number || !names)
+    {
+        perror("Failed to allocate range analysis names");
+        exit(EXIT_FAILURE);
+    }
+    for (int n = 0; n < analysis->nameCount; n++)
+        definedIn[n] = number[n] = -1;
+    for (int b = 0; b < analysis->blockCount; b++)
+    {
+        for (int i = analysis->blocks[b].first; i <= analysis->blocks[b].last; i++)
+        {
+            int uses[2] = {analysis->arg1[i], analysis->arg2[i]};
+            for (int u = 0; u < 2; u++)
+            {
+                if (uses[u] >= 0 && definedIn[uses[u]] != b && number[uses[u]] < 0)
+                    number[uses[u]] = analysis->crossCount++;
+            }
+            if (analysis->def[i] >= 0)
+                definedIn[analysis->def[i]] = b;
+        }
+    }
+    int local = analysis->crossCount;
+    for (int n = 0; n < analysis->nameCount; n++)
+    {
+        if (number[n] < 0)
+            number[n] = local++;
+        names[number[n]] = analysis->names[n];
+    }
+    for (int i = 0; i < analysis->count; i++)
+    {
+        if (analysis->def[i] >= 0)
+            analysis->def[i] = number[analysis->def[i]];
+        if (analysis->arg1[i] >= 0)
+            analysis->arg1[i] = number[analysis->arg1[i]];
+        if (analysis->arg2[i] >= 0)
+            analysis->arg2[i] = number[analysis->arg2[i]];
+    }
+    free(analysis->names);
+    analysis->names = names;
+    free(number);
+    free(definedIn);
+}
+
+void eliminateBoundsChecks(IRInstruction *first, IRInstruction *end)
+{
+    RangeAnalysis analysis;
+    memset(&analysis, 0, sizeof(analysis));
+    for (IRInstruction *current = first; current != end; current = current->next)
+        analysis.count++;
+    int checks = 0;
+    analysis.code = malloc(sizeof(IRInstruction *) * (analysis.count + 1));
+    analysis.def = malloc(sizeof(int) * (analysis.count + 1));
+    analysis.arg1 = malloc(sizeof(int) * (analysis.count + 1));
+    analysis.arg2 = malloc(sizeof(int) * (analysis.count + 1));
+    analysis.names = malloc(sizeof(char *) * (3 * analysis.count + 1));
+    analysis.nameTableSize = 16;
+    while (analysis.nameTableSize < 6 * analysis.count)
+        analysis.nameTableSize *= 2;
+    analysis.nameTable = malloc(sizeof(int) * analysis.nameTableSize);
+    if (!analysis.code || !analysis.def || !analysis.arg1 || !analysis.arg2 || !analysis.names || !analysis.nameTable)
+    {
+        perror("Failed to allocate range analysis");
+        exit(EXIT_FAILURE);
+    }
+    memset(analysis.nameTable, -1, sizeof(int) * analysis.nameTableSize);
+
+    int index = 0;
+    for (IRInstruction *current = first; current != end; current = current->next, index++)
+    {
+        analysis.code[index] = current;
+        char *uses[2];
+        int useCount = getInstructionUses(current, uses);
+        analysis.arg1[index] = analysis.arg2[index] = -1;
+        for (int u = 0; u < useCount; u++)
+        {
+            if (uses[u] == current->arg1)
+                analysis.arg1[index] = internName(&analysis, uses[u]);
+            if (uses[u] == current->arg2)
+                analysis.arg2[index] = internName(&analysis, uses[u]);
+        }
+        char *def = getInstructionDefinition(current);
+        analysis.def[index] = def ? internName(&analysis, def) : -1;
+        if (strcmp(current->op, "CHECK_BOUNDS") == 0)
+            checks++;
+    }
+
+    int removed = 0;
+    if (checks > 0)
+    {
+        buildBlocks(&analysis);
+        orderNames(&analysis);
+        collectThresholds(&analysis);
+        solve(&analysis);
+        Range *state = malloc(sizeof(Range) * (analysis.nameCount + 1));
+        if (!state)
+        {
+            perror("Failed to allocate range analysis state");
+            exit(EXIT_FAILURE);
+        }
+        for (int b = 0; b < analysis.blockCount; b++)
+        {
+            RangeBlock *block = &analysis.blocks[b];
+            if (!block->reached)
+                continue;
+            memcpy(state, block->in, sizeof(Range) * analysis.crossCount);
+            IRInstruction *previous = b > 0 ? analysis.code[block->first - 1] : NULL;
+            for (int i = block->first; i <= block->last; i++)
+            {
+                IRInstruction *ir = analysis.code[i];
+                if (strcmp(ir->op, "CHECK_BOUNDS") == 0)
+                {
+                    Range index = operandRange(state, analysis.arg1[i], ir->arg1);
+                    if (index.low >= 0 && index.high < immediateValue(ir->arg2))
+                    {
+                        previous->next = ir->next; // Never the first instruction, which is the FUNCTION
+                        removed++;
+                        continue;
+                    }
+                }
+                transfer(&analysis, state, i);
+                previous = ir;
+            }
+        }
+        free(state);
+        free(analysis.blocks[0].in);
+        free(analysis.blocks);
+        free(analysis.labels);
+        free(analysis.thresholds);
+    }
+    fprintf(diagnostics(), "RANGE: %s %d of %d bounds checks removed\n", getLabelName(first), removed, checks);
+
+    free(analysis.code);
+    free(analysis.def);
+    free(analysis.arg1);
+    free(analysis.arg2);
+    free(analysis.names);
+    free(analysis.nameTable);
+}
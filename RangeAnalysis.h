@@ -0,0 +1,16 @@
+#ifndef RANGE_ANALYSIS_H
+#define RANGE_ANALYSIS_H
+
+#include "IRGeneration.h"
+
+// Interval analysis over the IR of one unit, run before instruction selection.
+// Every variable and temporary live into a basic block gets a [low, high] range there,
+// narrowed on the edges of conditional branches and widened at loop headers so
+// the iteration terminates. A CHECK_BOUNDS whose index range lies within the
+// array is removed, which also lets selection fold the index into the address.
+
+// Unlinks the provably redundant bounds checks in [first, end); the first
+// instruction, the unit's FUNCTION, always stays
+void eliminateBoundsChecks(IRInstruction *first, IRInstruction *end);
+
+#endif // RANGE_ANALYSIS_H
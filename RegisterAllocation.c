@@ -0,0 +1,738 @@
+#include "RegisterAllocation.h"
+#include "CompilerStats.h"
+#include "NameTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// $t8/$t9 and $f16/$f18 are kept back so spill code always has somewhere to reload into.
+// Vectors never spill, since the vectorizer keeps within their registers.
+const char *scratchRegisters[REGISTER_CLASS_COUNT][SCRATCH_REGISTER_COUNT] = {
+    {"$t8", "$t9"}, {"$f16", "$f18"}, {"$w17", "$w19"}};
+
+const char *argumentRegisters[4] = {"$a0", "$a1", "$a2", "$a3"};
+
+typedef struct AllocatableRegister
+{
+    const char *name;
+    int calleeSaved; // Costs a save and restore in the prologue and epilogue
+    int leafOnly;    // Used for argument passing, so only free when the unit makes no calls
+    RegisterClass registerClass;
+} AllocatableRegister;
+
+// Tried in order, so caller-saved registers are preferred. Floats use only the
+// even registers, as o32 does, and $f20-$f30 are the callee-saved ones. Vectors
+// take odd MSA registers, whose low halves are the odd $f registers no float
+// uses, and are never live across a call.
+static const AllocatableRegister allocatableRegisters[] = {
+    {"$t0", 0, 0}, {"$t1", 0, 0}, {"$t2", 0, 0}, {"$t3", 0, 0},
+    {"$t4", 0, 0}, {"$t5", 0, 0}, {"$t6", 0, 0}, {"$t7", 0, 0},
+    {"$a0", 0, 1}, {"$a1", 0, 1}, {"$a2", 0, 1}, {"$a3", 0, 1}, {"$v1", 0, 1},
+    {"$s0", 1, 0}, {"$s1", 1, 0}, {"$s2", 1, 0}, {"$s3", 1, 0},
+    {"$s4", 1, 0}, {"$s5", 1, 0}, {"$s6", 1, 0}, {"$s7", 1, 0},
+    {"$f0", 0, 0, REGISTER_CLASS_FLOAT}, {"$f2", 0, 0, REGISTER_CLASS_FLOAT},
+    {"$f4", 0, 0, REGISTER_CLASS_FLOAT}, {"$f6", 0, 0, REGISTER_CLASS_FLOAT},
+    {"$f8", 0, 0, REGISTER_CLASS_FLOAT}, {"$f10", 0, 0, REGISTER_CLASS_FLOAT},
+    {"$f12", 0, 0, REGISTER_CLASS_FLOAT}, {"$f14", 0, 0, REGISTER_CLASS_FLOAT},
+    {"$f20", 1, 0, REGISTER_CLASS_FLOAT}, {"$f22", 1, 0, REGISTER_CLASS_FLOAT},
+    {"$f24", 1, 0, REGISTER_CLASS_FLOAT}, {"$f26", 1, 0, REGISTER_CLASS_FLOAT},
+    {"$f28", 1, 0, REGISTER_CLASS_FLOAT}, {"$f30", 1, 0, REGISTER_CLASS_FLOAT},
+    {"$w1", 0, 0, REGISTER_CLASS_VECTOR}, {"$w3", 0, 0, REGISTER_CLASS_VECTOR},
+    {"$w5", 0, 0, REGISTER_CLASS_VECTOR}, {"$w7", 0, 0, REGISTER_CLASS_VECTOR},
+    {"$w9", 0, 0, REGISTER_CLASS_VECTOR}, {"$w11", 0, 0, REGISTER_CLASS_VECTOR},
+    {"$w13", 0, 0, REGISTER_CLASS_VECTOR}, {"$w15", 0, 0, REGISTER_CLASS_VECTOR}};
+#define ALLOCATABLE_COUNT ((int)(sizeof(allocatableRegisters) / sizeof(allocatableRegisters[0])))
+
+typedef unsigned long BitWord;
+#define BITS_PER_WORD (8 * sizeof(BitWord))
+
+typedef struct BasicBlock
+{
+    int first;      // Index of the first instruction
+    int last;       // Index of the last instruction
+    int successors[2];
+    int successorCount;
+    BitWord *liveIn;
+    BitWord *liveOut;
+    BitWord *uses; // Read before any write in the block
+    BitWord *defs;
+} BasicBlock;
+
+static const char *intervalInSlot(const void *table, int slot)
+{
+    const RegisterAllocation *allocation = table;
+    int index = allocation->nameTable[slot];
+    return index < 0 ? NULL : allocation->intervals[index].name;
+}
+
+// Finds the slot holding name, or the empty slot where it belongs
+static int probeName(RegisterAllocation *allocation, const char *name)
+{
+    return probeNameTable(allocation, allocation->nameTableSize, intervalInSlot, name);
+}
+
+static int internName(RegisterAllocation *allocation, char *name)
+{
+    int slot = probeName(allocation, name);
+    if (allocation->nameTable[slot] < 0)
+    {
+        LiveInterval *interval = &allocation->intervals[allocation->intervalCount];
+        interval->name = name;
+        interval->start = -1;
+        interval->end = -1;
+        interval->useCount = 0;
+        interval->definitionCount = 0;
+        interval->crossesCall = 0;
+        interval->registerClass = REGISTER_CLASS_INT;
+        interval->reg = NULL;
+        interval->preferredReg = NULL;
+        interval->spillSlot = -1;
+        interval->coalesced = NULL;
+        allocation->nameTable[slot] = allocation->intervalCount++;
+    }
+    return allocation->nameTable[slot];
+}
+
+static LiveInterval *representative(LiveInterval *interval)
+{
+    while (interval->coalesced)
+    {
+        interval = interval->coalesced;
+    }
+    return interval;
+}
+
+LiveInterval *findInterval(RegisterAllocation *allocation, const char *name)
+{
+    if (!allocation || !name)
+        return NULL;
+    int slot = probeName(allocation, name);
+    if (allocation->nameTable[slot] < 0)
+        return NULL;
+    return representative(&allocation->intervals[allocation->nameTable[slot]]);
+}
+
+static void extendInterval(LiveInterval *interval, int position)
+{
+    if (interval->start < 0 || position < interval->start)
+        interval->start = position;
+    if (position > interval->end)
+        interval->end = position;
+}
+
+static BitWord *newBitSet(int words)
+{
+    BitWord *set = calloc(words > 0 ? words : 1, sizeof(BitWord));
+    if (!set)
+    {
+        perror("Failed to allocate liveness set");
+        exit(EXIT_FAILURE);
+    }
+    return set;
+}
+
+#define BIT_SET(set, i) ((set)[(i) / BITS_PER_WORD] |= (BitWord)1 << ((i) % BITS_PER_WORD))
+#define BIT_CLEAR(set, i) ((set)[(i) / BITS_PER_WORD] &= ~((BitWord)1 << ((i) % BITS_PER_WORD)))
+#define BIT_TEST(set, i) (((set)[(i) / BITS_PER_WORD] >> ((i) % BITS_PER_WORD)) & 1)
+
+// Blocks by the label they start with, for resolving branch targets
+typedef struct LabelTable
+{
+    int *slots; // Block index, or -1
+    BasicBlock *blocks;
+    IRInstruction **code;
+} LabelTable;
+
+static const char *labelInSlot(const void *table, int slot)
+{
+    const LabelTable *labels = table;
+    int block = labels->slots[slot];
+    return block < 0 ? NULL : getLabelName(labels->code[labels->blocks[block].first]);
+}
+
+// Splits the unit into basic blocks and links branches to their target labels
+static BasicBlock *buildBlocks(IRInstruction **code, int count, int *blockCount)
+{
+    int *blockOf = malloc(sizeof(int) * (count + 1));
+    BasicBlock *blocks = malloc(sizeof(BasicBlock) * (count + 1));
+    if (!blockOf || !blocks)
+    {
+        perror("Failed to allocate basic blocks");
+        exit(EXIT_FAILURE);
+    }
+
+    int blocksFound = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int leader = i == 0 || strcmp(code[i]->op, "LABEL") == 0 || isBlockTerminator(code[i - 1]);
+        if (leader)
+        {
+            blocks[blocksFound].first = i;
+            blocks[blocksFound].successorCount = 0;
+            blocksFound++;
+        }
+        blocks[blocksFound - 1].last = i;
+        blockOf[i] = blocksFound - 1;
+    }
+
+    // Hash the labels so branch targets resolve in constant time
+    int labelTableSize = 16;
+    while (labelTableSize < 2 * blocksFound)
+        labelTableSize <<= 1;
+    int *labelTable = malloc(sizeof(int) * labelTableSize);
+    if (!labelTable)
+    {
+        perror("Failed to allocate label table");
+        exit(EXIT_FAILURE);
+    }
+    memset(labelTable, -1, sizeof(int) * labelTableSize);
+    LabelTable labels = {labelTable, blocks, code};
+    for (int b = 0; b < blocksFound; b++)
+    {
+        char *label = getLabelName(code[blocks[b].first]);
+        if (!label)
+            continue;
+        int slot = probeNameTable(&labels, labelTableSize, labelInSlot, label);
+        if (labelTable[slot] < 0) // A label defined twice resolves to its first block
+            labelTable[slot] = b;
+    }
+
+    for (int b = 0; b < blocksFound; b++)
+    {
+        IRInstruction *last = code[blocks[b].last];
+        char *target = getBranchTarget(last);
+        if (target)
+        {
+            int slot = probeNameTable(&labels, labelTableSize, labelInSlot, target);
+            if (labelTable[slot] >= 0)
+                blocks[b].successors[blocks[b].successorCount++] = labelTable[slot];
+        }
+        int fallsThrough = strcmp(last->op, "GOTO") != 0 && strcmp(last->op, "RETURN") != 0;
+        if (fallsThrough && b + 1 < blocksFound)
+        {
+            blocks[b].successors[blocks[b].successorCount++] = b + 1;
+        }
+    }
+
+    free(labelTable);
+    free(blockOf);
+    *blockCount = blocksFound;
+    return blocks;
+}
+
+// Iterative backwards dataflow over the blocks until the live-in sets settle
+static void computeLiveness(RegisterAllocation *allocation, IRInstruction **code, BasicBlock *blocks, int blockCount)
+{
+    int words = (allocation->intervalCount + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+    for (int b = 0; b < blockCount; b++)
+    {
+        blocks[b].liveIn = newBitSet(words);
+        blocks[b].liveOut = newBitSet(words);
+        blocks[b].uses = newBitSet(words);
+        blocks[b].defs = newBitSet(words);
+        for (int i = blocks[b].first; i <= blocks[b].last; i++)
+        {
+            char *uses[2];
+            int useCount = getInstructionUses(code[i], uses);
+            for (int u = 0; u < useCount; u++)
+            {
+                int v = internName(allocation, uses[u]);
+                if (!BIT_TEST(blocks[b].defs, v))
+                    BIT_SET(blocks[b].uses, v);
+            }
+            char *def = getInstructionDefinition(code[i]);
+            if (def)
+                BIT_SET(blocks[b].defs, internName(allocation, def));
+        }
+    }
+
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (int b = blockCount - 1; b >= 0; b--)
+        {
+            for (int s = 0; s < blocks[b].successorCount; s++)
+            {
+                BitWord *succIn = blocks[blocks[b].successors[s]].liveIn;
+                for (int w = 0; w < words; w++)
+                    blocks[b].liveOut[w] |= succIn[w];
+            }
+            for (int w = 0; w < words; w++)
+            {
+                BitWord in = blocks[b].uses[w] | (blocks[b].liveOut[w] & ~blocks[b].defs[w]);
+                if (in != blocks[b].liveIn[w])
+                {
+                    blocks[b].liveIn[w] = in;
+                    changed = 1;
+                }
+            }
+        }
+    }
+}
+
+// Extends every interval in a liveness set to cover position, skipping empty words
+static void extendLiveSet(RegisterAllocation *allocation, BitWord *live, int words, int position)
+{
+    for (int w = 0; w < words; w++)
+    {
+        for (BitWord bits = live[w]; bits; bits &= bits - 1)
+        {
+            int v = w * BITS_PER_WORD + __builtin_ctzl(bits);
+            extendInterval(&allocation->intervals[v], position);
+        }
+    }
+}
+
+// Walks each block backwards, widening intervals to cover every position a value is live
+static void buildIntervals(RegisterAllocation *allocation, IRInstruction **code, BasicBlock *blocks, int blockCount)
+{
+    int words = (allocation->intervalCount + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    BitWord *live = newBitSet(words);
+
+    for (int b = 0; b < blockCount; b++)
+    {
+        memcpy(live, blocks[b].liveOut, words * sizeof(BitWord));
+        extendLiveSet(allocation, live, words, 2 * blocks[b].last + 1);
+
+        for (int i = blocks[b].last; i >= blocks[b].first; i--)
+        {
+            char *def = getInstructionDefinition(code[i]);
+            if (def)
+            {
+                int v = internName(allocation, def);
+                extendInterval(&allocation->intervals[v], 2 * i + 1);
+                allocation->intervals[v].useCount++;
+                allocation->intervals[v].definitionCount++;
+                BIT_CLEAR(live, v);
+            }
+            char *uses[2];
+            int useCount = getInstructionUses(code[i], uses);
+            for (int u = 0; u < useCount; u++)
+            {
+                int v = internName(allocation, uses[u]);
+                extendInterval(&allocation->intervals[v], 2 * i);
+                allocation->intervals[v].useCount++;
+                BIT_SET(live, v);
+            }
+        }
+
+        extendLiveSet(allocation, live, words, 2 * blocks[b].first);
+    }
+    free(live);
+}
+
+// True when target is written (or, with checkUses, read) by an instruction in
+// [from, to], or when control can enter or leave the range part way through
+static int touchedBetween(RegisterAllocation *allocation, IRInstruction **code, int from, int to,
+                          LiveInterval *target, int checkUses)
+{
+    for (int k = from; k <= to; k++)
+    {
+        if (strcmp(code[k]->op, "LABEL") == 0 || isBlockTerminator(code[k]))
+            return 1;
+        char *def = getInstructionDefinition(code[k]);
+        if (def && findInterval(allocation, def) == target)
+            return 1;
+        if (checkUses)
+        {
+            char *uses[2];
+            int useCount = getInstructionUses(code[k], uses);
+            for (int u = 0; u < useCount; u++)
+            {
+                if (findInterval(allocation, uses[u]) == target)
+                    return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void markFloat(RegisterAllocation *allocation, char *name)
+{
+    allocation->intervals[internName(allocation, name)].registerClass = REGISTER_CLASS_FLOAT;
+}
+
+static void markVector(RegisterAllocation *allocation, char *name)
+{
+    allocation->intervals[internName(allocation, name)].registerClass = REGISTER_CLASS_VECTOR;
+}
+
+// A value is a float when a float instruction writes or reads it. Copies spread
+// the class both ways so a move never crosses register files; a value that is
+// only ever copied, loaded or passed along stays an int and moves its bits.
+// Vectors are only ever written and read by vector instructions, never copied.
+static void classifyValues(RegisterAllocation *allocation, IRInstruction **code, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (writesVector(code[i]))
+            markVector(allocation, code[i]->result);
+        else if (writesFloat(code[i]))
+            markFloat(allocation, code[i]->result);
+        if (isVectorOperator(code[i]->op))
+        {
+            markVector(allocation, code[i]->arg1);
+            markVector(allocation, code[i]->arg2);
+        }
+        else if (strcmp(code[i]->op, "VSTORE") == 0)
+            markVector(allocation, code[i]->arg1);
+        else if (readsFloat(code[i]))
+        {
+            char *uses[2];
+            int useCount = getInstructionUses(code[i], uses);
+            for (int u = 0; u < useCount; u++)
+                markFloat(allocation, uses[u]);
+        }
+    }
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (int i = 0; i < count; i++)
+        {
+            char *uses[2];
+            if ((strcmp(code[i]->op, "=") != 0 && strcmp(code[i]->op, "LOAD") != 0) || getInstructionUses(code[i], uses) != 1)
+                continue;
+            LiveInterval *source = &allocation->intervals[internName(allocation, uses[0])];
+            LiveInterval *dest = &allocation->intervals[internName(allocation, code[i]->result)];
+            if (source->registerClass != dest->registerClass)
+            {
+                source->registerClass = dest->registerClass = REGISTER_CLASS_FLOAT;
+                changed = 1;
+            }
+        }
+    }
+}
+
+static void mergeIntervals(RegisterAllocation *allocation, LiveInterval *into, LiveInterval *from)
+{
+    if (from->start < into->start)
+        into->start = from->start;
+    if (from->end > into->end)
+        into->end = from->end;
+    into->useCount += from->useCount;
+    from->coalesced = into;
+    allocation->coalescedMoves++;
+}
+
+// Gives the source and destination of a copy one register when they never hold
+// different values at the same time, so the copy disappears from the output
+static void coalesceMoves(RegisterAllocation *allocation, IRInstruction **code, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(code[i]->op, "=") != 0 && strcmp(code[i]->op, "LOAD") != 0)
+            continue;
+
+        LiveInterval *source = findInterval(allocation, code[i]->arg1);
+        LiveInterval *dest = findInterval(allocation, code[i]->result);
+        if (!source || !dest || source == dest || source->registerClass != dest->registerClass)
+            continue;
+
+        if (source->end == 2 * i && dest->start == 2 * i + 1)
+        {
+            // The ranges only touch at the copy
+            mergeIntervals(allocation, source, dest);
+        }
+        else if (dest->definitionCount == 1 && dest->start == 2 * i + 1 &&
+                 !touchedBetween(allocation, code, i + 1, dest->end / 2 - 1, source, 0))
+        {
+            // A read of a variable: the copy may share its register while the variable is unchanged
+            mergeIntervals(allocation, source, dest);
+        }
+        else if (source->definitionCount == 1 && source->end == 2 * i &&
+                 !touchedBetween(allocation, code, source->start / 2 + 1, i - 1, dest, 1))
+        {
+            // A temporary stored to a variable whose old value is dead for the temporary's lifetime
+            mergeIntervals(allocation, dest, source);
+        }
+    }
+}
+
+static void markCallCrossings(RegisterAllocation *allocation, IRInstruction **code, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(code[i]->op, "CALL") != 0)
+            continue;
+        for (int v = 0; v < allocation->intervalCount; v++)
+        {
+            LiveInterval *interval = &allocation->intervals[v];
+            if (!interval->coalesced && interval->start <= 2 * i && interval->end > 2 * i + 1)
+                interval->crossesCall = 1;
+        }
+    }
+}
+
+// Leaf units keep register parameters where they arrive, so their PARAM moves vanish
+static void findCallsAndParameters(RegisterAllocation *allocation, IRInstruction **code, int count)
+{
+    allocation->isLeaf = 1;
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(code[i]->op, "CALL") == 0)
+        {
+            allocation->isLeaf = 0;
+            if (atoi(code[i]->arg2) > allocation->maxCallArguments)
+                allocation->maxCallArguments = atoi(code[i]->arg2);
+        }
+    }
+    for (int i = 0; i < count && allocation->isLeaf; i++)
+    {
+        if (strcmp(code[i]->op, "PARAM") == 0 && atoi(code[i]->arg1) < 4)
+            findInterval(allocation, code[i]->result)->preferredReg = argumentRegisters[atoi(code[i]->arg1)];
+    }
+}
+
+static int compareByStart(const void *a, const void *b)
+{
+    const LiveInterval *left = *(LiveInterval *const *)a;
+    const LiveInterval *right = *(LiveInterval *const *)b;
+    if (left->start != right->start)
+        return left->start - right->start;
+    return left->end - right->end;
+}
+
+static int allocatableIndex(const char *reg)
+{
+    for (int r = 0; r < ALLOCATABLE_COUNT; r++)
+    {
+        if (strcmp(allocatableRegisters[r].name, reg) == 0)
+            return r;
+    }
+    return -1;
+}
+
+// True when current may live in register r of a unit that is or is not a leaf
+static int canAssign(RegisterAllocation *allocation, LiveInterval *current, int r)
+{
+    const AllocatableRegister *candidate = &allocatableRegisters[r];
+    if (candidate->registerClass != current->registerClass || (candidate->leafOnly && !allocation->isLeaf))
+        return 0;
+    return !current->crossesCall || candidate->calleeSaved;
+}
+
+static void assignRegister(RegisterAllocation *allocation, LiveInterval *current, int r, int *isFree)
+{
+    isFree[r] = 0;
+    current->reg = allocatableRegisters[r].name;
+    if (allocatableRegisters[r].calleeSaved && current->registerClass == REGISTER_CLASS_FLOAT)
+        allocation->floatCalleeSavedUsed |= 1u << ((atoi(current->reg + 2) - 20) / 2);
+    else if (allocatableRegisters[r].calleeSaved)
+        allocation->calleeSavedUsed |= 1u << (current->reg[2] - '0');
+}
+
+static void spillInterval(RegisterAllocation *allocation, LiveInterval *interval)
+{
+    interval->reg = NULL;
+    interval->spillSlot = allocation->spillSlotCount++;
+    allocation->spillCount++;
+}
+
+// Linear scan (Poletto & Sarkar) over every register class. Values that live
+// across a call may only take callee-saved registers; others prefer $t registers
+// so that $s registers, which cost a save and restore, are left for them. Leaf
+// units may also use the argument registers and $v1. Floats and vectors are
+// scanned in the same pass but only ever take, or evict, their own registers.
+static void linearScan(RegisterAllocation *allocation)
+{
+    LiveInterval **sorted = malloc(sizeof(LiveInterval *) * (allocation->intervalCount + 1));
+    LiveInterval **active = malloc(sizeof(LiveInterval *) * (allocation->intervalCount + 1));
+    if (!sorted || !active)
+    {
+        perror("Failed to allocate linear scan state");
+        exit(EXIT_FAILURE);
+    }
+
+    int sortedCount = 0;
+    for (int v = 0; v < allocation->intervalCount; v++)
+    {
+        if (!allocation->intervals[v].coalesced && allocation->intervals[v].start >= 0)
+            sorted[sortedCount++] = &allocation->intervals[v];
+    }
+    qsort(sorted, sortedCount, sizeof(LiveInterval *), compareByStart);
+
+    int isFree[ALLOCATABLE_COUNT];
+    for (int r = 0; r < ALLOCATABLE_COUNT; r++)
+        isFree[r] = 1;
+
+    int activeCount = 0;
+    for (int i = 0; i < sortedCount; i++)
+    {
+        LiveInterval *current = sorted[i];
+
+        // Expire intervals that ended before this one starts; active is sorted by end
+        int kept = 0;
+        for (int a = 0; a < activeCount; a++)
+        {
+            if (active[a]->end < current->start)
+            {
+                isFree[allocatableIndex(active[a]->reg)] = 1;
+            }
+            else
+            {
+                active[kept++] = active[a];
+            }
+        }
+        activeCount = kept;
+
+        if (current->preferredReg)
+        {
+            int preferred = allocatableIndex(current->preferredReg);
+            if (preferred >= 0 && isFree[preferred] && canAssign(allocation, current, preferred))
+                assignRegister(allocation, current, preferred, isFree);
+        }
+        for (int r = 0; r < ALLOCATABLE_COUNT && !current->reg; r++)
+        {
+            if (isFree[r] && canAssign(allocation, current, r))
+                assignRegister(allocation, current, r, isFree);
+        }
+
+        if (!current->reg)
+        {
+            // Spill whichever usable interval ends last; it frees a register for the longest time
+            LiveInterval *victim = NULL;
+            int victimIndex = -1;
+            for (int a = activeCount - 1; a >= 0; a--)
+            {
+                if (canAssign(allocation, current, allocatableIndex(active[a]->reg)))
+                {
+                    victim = active[a];
+                    victimIndex = a;
+                    break;
+                }
+            }
+            if (victim && victim->end > current->end)
+            {
+                current->reg = victim->reg;
+                spillInterval(allocation, victim);
+                for (int a = victimIndex; a < activeCount - 1; a++)
+                    active[a] = active[a + 1];
+                activeCount--;
+            }
+            else
+            {
+                spillInterval(allocation, current);
+                continue;
+            }
+        }
+
+        int position = activeCount;
+        while (position > 0 && active[position - 1]->end > current->end)
+        {
+            active[position] = active[position - 1];
+            position--;
+        }
+        active[position] = current;
+        activeCount++;
+    }
+
+    free(sorted);
+    free(active);
+}
+
+// Computes live intervals over the IR in [first, end) and assigns every variable
+// and temporary either a register or a stack slot
+RegisterAllocation *allocateRegisters(IRInstruction *first, IRInstruction *end)
+{
+    int count = 0;
+    for (IRInstruction *ir = first; ir != end; ir = ir->next)
+        count++;
+
+    IRInstruction **code = malloc(sizeof(IRInstruction *) * (count + 1));
+    RegisterAllocation *allocation = calloc(1, sizeof(RegisterAllocation));
+    if (!code || !allocation)
+    {
+        perror("Failed to allocate register allocation state");
+        exit(EXIT_FAILURE);
+    }
+    count = 0;
+    for (IRInstruction *ir = first; ir != end; ir = ir->next)
+        code[count++] = ir;
+
+    // Every instruction names at most three values, which bounds the interval count
+    int maxNames = 3 * count + 1;
+    allocation->intervals = malloc(sizeof(LiveInterval) * maxNames);
+    allocation->nameTableSize = 16;
+    while (allocation->nameTableSize < 2 * maxNames)
+        allocation->nameTableSize <<= 1;
+    allocation->nameTable = malloc(sizeof(int) * allocation->nameTableSize);
+    if (!allocation->intervals || !allocation->nameTable)
+    {
+        perror("Failed to allocate live intervals");
+        exit(EXIT_FAILURE);
+    }
+    memset(allocation->nameTable, -1, sizeof(int) * allocation->nameTableSize);
+
+    // Intern every name first so the liveness sets can be sized once
+    for (int i = 0; i < count; i++)
+    {
+        char *uses[2];
+        int useCount = getInstructionUses(code[i], uses);
+        for (int u = 0; u < useCount; u++)
+            internName(allocation, uses[u]);
+        char *def = getInstructionDefinition(code[i]);
+        if (def)
+            internName(allocation, def);
+    }
+
+    int blockCount = 0;
+    BasicBlock *blocks = buildBlocks(code, count, &blockCount);
+    computeLiveness(allocation, code, blocks, blockCount);
+    buildIntervals(allocation, code, blocks, blockCount);
+    classifyValues(allocation, code, count);
+    coalesceMoves(allocation, code, count);
+    markCallCrossings(allocation, code, count);
+    findCallsAndParameters(allocation, code, count);
+    linearScan(allocation);
+
+    compilerStats.values += allocation->intervalCount;
+    compilerStats.spills += allocation->spillCount;
+    for (int v = 0; v < allocation->intervalCount; v++)
+        compilerStats.valuesInRegisters += !allocation->intervals[v].coalesced && allocation->intervals[v].reg;
+
+    for (int b = 0; b < blockCount; b++)
+    {
+        free(blocks[b].liveIn);
+        free(blocks[b].liveOut);
+        free(blocks[b].uses);
+        free(blocks[b].defs);
+    }
+    free(blocks);
+    free(code);
+    return allocation;
+}
+
+void printRegisterAllocation(RegisterAllocation *allocation)
+{
+    FILE *out = diagnostics();
+    int inRegisters = 0;
+    for (int v = 0; v < allocation->intervalCount; v++)
+    {
+        LiveInterval *interval = &allocation->intervals[v];
+        if (interval->coalesced)
+            continue;
+        if (interval->reg)
+        {
+            fprintf(out, "REGALLOC: %s [%d, %d] -> %s\n", interval->name, interval->start, interval->end, interval->reg);
+            inRegisters++;
+        }
+        else
+        {
+            fprintf(out, "REGALLOC: %s [%d, %d] -> spill slot %d\n", interval->name, interval->start, interval->end, interval->spillSlot);
+        }
+    }
+    fprintf(out, "REGALLOC: %d values, %d in registers, %d spilled, %d moves coalesced\n",
+            allocation->intervalCount, inRegisters, allocation->spillCount, allocation->coalescedMoves);
+}
+
+void freeRegisterAllocation(RegisterAllocation *allocation)
+{
+    if (!allocation)
+        return;
+    free(allocation->intervals);
+    free(allocation->nameTable);
+    free(allocation);
+}
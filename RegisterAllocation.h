@@ -0,0 +1,59 @@
+#ifndef REGISTER_ALLOCATION_H
+#define REGISTER_ALLOCATION_H
+
+#include "IRGeneration.h"
+
+// Registers reserved for reloading spilled values; never handed out by the allocator
+#define SCRATCH_REGISTER_COUNT 2
+
+// Ints live in the general registers, floats in the coprocessor 1 registers and
+// vectors of four in the MSA registers
+typedef enum
+{
+    REGISTER_CLASS_INT,
+    REGISTER_CLASS_FLOAT,
+    REGISTER_CLASS_VECTOR,
+    REGISTER_CLASS_COUNT
+} RegisterClass;
+
+// The live range of one variable or temporary, numbered over the IR of a unit.
+// Each instruction i owns two positions: 2i where it reads, 2i+1 where it writes.
+typedef struct LiveInterval
+{
+    char *name;
+    int start;
+    int end;
+    int useCount;
+    int definitionCount;
+    int crossesCall;                // Live across a CALL, so it needs a callee-saved register
+    RegisterClass registerClass;
+    const char *reg;                // Assigned register, NULL when spilled
+    const char *preferredReg;       // Taken when free, e.g. the argument register a parameter arrives in
+    int spillSlot;                  // Stack slot index, -1 when held in a register
+    struct LiveInterval *coalesced; // Interval this one was merged into by move coalescing
+} LiveInterval;
+
+typedef struct RegisterAllocation
+{
+    LiveInterval *intervals;
+    int intervalCount;
+    int *nameTable; // Open-addressed hash from name to interval index
+    int nameTableSize;
+    int spillSlotCount;
+    int spillCount;
+    int coalescedMoves;
+    unsigned int calleeSavedUsed; // Bit i set when $s<i> is assigned
+    unsigned int floatCalleeSavedUsed; // Bit i set when $f<20 + 2i> is assigned
+    int isLeaf;                   // No calls, so argument registers are free for values
+    int maxCallArguments;         // Most arguments passed by any call in the unit
+} RegisterAllocation;
+
+RegisterAllocation *allocateRegisters(IRInstruction *first, IRInstruction *end);
+LiveInterval *findInterval(RegisterAllocation *allocation, const char *name);
+void printRegisterAllocation(RegisterAllocation *allocation);
+void freeRegisterAllocation(RegisterAllocation *allocation);
+
+extern const char *scratchRegisters[REGISTER_CLASS_COUNT][SCRATCH_REGISTER_COUNT];
+extern const char *argumentRegisters[4];
+
+#endif // REGISTER_ALLOCATION_H
@@ -0,0 +1,93 @@
+#include "ThreadPool.h"
+#include "CompilerStats.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct TaskQueue
+{
+    int count;
+    int next;     // Next index to hand out
+    int finished; // Indices below it have been finished
+    char *done;   // Per index, set once its task has run
+    void (*task)(int index, void *context);
+    void (*finish)(int index, void *context);
+    void *context;
+    pthread_mutex_t lock;
+    CompilerStats stats; // Counters of the threads that have exited
+} TaskQueue;
+
+static void runQueue(TaskQueue *queue)
+{
+    while (1)
+    {
+        pthread_mutex_lock(&queue->lock);
+        if (queue->next == queue->count)
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return;
+        }
+        int index = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+
+        queue->task(index, queue->context);
+
+        // Finishing under the lock keeps it in order and one at a time; it is
+        // meant to be short next to a task
+        pthread_mutex_lock(&queue->lock);
+        queue->done[index] = 1;
+        while (queue->finished < queue->count && queue->done[queue->finished])
+        {
+            if (queue->finish)
+                queue->finish(queue->finished, queue->context);
+            queue->finished++;
+        }
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+static void *runWorker(void *argument)
+{
+    TaskQueue *queue = argument;
+    runQueue(queue);
+    pthread_mutex_lock(&queue->lock);
+    addCompilerStats(&queue->stats, &compilerStats);
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+void runTasks(int jobs, int count, void (*task)(int index, void *context), void (*finish)(int index, void *context),
+              void *context)
+{
+    TaskQueue queue = {.count = count, .done = calloc(count + 1, 1), .task = task, .finish = finish, .context = context};
+    pthread_mutex_init(&queue.lock, NULL);
+    if (!queue.done)
+    {
+        perror("Failed to allocate task queue");
+        exit(EXIT_FAILURE);
+    }
+    int workerCount = jobs - 1 < count - 1 ? jobs - 1 : count - 1;
+    pthread_t *workers = malloc(sizeof(pthread_t) * (workerCount > 0 ? workerCount : 1));
+    if (!workers)
+    {
+        perror("Failed to allocate worker threads");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < workerCount; i++)
+    {
+        int error = pthread_create(&workers[i], NULL, runWorker, &queue);
+        if (error)
+        {
+            fprintf(stderr, "Failed to start worker thread: error %d\n", error);
+            exit(EXIT_FAILURE);
+        }
+    }
+    runQueue(&queue);
+    for (int i = 0; i < workerCount; i++)
+        pthread_join(workers[i], NULL);
+
+    addCompilerStats(&compilerStats, &queue.stats);
+    pthread_mutex_destroy(&queue.lock);
+    free(workers);
+    free(queue.done);
+}
@@ -0,0 +1,14 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Runs task(index, context) for every index in [0, count) on jobs threads, the
+// calling thread among them. Indices are handed out in increasing order as
+// threads come free. finish(index, context), if not NULL, runs once the task
+// of index and of every lower index are done: in index order, on whichever
+// thread completed the last of them, never two at once. Each thread keeps its
+// own compilerStats; the other threads' counters are added to the caller's
+// before runTasks returns.
+void runTasks(int jobs, int count, void (*task)(int index, void *context), void (*finish)(int index, void *context),
+              void *context);
+
+#endif // THREAD_POOL_H
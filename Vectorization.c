@@ -0,0 +1,141 @@
+#include "Vectorization.h"
+#include <string.h>
+
+typedef struct ExpressionScan
+{
+    int vectors;    // Values the statement computes per iteration, loads included
+    int invariants; // Splats of literals and variables
+} ExpressionScan;
+
+static int isVariable(ASTNode *node, const char *name)
+{
+    return node->type == AST_VARIABLE && strcmp(node->value.strValue, name) == 0;
+}
+
+// The offset c of an index i, i + c, c + i or i - c
+static int indexOffset(ASTNode *index, const char *induction, int *offset)
+{
+    if (isVariable(index, induction))
+    {
+        *offset = 0;
+        return 1;
+    }
+    if (index->type != AST_BINARY_EXPR || (index->value.opType != OP_PLUS && index->value.opType != OP_MINUS))
+        return 0;
+    ASTNode *left = index->children[0];
+    ASTNode *right = index->children[1];
+    if (index->value.opType == OP_PLUS && isVariable(right, induction) && left->type == AST_LITERAL)
+        right = left;
+    else if (!isVariable(left, induction) || right->type != AST_LITERAL)
+        return 0;
+    int value = right->value.intValue;
+    if (value < -MAX_VECTOR_OFFSET || value > MAX_VECTOR_OFFSET)
+        return 0;
+    *offset = index->value.opType == OP_MINUS ? -value : value;
+    return 1;
+}
+
+// Records an access to array[i + offset]; stored marks the arrays the loop writes
+static int addAccess(VectorLoop *vector, ASTNode *access, int stored, char *storedArrays)
+{
+    const char *array = access->children[0]->value.strValue;
+    int offset;
+    if (!indexOffset(access->children[1], vector->counted.induction->value.strValue, &offset))
+        return 0;
+    int a = 0;
+    while (a < vector->accessCount &&
+           (strcmp(vector->accesses[a].array, array) != 0 || vector->accesses[a].offset != offset))
+        a++;
+    if (a == vector->accessCount)
+    {
+        if (a == MAX_VECTOR_ACCESSES)
+            return 0;
+        vector->accesses[a].array = array;
+        vector->accesses[a].offset = offset;
+        vector->accessCount++;
+    }
+    storedArrays[a] |= stored;
+    return 1;
+}
+
+static int scanExpression(ASTNode *node, VectorLoop *vector, char *storedArrays, ExpressionScan *scan)
+{
+    switch (node->type)
+    {
+    case AST_ARRAY_ACCESS:
+        scan->vectors++;
+        return addAccess(vector, node, 0, storedArrays);
+    case AST_LITERAL:
+    case AST_FLOAT_LITERAL:
+        scan->invariants++;
+        return 1;
+    case AST_VARIABLE:
+        scan->invariants++;
+        return !isVariable(node, vector->counted.induction->value.strValue);
+    case AST_BINARY_EXPR:
+        if (node->value.opType != OP_PLUS && node->value.opType != OP_MINUS && node->value.opType != OP_MULTIPLY &&
+            node->value.opType != OP_DIVIDE)
+            return 0;
+        scan->vectors++;
+        return scanExpression(node->children[0], vector, storedArrays, scan) &&
+               scanExpression(node->children[1], vector, storedArrays, scan);
+    default:
+        return 0;
+    }
+}
+
+int findVectorLoop(ASTNode *loop, VectorLoop *vector)
+{
+    CountedLoop *counted = &vector->counted;
+    if (!findCountedLoop(loop, counted) || counted->step != 1 || counted->hasCalls ||
+        (counted->relation != OP_LESS && counted->relation != OP_LESS_EQUAL))
+        return 0;
+
+    ASTNode *body = loop->children[1];
+    if (body->childCount < 2)
+        return 0;
+    char storedArrays[MAX_VECTOR_ACCESSES] = {0};
+    int invariants = 0;
+    int widest = 0;
+    vector->accessCount = 0;
+    for (int s = 0; s < body->childCount - 1; s++)
+    {
+        ASTNode *statement = body->children[s];
+        if (statement->type != AST_ASSIGNMENT || statement->children[0]->type != AST_ARRAY_ACCESS ||
+            !addAccess(vector, statement->children[0], 1, storedArrays))
+            return 0;
+        ExpressionScan scan = {0};
+        if (!scanExpression(statement->children[1], vector, storedArrays, &scan))
+            return 0;
+        invariants += scan.invariants;
+        if (scan.vectors > widest)
+            widest = scan.vectors;
+    }
+    if (invariants + widest > VECTOR_REGISTER_BUDGET)
+        return 0;
+
+    // A stored array read or written at another offset would carry values between iterations
+    for (int a = 0; a < vector->accessCount; a++)
+    {
+        for (int b = 0; b < vector->accessCount; b++)
+        {
+            if (storedArrays[a] && a != b && strcmp(vector->accesses[a].array, vector->accesses[b].array) == 0)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+int findVectorAccess(VectorLoop *vector, ASTNode *access)
+{
+    int offset;
+    if (!indexOffset(access->children[1], vector->counted.induction->value.strValue, &offset))
+        return -1;
+    for (int a = 0; a < vector->accessCount; a++)
+    {
+        if (strcmp(vector->accesses[a].array, access->children[0]->value.strValue) == 0 &&
+            vector->accesses[a].offset == offset)
+            return a;
+    }
+    return -1;
+}
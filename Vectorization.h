@@ -0,0 +1,44 @@
+#ifndef VECTORIZATION_H
+#define VECTORIZATION_H
+
+#include "LoopUnrolling.h"
+
+// Recognizes counted loops IR generation can run four elements at a time with
+// MIPS MSA instructions (--msa):
+//     while (i < bound) { a[i + c] = expr; ...; i = i + 1; }
+// where the relation is < or <=, every statement before the step stores to an
+// array element at a literal offset c from i, and expr adds, subtracts,
+// multiplies and divides array elements at literal offsets from i, literals
+// and variables other than i. The body assigns no variable but i, so
+// the variables are loop invariant. An array the loop stores to is accessed at
+// that one offset only, so element k of each statement reads nothing but
+// element k of the arrays, and no iteration reads what another one wrote:
+// running each statement over four elements before the next computes what
+// running the statements one element at a time does.
+
+#define VECTOR_LANES 4             // 32-bit elements in a 128-bit MSA register
+#define VECTOR_REGISTER_BUDGET 8   // $w registers the allocator hands out; vectors never spill
+#define MAX_VECTOR_ACCESSES 16
+#define MAX_VECTOR_OFFSET 1024
+
+typedef struct VectorAccess
+{
+    const char *array;
+    int offset; // Element offset from i
+} VectorAccess;
+
+typedef struct VectorLoop
+{
+    CountedLoop counted;
+    VectorAccess accesses[MAX_VECTOR_ACCESSES]; // Each array and offset once
+    int accessCount;
+} VectorLoop;
+
+// Fills vector and returns 1 when loop has the shape above and every statement
+// fits in the vector registers alongside the loop's invariants
+int findVectorLoop(ASTNode *loop, VectorLoop *vector);
+
+// Index in vector->accesses of an array access in the loop findVectorLoop accepted
+int findVectorAccess(VectorLoop *vector, ASTNode *access);
+
+#endif // VECTORIZATION_H
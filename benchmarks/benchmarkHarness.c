@@ -0,0 +1,90 @@
+#include "benchmarkHarness.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+long long parseSize(const char *text)
+{
+    char *end;
+    long long size = strtoll(text, &end, 10);
+    if (*end == 'K' || *end == 'k')
+        size <<= 10;
+    else if (*end == 'M' || *end == 'm')
+        size <<= 20;
+    return size;
+}
+
+long long generateProgram(const char *generator, long long size, const char *path, int *functions)
+{
+    char sizeText[32];
+    char reportPath[4096];
+    snprintf(sizeText, sizeof(sizeText), "%lld", size);
+    snprintf(reportPath, sizeof(reportPath), "%s.report", path);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (!freopen(path, "w", stdout) || !freopen(reportPath, "w", stderr))
+            _exit(127);
+        execl(generator, generator, sizeText, (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "Failed to run %s\n", generator);
+        exit(EXIT_FAILURE);
+    }
+    // "generateProgram: <bytes> bytes, <functions> functions, ..."
+    char report[512] = "";
+    FILE *file = fopen(reportPath, "r");
+    if (!file || !fgets(report, sizeof(report), file))
+    {
+        fprintf(stderr, "No report from %s\n", generator);
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+    unlink(reportPath);
+    long long bytes = 0;
+    int count = 0;
+    const char *counts = strchr(report, ' ');
+    if (!counts || sscanf(counts, " %lld bytes, %d functions", &bytes, &count) != 2)
+    {
+        fprintf(stderr, "Unexpected report from %s: %s", generator, report);
+        exit(EXIT_FAILURE);
+    }
+    if (functions)
+        *functions = count;
+    return bytes;
+}
+
+unsigned long long hashFile(const char *path)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return 0;
+    int c;
+    while ((c = getc(file)) != EOF)
+        hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+    fclose(file);
+    return hash;
+}
+
+double phaseSeconds(const char *record, const char *phase)
+{
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\": {\"seconds\": ", phase);
+    const char *found = strstr(record, key);
+    return found ? atof(found + strlen(key)) : -1;
+}
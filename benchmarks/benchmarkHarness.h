@@ -0,0 +1,18 @@
+#ifndef BENCHMARKHARNESS_H
+#define BENCHMARKHARNESS_H
+
+// Helpers shared by the benchmark drivers; the Makefile links benchmarkHarness.c into each
+
+// Monotonic wall-clock seconds
+double now();
+// A size like 100, 10K or 10M in bytes
+long long parseSize(const char *text);
+// Runs generateProgram for size bytes into path; returns the bytes it wrote and,
+// when functions is set, the number of functions it reports. Exits on failure.
+long long generateProgram(const char *generator, long long size, const char *path, int *functions);
+// FNV-1a of a file's bytes, 0 when it cannot be read
+unsigned long long hashFile(const char *path);
+// Seconds a --stats --time-phases record charges to a phase, or -1 when it has none
+double phaseSeconds(const char *record, const char *phase);
+
+#endif
@@ -0,0 +1,185 @@
+// What --cache saves on a generated program with at least the requested number
+// of functions. The program is compiled without the cache, then into an empty
+// cache, again unchanged, and once more after one function in the middle was
+// edited. One JSON record per compile gives its wall time, the cache's hits and
+// misses, the speedup over compiling the same source without the cache and
+// whether the output is byte for byte the same as that compile's.
+// Usage: cacheBenchmark <compiler> <generator> <functions>
+#include "benchmarkHarness.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TIMEOUT_SECONDS 600
+#define BYTES_PER_FUNCTION 6000 // What generateProgram writes per function, roughly
+
+static const char *cacheDirectory = "cacheBenchmark.cache";
+
+// Copies the program with function's first local initialized differently
+static void editFunction(const char *path, const char *editedPath, int function)
+{
+    FILE *in = fopen(path, "r");
+    FILE *out = fopen(editedPath, "w");
+    if (!in || !out)
+    {
+        perror("Failed to copy program");
+        exit(EXIT_FAILURE);
+    }
+    char header[32];
+    snprintf(header, sizeof(header), "int f%d(", function);
+    char line[65536];
+    int inFunction = 0, edited = 0;
+    while (fgets(line, sizeof(line), in))
+    {
+        if (strncmp(line, header, strlen(header)) == 0)
+            inFunction = 1;
+        else if (inFunction && !edited && strcmp(line, "    int v0 = p0 + 0;\n") == 0)
+        {
+            strcpy(line, "    int v0 = p0 + 1;\n");
+            edited = 1;
+        }
+        fputs(line, out);
+    }
+    fclose(in);
+    fclose(out);
+    if (!edited)
+    {
+        fprintf(stderr, "Found no f%d to edit in %s\n", function, path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void clearCache()
+{
+    DIR *directory = opendir(cacheDirectory);
+    if (!directory)
+        return;
+    char path[4096];
+    for (struct dirent *file = readdir(directory); file; file = readdir(directory))
+    {
+        if (strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", cacheDirectory, file->d_name);
+        unlink(path);
+    }
+    closedir(directory);
+    rmdir(cacheDirectory);
+}
+
+static long long countOf(const char *record, const char *name)
+{
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\": ", name);
+    const char *found = strstr(record, key);
+    return found ? atoll(found + strlen(key)) : -1;
+}
+
+// One compile, through the cache when cached is set: wall seconds, or -1 when
+// it failed. Hits, misses and a hash of the output go to the rest.
+static double compile(const char *compiler, const char *path, int cached, long long *hits, long long *misses,
+                      unsigned long long *output)
+{
+    const char *outputPath = "cacheBenchmark.asm";
+    const char *statsPath = "cacheBenchmark.stats";
+    char cacheOption[256];
+    char statsOption[256];
+    snprintf(cacheOption, sizeof(cacheOption), "--cache=%s", cacheDirectory);
+    snprintf(statsOption, sizeof(statsOption), "--stats=%s", statsPath);
+    unlink(statsPath); // The compiler appends
+    double start = now();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (!freopen("/dev/null", "w", stdout) || !freopen("/dev/null", "w", stderr))
+            _exit(127);
+        alarm(TIMEOUT_SECONDS);
+        if (cached)
+            execl(compiler, compiler, cacheOption, statsOption, "-o", outputPath, path, (char *)NULL);
+        else
+            execl(compiler, compiler, statsOption, "-o", outputPath, path, (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    double wall = now() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+
+    char record[8192] = "";
+    FILE *stats = fopen(statsPath, "r");
+    if (!stats || !fgets(record, sizeof(record), stats))
+        return -1;
+    fclose(stats);
+    *hits = countOf(record, "cacheHits");
+    *misses = countOf(record, "cacheMisses");
+    *output = hashFile(outputPath);
+    unlink(outputPath);
+    unlink(statsPath);
+    return wall;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        fprintf(stderr, "Usage: %s <compiler> <generator> <functions>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int wanted = atoi(argv[3]);
+    const char *path = "cacheBenchmark.cmm";
+    const char *editedPath = "cacheBenchmark.edited.cmm";
+    long long size = (long long)wanted * BYTES_PER_FUNCTION;
+    int functions = 0;
+    long long bytes = generateProgram(argv[2], size, path, &functions);
+    while (functions < wanted)
+    {
+        size = size * wanted / (functions > 0 ? functions : 1) + BYTES_PER_FUNCTION;
+        bytes = generateProgram(argv[2], size, path, &functions);
+    }
+    editFunction(path, editedPath, functions / 2);
+
+    // Each compile, and the one without the cache its time and output are compared with
+    static const struct
+    {
+        const char *name;
+        int edited;
+        int cached;
+    } runs[] = {{"uncached", 0, 0}, {"cold", 0, 1}, {"warm", 0, 1}, {"editedUncached", 1, 0}, {"edited", 1, 1}};
+    double baseline[2] = {0, 0};
+    unsigned long long baselineOutput[2] = {0, 0};
+    int status = EXIT_SUCCESS;
+    clearCache();
+    for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+    {
+        long long hits = 0, misses = 0;
+        unsigned long long output = 0;
+        int edited = runs[r].edited;
+        double wall = compile(argv[1], edited ? editedPath : path, runs[r].cached, &hits, &misses, &output);
+        if (wall < 0)
+        {
+            printf("{\"run\": \"%s\", \"status\": \"failed\"}\n", runs[r].name);
+            status = EXIT_FAILURE;
+            continue;
+        }
+        if (!runs[r].cached)
+        {
+            baseline[edited] = wall;
+            baselineOutput[edited] = output;
+        }
+        int same = output == baselineOutput[edited];
+        printf("{\"run\": \"%s\", \"functions\": %d, \"bytes\": %lld, \"seconds\": %.6f, \"hits\": %lld, "
+               "\"misses\": %lld, \"speedup\": %.3f, \"sameOutput\": %s}\n",
+               runs[r].name, functions, bytes, wall, runs[r].cached ? hits : 0, runs[r].cached ? misses : 0,
+               baseline[edited] / wall, same ? "true" : "false");
+        fflush(stdout);
+        if (!same)
+            status = EXIT_FAILURE;
+    }
+    clearCache();
+    unlink(path);
+    unlink(editedPath);
+    return status;
+}
@@ -0,0 +1,116 @@
+// Compiles generated programs of growing size and prints one JSON record per run:
+// wall time, peak RSS, throughput per phase and the compiler's own --stats
+// --time-phases record. scalingExponent compares each run with the previous size;
+// near 1 is linear, and anything well above it points at a quadratic walk somewhere.
+// Usage: compileBenchmark <compiler> <generator> [size...]   sizes like 1K, 10M
+#include "benchmarkHarness.h"
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TIMEOUT_SECONDS 600
+
+static const char *phases[] = {"lex", "parse", "symbols", "ir", "boundsChecks", "select", "regalloc", "mips",
+                               "peephole", "schedule", "delaySlots", "write", "dump"};
+
+typedef struct
+{
+    const char *status;
+    double wall;
+    long peakRssKb;
+    char record[8192]; // The compiler's --stats --time-phases JSON, empty if it wrote none
+} Run;
+
+static void compile(const char *compiler, const char *path, const char *statsPath, Run *run)
+{
+    char statsOption[256];
+    snprintf(statsOption, sizeof(statsOption), "--stats=%s", statsPath);
+    unlink(statsPath); // The compiler appends
+    double start = now();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // Its stdout carries the full AST and IR dumps
+        if (!freopen("/dev/null", "w", stdout) || !freopen("/dev/null", "w", stderr))
+            _exit(127);
+        alarm(TIMEOUT_SECONDS); // Survives exec and kills a compile that runs away
+        execl(compiler, compiler, "--time-phases", statsOption, "-o", "/dev/null", path, (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    run->wall = now() - start;
+    run->peakRssKb = usage.ru_maxrss;
+    if (WIFSIGNALED(status))
+        run->status = WTERMSIG(status) == SIGALRM ? "timeout" : "crashed";
+    else
+        run->status = WEXITSTATUS(status) == 0 ? "ok" : "failed";
+
+    run->record[0] = '\0';
+    FILE *stats = fopen(statsPath, "r");
+    if (stats)
+    {
+        if (fgets(run->record, sizeof(run->record), stats))
+            run->record[strcspn(run->record, "\n")] = '\0';
+        fclose(stats);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *defaultSizes[] = {"1K", "10K", "100K", "1M", "10M", "100M"};
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <compiler> <generator> [size...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char **sizes = argc > 3 ? (const char **)argv + 3 : defaultSizes;
+    int sizeCount = argc > 3 ? argc - 3 : (int)(sizeof(defaultSizes) / sizeof(defaultSizes[0]));
+    const char *path = "compileBenchmark.cmm";
+    const char *statsPath = "compileBenchmark.stats";
+
+    long long previousBytes = 0;
+    double previousWall = 0;
+    for (int i = 0; i < sizeCount; i++)
+    {
+        long long bytes = generateProgram(argv[2], parseSize(sizes[i]), path, NULL);
+        Run run;
+        compile(argv[1], path, statsPath, &run);
+
+        printf("{\"bytes\": %lld, \"status\": \"%s\", \"wallSeconds\": %.6f, \"peakRssKb\": %ld, ", bytes,
+               run.status, run.wall, run.peakRssKb);
+        printf("\"bytesPerSecond\": {");
+        for (int p = 0; p < (int)(sizeof(phases) / sizeof(phases[0])); p++)
+        {
+            double seconds = phaseSeconds(run.record, phases[p]);
+            printf(p ? ", \"%s\": " : "\"%s\": ", phases[p]);
+            if (seconds > 0)
+                printf("%.0f", bytes / seconds);
+            else
+                printf("null");
+        }
+        printf("}, \"scalingExponent\": ");
+        if (previousBytes > 0 && previousWall > 0 && strcmp(run.status, "ok") == 0)
+            printf("%.3f", log(run.wall / previousWall) / log((double)bytes / previousBytes));
+        else
+            printf("null");
+        printf(", \"compiler\": %s}\n", run.record[0] ? run.record : "null");
+        fflush(stdout);
+        fprintf(stderr, "%s: %lld bytes, %s, %.3f s, %ld KB peak\n", sizes[i], bytes, run.status, run.wall,
+                run.peakRssKb);
+
+        previousBytes = bytes;
+        previousWall = run.wall;
+        if (strcmp(run.status, "ok") != 0)
+            break; // Larger inputs will only fail the same way, more slowly
+    }
+    unlink(path);
+    unlink(statsPath);
+    return EXIT_SUCCESS;
+}
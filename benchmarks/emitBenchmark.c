@@ -0,0 +1,136 @@
+// Measures assembly emission throughput for each sink against the old
+// fprintf-per-line writer. Usage: emitBenchmark [instructions] [repeats]
+#include "benchmarkHarness.h"
+#include "../AsmEmitter.h"
+#include "../MipsInstruction.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// A mix shaped like real output: arithmetic, immediates, spill traffic, labels and branches
+static MipsList *buildSyntheticList(int count)
+{
+    static char labels[64][16];
+    MipsList *list = createMipsList();
+    emitMipsDirective(list, ".text", NO_OPERAND);
+    emitMipsLabel(list, "main");
+    for (int i = 0; i < count; i++)
+    {
+        int a = 8 + i % 16, b = 8 + (i * 7) % 16, c = 8 + (i * 13) % 16;
+        switch (i % 8)
+        {
+        case 0:
+        case 1:
+            emitMips(list, "add", mipsRegister(a), mipsRegister(b), mipsRegister(c));
+            break;
+        case 2:
+            emitMips(list, "li", mipsRegister(a), mipsImmediate(i * 37 - 100000), NO_OPERAND);
+            break;
+        case 3:
+            emitMips(list, "lw", mipsRegister(a), mipsMemory(4 * (i % 256), MIPS_REG_SP), NO_OPERAND);
+            break;
+        case 4:
+            emitMips(list, "sw", mipsRegister(b), mipsMemory(4 * (i % 256), MIPS_REG_SP), NO_OPERAND);
+            break;
+        case 5:
+            emitMips(list, "move", mipsRegister(a), mipsRegister(c), NO_OPERAND);
+            break;
+        case 6:
+            snprintf(labels[i % 64], sizeof(labels[0]), "L%d", i % 64);
+            emitMipsLabel(list, labels[i % 64]);
+            break;
+        default:
+            emitMips(list, "bne", mipsRegister(a), mipsRegister(b), mipsLabelOperand(labels[(i / 8) % 64]));
+            break;
+        }
+    }
+    return list;
+}
+
+// The writer generateMIPS used before the emitter existed
+static void fprintfList(FILE *out, MipsList *list)
+{
+    for (MipsInstruction *instr = list->head; instr; instr = instr->next)
+    {
+        if (instr->kind == MIPS_LABEL)
+        {
+            fprintf(out, "%s:\n", instr->op);
+            continue;
+        }
+        fputs(instr->op, out);
+        for (int i = 0; i < instr->operandCount; i++)
+        {
+            MipsOperand operand = instr->operands[i];
+            fputs(i == 0 ? " " : ", ", out);
+            if (operand.kind == OPERAND_REGISTER)
+                fputs(mipsRegisterNames[operand.reg], out);
+            else if (operand.kind == OPERAND_IMMEDIATE)
+                fprintf(out, "%d", operand.value);
+            else if (operand.kind == OPERAND_LABEL)
+                fputs(operand.label, out);
+            else
+                fprintf(out, "%d(%s)", operand.value, mipsRegisterNames[operand.reg]);
+        }
+        fputc('\n', out);
+    }
+}
+
+static void report(const char *name, size_t bytes, double seconds, int repeats)
+{
+    printf("EMIT: %-18s %8.1f MB/s (%zu bytes x %d in %.3f s)\n",
+           name, bytes * (double)repeats / seconds / 1e6, bytes, repeats, seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int repeats = argc > 2 ? atoi(argv[2]) : 5;
+    const char *path = "emitBenchmark.asm";
+    MipsList *list = buildSyntheticList(count);
+
+    AsmEmitter *memory = createMemoryEmitter();
+    double start = now();
+    for (int r = 0; r < repeats; r++)
+    {
+        resetEmitter(memory);
+        writeMipsList(memory, list);
+    }
+    size_t bytes;
+    getEmitterContents(memory, &bytes);
+    report("memory", bytes, now() - start, repeats);
+    closeEmitter(memory);
+
+    start = now();
+    for (int r = 0; r < repeats; r++)
+    {
+        AsmEmitter *file = createFileEmitter(path);
+        writeMipsList(file, list);
+        closeEmitter(file);
+    }
+    report("file", bytes, now() - start, repeats);
+
+    int devNull = open("/dev/null", O_WRONLY);
+    start = now();
+    for (int r = 0; r < repeats; r++)
+    {
+        AsmEmitter *fd = createFdEmitter(devNull);
+        writeMipsList(fd, list);
+        closeEmitter(fd);
+    }
+    report("fd (/dev/null)", bytes, now() - start, repeats);
+    close(devNull);
+
+    start = now();
+    for (int r = 0; r < repeats; r++)
+    {
+        FILE *out = fopen(path, "w+");
+        fprintfList(out, list);
+        fclose(out);
+    }
+    report("fprintf (file)", bytes, now() - start, repeats);
+
+    unlink(path);
+    freeMipsList(list);
+    return 0;
+}
@@ -0,0 +1,217 @@
+// Writes a synthetic C-- program of roughly the requested size to stdout for the
+// compile-time benchmark: many globals and arrays, many functions calling earlier
+// ones, long expression chains, deeply nested if/while and large loop bodies.
+// Usage: generateProgram <bytes> [seed]
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_DEPTH 6
+#define LOCALS 8
+#define ARRAY_SIZE 32
+
+static long long written;
+static unsigned int state;
+static int globalCount, arrayCount, functionCount;
+static int paramCounts[1 << 20];
+
+static void emit(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    written += vprintf(format, args);
+    va_end(args);
+}
+
+// xorshift32, so a seed always produces the same program
+static int randomBelow(int limit)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (int)(state % (unsigned int)limit);
+}
+
+static void indent(int depth)
+{
+    emit("%*s", 4 * (depth + 1), "");
+}
+
+// A value in scope inside function f: parameter, local, loop counter, global or array element
+static void emitOperand(int f, int depth)
+{
+    switch (randomBelow(6))
+    {
+    case 0:
+        emit("p%d", randomBelow(paramCounts[f]));
+        break;
+    case 1:
+    case 2:
+        emit("v%d", randomBelow(LOCALS));
+        break;
+    case 3:
+        emit("k%d", randomBelow(depth + 1));
+        break;
+    case 4:
+        emit("g%d", randomBelow(globalCount));
+        break;
+    default:
+        emit("a%d[%d]", randomBelow(arrayCount), randomBelow(ARRAY_SIZE));
+        break;
+    }
+}
+
+static void emitExpression(int f, int depth, int terms)
+{
+    for (int i = 0; i < terms; i++)
+    {
+        if (i > 0)
+            emit(randomBelow(3) ? " + " : " - ");
+        int kind = randomBelow(10);
+        if (kind == 0 && f > 0)
+        {
+            // Only earlier functions, so the call graph stays acyclic
+            int callee = f - 1 - randomBelow(f < 8 ? f : 8);
+            emit("f%d(", callee);
+            for (int a = 0; a < paramCounts[callee]; a++)
+            {
+                emit(a ? ", " : "");
+                emitOperand(f, depth);
+            }
+            emit(")");
+        }
+        else if (kind <= 3)
+        {
+            emitOperand(f, depth);
+            emit(" * %d", 2 + randomBelow(30));
+        }
+        else if (kind == 4)
+        {
+            emit("(");
+            emitOperand(f, depth);
+            emit(" - ");
+            emitOperand(f, depth);
+            emit(") / %d", 2 + randomBelow(8));
+        }
+        else if (kind == 5)
+            emit("%d", randomBelow(1000));
+        else
+            emitOperand(f, depth);
+    }
+}
+
+static void emitAssignment(int f, int depth)
+{
+    indent(depth);
+    switch (randomBelow(8))
+    {
+    case 0:
+        emit("g%d = ", randomBelow(globalCount));
+        break;
+    case 1:
+        emit("a%d[%d] = ", randomBelow(arrayCount), randomBelow(ARRAY_SIZE));
+        break;
+    default:
+        emit("v%d = ", randomBelow(LOCALS));
+        break;
+    }
+    emitExpression(f, depth, 2 + randomBelow(randomBelow(4) ? 6 : 40));
+    emit(";\n");
+}
+
+static void emitBlock(int f, int depth, int statements);
+
+static void emitStatement(int f, int depth)
+{
+    int kind = depth < MAX_DEPTH ? randomBelow(8) : 0;
+    if (kind == 6)
+    {
+        indent(depth);
+        emit("if (");
+        emitOperand(f, depth);
+        emit(" < %d) {\n", randomBelow(500));
+        emitBlock(f, depth + 1, 1 + randomBelow(3));
+        indent(depth);
+        emit("} else {\n");
+        emitBlock(f, depth + 1, 1 + randomBelow(3));
+        indent(depth);
+        emit("}\n");
+    }
+    else if (kind == 7)
+    {
+        // Counter k(depth + 1) belongs to this loop alone, so every loop terminates
+        int counter = depth + 1;
+        indent(depth);
+        emit("k%d = 0;\n", counter);
+        indent(depth);
+        emit("while (k%d < %d) {\n", counter, 2 + randomBelow(6));
+        emitBlock(f, depth + 1, 1 + randomBelow(depth == 0 ? 16 : 3));
+        indent(depth + 1);
+        emit("k%d = k%d + 1;\n", counter, counter);
+        indent(depth);
+        emit("}\n");
+    }
+    else
+        emitAssignment(f, depth);
+}
+
+static void emitBlock(int f, int depth, int statements)
+{
+    for (int i = 0; i < statements; i++)
+        emitStatement(f, depth);
+}
+
+static void emitFunction(int f)
+{
+    paramCounts[f] = 1 + randomBelow(4);
+    emit("int f%d(", f);
+    for (int p = 0; p < paramCounts[f]; p++)
+        emit("%sint p%d", p ? ", " : "", p);
+    emit(") {\n");
+    for (int v = 0; v < LOCALS; v++)
+        emit("    int v%d = p%d + %d;\n", v, v % paramCounts[f], v);
+    for (int k = 0; k <= MAX_DEPTH; k++)
+        emit("    int k%d = 0;\n", k);
+    emitBlock(f, 0, 4 + randomBelow(12));
+    emit("    return ");
+    emitExpression(f, 0, 2 + randomBelow(6));
+    emit(";\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <bytes> [seed]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    long long target = atoll(argv[1]);
+    state = argc > 2 ? (unsigned int)atoi(argv[2]) : 12345;
+    if (state == 0)
+        state = 1;
+
+    // Globals grow with the program so symbol lookups see a realistic scope
+    globalCount = target / 512 < 4 ? 4 : target / 512 > 4096 ? 4096 : (int)(target / 512);
+    arrayCount = globalCount / 16 + 1;
+    for (int g = 0; g < globalCount; g++)
+        emit("int g%d = %d;\n", g, randomBelow(100));
+    for (int a = 0; a < arrayCount; a++)
+        emit("int a%d[%d];\n", a, ARRAY_SIZE);
+
+    // Reserve room for the top-level code
+    while (written < target - 200 && functionCount < (int)(sizeof(paramCounts) / sizeof(paramCounts[0])))
+        emitFunction(functionCount++);
+
+    emit("int total = 0;\n");
+    for (int f = functionCount > 4 ? functionCount - 4 : 0; f < functionCount; f++)
+    {
+        emit("total = total + f%d(", f);
+        for (int p = 0; p < paramCounts[f]; p++)
+            emit("%s%d", p ? ", " : "", 1 + randomBelow(9));
+        emit(");\n");
+    }
+    emit("return total;\n");
+    fprintf(stderr, "generateProgram: %lld bytes, %d functions, %d globals, %d arrays\n", written,
+            functionCount, globalCount, arrayCount);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+// Speedup of --jobs over a serial back end on a generated program with at least
+// the requested number of functions. For each job count the compile runs a few
+// times and the fastest counts; one JSON record per job count gives the wall
+// time, the back end's share of it (bounds checks through delay slots), both
+// speedups over the first job count (1 by default) and whether the output is
+// byte for byte the same as with it.
+// Usage: parallelBenchmark <compiler> <generator> <functions> [jobs...]
+#include "benchmarkHarness.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define REPEATS 3
+#define TIMEOUT_SECONDS 600
+#define BYTES_PER_FUNCTION 6000 // What generateProgram writes per function, roughly
+
+static const char *backEndPhases[] = {"boundsChecks", "select", "regalloc", "mips", "peephole", "schedule",
+                                      "delaySlots"};
+
+// One compile with jobs threads: wall seconds, or -1 when it failed. The back
+// end's seconds and a hash of the output go to backEnd and output.
+static double compile(const char *compiler, const char *path, int jobs, double *backEnd, unsigned long long *output)
+{
+    const char *outputPath = "parallelBenchmark.asm";
+    const char *statsPath = "parallelBenchmark.stats";
+    char jobsOption[32];
+    char statsOption[256];
+    snprintf(jobsOption, sizeof(jobsOption), "--jobs=%d", jobs);
+    snprintf(statsOption, sizeof(statsOption), "--stats=%s", statsPath);
+    unlink(statsPath); // The compiler appends
+    double start = now();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (!freopen("/dev/null", "w", stdout) || !freopen("/dev/null", "w", stderr))
+            _exit(127);
+        alarm(TIMEOUT_SECONDS);
+        execl(compiler, compiler, jobsOption, "--time-phases", statsOption, "-o", outputPath, path, (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    double wall = now() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+
+    char record[8192] = "";
+    FILE *stats = fopen(statsPath, "r");
+    if (!stats || !fgets(record, sizeof(record), stats))
+        return -1;
+    fclose(stats);
+    *backEnd = 0;
+    for (size_t p = 0; p < sizeof(backEndPhases) / sizeof(backEndPhases[0]); p++)
+    {
+        double seconds = phaseSeconds(record, backEndPhases[p]);
+        if (seconds < 0)
+            return -1;
+        *backEnd += seconds;
+    }
+    *output = hashFile(outputPath);
+    unlink(outputPath);
+    unlink(statsPath);
+    return wall;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        fprintf(stderr, "Usage: %s <compiler> <generator> <functions> [jobs...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int wanted = atoi(argv[3]);
+    int jobCounts[64];
+    int jobCount = 0;
+    if (argc > 4)
+    {
+        for (int i = 4; i < argc && jobCount < 64; i++)
+            jobCounts[jobCount++] = atoi(argv[i]);
+    }
+    else
+    {
+        // Powers of two up to twice the cores, and at least up to 8
+        for (int jobs = 1; jobs <= 2 * cores || jobs <= 8; jobs *= 2)
+            jobCounts[jobCount++] = jobs;
+    }
+
+    const char *path = "parallelBenchmark.cmm";
+    long long size = (long long)wanted * BYTES_PER_FUNCTION;
+    int functions = 0;
+    long long bytes = generateProgram(argv[2], size, path, &functions);
+    while (functions < wanted)
+    {
+        size = size * wanted / (functions > 0 ? functions : 1) + BYTES_PER_FUNCTION;
+        bytes = generateProgram(argv[2], size, path, &functions);
+    }
+
+    double serialWall = 0, serialBackEnd = 0;
+    unsigned long long serialOutput = 0;
+    int status = EXIT_SUCCESS;
+    for (int j = 0; j < jobCount; j++)
+    {
+        // The first run's output is the one checked; every run compiles the same program
+        double backEnd = 0;
+        unsigned long long output = 0;
+        double wall = compile(argv[1], path, jobCounts[j], &backEnd, &output);
+        for (int r = 1; r < REPEATS && wall >= 0; r++)
+        {
+            double runBackEnd;
+            unsigned long long runOutput;
+            double runWall = compile(argv[1], path, jobCounts[j], &runBackEnd, &runOutput);
+            if (runWall >= 0 && runWall < wall)
+            {
+                wall = runWall;
+                backEnd = runBackEnd;
+            }
+        }
+        if (wall < 0)
+        {
+            printf("{\"functions\": %d, \"bytes\": %lld, \"cores\": %d, \"jobs\": %d, \"status\": \"failed\"}\n",
+                   functions, bytes, cores, jobCounts[j]);
+            status = EXIT_FAILURE;
+            continue;
+        }
+        if (j == 0)
+        {
+            serialWall = wall;
+            serialBackEnd = backEnd;
+            serialOutput = output;
+        }
+        int same = output == serialOutput;
+        printf("{\"functions\": %d, \"bytes\": %lld, \"cores\": %d, \"jobs\": %d, \"seconds\": %.6f, "
+               "\"backEndSeconds\": %.6f, \"speedup\": %.3f, \"backEndSpeedup\": %.3f, \"sameOutput\": %s}\n",
+               functions, bytes, cores, jobCounts[j], wall, backEnd, serialWall / wall,
+               backEnd > 0 ? serialBackEnd / backEnd : 0, same ? "true" : "false");
+        fflush(stdout);
+        if (!same)
+            status = EXIT_FAILURE;
+    }
+    unlink(path);
+    return status;
+}
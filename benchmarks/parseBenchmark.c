@@ -0,0 +1,154 @@
+// Parse throughput of the bison parser against the hand-written one (--parser=pratt)
+// on generated programs. Each parser runs the front end alone (--syntax-only) a few
+// times per size; the fastest run's lex, parse and symbol table seconds count. The
+// AST each prints is hashed, so every record also says whether the two agree.
+// Usage: parseBenchmark <compiler> <generator> [size...]   sizes like 1K, 10M
+#include "benchmarkHarness.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define REPEATS 5
+#define TIMEOUT_SECONDS 600
+
+static const char *parsers[] = {"bison", "pratt"};
+
+// Hashes what follows "AST: Printing AST" in the compiler's output: the tree itself
+static unsigned long long hashTree(FILE *output)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    char line[4096];
+    int inTree = 0;
+    while (fgets(line, sizeof(line), output))
+    {
+        if (!inTree)
+        {
+            inTree = strcmp(line, "AST: Printing AST\n") == 0;
+            continue;
+        }
+        for (const char *c = line; *c; c++)
+            hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Runs one front end; returns its lex, parse and symbol seconds, or -1 when it
+// failed. With tree set, the AST's hash goes there.
+static double parse(const char *compiler, const char *parser, const char *path, const char *statsPath,
+                    long long *tokens, unsigned long long *tree)
+{
+    char parserOption[64];
+    char statsOption[256];
+    snprintf(parserOption, sizeof(parserOption), "--parser=%s", parser);
+    snprintf(statsOption, sizeof(statsOption), "--stats=%s", statsPath);
+    unlink(statsPath); // The compiler appends
+    int pipeFds[2];
+    if (tree && pipe(pipeFds) != 0)
+    {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (tree)
+        {
+            dup2(pipeFds[1], STDOUT_FILENO);
+            close(pipeFds[0]);
+            close(pipeFds[1]);
+        }
+        else if (!freopen("/dev/null", "w", stdout))
+            _exit(127);
+        if (!freopen("/dev/null", "w", stderr))
+            _exit(127);
+        alarm(TIMEOUT_SECONDS);
+        execl(compiler, compiler, parserOption, "--syntax-only", "--time-phases", statsOption, path, (char *)NULL);
+        _exit(127);
+    }
+    if (tree)
+    {
+        close(pipeFds[1]);
+        FILE *output = fdopen(pipeFds[0], "r");
+        *tree = hashTree(output);
+        fclose(output);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+
+    char record[8192] = "";
+    FILE *stats = fopen(statsPath, "r");
+    if (!stats || !fgets(record, sizeof(record), stats))
+        return -1;
+    fclose(stats);
+    static const char *phases[] = {"lex", "parse", "symbols"};
+    double seconds = 0;
+    for (int p = 0; p < 3; p++)
+    {
+        double phase = phaseSeconds(record, phases[p]);
+        if (phase < 0)
+            return -1;
+        seconds += phase;
+    }
+    const char *found = strstr(record, "\"tokens\": ");
+    *tokens = found ? atoll(found + strlen("\"tokens\": ")) : 0;
+    return seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *defaultSizes[] = {"10K", "100K", "1M", "10M"};
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <compiler> <generator> [size...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char **sizes = argc > 3 ? (const char **)argv + 3 : defaultSizes;
+    int sizeCount = argc > 3 ? argc - 3 : (int)(sizeof(defaultSizes) / sizeof(defaultSizes[0]));
+    const char *path = "parseBenchmark.cmm";
+    const char *statsPath = "parseBenchmark.stats";
+
+    int status = EXIT_SUCCESS;
+    for (int i = 0; i < sizeCount; i++)
+    {
+        long long bytes = generateProgram(argv[2], parseSize(sizes[i]), path, NULL);
+        double best[2];
+        unsigned long long trees[2];
+        long long tokens = 0;
+        for (int p = 0; p < 2; p++)
+        {
+            best[p] = parse(argv[1], parsers[p], path, statsPath, &tokens, &trees[p]);
+            for (int r = 1; r < REPEATS && best[p] > 0; r++)
+            {
+                double seconds = parse(argv[1], parsers[p], path, statsPath, &tokens, NULL);
+                if (seconds >= 0 && seconds < best[p])
+                    best[p] = seconds;
+            }
+        }
+
+        printf("{\"bytes\": %lld, \"tokens\": %lld", bytes, tokens);
+        for (int p = 0; p < 2; p++)
+        {
+            if (best[p] > 0)
+                printf(", \"%s\": {\"seconds\": %.6f, \"bytesPerSecond\": %.0f}", parsers[p], best[p], bytes / best[p]);
+            else
+                printf(", \"%s\": null", parsers[p]);
+        }
+        int same = best[0] > 0 && best[1] > 0 && trees[0] == trees[1];
+        printf(", \"speedup\": ");
+        if (best[0] > 0 && best[1] > 0)
+            printf("%.3f", best[0] / best[1]);
+        else
+            printf("null");
+        printf(", \"sameAst\": %s}\n", same ? "true" : "false");
+        fflush(stdout);
+        if (!same)
+            status = EXIT_FAILURE;
+    }
+    unlink(path);
+    unlink(statsPath);
+    return status;
+}
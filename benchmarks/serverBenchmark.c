@@ -0,0 +1,134 @@
+// Per-request compile latency of a fresh compiler process against a --serve server,
+// reached both through the --client binary and straight over the socket the way an
+// editor integration would. Prints one JSON record per mode with p50, p99 and mean.
+// Usage: serverBenchmark <compiler> <input.cmm> [requests]
+#include "benchmarkHarness.h"
+#include "../CompilerServer.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Runs the compiler with output discarded and returns its exit status
+static int run(char *argv[])
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (!freopen("/dev/null", "w", stdout) || !freopen("/dev/null", "w", stderr))
+            _exit(127);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+static void report(const char *mode, double *latencies, int count)
+{
+    double total = 0;
+    for (int i = 0; i < count; i++)
+        total += latencies[i];
+    qsort(latencies, count, sizeof(double), compareDoubles);
+    printf("{\"mode\": \"%s\", \"requests\": %d, \"p50Ms\": %.3f, \"p99Ms\": %.3f, \"meanMs\": %.3f}\n", mode, count,
+           latencies[count / 2] * 1e3, latencies[(int)(count * 0.99)] * 1e3, total / count * 1e3);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <compiler> <input.cmm> [requests]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int requests = argc > 3 ? atoi(argv[3]) : 200;
+    if (requests < 1)
+        requests = 1;
+    double *latencies = malloc(sizeof(double) * requests);
+    const char *socketPath = "serverBenchmark.sock";
+    char clientOption[256];
+    snprintf(clientOption, sizeof(clientOption), "--client=%s", socketPath);
+    char serveOption[256];
+    snprintf(serveOption, sizeof(serveOption), "--serve=%s", socketPath);
+
+    char *freshArgs[] = {argv[1], "-o", "/dev/null", argv[2], NULL};
+    for (int i = 0; i < requests; i++)
+    {
+        double start = now();
+        if (run(freshArgs) != 0)
+        {
+            fprintf(stderr, "Failed to compile %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        latencies[i] = now() - start;
+    }
+    report("fresh", latencies, requests);
+
+    pid_t server = fork();
+    if (server == 0)
+    {
+        if (!freopen("/dev/null", "w", stderr))
+            _exit(127);
+        execl(argv[1], argv[1], serveOption, (char *)NULL);
+        _exit(127);
+    }
+    // Wait until it accepts; a compile of nothing is cheap and proves the socket is up
+    int null = open("/dev/null", O_RDWR);
+    const int fds[3] = {null, null, null};
+    char *requestArgs[] = {argv[1], "-o", "/dev/null", argv[2], NULL};
+    int ready = 0;
+    for (int attempt = 0; attempt < 500 && !ready; attempt++)
+    {
+        ready = requestCompile(socketPath, 4, requestArgs, fds) == 0;
+        if (!ready)
+            usleep(10000);
+    }
+    if (!ready)
+    {
+        fprintf(stderr, "Server did not come up on %s\n", socketPath);
+        kill(server, SIGTERM);
+        return EXIT_FAILURE;
+    }
+
+    char *clientArgs[] = {argv[1], clientOption, "-o", "/dev/null", argv[2], NULL};
+    for (int i = 0; i < requests; i++)
+    {
+        double start = now();
+        if (run(clientArgs) != 0)
+        {
+            fprintf(stderr, "Failed to compile %s through the client\n", argv[2]);
+            break;
+        }
+        latencies[i] = now() - start;
+    }
+    report("client", latencies, requests);
+
+    for (int i = 0; i < requests; i++)
+    {
+        double start = now();
+        if (requestCompile(socketPath, 4, requestArgs, fds) != 0)
+        {
+            fprintf(stderr, "Failed to compile %s over the socket\n", argv[2]);
+            break;
+        }
+        latencies[i] = now() - start;
+    }
+    report("socket", latencies, requests);
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    close(null);
+    free(latencies);
+    return EXIT_SUCCESS;
+}
@@ -4,9 +4,19 @@
 #include "symbolTable.h"
 #include "IRGeneration.h"
 #include "MipsGeneration.h"
+#include "DataLayout.h"
+#include "Options.h"
+#include "CompilerStats.h"
+#include "CompilerServer.h"
+#include "Profile.h"
+#include "Inlining.h"
+#include "PrattParser.h"
+#include "FunctionCache.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
+#include <unistd.h>
 
 
 
@@ -16,16 +26,35 @@ extern FILE* yyin; // The input file
 extern int yylex();
 extern int yyparse();
 extern char* yytext;
+int countedLex(); // yylex for both parsers
 
-SymbolTable* symbolTable; // The symbol table   
-ASTNode* astRoot; // The root of the AST
+extern SymbolTable* symbolTable; // The symbol table   
+extern ASTNode* astRoot; // The root of the AST
+}
+
+%code {
+// Defined here rather than in the header so the lexer can include it without duplicate symbols
+SymbolTable* symbolTable;
+ASTNode* astRoot;
+
+// The parser pulls tokens through this so lexing is counted and timed on its own
+int countedLex() {
+    enterPhase(PHASE_LEX);
+    int token = yylex();
+    leavePhase();
+    compilerStats.tokens++;
+    return token;
+}
+#define yylex countedLex
+
+static void streamStatement(ASTNode *statement);
 }
 
 %start program
 
 %union {
     int intValue;        // For integer values, typically used with NUMBER
-    double floatValue;   // For floating-point values, used with FLOAT
+    double floatValue;   // For floating-point values, used with FLOAT_LITERAL
     char* strValue;      // For string values, used with STRING
     char* identifier;    // For identifiers, used with IDENTIFIER
     struct ASTNode* astNode;    // For AST nodes
@@ -33,17 +62,20 @@ ASTNode* astRoot; // The root of the AST
 }
 
 %token <intValue> NUMBER      // INTEGER literals from the lexer
-%token <floatValue> FLOAT     // FLOAT literals from the lexer
+%token <floatValue> FLOAT_LITERAL // FLOAT literals from the lexer
 %token <strValue> STRING      // STRING literals from the lexer
 %token <identifier> IDENTIFIER  // Identifiers, such as variable names
-%token INT VOID  // Type keywords
+%token INT FLOAT VOID  // Type keywords
 
-%type <astNode> program statement block assignment arrayDeclaration arrayAccess declaration ifStatement whileLoop functionDeclaration functionCall returnStatement expression parameters parameterList arguments
+%type <astNode> program statement statementList block assignment arrayDeclaration arrayAccess declaration ifStatement whileLoop functionDeclaration functionCall returnStatement expression parameters parameterList arguments
 %type <typeCode> TYPE
 
 %token PLUS MINUS MULTIPLY DIVIDE LPAREN RPAREN SEMICOLON ASSIGN 
 %token LBRACKET RBRACKET IF ELSE WHILE LBRACE RBRACE COMMA RETURN
+%token LT GT LE GE EQ NE
 
+%nonassoc EQ NE
+%nonassoc LT GT LE GE
 %left PLUS MINUS 
 %left MULTIPLY DIVIDE
 
@@ -71,6 +103,8 @@ program:
         
         if (astRoot != NULL && $2 != NULL) {
             addChildNode(astRoot, $2);
+            if (compilerOptions.stream)
+                streamStatement($2);
         } else {
             if (astRoot == NULL) {
                 fprintf(stderr, "Error: AST root is NULL when adding a statement.\n");
@@ -96,11 +130,6 @@ statement:
         $$ = $1;
         printf("PARSER: Executing statement -> arrayDeclaration;\n");
     }
-    | arrayAccess SEMICOLON
-    {
-        $$ = $1;
-        printf("PARSER: Executing statement -> arrayAccess;\n");
-    }
     | declaration SEMICOLON
     {
         $$ = $1;
@@ -121,11 +150,6 @@ statement:
         $$ = $1;
         printf("PARSER: Executing statement -> functionDeclaration\n");
     }
-    | functionCall 
-    {
-        $$ = $1;
-        printf("PARSER: Executing statement -> functionCall;\n");
-    }
     | returnStatement SEMICOLON
     {
         $$ = $1;
@@ -153,6 +177,13 @@ assignment:
         }
         free($1);
     }
+    | arrayAccess ASSIGN expression {
+        printf("PARSER: Executing assignment -> identifier[expression] assign expression\n");
+        ASTNode* assignNode = createASTNode(AST_ASSIGNMENT);
+        addChildNode(assignNode, $1);
+        addChildNode(assignNode, $3);
+        $$ = assignNode;
+    }
 ;
 
 arrayDeclaration:
@@ -272,14 +303,38 @@ functionDeclaration:
 
 
 parameters:
-    parameterList  
+    /* empty */
+    {
+        $$ = createASTNode(AST_PARAMETER_LIST);
+    }
+    | parameterList  
     { $$ = $1; } 
-    /* There's no need for the "no parameters" case anymore */
 ;
 
 
 parameterList:
-    IDENTIFIER
+    TYPE IDENTIFIER
+    {
+        ASTNode* paramNode = createASTNode(AST_PARAMETER);
+        paramNode->value.strValue = strdup($2);
+        addChildNode(paramNode, createTypeNode(AST_TYPE, $1));
+
+        ASTNode* paramList = createASTNode(AST_PARAMETER_LIST);
+        addChildNode(paramList, paramNode);
+        addSymbolToCurrentScope(symbolTable, $2, $1);
+
+        $$ = paramList;
+    }
+    | parameterList COMMA TYPE IDENTIFIER
+    {
+        ASTNode* paramNode = createASTNode(AST_PARAMETER);
+        paramNode->value.strValue = strdup($4);
+        addChildNode(paramNode, createTypeNode(AST_TYPE, $3));
+        addChildNode($1, paramNode);
+        addSymbolToCurrentScope(symbolTable, $4, $3);
+        $$ = $1;
+    }
+    | IDENTIFIER
     {
         // Create a new parameter node
         ASTNode* paramNode = createASTNode(AST_PARAMETER);
@@ -305,7 +360,18 @@ parameterList:
 
 
 functionCall:
-    IDENTIFIER LPAREN arguments RPAREN SEMICOLON
+    IDENTIFIER LPAREN RPAREN
+    {
+        printf("PARSER: Executing function call -> identifier()\n");
+        ASTNode* callNode = createASTNode(AST_FUNCTION_CALL);
+        ASTNode* nameNode = createASTNode(AST_VARIABLE);
+        nameNode->value.strValue = strdup($1);
+        addChildNode(callNode, nameNode);
+        addChildNode(callNode, createASTNode(AST_ARGUMENTS));
+        $$ = callNode;
+        free($1);
+    }
+    | IDENTIFIER LPAREN arguments RPAREN
     {
         printf("PARSER: Executing function call -> identifier(arguments)\n");
         ASTNode* callNode = createASTNode(AST_FUNCTION_CALL);
@@ -356,11 +422,27 @@ block:
         printf("PARSER: Executing block start -> {\n");
         pushScope(symbolTable);
     }
-    program
+    statementList
     RBRACE
     {
         printf("PARSER: Executing block end -> }\n");
         popScope(symbolTable);
+        $$ = $3;
+    }
+;
+
+// Blocks collect their own statements; going through program would replace astRoot
+statementList:
+    /* empty */
+    {
+        $$ = createASTNode(AST_BLOCK);
+    }
+    | statementList statement
+    {
+        if ($2 != NULL) {
+            addChildNode($1, $2);
+        }
+        $$ = $1;
     }
 ;
 
@@ -372,6 +454,13 @@ expression:
         numNode->value.intValue = $1;
         $$ = numNode;
     }
+    | FLOAT_LITERAL
+    {
+        printf("PARSER: Executing expression -> float literal\n");
+        ASTNode* numNode = createASTNode(AST_FLOAT_LITERAL);
+        numNode->value.floatValue = $1;
+        $$ = numNode;
+    }
     | IDENTIFIER
     {
         printf("PARSER: Executing expression -> identifier\n");
@@ -384,6 +473,11 @@ expression:
         printf("PARSER: Executing expression -> functionCall;\n");
         $$ = $1; 
     }
+    | arrayAccess
+    {
+        printf("PARSER: Executing expression -> arrayAccess\n");
+        $$ = $1;
+    }
     | expression PLUS expression
     {
         printf("PARSER: Executing expression -> expression + expression\n");
@@ -420,6 +514,60 @@ expression:
         addChildNode(exprNode, $3);
         $$ = exprNode;
     }
+    | expression LT expression
+    {
+        printf("PARSER: Executing expression -> expression < expression\n");
+        ASTNode* exprNode = createASTNode(AST_BINARY_EXPR);
+        exprNode->value.opType = OP_LESS;
+        addChildNode(exprNode, $1);
+        addChildNode(exprNode, $3);
+        $$ = exprNode;
+    }
+    | expression LE expression
+    {
+        printf("PARSER: Executing expression -> expression <= expression\n");
+        ASTNode* exprNode = createASTNode(AST_BINARY_EXPR);
+        exprNode->value.opType = OP_LESS_EQUAL;
+        addChildNode(exprNode, $1);
+        addChildNode(exprNode, $3);
+        $$ = exprNode;
+    }
+    | expression GT expression
+    {
+        printf("PARSER: Executing expression -> expression > expression\n");
+        ASTNode* exprNode = createASTNode(AST_BINARY_EXPR);
+        exprNode->value.opType = OP_GREATER;
+        addChildNode(exprNode, $1);
+        addChildNode(exprNode, $3);
+        $$ = exprNode;
+    }
+    | expression GE expression
+    {
+        printf("PARSER: Executing expression -> expression >= expression\n");
+        ASTNode* exprNode = createASTNode(AST_BINARY_EXPR);
+        exprNode->value.opType = OP_GREATER_EQUAL;
+        addChildNode(exprNode, $1);
+        addChildNode(exprNode, $3);
+        $$ = exprNode;
+    }
+    | expression EQ expression
+    {
+        printf("PARSER: Executing expression -> expression == expression\n");
+        ASTNode* exprNode = createASTNode(AST_BINARY_EXPR);
+        exprNode->value.opType = OP_EQUAL;
+        addChildNode(exprNode, $1);
+        addChildNode(exprNode, $3);
+        $$ = exprNode;
+    }
+    | expression NE expression
+    {
+        printf("PARSER: Executing expression -> expression != expression\n");
+        ASTNode* exprNode = createASTNode(AST_BINARY_EXPR);
+        exprNode->value.opType = OP_NOT_EQUAL;
+        addChildNode(exprNode, $1);
+        addChildNode(exprNode, $3);
+        $$ = exprNode;
+    }
     | LPAREN expression RPAREN
     {
         printf("PARSER: Executing expression -> (expression)\n");
@@ -430,55 +578,212 @@ expression:
 
 %%
 
-int main() {  
-    /* extern int yydebug;
-    yydebug = 1; */
+// "-o -" sends the assembly to stdout after the diagnostics
+static AsmEmitter *openOutput() {
+    AsmEmitter *out = strcmp(compilerOptions.outputFile, "-") == 0
+        ? createStreamEmitter(stdout)
+        : createFileEmitter(compilerOptions.outputFile);
+    if (!out) {
+        perror("Failed to open output file");
+        exit(EXIT_FAILURE);
+    }
+    return out;
+}
 
-    clock_t startTime, endTime;
-    double cpuTimeUsed;
+// --stream: each function is lowered, optimized and written the moment the parser
+// completes it, then its body's AST and IR are freed, leaving only its signature.
+// Global declarations are laid out as they arrive; the other top-level statements
+// wait in astRoot and become main at the end.
+static void streamStatement(ASTNode *statement) {
+    if (statement->type == AST_DECLARATION || statement->type == AST_ARRAY_DECLARATION) {
+        declareGlobal(statement);
+        return;
+    }
+    if (statement->type != AST_FUNCTION_DECLARATION)
+        return;
 
-    startTime = clock(); // Start the timer
+    enterPhase(PHASE_DUMP);
+    printAST(statement, 0);
+    leavePhase();
 
-    yyin = fopen("test1.cmm", "r");
-    if (!yyin) {
-        fprintf(stderr, "Could not open input file\n");
-        return 1;
-    }
+    enterPhase(PHASE_IR);
+    IRInstruction *unit = generateStreamedFunctionIR(astRoot, statement);
+    leavePhase();
 
-    symbolTable = createSymbolTable(); // Initialize the symbol table
+    enterPhase(PHASE_DUMP);
+    printIRInstructions(unit);
+    leavePhase();
 
+    enterPhase(PHASE_MIPS);
+    generateStreamedUnit(unit);
+    leavePhase();
 
-    if (yyparse() == 0) {
-        printf("PARSER: Parsing completed successfully\n");
-    } else {
-        printf("PARSER: Parsing failed\n");
+    freeAST(statement->children[3]);
+    statement->children[3] = NULL;
+}
+
+static void finishStreaming() {
+    enterPhase(PHASE_IR);
+    printf("IR: Creating IR instruction\n");
+    IRInstruction *mainUnit = generateIRForNode(astRoot);
+    leavePhase();
+    if (mainUnit == NULL) {
+        fprintf(stderr, "Error generating IR instructions\n");
+        exit(EXIT_FAILURE);
     }
 
+    enterPhase(PHASE_DUMP);
+    printIRInstructions(mainUnit);
+    leavePhase();
+
+    enterPhase(PHASE_MIPS);
+    generateStreamedUnit(mainUnit);
+    finishStreamingMIPS();
+    leavePhase();
+}
+
+// --syntax-only: the tree as compileProgram would print it first
+static void printSyntaxTree() {
+    enterPhase(PHASE_DUMP);
+    printf("AST: Printing AST\n");
+    if (astRoot)
+        printAST(astRoot, 0);
+    leavePhase();
+}
+
+static void compileProgram(AsmEmitter *out) {
+    enterPhase(PHASE_DUMP);
     printf("AST: Printing AST\n");
     printAST(astRoot, 0); 
+    leavePhase();
 
+    enterPhase(PHASE_IR);
     printf("IR: Creating IR instruction\n");
     IRInstruction *irHead = generateIRForNode(astRoot);
+    if (compilerOptions.profileUse)
+        inlineHotCalls(irHead);
+    leavePhase();
+
+    enterPhase(PHASE_DUMP);
     printIRInstructions(irHead);
+    leavePhase();
 
     if (irHead == NULL) {
         fprintf(stderr, "Error generating IR instructions\n");
+        exit(EXIT_FAILURE);
+    }
+
+    enterPhase(PHASE_MIPS);
+    printf("MIPS: Generating MIPS code\n");
+    generateMIPS(irHead, out); // Translate the IR instructions to assembly code
+    leavePhase();
+}
+
+// One whole compile; a --serve worker runs it with the arguments of its request
+static int compile(int argc, char* argv[]) {
+    /* extern int yydebug;
+    yydebug = 1; */
+
+    if (!parseCompilerOptions(argc, argv)) {
         return 1;
     }
+    memset(&compilerStats, 0, sizeof(compilerStats)); // A worker inherits the server's
+    startCompilerStats();
+    if (compilerOptions.profileUse)
+        loadProfile(compilerOptions.profileUse);
 
+    yyin = strcmp(compilerOptions.inputFile, "-") == 0 ? stdin : fopen(compilerOptions.inputFile, "r");
+    if (!yyin) {
+        fprintf(stderr, "Could not open input file\n");
+        return 1;
+    }
 
-    endTime = clock();
-    cpuTimeUsed = ((double) (endTime - startTime)) / CLOCKS_PER_SEC;
+    symbolTable = createSymbolTable(); // Initialize the symbol table
 
-    printf("Compilation Time: %f seconds\n", cpuTimeUsed);
-    
-    printf("MIPS: Generating MIPS code\n");
-    generateMIPS(irHead, "output.asm"); // Translate the IR instructions to assembly code
+    AsmEmitter *out = compilerOptions.syntaxOnly ? NULL : openOutput();
+    if (compilerOptions.stream)
+        beginStreamingMIPS(out);
+    if (compilerOptions.cacheDirectory)
+        openFunctionCache(compilerOptions.cacheDirectory, compilerOptions.cacheLimit);
+
+    enterPhase(PHASE_PARSE);
+    int failed = compilerOptions.prattParser ? prattParse(compilerOptions.stream ? streamStatement : NULL) : yyparse();
+    if (!failed) {
+        printf("PARSER: Parsing completed successfully\n");
+    } else {
+        printf("PARSER: Parsing failed\n");
+    }
+    leavePhase();
+
+    if (compilerOptions.syntaxOnly)
+        printSyntaxTree();
+    else if (compilerOptions.stream)
+        finishStreaming();
+    else
+        compileProgram(out);
+
+    if (out) {
+        enterPhase(PHASE_WRITE);
+        if (closeEmitter(out) != 0) {
+            fprintf(stderr, "Failed to write %s\n", compilerOptions.outputFile);
+            return 1;
+        }
+        leavePhase();
+    }
+    if (compilerOptions.cacheDirectory)
+        closeFunctionCache();
     
     fclose(yyin);
     freeSymbolTable(symbolTable); // Clean up the symbol table
 
-    return 0;
+    // One record per compile, appended so a stats file collects a whole build
+    if (compilerOptions.stats || compilerOptions.timePhases) {
+        FILE *statsOut = compilerOptions.statsFile ? fopen(compilerOptions.statsFile, "a") : stderr;
+        if (!statsOut) {
+            perror("Failed to open stats file");
+            return 1;
+        }
+        writeCompilerStats(statsOut);
+        if (statsOut != stderr)
+            fclose(statsOut);
+    }
+
+    return compilerOptions.syntaxOnly && failed; // A full compile carries on past syntax errors
+}
+
+// Passes everything but --client itself on, with this process's stdin, stdout and stderr
+static int compileOnServer(int argc, char* argv[]) {
+    char **request = malloc(sizeof(char *) * argc);
+    int count = 0;
+    for (int i = 0; i < argc; i++) {
+        if (strncmp(argv[i], "--client=", 9) != 0)
+            request[count++] = argv[i];
+    }
+    const int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    int status = requestCompile(compilerOptions.clientSocket, count, request, fds);
+    free(request);
+    if (status < 0) {
+        perror("Failed to reach compiler server");
+        return 1;
+    }
+    return status;
+}
+
+// A server started with --cache keeps that directory's entries in memory for its workers
+static void warmServer() {
+    if (compilerOptions.cacheDirectory)
+        keepFunctionCacheResident(compilerOptions.cacheDirectory);
+}
+
+int main(int argc, char* argv[]) {
+    if (!parseCompilerOptions(argc, argv)) {
+        return 1;
+    }
+    if (compilerOptions.serveSocket)
+        return serveCompiler(compilerOptions.serveSocket, compile, warmServer);
+    if (compilerOptions.clientSocket)
+        return compileOnServer(argc, argv);
+    return compile(argc, argv);
 }
 
 int yyerror(const char* s) {
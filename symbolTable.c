@@ -1,4 +1,5 @@
 #include "symbolTable.h"
+#include "CompilerStats.h"
 
 SymbolTable *createSymbolTable()
 {
@@ -15,6 +16,7 @@ SymbolTable *createSymbolTable()
 
 void pushScope(SymbolTable *table)
 {
+    enterPhase(PHASE_SYMBOLS);
     Scope *newScope = (Scope *)malloc(sizeof(Scope));
     if (!newScope)
     {
@@ -24,6 +26,7 @@ void pushScope(SymbolTable *table)
     newScope->entries = NULL;
     newScope->next = table->top;
     table->top = newScope;
+    leavePhase();
 }
 
 // Pop the top scope from the stack
@@ -32,6 +35,7 @@ void popScope(SymbolTable *table)
     if (table->top == NULL)
         return;
 
+    enterPhase(PHASE_SYMBOLS);
     Scope *topScope = table->top;
     table->top = topScope->next;
 
@@ -44,6 +48,7 @@ void popScope(SymbolTable *table)
         entry = next;
     }
     free(topScope);
+    leavePhase();
 }
 
 // Add a symbol to the current (top) scope
@@ -55,6 +60,8 @@ void addSymbolToCurrentScope(SymbolTable *table, char *identifier, TypeCode type
         return;
     }
 
+    enterPhase(PHASE_SYMBOLS);
+    compilerStats.symbolsAdded++;
     SymbolTableEntry *newEntry = (SymbolTableEntry *)malloc(sizeof(SymbolTableEntry));
     if (!newEntry)
     {
@@ -65,22 +72,29 @@ void addSymbolToCurrentScope(SymbolTable *table, char *identifier, TypeCode type
     newEntry->type = type;
     newEntry->next = table->top->entries;
     table->top->entries = newEntry;
+    leavePhase();
 }
 
 // Find a symbol in the table starting from the current scope and moving outwards
 SymbolTableEntry *findSymbol(SymbolTable *table, char *identifier)
 {
-    for (Scope *scope = table->top; scope != NULL; scope = scope->next)
+    enterPhase(PHASE_SYMBOLS);
+    compilerStats.symbolLookups++;
+    SymbolTableEntry *found = NULL;
+    for (Scope *scope = table->top; scope != NULL && !found; scope = scope->next)
     {
         for (SymbolTableEntry *entry = scope->entries; entry != NULL; entry = entry->next)
         {
+            compilerStats.symbolProbes++;
             if (strcmp(entry->identifier, identifier) == 0)
             {
-                return entry;
+                found = entry;
+                break;
             }
         }
     }
-    return NULL;
+    leavePhase();
+    return found;
 }
 
 // Free the symbol table and all scopes